@@ -141,6 +141,17 @@ static int log_index_operation(cls_method_context_t hctx, cls_rgw_obj_key& obj_k
   return cls_cxx_map_set_val(hctx, key, &bl);
 }
 
+/*
+ * whether an index change goes to the bucket index log. while an online
+ * reshard copies the shard, every change is logged so that the new shards
+ * can replay the ones that raced with the copy
+ */
+static bool bi_log_needed(const rgw_bucket_dir_header& header, bool log_op)
+{
+  return (log_op && !header.syncstopped) ||
+    header.new_instance.resharding_online();
+}
+
 /*
  * read list of objects, skips objects in the ugly namespace
  */
@@ -424,6 +435,20 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
   uint32_t left_to_read = op.num_entries;
   bool more;
 
+  /* entries sorting before skip_key belong to a common prefix which was
+   * already returned */
+  string skip_key;
+  if (!op.delimiter.empty()) {
+    /* a marker inside a common prefix is where the previous listing
+     * stopped after returning that prefix */
+    size_t pos = op.start_obj.name.find(op.delimiter, op.filter_prefix.size());
+    if (pos != string::npos) {
+      skip_key = op.start_obj.name.substr(0, pos + op.delimiter.size());
+      skip_key.append(1, (char)0xFF);
+      start_key = skip_key;
+    }
+  }
+
   do {
     rc = get_obj_vals(hctx, start_key, op.filter_prefix, left_to_read, &keys, &more);
     if (rc < 0)
@@ -441,6 +466,10 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
         break;
       }
 
+      if (kiter->first < skip_key) {
+        continue;
+      }
+
       bufferlist& entrybl = kiter->second;
       auto eiter = entrybl.cbegin();
       try {
@@ -472,8 +501,33 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
         CLS_LOG(20, "entry %s[%s] is not visible\n", key.name.c_str(), key.instance.c_str());
         continue;
       }
+
+      if (!op.delimiter.empty()) {
+        size_t pos = key.name.find(op.delimiter, op.filter_prefix.size());
+        if (pos != string::npos) {
+          /* return a single entry for the common prefix, and seek past
+           * the rest of it instead of reading every entry under it */
+          string prefix_key = key.name.substr(0, pos + op.delimiter.size());
+          if (m.size() < op.num_entries) {
+            rgw_bucket_dir_entry& prefix_entry = m[prefix_key];
+            prefix_entry.key.name = prefix_key;
+            prefix_entry.exists = true;
+            prefix_entry.flags = RGW_BUCKET_DIRENT_FLAG_COMMON_PREFIX;
+          }
+          left_to_read--;
+
+          skip_key = std::move(prefix_key);
+          skip_key.append(1, (char)0xFF);
+          start_key = skip_key;
+          CLS_LOG(20, "got common prefix %s m.size()=%d\n", escape_str(skip_key).c_str(), (int)m.size());
+          continue;
+        }
+      }
+
       if (m.size() < op.num_entries) {
-        m[kiter->first] = entry;
+        /* listings don't return the data of inlined objects */
+        entry.inline_data.reset();
+        m[kiter->first] = std::move(entry);
       }
       left_to_read--;
 
@@ -563,6 +617,32 @@ static int write_bucket_header(cls_method_context_t hctx, rgw_bucket_dir_header
   return cls_cxx_map_write_header(hctx, &header_bl);
 }
 
+/*
+ * log a change to the index entries of an object which is otherwise not
+ * logged, for an online reshard to pick it up
+ */
+static int log_reshard_change(cls_method_context_t hctx, cls_rgw_obj_key& key,
+                              string& tag)
+{
+  rgw_bucket_dir_header header;
+  int rc = read_bucket_header(hctx, &header);
+  if (rc < 0) {
+    return rc;
+  }
+  if (!header.new_instance.resharding_online()) {
+    return 0;
+  }
+  real_time mtime;
+  rgw_bucket_entry_ver ver;
+  rc = log_index_operation(hctx, key, CLS_RGW_OP_UNKNOWN, tag, mtime, ver,
+                           CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker,
+                           0, NULL, NULL, NULL);
+  if (rc < 0) {
+    return rc;
+  }
+  return write_bucket_header(hctx, &header);
+}
+
 
 int rgw_bucket_rebuild_index(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 {
@@ -714,7 +794,7 @@ int rgw_bucket_prepare_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     return rc;
   }
 
-  if (op.log_op && !header.syncstopped) {
+  if (bi_log_needed(header, op.log_op)) {
     rc = log_index_operation(hctx, op.key, op.op, op.tag, entry.meta.mtime,
                              entry.ver, info.state, header.ver, header.max_marker, op.bilog_flags, NULL, NULL, &op.zones_trace);
     if (rc < 0)
@@ -728,7 +808,7 @@ int rgw_bucket_prepare_op(cls_method_context_t hctx, bufferlist *in, bufferlist
   if (rc < 0)
     return rc;
 
-  if (op.log_op && !header.syncstopped)
+  if (bi_log_needed(header, op.log_op))
     return write_bucket_header(hctx, &header);
   return 0;
 }
@@ -822,6 +902,14 @@ static int read_key_entry(cls_method_context_t hctx, cls_rgw_obj_key& key,
   return 0;
 }
 
+static int complete_op(cls_method_context_t hctx, rgw_cls_obj_complete_op& op,
+                       rgw_bucket_inline_data *inline_data);
+static int apply_complete_op(cls_method_context_t hctx,
+                             rgw_bucket_dir_header& header,
+                             rgw_cls_obj_complete_op& op,
+                             rgw_bucket_inline_data *inline_data,
+                             bool *header_changed, bool *wrote);
+
 int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 {
   // decode request
@@ -838,6 +926,16 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
           (unsigned long)op.ver.pool, (unsigned long long)op.ver.epoch,
           op.tag.c_str());
 
+  return complete_op(hctx, op, nullptr);
+}
+
+/*
+ * apply a complete op. an added entry holds inline_data if given, and any
+ * data inlined before is dropped otherwise
+ */
+static int complete_op(cls_method_context_t hctx, rgw_cls_obj_complete_op& op,
+                       rgw_bucket_inline_data *inline_data)
+{
   rgw_bucket_dir_header header;
   int rc = read_bucket_header(hctx, &header);
   if (rc < 0) {
@@ -845,11 +943,32 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     return -EINVAL;
   }
 
+  bool header_changed = false;
+  bool wrote = false;
+  rc = apply_complete_op(hctx, header, op, inline_data, &header_changed, &wrote);
+  if (rc < 0 || !header_changed) {
+    return rc;
+  }
+  return write_bucket_header(hctx, &header);
+}
+
+/*
+ * apply a complete op to the entries, bilog and the given header, which the
+ * caller writes if header_changed is set. the op is checked before anything
+ * is written, and wrote is set once it starts writing, so an op that fails
+ * with wrote unset changed neither the header nor the omap
+ */
+static int apply_complete_op(cls_method_context_t hctx,
+                             rgw_bucket_dir_header& header,
+                             rgw_cls_obj_complete_op& op,
+                             rgw_bucket_inline_data *inline_data,
+                             bool *header_changed, bool *wrote)
+{
   rgw_bucket_dir_entry entry;
   bool ondisk = true;
 
   string idx;
-  rc = read_key_entry(hctx, op.key, &idx, &entry);
+  int rc = read_key_entry(hctx, op.key, &idx, &entry);
   if (rc == -ENOENT) {
     entry.key = op.key;
     entry.ver = op.ver;
@@ -884,9 +1003,15 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     cancel = true;
   }
 
+  if (!cancel && op.op == CLS_RGW_OP_DEL && !ondisk) {
+    return -ENOENT;
+  }
+
+  *wrote = true;
+
   bufferlist op_bl;
   if (cancel) {
-    if (op.log_op && !header.syncstopped) {
+    if (bi_log_needed(header, op.log_op)) {
       rc = log_index_operation(hctx, op.key, op.op, op.tag, entry.meta.mtime, entry.ver,
                                CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, op.bilog_flags, NULL, NULL, &op.zones_trace);
       if (rc < 0)
@@ -901,9 +1026,7 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
         return rc;
     }
 
-    if (op.log_op && !header.syncstopped) {
-      return write_bucket_header(hctx, &header);
-    }
+    *header_changed = bi_log_needed(header, op.log_op);
     return 0;
   }
 
@@ -915,6 +1038,7 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
   switch ((int)op.op) {
   case CLS_RGW_OP_DEL:
     entry.meta = op.meta;
+    entry.inline_data.reset();
     if (ondisk) {
       if (!entry.pending_map.size()) {
 	int ret = cls_cxx_map_remove_key(hctx, idx);
@@ -928,8 +1052,6 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
 	if (ret < 0)
 	  return ret;
       }
-    } else {
-      return -ENOENT;
     }
     break;
   case CLS_RGW_OP_ADD:
@@ -940,6 +1062,11 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
       entry.key = op.key;
       entry.exists = true;
       entry.tag = op.tag;
+      if (inline_data) {
+        entry.inline_data = std::move(*inline_data);
+      } else {
+        entry.inline_data.reset();
+      }
       stats.num_entries++;
       stats.total_size += meta.accounted_size;
       stats.total_size_rounded += cls_rgw_get_rounded_size(meta.accounted_size);
@@ -953,7 +1080,7 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     break;
   }
 
-  if (op.log_op && !header.syncstopped) {
+  if (bi_log_needed(header, op.log_op)) {
     rc = log_index_operation(hctx, op.key, op.op, op.tag, entry.meta.mtime, entry.ver,
                              CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, op.bilog_flags, NULL, NULL, &op.zones_trace);
     if (rc < 0)
@@ -981,7 +1108,7 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
 	    int(remove_entry.meta.category));
     unaccount_entry(header, remove_entry);
 
-    if (op.log_op && !header.syncstopped) {
+    if (bi_log_needed(header, op.log_op)) {
       ++header.ver; // increment index version, or we'll overwrite keys previously written
       rc = log_index_operation(hctx, remove_key, CLS_RGW_OP_DEL, op.tag, remove_entry.meta.mtime,
                                remove_entry.ver, CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, op.bilog_flags, NULL, NULL, &op.zones_trace);
@@ -996,9 +1123,164 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     }
   }
 
+  *header_changed = true;
+  return 0;
+}
+
+/*
+ * apply the complete ops of many objects in one transaction, reading and
+ * writing the header once. the ops are applied in order. an op that fails
+ * its checks, like one with an unknown tag, is skipped without failing the
+ * others. an op that fails once it started writing fails the whole batch so
+ * that none of it is applied, and the client sends the ops one at a time
+ */
+static int rgw_bucket_complete_ops(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  // decode request
+  rgw_cls_obj_complete_ops_op op;
+  auto iter = in->cbegin();
+  try {
+    decode(op, iter);
+  } catch (buffer::error& err) {
+    CLS_LOG(1, "ERROR: rgw_bucket_complete_ops(): failed to decode request\n");
+    return -EINVAL;
+  }
+  CLS_LOG(10, "rgw_bucket_complete_ops(): request: ops=%d\n", (int)op.ops.size());
+
+  /* entries written by an op aren't visible to the reads of later ops in the
+   * same transaction, so each entry may only be touched once */
+  set<cls_rgw_obj_key> keys;
+  for (auto& o : op.ops) {
+    set<cls_rgw_obj_key> op_keys{o.remove_objs.begin(), o.remove_objs.end()};
+    op_keys.insert(o.key);
+    for (auto& k : op_keys) {
+      if (keys.count(k)) {
+        CLS_LOG(1, "ERROR: rgw_bucket_complete_ops(): duplicate entry name=%s instance=%s\n",
+                k.name.c_str(), k.instance.c_str());
+        return -EINVAL;
+      }
+    }
+    keys.insert(op_keys.begin(), op_keys.end());
+  }
+
+  rgw_bucket_dir_header header;
+  int rc = read_bucket_header(hctx, &header);
+  if (rc < 0) {
+    CLS_LOG(1, "ERROR: rgw_bucket_complete_ops(): failed to read header\n");
+    return -EINVAL;
+  }
+
+  bool header_changed = false;
+  for (auto& o : op.ops) {
+    bool changed = false;
+    bool wrote = false;
+    rc = apply_complete_op(hctx, header, o, nullptr, &changed, &wrote);
+    if (rc < 0 && wrote) {
+      CLS_LOG(0, "ERROR: rgw_bucket_complete_ops(): op=%d name=%s instance=%s tag=%s failed, rc=%d\n",
+              o.op, o.key.name.c_str(), o.key.instance.c_str(), o.tag.c_str(), rc);
+      return rc;
+    }
+    if (rc < 0) {
+      CLS_LOG(1, "rgw_bucket_complete_ops(): op=%d name=%s instance=%s tag=%s skipped, rc=%d\n",
+              o.op, o.key.name.c_str(), o.key.instance.c_str(), o.tag.c_str(), rc);
+      continue;
+    }
+    if (changed) {
+      // bump the version between ops as write_bucket_header() would, so
+      // their bilog entries get their own keys
+      ++header.ver;
+      header_changed = true;
+    }
+  }
+
+  if (!header_changed) {
+    return 0;
+  }
   return write_bucket_header(hctx, &header);
 }
 
+static int rgw_bucket_put_inline(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  // decode request
+  rgw_cls_obj_put_inline_op op;
+  auto iter = in->cbegin();
+  try {
+    decode(op, iter);
+  } catch (buffer::error& err) {
+    CLS_LOG(1, "ERROR: rgw_bucket_put_inline(): failed to decode request\n");
+    return -EINVAL;
+  }
+  CLS_LOG(1, "rgw_bucket_put_inline(): request: name=%s size=%u mode=%d\n",
+          op.op.key.name.c_str(), op.inline_data.data.length(), (int)op.mode);
+
+  /* there is no prepare to complete, and versioned entries are linked
+   * through their olh instead */
+  if (op.op.op != CLS_RGW_OP_ADD || !op.op.tag.empty() ||
+      !op.op.key.instance.empty()) {
+    return -EINVAL;
+  }
+
+  switch (op.mode) {
+  case CLS_RGW_PUT_INLINE_OVERWRITE:
+    break;
+  case CLS_RGW_PUT_INLINE_EXCLUSIVE:
+  case CLS_RGW_PUT_INLINE_REPLACE_INLINE:
+    {
+      /* checked in the same transaction as the write, so a head object
+       * written by a regular put can't be orphaned */
+      rgw_bucket_dir_entry entry;
+      string idx;
+      int rc = read_key_entry(hctx, op.op.key, &idx, &entry);
+      if (rc < 0 && rc != -ENOENT) {
+        return rc;
+      }
+      if (rc == 0 && entry.exists &&
+          (op.mode == CLS_RGW_PUT_INLINE_EXCLUSIVE || !entry.inline_data)) {
+        return -EEXIST;
+      }
+    }
+    break;
+  default:
+    return -EINVAL;
+  }
+
+  return complete_op(hctx, op.op, &op.inline_data);
+}
+
+static int rgw_guard_inline_entry(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  rgw_cls_guard_inline_entry_op op;
+  auto iter = in->cbegin();
+  try {
+    decode(op, iter);
+  } catch (buffer::error& err) {
+    CLS_LOG(1, "ERROR: rgw_guard_inline_entry(): failed to decode request\n");
+    return -EINVAL;
+  }
+
+  rgw_bucket_dir_entry entry;
+  string idx;
+  int rc = read_key_entry(hctx, op.key, &idx, &entry);
+  if (rc == -ENOENT) {
+    return op.ret_err;
+  }
+  if (rc < 0) {
+    return rc;
+  }
+
+  /* a regular put or another inline put replaced the object we read */
+  if (!entry.exists || !entry.inline_data) {
+    return op.ret_err;
+  }
+  auto& attrs = entry.inline_data->attrs;
+  auto tag = attrs.find(RGW_BUCKET_INLINE_ID_TAG_ATTR);
+  if (tag == attrs.end() || !tag->second.contents_equal(op.id_tag)) {
+    return op.ret_err;
+  }
+
+  return 0;
+}
+
 template <class T>
 static int write_entry(cls_method_context_t hctx, T& entry, const string& key)
 {
@@ -1563,7 +1845,7 @@ static int rgw_bucket_link_olh(cls_method_context_t hctx, bufferlist *in, buffer
     return ret;
   }
 
-  if (op.log_op && !header.syncstopped) {
+  if (bi_log_needed(header, op.log_op)) {
     rgw_bucket_dir_entry& entry = obj.get_dir_entry();
 
     rgw_bucket_entry_ver ver;
@@ -1722,7 +2004,7 @@ static int rgw_bucket_unlink_instance(cls_method_context_t hctx, bufferlist *in,
     return ret;
   }
 
-  if (op.log_op && !header.syncstopped) {
+  if (bi_log_needed(header, op.log_op)) {
     rgw_bucket_entry_ver ver;
     ver.epoch = (op.olh_epoch ? op.olh_epoch : olh.get_epoch());
 
@@ -1842,7 +2124,7 @@ static int rgw_bucket_trim_olh_log(cls_method_context_t hctx, bufferlist *in, bu
     return ret;
   }
 
-  return 0;
+  return log_reshard_change(hctx, op.olh, op.olh_tag);
 }
 
 static int rgw_bucket_clear_olh(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
@@ -1883,6 +2165,11 @@ static int rgw_bucket_clear_olh(cls_method_context_t hctx, bufferlist *in, buffe
     return ret;
   }
 
+  ret = log_reshard_change(hctx, op.key, op.olh_tag);
+  if (ret < 0) {
+    return ret;
+  }
+
   rgw_bucket_dir_entry plain_entry;
 
   /* read plain entry, make sure it's a versioned place holder */
@@ -1997,7 +2284,10 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx,
 	ret = cls_cxx_map_remove_key(hctx, cur_change_key);
 	if (ret < 0)
 	  return ret;
-        if (log_op && cur_disk.exists && !header.syncstopped) {
+        if (bi_log_needed(header, log_op) &&
+            (cur_disk.exists || header.new_instance.resharding_online())) {
+          ++header.ver; // or entries logged by one call overwrite each other
+          header_changed = true;
           ret = log_index_operation(hctx, cur_disk.key, CLS_RGW_OP_DEL, cur_disk.tag, cur_disk.meta.mtime,
                                     cur_disk.ver, CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, 0, NULL, NULL, NULL);
           if (ret < 0) {
@@ -2016,12 +2306,18 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx,
         stats.actual_size += cur_change.meta.size;
         header_changed = true;
         cur_change.index_ver = header.ver;
+        if (!cur_change.inline_data) {
+          /* suggestions are built from listings, which leave out the
+           * data of inlined objects */
+          cur_change.inline_data = std::move(cur_disk.inline_data);
+        }
         bufferlist cur_state_bl;
         encode(cur_change, cur_state_bl);
         ret = cls_cxx_map_set_val(hctx, cur_change_key, &cur_state_bl);
         if (ret < 0)
 	  return ret;
-        if (log_op && !header.syncstopped) {
+        if (bi_log_needed(header, log_op)) {
+          ++header.ver;
           ret = log_index_operation(hctx, cur_change.key, CLS_RGW_OP_ADD, cur_change.tag, cur_change.meta.mtime,
                                     cur_change.ver, CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, 0, NULL, NULL, NULL);
           if (ret < 0) {
@@ -2893,6 +3189,41 @@ static void usage_record_name_by_user(const string& user, uint64_t epoch, const
   key = buf;
 }
 
+/*
+ * Besides the hourly records, every usage entry is also merged into a daily
+ * rollup of the same user and bucket.  Reads over whole days can iterate
+ * those instead, a 24th of the keys.  The rollups live under their own
+ * prefix, sorting after all the hourly records, with the same two indexes.
+ * They only cover the usage added since they were introduced, so the first
+ * day they fully cover is kept under usage_daily_start_key.
+ */
+#define USAGE_DAY_SECS (24 * 60 * 60)
+static const string usage_daily_by_time_prefix = "\x80" "d_";
+static const string usage_daily_by_user_prefix = "\x80" "u_";
+static const string usage_daily_start_key = "\x80" "start";
+
+static uint64_t usage_day(uint64_t epoch)
+{
+  return epoch - epoch % USAGE_DAY_SECS;
+}
+
+static const rgw_user& usage_record_user(const rgw_usage_log_entry& entry)
+{
+  return entry.payer.empty() ? entry.owner : entry.payer;
+}
+
+static void usage_daily_name_by_time(uint64_t epoch, const string& user, const string& bucket, string& key)
+{
+  usage_record_name_by_time(usage_day(epoch), user, bucket, key);
+  key.insert(0, usage_daily_by_time_prefix);
+}
+
+static void usage_daily_name_by_user(const string& user, uint64_t epoch, const string& bucket, string& key)
+{
+  usage_record_name_by_user(user, usage_day(epoch), bucket, key);
+  key.insert(0, usage_daily_by_user_prefix);
+}
+
 static int usage_record_decode(bufferlist& record_bl, rgw_usage_log_entry& e)
 {
   auto kiter = record_bl.cbegin();
@@ -2921,18 +3252,34 @@ int rgw_user_usage_log_add(cls_method_context_t hctx, bufferlist *in, bufferlist
   }
 
   rgw_usage_log_info& info = op.info;
-  vector<rgw_usage_log_entry>::iterator iter;
 
-  for (iter = info.entries.begin(); iter != info.entries.end(); ++iter) {
-    rgw_usage_log_entry& entry = *iter;
-    string key_by_time;
+  /* merge the entries of the batch first, hourly and daily, so that each
+   * record is read and written once.  both indexes of a record share the
+   * by-time key here */
+  map<string, rgw_usage_log_entry> records;
+  map<string, string> keys_by_user;
+  uint64_t max_epoch = 0;
+  for (auto& entry : info.entries) {
+    const string user = usage_record_user(entry).to_str();
 
-    rgw_user *puser = (entry.payer.empty() ? &entry.owner : &entry.payer);
+    CLS_LOG(10, "rgw_user_usage_log_add user=%s bucket=%s\n", user.c_str(), entry.bucket.c_str());
 
-    usage_record_name_by_time(entry.epoch, puser->to_str(), entry.bucket, key_by_time);
+    string key_by_time;
+    usage_record_name_by_time(entry.epoch, user, entry.bucket, key_by_time);
+    records[key_by_time].aggregate(entry);
+    usage_record_name_by_user(user, entry.epoch, entry.bucket, keys_by_user[key_by_time]);
 
-    CLS_LOG(10, "rgw_user_usage_log_add user=%s bucket=%s\n", puser->to_str().c_str(), entry.bucket.c_str());
+    usage_daily_name_by_time(entry.epoch, user, entry.bucket, key_by_time);
+    auto& daily = records[key_by_time];
+    daily.aggregate(entry);
+    daily.epoch = usage_day(entry.epoch);
+    usage_daily_name_by_user(user, entry.epoch, entry.bucket, keys_by_user[key_by_time]);
 
+    max_epoch = std::max(max_epoch, entry.epoch);
+  }
+
+  map<string, bufferlist> vals;
+  for (auto& [key_by_time, record] : records) {
     bufferlist record_bl;
     int ret = cls_cxx_map_get_val(hctx, key_by_time, &record_bl);
     if (ret < 0 && ret != -ENOENT) {
@@ -2945,29 +3292,119 @@ int rgw_user_usage_log_add(cls_method_context_t hctx, bufferlist *in, bufferlist
       if (ret < 0)
         return ret;
       CLS_LOG(10, "rgw_user_usage_log_add aggregating existing bucket\n");
-      entry.aggregate(e);
+      record.aggregate(e);
     }
 
-    bufferlist new_record_bl;
-    encode(entry, new_record_bl);
-    ret = cls_cxx_map_set_val(hctx, key_by_time, &new_record_bl);
-    if (ret < 0)
+    bufferlist& new_record_bl = vals[key_by_time];
+    encode(record, new_record_bl);
+    vals[keys_by_user[key_by_time]] = new_record_bl;
+  }
+
+  if (!records.empty()) {
+    bufferlist start_bl;
+    int ret = cls_cxx_map_get_val(hctx, usage_daily_start_key, &start_bl);
+    if (ret == -ENOENT) {
+      /* unless there's no usage here yet, the days so far are incomplete */
+      map<string, bufferlist> existing;
+      bool more;
+      ret = cls_cxx_map_get_vals(hctx, string(), string(), 1, &existing, &more);
+      if (ret < 0)
+        return ret;
+      uint64_t start = 0;
+      if (!existing.empty()) {
+        start = usage_day(max_epoch) + USAGE_DAY_SECS;
+      }
+      CLS_LOG(10, "rgw_user_usage_log_add daily rollups start at %llu\n",
+              (unsigned long long)start);
+      encode(start, vals[usage_daily_start_key]);
+    } else if (ret < 0) {
       return ret;
+    }
+  }
+
+  return cls_cxx_map_set_vals(hctx, &vals);
+}
+
+/* whether the daily rollups hold all of the usage in [start, end) */
+static bool usage_daily_covers(cls_method_context_t hctx, uint64_t start, uint64_t end)
+{
+  if (start % USAGE_DAY_SECS != 0 ||
+      (end != (uint64_t)-1 && end % USAGE_DAY_SECS != 0)) {
+    return false;
+  }
+  bufferlist bl;
+  int ret = cls_cxx_map_get_val(hctx, usage_daily_start_key, &bl);
+  if (ret < 0) {
+    return false;
+  }
+  uint64_t daily_start;
+  try {
+    auto p = bl.cbegin();
+    decode(daily_start, p);
+  } catch (buffer::error& err) {
+    CLS_LOG(1, "ERROR: usage_daily_covers(): failed to decode daily start\n");
+    return false;
+  }
+  return daily_start <= start;
+}
+
+static void usage_data_subtract(rgw_usage_data& from, const rgw_usage_data& usage)
+{
+  from.bytes_sent -= std::min(from.bytes_sent, usage.bytes_sent);
+  from.bytes_received -= std::min(from.bytes_received, usage.bytes_received);
+  from.ops -= std::min(from.ops, usage.ops);
+  from.successful_ops -= std::min(from.successful_ops, usage.successful_ops);
+}
+
+/* take a trimmed hourly record out of its daily rollup */
+static int usage_daily_subtract(cls_method_context_t hctx, const rgw_usage_log_entry& entry)
+{
+  const string user = usage_record_user(entry).to_str();
+  string key_by_time;
+  string key_by_user;
+  usage_daily_name_by_time(entry.epoch, user, entry.bucket, key_by_time);
+  usage_daily_name_by_user(user, entry.epoch, entry.bucket, key_by_user);
 
-    string key_by_user;
-    usage_record_name_by_user(puser->to_str(), entry.epoch, entry.bucket, key_by_user);
-    ret = cls_cxx_map_set_val(hctx, key_by_user, &new_record_bl);
+  bufferlist record_bl;
+  int ret = cls_cxx_map_get_val(hctx, key_by_time, &record_bl);
+  if (ret == -ENOENT)
+    return 0;
+  if (ret < 0)
+    return ret;
+  rgw_usage_log_entry daily;
+  ret = usage_record_decode(record_bl, daily);
+  if (ret < 0)
+    return ret;
+
+  for (const auto& [category, usage] : entry.usage_map) {
+    auto i = daily.usage_map.find(category);
+    if (i == daily.usage_map.end())
+      continue;
+    usage_data_subtract(i->second, usage);
+    usage_data_subtract(daily.total_usage, usage);
+    if (i->second.ops == 0 && i->second.bytes_sent == 0 &&
+        i->second.bytes_received == 0) {
+      daily.usage_map.erase(i);
+    }
+  }
+
+  if (daily.usage_map.empty()) {
+    ret = cls_cxx_map_remove_key(hctx, key_by_time);
     if (ret < 0)
       return ret;
+    return cls_cxx_map_remove_key(hctx, key_by_user);
   }
 
-  return 0;
+  map<string, bufferlist> vals;
+  encode(daily, vals[key_by_time]);
+  vals[key_by_user] = vals[key_by_time];
+  return cls_cxx_map_set_vals(hctx, &vals);
 }
 
 static int usage_iterate_range(cls_method_context_t hctx, uint64_t start, uint64_t end, const string& user,
                             const string& bucket, string& key_iter, uint32_t max_entries, bool *truncated,
                             int (*cb)(cls_method_context_t, const string&, rgw_usage_log_entry&, void *),
-                            void *param)
+                            void *param, bool daily = false)
 {
   CLS_LOG(10, "usage_iterate_range");
 
@@ -2982,10 +3419,15 @@ static int usage_iterate_range(cls_method_context_t hctx, uint64_t start, uint64
 
   ceph_assert(truncated != nullptr);
 
+  const string& prefix = !daily ? string() :
+    (by_user ? usage_daily_by_user_prefix : usage_daily_by_time_prefix);
+
   if (!by_user) {
     usage_record_prefix_by_time(end, end_key);
+    end_key.insert(0, prefix);
   } else {
-    user_key = user;
+    user_key = prefix;
+    user_key.append(user);
     user_key.append("_");
   }
 
@@ -2995,6 +3437,7 @@ static int usage_iterate_range(cls_method_context_t hctx, uint64_t start, uint64
     } else {
       usage_record_prefix_by_time(start, start_key);
     }
+    start_key.insert(0, prefix);
   } else {
     start_key = key_iter;
   }
@@ -3094,7 +3537,8 @@ int rgw_user_usage_log_read(cls_method_context_t hctx, bufferlist *in, bufferlis
   string iter = op.iter;
 #define MAX_ENTRIES 1000
   uint32_t max_entries = (op.max_entries ? op.max_entries : MAX_ENTRIES);
-  int ret = usage_iterate_range(hctx, op.start_epoch, op.end_epoch, op.owner, op.bucket, iter, max_entries, &ret_info.truncated, usage_log_read_cb, (void *)usage);
+  const bool daily = op.daily && usage_daily_covers(hctx, op.start_epoch, op.end_epoch);
+  int ret = usage_iterate_range(hctx, op.start_epoch, op.end_epoch, op.owner, op.bucket, iter, max_entries, &ret_info.truncated, usage_log_read_cb, (void *)usage, daily);
   if (ret < 0)
     return ret;
 
@@ -3122,7 +3566,11 @@ static int usage_log_trim_cb(cls_method_context_t hctx, const string& key, rgw_u
   if (ret < 0)
     return ret;
 
-  return cls_cxx_map_remove_key(hctx, key_by_user);
+  ret = cls_cxx_map_remove_key(hctx, key_by_user);
+  if (ret < 0)
+    return ret;
+
+  return usage_daily_subtract(hctx, entry);
 }
 
 int rgw_user_usage_log_trim(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
@@ -3838,7 +4286,7 @@ static int rgw_set_bucket_resharding(cls_method_context_t hctx, bufferlist *in,
     return rc;
   }
 
-  header.new_instance.set_status(op.entry.new_bucket_instance_id, op.entry.num_shards, op.entry.reshard_status);
+  header.new_instance = op.entry;
 
   return write_bucket_header(hctx, &header);
 }
@@ -3885,7 +4333,8 @@ static int rgw_guard_bucket_resharding(cls_method_context_t hctx, bufferlist *in
     return rc;
   }
 
-  if (header.resharding()) {
+  /* an online reshard logs the changes instead of blocking them */
+  if (header.resharding() && !header.new_instance.resharding_online()) {
     return op.ret_err;
   }
 
@@ -3933,6 +4382,9 @@ CLS_INIT(rgw)
   cls_method_handle_t h_rgw_bucket_update_stats;
   cls_method_handle_t h_rgw_bucket_prepare_op;
   cls_method_handle_t h_rgw_bucket_complete_op;
+  cls_method_handle_t h_rgw_bucket_put_inline;
+  cls_method_handle_t h_rgw_guard_inline_entry;
+  cls_method_handle_t h_rgw_bucket_complete_ops;
   cls_method_handle_t h_rgw_bucket_link_olh;
   cls_method_handle_t h_rgw_bucket_unlink_instance_op;
   cls_method_handle_t h_rgw_bucket_read_olh_log;
@@ -3984,6 +4436,9 @@ CLS_INIT(rgw)
   cls_register_cxx_method(h_class, RGW_BUCKET_UPDATE_STATS, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_update_stats, &h_rgw_bucket_update_stats);
   cls_register_cxx_method(h_class, RGW_BUCKET_PREPARE_OP, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_prepare_op, &h_rgw_bucket_prepare_op);
   cls_register_cxx_method(h_class, RGW_BUCKET_COMPLETE_OP, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_complete_op, &h_rgw_bucket_complete_op);
+  cls_register_cxx_method(h_class, RGW_BUCKET_PUT_INLINE, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_put_inline, &h_rgw_bucket_put_inline);
+  cls_register_cxx_method(h_class, RGW_GUARD_INLINE_ENTRY, CLS_METHOD_RD, rgw_guard_inline_entry, &h_rgw_guard_inline_entry);
+  cls_register_cxx_method(h_class, RGW_BUCKET_COMPLETE_OPS, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_complete_ops, &h_rgw_bucket_complete_ops);
   cls_register_cxx_method(h_class, RGW_BUCKET_LINK_OLH, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_link_olh, &h_rgw_bucket_link_olh);
   cls_register_cxx_method(h_class, RGW_BUCKET_UNLINK_INSTANCE, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_unlink_instance, &h_rgw_bucket_unlink_instance_op);
   cls_register_cxx_method(h_class, RGW_BUCKET_READ_OLH_LOG, CLS_METHOD_RD, rgw_bucket_read_olh_log, &h_rgw_bucket_read_olh_log);
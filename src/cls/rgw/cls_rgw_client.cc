@@ -209,9 +209,57 @@ void cls_rgw_bucket_complete_op(ObjectWriteOperation& o, RGWModifyOp op, string&
   o.exec(RGW_CLASS, RGW_BUCKET_COMPLETE_OP, in);
 }
 
+void cls_rgw_bucket_complete_ops(ObjectWriteOperation& o,
+                                 const vector<rgw_cls_obj_complete_op>& ops)
+{
+  bufferlist in;
+  rgw_cls_obj_complete_ops_op call;
+  call.ops = ops;
+  encode(call, in);
+  o.exec(RGW_CLASS, RGW_BUCKET_COMPLETE_OPS, in);
+}
+
+void cls_rgw_bucket_put_inline(ObjectWriteOperation& o,
+                               const cls_rgw_obj_key& key,
+                               rgw_bucket_dir_entry_meta& dir_meta,
+                               rgw_bucket_inline_data& inline_data,
+                               RGWPutInlineMode mode, bool log_op,
+                               uint16_t bilog_flags, rgw_zone_set *zones_trace)
+{
+  bufferlist in;
+  rgw_cls_obj_put_inline_op call;
+  call.op.op = CLS_RGW_OP_ADD;
+  call.op.key = key;
+  call.op.ver.pool = -1;
+  call.op.meta = dir_meta;
+  call.op.log_op = log_op;
+  call.op.bilog_flags = bilog_flags;
+  if (zones_trace) {
+    call.op.zones_trace = *zones_trace;
+  }
+  call.inline_data = inline_data;
+  call.mode = mode;
+  encode(call, in);
+  o.exec(RGW_CLASS, RGW_BUCKET_PUT_INLINE, in);
+}
+
+void cls_rgw_guard_inline_entry(ObjectOperation& op,
+                                const cls_rgw_obj_key& key,
+                                const bufferlist& id_tag, int ret_err)
+{
+  bufferlist in;
+  rgw_cls_guard_inline_entry_op call;
+  call.key = key;
+  call.id_tag = id_tag;
+  call.ret_err = ret_err;
+  encode(call, in);
+  op.exec(RGW_CLASS, RGW_GUARD_INLINE_ENTRY, in);
+}
+
 void cls_rgw_bucket_list_op(librados::ObjectReadOperation& op,
                             const cls_rgw_obj_key& start_obj,
                             const std::string& filter_prefix,
+                            const std::string& delimiter,
                             uint32_t num_entries,
                             bool list_versions,
                             rgw_cls_list_ret* result)
@@ -220,6 +268,7 @@ void cls_rgw_bucket_list_op(librados::ObjectReadOperation& op,
   rgw_cls_list_op call;
   call.start_obj = start_obj;
   call.filter_prefix = filter_prefix;
+  call.delimiter = delimiter;
   call.num_entries = num_entries;
   call.list_versions = list_versions;
   encode(call, in);
@@ -230,18 +279,19 @@ void cls_rgw_bucket_list_op(librados::ObjectReadOperation& op,
 static bool issue_bucket_list_op(librados::IoCtx& io_ctx, const string& oid,
 				 const cls_rgw_obj_key& start_obj,
 				 const string& filter_prefix,
+				 const string& delimiter,
 				 uint32_t num_entries, bool list_versions,
 				 BucketIndexAioManager *manager,
 				 rgw_cls_list_ret *pdata) {
   librados::ObjectReadOperation op;
-  cls_rgw_bucket_list_op(op, start_obj, filter_prefix,
+  cls_rgw_bucket_list_op(op, start_obj, filter_prefix, delimiter,
                          num_entries, list_versions, pdata);
   return manager->aio_operate(io_ctx, oid, &op);
 }
 
 int CLSRGWIssueBucketList::issue_op(int shard_id, const string& oid)
 {
-  return issue_bucket_list_op(io_ctx, oid, start_obj, filter_prefix, num_entries, list_versions, &manager, &result[shard_id]);
+  return issue_bucket_list_op(io_ctx, oid, start_obj, filter_prefix, delimiter, num_entries, list_versions, &manager, &result[shard_id]);
 }
 
 void cls_rgw_remove_obj(librados::ObjectWriteOperation& o, list<string>& keep_attr_prefixes)
@@ -552,7 +602,7 @@ void cls_rgw_suggest_changes(ObjectWriteOperation& o, bufferlist& updates)
 int CLSRGWIssueGetDirHeader::issue_op(int shard_id, const string& oid)
 {
   cls_rgw_obj_key nokey;
-  return issue_bucket_list_op(io_ctx, oid, nokey, "", 0, false, &manager, &result[shard_id]);
+  return issue_bucket_list_op(io_ctx, oid, nokey, "", "", 0, false, &manager, &result[shard_id]);
 }
 
 static bool issue_resync_bi_log(librados::IoCtx& io_ctx, const string& oid, BucketIndexAioManager *manager)
@@ -622,7 +672,7 @@ int cls_rgw_get_dir_header_async(IoCtx& io_ctx, string& oid, RGWGetDirHeader_CB
 int cls_rgw_usage_log_read(IoCtx& io_ctx, const string& oid, const string& user, const string& bucket,
                            uint64_t start_epoch, uint64_t end_epoch, uint32_t max_entries,
                            string& read_iter, map<rgw_user_bucket, rgw_usage_log_entry>& usage,
-                           bool *is_truncated)
+                           bool *is_truncated, bool daily)
 {
   if (is_truncated)
     *is_truncated = false;
@@ -635,6 +685,7 @@ int cls_rgw_usage_log_read(IoCtx& io_ctx, const string& oid, const string& user,
   call.max_entries = max_entries;
   call.bucket = bucket;
   call.iter = read_iter;
+  call.daily = daily;
   encode(call, in);
   int r = io_ctx.exec(oid, RGW_CLASS, RGW_USER_USAGE_LOG_READ, in, out);
   if (r < 0)
@@ -1014,5 +1065,8 @@ static bool issue_set_bucket_resharding(librados::IoCtx& io_ctx, const string& o
 
 int CLSRGWIssueSetBucketResharding::issue_op(int shard_id, const string& oid)
 {
-  return issue_set_bucket_resharding(io_ctx, oid, entry, &manager);
+  auto i = shard_entries.find(shard_id);
+  return issue_set_bucket_resharding(io_ctx, oid,
+                                     (i != shard_entries.end() ? i->second : entry),
+                                     &manager);
 }
@@ -358,6 +358,28 @@ void cls_rgw_bucket_complete_op(librados::ObjectWriteOperation& o, RGWModifyOp o
 				list<cls_rgw_obj_key> *remove_objs, bool log_op,
                                 uint16_t bilog_op, rgw_zone_set *zones_trace);
 
+/* apply the complete ops of many objects on a shard in one transaction. no
+ * two ops may touch the same entry. OSDs without the method fail it with
+ * -EOPNOTSUPP */
+void cls_rgw_bucket_complete_ops(librados::ObjectWriteOperation& o,
+                                 const vector<rgw_cls_obj_complete_op>& ops);
+
+/* add an entry holding the object's data, replacing the existing entry as
+ * the mode allows, or failing with -EEXIST. OSDs without the method fail it
+ * with -EOPNOTSUPP */
+void cls_rgw_bucket_put_inline(librados::ObjectWriteOperation& o,
+                               const cls_rgw_obj_key& key,
+                               rgw_bucket_dir_entry_meta& dir_meta,
+                               rgw_bucket_inline_data& inline_data,
+                               RGWPutInlineMode mode, bool log_op,
+                               uint16_t bilog_flags, rgw_zone_set *zones_trace);
+
+/* fail the op with ret_err unless the entry is still the inline object
+ * written with id_tag */
+void cls_rgw_guard_inline_entry(librados::ObjectOperation& op,
+                                const cls_rgw_obj_key& key,
+                                const bufferlist& id_tag, int ret_err);
+
 void cls_rgw_remove_obj(librados::ObjectWriteOperation& o, list<string>& keep_attr_prefixes);
 void cls_rgw_obj_store_pg_ver(librados::ObjectWriteOperation& o, const string& attr);
 void cls_rgw_obj_check_attrs_prefix(librados::ObjectOperation& o, const string& prefix, bool fail_if_exist);
@@ -395,6 +417,9 @@ int cls_rgw_clear_olh(librados::IoCtx& io_ctx, librados::ObjectWriteOperation& o
  * io_ctx        - IO context for rados.
  * start_obj     - marker for the listing.
  * filter_prefix - filter prefix.
+ * delimiter     - if not empty, each common prefix is returned as a single entry
+ *                 flagged RGW_BUCKET_DIRENT_FLAG_COMMON_PREFIX.  OSDs which
+ *                 predate it ignore the delimiter and return every entry.
  * num_entries   - number of entries to request for each object (note the total
  *                 amount of entries returned depends on the number of shardings).
  * list_results  - the list results keyed by bucket index object id.
@@ -406,6 +431,7 @@ int cls_rgw_clear_olh(librados::IoCtx& io_ctx, librados::ObjectWriteOperation& o
 class CLSRGWIssueBucketList : public CLSRGWConcurrentIO {
   cls_rgw_obj_key start_obj;
   string filter_prefix;
+  string delimiter;
   uint32_t num_entries;
   bool list_versions;
   map<int, rgw_cls_list_ret>& result;
@@ -413,18 +439,20 @@ protected:
   int issue_op(int shard_id, const string& oid) override;
 public:
   CLSRGWIssueBucketList(librados::IoCtx& io_ctx, const cls_rgw_obj_key& _start_obj,
-                        const string& _filter_prefix, uint32_t _num_entries,
+                        const string& _filter_prefix,
+                        const string& _delimiter, uint32_t _num_entries,
                         bool _list_versions,
                         map<int, string>& oids,
                         map<int, rgw_cls_list_ret>& list_results,
                         uint32_t max_aio) :
   CLSRGWConcurrentIO(io_ctx, oids, max_aio),
-  start_obj(_start_obj), filter_prefix(_filter_prefix), num_entries(_num_entries), list_versions(_list_versions), result(list_results) {}
+  start_obj(_start_obj), filter_prefix(_filter_prefix), delimiter(_delimiter), num_entries(_num_entries), list_versions(_list_versions), result(list_results) {}
 };
 
 void cls_rgw_bucket_list_op(librados::ObjectReadOperation& op,
                             const cls_rgw_obj_key& start_obj,
                             const std::string& filter_prefix,
+                            const std::string& delimiter,
                             uint32_t num_entries,
                             bool list_versions,
                             rgw_cls_list_ret* result);
@@ -504,12 +532,17 @@ public:
 
 class CLSRGWIssueSetBucketResharding : public CLSRGWConcurrentIO {
   cls_rgw_bucket_instance_entry entry;
+  map<int, cls_rgw_bucket_instance_entry> shard_entries;
 protected:
   int issue_op(int shard_id, const string& oid) override;
 public:
   CLSRGWIssueSetBucketResharding(librados::IoCtx& ioc, map<int, string>& _bucket_objs,
                                  const cls_rgw_bucket_instance_entry& _entry,
                                  uint32_t _max_aio) : CLSRGWConcurrentIO(ioc, _bucket_objs, _max_aio), entry(_entry) {}
+  /* a different entry for each shard, e.g. with its own progress */
+  CLSRGWIssueSetBucketResharding(librados::IoCtx& ioc, map<int, string>& _bucket_objs,
+                                 const map<int, cls_rgw_bucket_instance_entry>& _shard_entries,
+                                 uint32_t _max_aio) : CLSRGWConcurrentIO(ioc, _bucket_objs, _max_aio), shard_entries(_shard_entries) {}
 };
 
 class CLSRGWIssueResyncBucketBILog : public CLSRGWConcurrentIO {
@@ -537,7 +570,8 @@ void cls_rgw_suggest_changes(librados::ObjectWriteOperation& o, bufferlist& upda
 /* usage logging */
 int cls_rgw_usage_log_read(librados::IoCtx& io_ctx, const string& oid, const string& user, const string& bucket,
                            uint64_t start_epoch, uint64_t end_epoch, uint32_t max_entries, string& read_iter,
-			   map<rgw_user_bucket, rgw_usage_log_entry>& usage, bool *is_truncated);
+			   map<rgw_user_bucket, rgw_usage_log_entry>& usage, bool *is_truncated,
+			   bool daily = false);
 
 int cls_rgw_usage_log_trim(librados::IoCtx& io_ctx, const string& oid, const string& user, const string& bucket,
                            uint64_t start_epoch, uint64_t end_epoch);
@@ -152,6 +152,68 @@ void rgw_cls_obj_complete_op::dump(Formatter *f) const
   ::encode_json("zones_trace", zones_trace, f);
 }
 
+void rgw_cls_obj_put_inline_op::generate_test_instances(list<rgw_cls_obj_put_inline_op*>& o)
+{
+  rgw_cls_obj_put_inline_op *op = new rgw_cls_obj_put_inline_op;
+  op->op.key.name = "name";
+  op->op.meta.size = 4;
+  op->inline_data.data.append("data");
+  op->mode = CLS_RGW_PUT_INLINE_EXCLUSIVE;
+  o.push_back(op);
+
+  o.push_back(new rgw_cls_obj_put_inline_op);
+}
+
+void rgw_cls_obj_put_inline_op::dump(Formatter *f) const
+{
+  f->open_object_section("op");
+  op.dump(f);
+  f->close_section();
+  f->open_object_section("inline_data");
+  inline_data.dump(f);
+  f->close_section();
+  f->dump_int("mode", (int)mode);
+}
+
+void rgw_cls_guard_inline_entry_op::generate_test_instances(list<rgw_cls_guard_inline_entry_op*>& o)
+{
+  rgw_cls_guard_inline_entry_op *op = new rgw_cls_guard_inline_entry_op;
+  op->key.name = "name";
+  op->id_tag.append("tag");
+  op->ret_err = -ECANCELED;
+  o.push_back(op);
+
+  o.push_back(new rgw_cls_guard_inline_entry_op);
+}
+
+void rgw_cls_guard_inline_entry_op::dump(Formatter *f) const
+{
+  f->open_object_section("key");
+  key.dump(f);
+  f->close_section();
+  f->dump_string("id_tag", id_tag.to_str());
+  f->dump_int("ret_err", ret_err);
+}
+
+void rgw_cls_obj_complete_ops_op::generate_test_instances(list<rgw_cls_obj_complete_ops_op*>& o)
+{
+  rgw_cls_obj_complete_ops_op *op = new rgw_cls_obj_complete_ops_op;
+  list<rgw_cls_obj_complete_op*> ls;
+  rgw_cls_obj_complete_op::generate_test_instances(ls);
+  for (auto c : ls) {
+    op->ops.push_back(*c);
+    delete c;
+  }
+  o.push_back(op);
+
+  o.push_back(new rgw_cls_obj_complete_ops_op);
+}
+
+void rgw_cls_obj_complete_ops_op::dump(Formatter *f) const
+{
+  encode_json("ops", ops, f);
+}
+
 void rgw_cls_link_olh_op::generate_test_instances(list<rgw_cls_link_olh_op*>& o)
 {
   rgw_cls_link_olh_op *op = new rgw_cls_link_olh_op;
@@ -291,6 +353,7 @@ void rgw_cls_list_op::generate_test_instances(list<rgw_cls_list_op*>& o)
   op->start_obj.name = "start_obj";
   op->num_entries = 100;
   op->filter_prefix = "filter_prefix";
+  op->delimiter = "/";
   o.push_back(op);
   o.push_back(new rgw_cls_list_op);
 }
@@ -299,6 +362,7 @@ void rgw_cls_list_op::dump(Formatter *f) const
 {
   f->dump_string("start_obj", start_obj.name);
   f->dump_unsigned("num_entries", num_entries);
+  f->dump_string("delimiter", delimiter);
 }
 
 void rgw_cls_list_ret::generate_test_instances(list<rgw_cls_list_ret*>& o)
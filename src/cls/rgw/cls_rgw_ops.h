@@ -162,6 +162,91 @@ struct rgw_cls_obj_complete_op
 };
 WRITE_CLASS_ENCODER(rgw_cls_obj_complete_op)
 
+/*
+ * add an entry holding the object data, without a prepare and without a
+ * head object. this is a complete op of its own so that OSDs which can't
+ * store the data reject it instead of dropping it
+ */
+struct rgw_cls_obj_put_inline_op
+{
+  rgw_cls_obj_complete_op op;
+  rgw_bucket_inline_data inline_data;
+  RGWPutInlineMode mode{CLS_RGW_PUT_INLINE_OVERWRITE};
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    encode(op, bl);
+    encode(inline_data, bl);
+    uint8_t m = (uint8_t)mode;
+    encode(m, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::const_iterator &bl) {
+    DECODE_START(1, bl);
+    decode(op, bl);
+    decode(inline_data, bl);
+    uint8_t m;
+    decode(m, bl);
+    mode = (RGWPutInlineMode)m;
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<rgw_cls_obj_put_inline_op*>& o);
+};
+WRITE_CLASS_ENCODER(rgw_cls_obj_put_inline_op)
+
+/*
+ * fails with ret_err unless the entry still holds the inline object written
+ * with id_tag
+ */
+struct rgw_cls_guard_inline_entry_op
+{
+  cls_rgw_obj_key key;
+  bufferlist id_tag;
+  int ret_err{0};
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    encode(key, bl);
+    encode(id_tag, bl);
+    encode(ret_err, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::const_iterator &bl) {
+    DECODE_START(1, bl);
+    decode(key, bl);
+    decode(id_tag, bl);
+    decode(ret_err, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<rgw_cls_guard_inline_entry_op*>& o);
+};
+WRITE_CLASS_ENCODER(rgw_cls_guard_inline_entry_op)
+
+/*
+ * the complete ops of many objects on an index shard, applied together.
+ * each entry may be touched by only one of the ops
+ */
+struct rgw_cls_obj_complete_ops_op
+{
+  vector<rgw_cls_obj_complete_op> ops;
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    encode(ops, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::const_iterator &bl) {
+    DECODE_START(1, bl);
+    decode(ops, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<rgw_cls_obj_complete_ops_op*>& o);
+};
+WRITE_CLASS_ENCODER(rgw_cls_obj_complete_ops_op)
+
 struct rgw_cls_link_olh_op {
   cls_rgw_obj_key key;
   string olh_tag;
@@ -383,19 +468,21 @@ struct rgw_cls_list_op
   uint32_t num_entries;
   string filter_prefix;
   bool list_versions;
+  string delimiter; // if set, entries under a common prefix are returned as one
 
   rgw_cls_list_op() : num_entries(0), list_versions(false) {}
 
   void encode(bufferlist &bl) const {
-    ENCODE_START(5, 4, bl);
+    ENCODE_START(6, 4, bl);
     encode(num_entries, bl);
     encode(filter_prefix, bl);
     encode(start_obj, bl);
     encode(list_versions, bl);
+    encode(delimiter, bl);
     ENCODE_FINISH(bl);
   }
   void decode(bufferlist::const_iterator &bl) {
-    DECODE_START_LEGACY_COMPAT_LEN(5, 2, 2, bl);
+    DECODE_START_LEGACY_COMPAT_LEN(6, 2, 2, bl);
     if (struct_v < 4) {
       decode(start_obj.name, bl);
     }
@@ -406,6 +493,8 @@ struct rgw_cls_list_op
       decode(start_obj, bl);
     if (struct_v >= 5)
       decode(list_versions, bl);
+    if (struct_v >= 6)
+      decode(delimiter, bl);
     DECODE_FINISH(bl);
   }
   void dump(Formatter *f) const;
@@ -710,20 +799,24 @@ struct rgw_cls_usage_log_read_op {
 
   string iter;  // should be empty for the first call, non empty for subsequent calls
   uint32_t max_entries;
+  // read the daily rollups where they cover the range. the results are the
+  // same, except for the epochs of the entries
+  bool daily = false;
 
   void encode(bufferlist& bl) const {
-    ENCODE_START(2, 1, bl);
+    ENCODE_START(3, 1, bl);
     encode(start_epoch, bl);
     encode(end_epoch, bl);
     encode(owner, bl);
     encode(iter, bl);
     encode(max_entries, bl);
     encode(bucket, bl);
+    encode(daily, bl);
     ENCODE_FINISH(bl);
   }
 
   void decode(bufferlist::const_iterator& bl) {
-    DECODE_START(2, bl);
+    DECODE_START(3, bl);
     decode(start_epoch, bl);
     decode(end_epoch, bl);
     decode(owner, bl);
@@ -732,6 +825,9 @@ struct rgw_cls_usage_log_read_op {
     if (struct_v >= 2) {
       decode(bucket, bl);
     }
+    if (struct_v >= 3) {
+      decode(daily, bl);
+    }
     DECODE_FINISH(bl);
   }
 };
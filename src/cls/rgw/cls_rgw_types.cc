@@ -107,6 +107,33 @@ void rgw_bucket_dir_entry::generate_test_instances(list<rgw_bucket_dir_entry*>&
     delete m;
   }
   o.push_back(new rgw_bucket_dir_entry);
+
+  rgw_bucket_dir_entry *e = new rgw_bucket_dir_entry;
+  e->key.name = "inline";
+  e->exists = true;
+  e->meta.size = 5;
+  e->inline_data.emplace();
+  e->inline_data->data.append("hello");
+  e->inline_data->attrs["user.rgw.etag"].append("etag");
+  o.push_back(e);
+}
+
+void rgw_bucket_inline_data::dump(Formatter *f) const
+{
+  encode_json("size", data.length(), f);
+  f->open_array_section("attrs");
+  for (auto& a : attrs) {
+    f->dump_string("name", a.first);
+  }
+  f->close_section();
+}
+
+void rgw_bucket_inline_data::generate_test_instances(list<rgw_bucket_inline_data*>& o)
+{
+  o.push_back(new rgw_bucket_inline_data);
+  o.push_back(new rgw_bucket_inline_data);
+  o.back()->data.append("data");
+  o.back()->attrs["user.rgw.etag"].append("etag");
 }
 
 void rgw_bucket_entry_ver::dump(Formatter *f) const
@@ -141,6 +168,9 @@ void rgw_bucket_dir_entry::dump(Formatter *f) const
   encode_json("flags", (int)flags , f);
   encode_json("pending_map", pending_map, f);
   encode_json("versioned_epoch", versioned_epoch , f);
+  if (inline_data) {
+    encode_json("inline_data", *inline_data, f);
+  }
 }
 
 void rgw_bucket_dir_entry::decode_json(JSONObj *obj) {
@@ -685,13 +715,19 @@ void cls_rgw_bucket_instance_entry::dump(Formatter *f) const
     case CLS_RGW_RESHARD_DONE:
       status_str = "done";
       break;
+    case CLS_RGW_RESHARD_ONLINE:
+      status_str = "online";
+      break;
     default:
       status_str = "invalid";
   }
   encode_json("reshard_status", status_str, f);
   encode_json("new_bucket_instance_id", new_bucket_instance_id, f);
   encode_json("num_shards", num_shards, f);
-
+  encode_json("start_time", utime_t(start_time), f);
+  encode_json("update_time", utime_t(update_time), f);
+  encode_json("num_entries_copied", num_entries_copied, f);
+  encode_json("num_entries_replayed", num_entries_replayed, f);
 }
 
 void cls_rgw_bucket_instance_entry::generate_test_instances(list<cls_rgw_bucket_instance_entry*>& ls)
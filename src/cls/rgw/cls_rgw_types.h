@@ -54,6 +54,14 @@ enum RGWCheckMTimeType {
   CLS_RGW_CHECK_TIME_MTIME_GE = 4,
 };
 
+/* which entries bucket_put_inline replaces */
+enum RGWPutInlineMode {
+  CLS_RGW_PUT_INLINE_OVERWRITE = 0, /* any entry */
+  CLS_RGW_PUT_INLINE_EXCLUSIVE = 1, /* none, fails with EEXIST if the object exists */
+  CLS_RGW_PUT_INLINE_REPLACE_INLINE = 2, /* fails with EEXIST if the object exists and
+                                          * isn't inline, so it has a head object */
+};
+
 #define ROUND_BLOCK_SIZE 4096
 
 static inline uint64_t cls_rgw_get_rounded_size(uint64_t size)
@@ -325,10 +333,40 @@ struct cls_rgw_obj_key {
 WRITE_CLASS_ENCODER(cls_rgw_obj_key)
 
 
+/*
+ * the data and xattrs of a small object, kept in its bucket index entry
+ * instead of in a head object
+ */
+struct rgw_bucket_inline_data {
+  bufferlist data;
+  map<string, bufferlist> attrs;
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    encode(data, bl);
+    encode(attrs, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::const_iterator &bl) {
+    DECODE_START(1, bl);
+    decode(data, bl);
+    decode(attrs, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<rgw_bucket_inline_data*>& o);
+};
+WRITE_CLASS_ENCODER(rgw_bucket_inline_data)
+
+/* the inline attr holding the tag of the write that stored the object, same
+ * as rgw's RGW_ATTR_ID_TAG */
+#define RGW_BUCKET_INLINE_ID_TAG_ATTR "user.rgw.idtag"
+
 #define RGW_BUCKET_DIRENT_FLAG_VER           0x1    /* a versioned object instance */
 #define RGW_BUCKET_DIRENT_FLAG_CURRENT       0x2    /* the last object instance of a versioned object */
 #define RGW_BUCKET_DIRENT_FLAG_DELETE_MARKER 0x4    /* delete marker */
 #define RGW_BUCKET_DIRENT_FLAG_VER_MARKER    0x8    /* object is versioned, a placeholder for the plain entry */
+#define RGW_BUCKET_DIRENT_FLAG_COMMON_PREFIX 0x8000 /* not an object, stands for all entries under a common prefix */
 
 struct rgw_bucket_dir_entry {
   cls_rgw_obj_key key;
@@ -341,12 +379,13 @@ struct rgw_bucket_dir_entry {
   string tag;
   uint16_t flags;
   uint64_t versioned_epoch;
+  boost::optional<rgw_bucket_inline_data> inline_data;
 
   rgw_bucket_dir_entry() :
     exists(false), index_ver(0), flags(0), versioned_epoch(0) {}
 
   void encode(bufferlist &bl) const {
-    ENCODE_START(8, 3, bl);
+    ENCODE_START(9, 3, bl);
     encode(key.name, bl);
     encode(ver.epoch, bl);
     encode(exists, bl);
@@ -359,10 +398,11 @@ struct rgw_bucket_dir_entry {
     encode(key.instance, bl);
     encode(flags, bl);
     encode(versioned_epoch, bl);
+    encode(inline_data, bl);
     ENCODE_FINISH(bl);
   }
   void decode(bufferlist::const_iterator &bl) {
-    DECODE_START_LEGACY_COMPAT_LEN(8, 3, 3, bl);
+    DECODE_START_LEGACY_COMPAT_LEN(9, 3, 3, bl);
     decode(key.name, bl);
     decode(ver.epoch, bl);
     decode(exists, bl);
@@ -389,6 +429,9 @@ struct rgw_bucket_dir_entry {
     if (struct_v >= 8) {
       decode(versioned_epoch, bl);
     }
+    if (struct_v >= 9) {
+      decode(inline_data, bl);
+    }
     DECODE_FINISH(bl);
   }
 
@@ -402,6 +445,7 @@ struct rgw_bucket_dir_entry {
     return is_current() && !is_delete_marker();
   }
   bool is_valid() { return (flags & RGW_BUCKET_DIRENT_FLAG_VER_MARKER) == 0; }
+  bool is_common_prefix() const { return (flags & RGW_BUCKET_DIRENT_FLAG_COMMON_PREFIX) != 0; }
 
   void dump(Formatter *f) const;
   void decode_json(JSONObj *obj);
@@ -641,6 +685,7 @@ enum cls_rgw_reshard_status {
   CLS_RGW_RESHARD_NONE        = 0,
   CLS_RGW_RESHARD_IN_PROGRESS = 1,
   CLS_RGW_RESHARD_DONE        = 2,
+  CLS_RGW_RESHARD_ONLINE      = 3, /* copying while writes go on, index changes are logged */
 };
 
 static inline std::string to_string(const enum cls_rgw_reshard_status status)
@@ -655,6 +700,9 @@ static inline std::string to_string(const enum cls_rgw_reshard_status status)
   case CLS_RGW_RESHARD_DONE:
     return "CLS_RGW_RESHARD_DONE";
     break;
+  case CLS_RGW_RESHARD_ONLINE:
+    return "CLS_RGW_RESHARD_ONLINE";
+    break;
   default:
     break;
   };
@@ -665,22 +713,37 @@ struct cls_rgw_bucket_instance_entry {
   cls_rgw_reshard_status reshard_status{CLS_RGW_RESHARD_NONE};
   string new_bucket_instance_id;
   int32_t num_shards{-1};
+  /* progress of the reshard of this shard */
+  ceph::real_time start_time;
+  ceph::real_time update_time;
+  uint64_t num_entries_copied{0};
+  uint64_t num_entries_replayed{0}; /* bilog entries of an online reshard */
 
   void encode(bufferlist& bl) const {
-    ENCODE_START(1, 1, bl);
+    ENCODE_START(2, 1, bl);
     encode((uint8_t)reshard_status, bl);
     encode(new_bucket_instance_id, bl);
     encode(num_shards, bl);
+    encode(start_time, bl);
+    encode(update_time, bl);
+    encode(num_entries_copied, bl);
+    encode(num_entries_replayed, bl);
     ENCODE_FINISH(bl);
   }
 
   void decode(bufferlist::const_iterator& bl) {
-    DECODE_START(1, bl);
+    DECODE_START(2, bl);
     uint8_t s;
     decode(s, bl);
     reshard_status = (cls_rgw_reshard_status)s;
     decode(new_bucket_instance_id, bl);
     decode(num_shards, bl);
+    if (struct_v >= 2) {
+      decode(start_time, bl);
+      decode(update_time, bl);
+      decode(num_entries_copied, bl);
+      decode(num_entries_replayed, bl);
+    }
     DECODE_FINISH(bl);
   }
 
@@ -704,6 +767,9 @@ struct cls_rgw_bucket_instance_entry {
   bool resharding_in_progress() const {
     return reshard_status == CLS_RGW_RESHARD_IN_PROGRESS;
   }
+  bool resharding_online() const {
+    return reshard_status == CLS_RGW_RESHARD_ONLINE;
+  }
 };
 WRITE_CLASS_ENCODER(cls_rgw_bucket_instance_entry)
 
@@ -891,6 +891,7 @@ OPTION(osd_discard_disconnected_ops, OPT_BOOL)
 OPTION(memstore_device_bytes, OPT_U64)
 OPTION(memstore_page_set, OPT_BOOL)
 OPTION(memstore_page_size, OPT_U64)
+OPTION(memstore_page_set_hugetlb, OPT_BOOL)
 
 OPTION(bdev_debug_inflight_ios, OPT_BOOL)
 OPTION(bdev_inject_crash, OPT_INT)  // if N>0, then ~ 1/N IOs will complete before we crash on flush.
@@ -926,6 +927,10 @@ OPTION(bluefs_buffered_io, OPT_BOOL)
 OPTION(bluefs_sync_write, OPT_BOOL)
 OPTION(bluefs_allocator, OPT_STR)     // stupid | bitmap
 OPTION(bluefs_preextend_wal_files, OPT_BOOL)  // this *requires* that rocksdb has recycling enabled
+OPTION(bluefs_migrate_interval, OPT_FLOAT)  // hot/cold SST migration, 0 = off
+OPTION(bluefs_migrate_min_heat, OPT_U64)
+OPTION(bluefs_migrate_max_bytes, OPT_U64)
+OPTION(bluefs_migrate_db_reserve_ratio, OPT_FLOAT)
 
 OPTION(bluestore_bluefs, OPT_BOOL)
 OPTION(bluestore_bluefs_env_mirror, OPT_BOOL) // mirror to normal Env for debug
@@ -1013,6 +1018,7 @@ OPTION(bluestore_cache_size_hdd, OPT_U64)
 OPTION(bluestore_cache_size_ssd, OPT_U64)
 OPTION(bluestore_cache_meta_ratio, OPT_DOUBLE)
 OPTION(bluestore_cache_kv_ratio, OPT_DOUBLE)
+OPTION(bluestore_cache_compressed_ratio, OPT_DOUBLE)
 OPTION(bluestore_kvbackend, OPT_STR)
 OPTION(bluestore_allocator, OPT_STR)     // stupid | bitmap
 OPTION(bluestore_freelist_blocks_per_key, OPT_INT)
@@ -1234,6 +1240,8 @@ OPTION(journal_throttle_max_multiple, OPT_DOUBLE)
 
 OPTION(journal_align_min_size, OPT_INT)  // align data payloads >= this.
 OPTION(journal_replay_from, OPT_INT)
+OPTION(journal_replay_threads, OPT_INT)
+OPTION(journal_replay_max_bytes, OPT_INT)
 OPTION(journal_zero_on_create, OPT_BOOL)
 OPTION(journal_ignore_corruption, OPT_BOOL) // assume journal is not corrupt
 OPTION(journal_discard, OPT_BOOL) //using ssd disk as journal, whether support discard nouse journal-data.
@@ -1503,6 +1511,8 @@ OPTION(rgw_crypt_s3_kms_encryption_keys, OPT_STR) // extra keys that may be used
                                                       // defined as map "key1=YmluCmJvb3N0CmJvb3N0LQ== key2=b3V0CnNyYwpUZXN0aW5nCg=="
 OPTION(rgw_crypt_suppress_logs, OPT_BOOL)   // suppress logs that might print customer key
 OPTION(rgw_list_bucket_min_readahead, OPT_INT) // minimum number of entries to read from rados for bucket listing
+OPTION(rgw_list_bucket_min_shard_entries, OPT_U32) // minimum number of entries to read from each index shard for ordered listing
+OPTION(rgw_list_bucket_cls_delimiter, OPT_BOOL) // let the bucket index skip common prefixes when listing with a delimiter
 
 OPTION(rgw_rest_getusage_op_compat, OPT_BOOL) // dump description of total stats for s3 GetUsage API
 
@@ -1541,3 +1551,6 @@ OPTION(rgw_sts_client_secret, OPT_STR) // Client Secret
 OPTION(debug_allow_any_pool_priority, OPT_BOOL)
 
 OPTION(crimson_debug_pg_always_active, OPT_BOOL)
+OPTION(crimson_osd_objectstore, OPT_STR)
+OPTION(crimson_blockstore_size, OPT_U64)
+OPTION(crimson_blockstore_journal_size, OPT_U64)
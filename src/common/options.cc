@@ -4107,6 +4107,12 @@ std::vector<Option> get_global_options() {
     .set_default(64_K)
     .set_description(""),
 
+    Option("memstore_page_set_hugetlb", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Back memstore page set arenas with reserved huge pages")
+    .set_long_description("Page data is allocated from 2MB arenas which are eligible for transparent huge pages. If this is enabled, arenas are mapped with MAP_HUGETLB instead, which requires huge pages to be reserved with vm.nr_hugepages; when none are available we fall back to transparent huge pages.")
+    .add_see_also("memstore_page_set"),
+
     Option("objectstore_blackhole", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description(""),
@@ -4222,6 +4228,27 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("bluefs_migrate_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("How frequently (in seconds) to move hot SST files from the slow device to the DB device")
+    .set_long_description("When the DB device overflows, BlueFS places new SST files on the slow device.  If this is non-zero, a background thread periodically promotes frequently read SST files back to the DB device, and demotes cold ones to make room.  Zero disables migration."),
+
+    Option("bluefs_migrate_min_heat", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(16_M)
+    .set_description("Decayed number of bytes read from an SST file before it is considered hot")
+    .add_see_also("bluefs_migrate_interval"),
+
+    Option("bluefs_migrate_max_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_G)
+    .set_description("Maximum number of bytes to move between devices per migration pass")
+    .add_see_also("bluefs_migrate_interval"),
+
+    Option("bluefs_migrate_db_reserve_ratio", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.1)
+    .set_min_max(0.0, 1.0)
+    .set_description("Fraction of the DB device to keep free for new SST files when promoting hot files")
+    .add_see_also("bluefs_migrate_interval"),
+
     Option("bluestore_bluefs", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(true)
     .set_flag(Option::FLAG_CREATE)
@@ -4553,6 +4580,12 @@ std::vector<Option> get_global_options() {
     .add_see_also("bluestore_cache_size")
     .set_description("Ratio of bluestore cache to devote to kv database (rocksdb)"),
 
+    Option("bluestore_cache_compressed_ratio", Option::TYPE_FLOAT, Option::LEVEL_DEV)
+    .set_default(0)
+    .add_see_also("bluestore_cache_size")
+    .set_description("Ratio of bluestore cache to devote to compressed blob data")
+    .set_long_description("Compressed blobs are normally only cached after decompression.  A non-zero ratio keeps a second tier of compressed payloads in memory, which are decompressed on a hit instead of being read from disk.  The ratio is taken from the portion of the cache devoted to object data."),
+
     Option("bluestore_cache_autotune", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(true)
     .add_see_also("bluestore_cache_size")
@@ -5247,6 +5280,21 @@ std::vector<Option> get_global_options() {
     .set_default(0)
     .set_description(""),
 
+    Option("journal_replay_threads", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_description("Number of threads applying journal entries at mount")
+    .set_long_description("With more than one thread, entries touching "
+                          "different collections are applied in parallel, "
+                          "while those of each collection are still applied "
+                          "in journal order.")
+    .add_see_also("journal_replay_max_bytes"),
+
+    Option("journal_replay_max_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(256_M)
+    .set_description("Max bytes of journal entries read ahead of their "
+                     "application during a parallel replay")
+    .add_see_also("journal_replay_threads"),
+
   Option("mgr_stats_threshold", Option::TYPE_INT, Option::LEVEL_ADVANCED)
   .set_default((int64_t)PerfCountersBuilder::PRIO_USEFUL)
   .set_description("Lowest perfcounter priority collected by mgr")
@@ -5488,6 +5536,17 @@ std::vector<Option> get_rgw_options() {
         "need to be atomic, and anything larger than this would require more than a single "
         "operation."),
 
+    Option("rgw_inline_data_max_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Max size of objects stored in their bucket index entry")
+    .set_long_description(
+        "When non zero, buckets created afterwards store objects up to this size "
+        "in their bucket index entry instead of in a head object, so that writing "
+        "one takes a single RADOS operation. Reads in these buckets look up the "
+        "index entry first, which costs an extra round trip for larger objects. "
+        "Versioning can't be enabled on such buckets.")
+    .add_see_also("rgw_max_chunk_size"),
+
     Option("rgw_put_obj_min_window_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(16_M)
     .set_description("The minimum RADOS write window size (in bytes).")
@@ -5504,6 +5563,27 @@ std::vector<Option> get_rgw_options() {
     .set_long_description("The window size may be dynamically adjusted, but will not surpass this value.")
     .add_see_also({"rgw_put_obj_min_window_size", "rgw_max_chunk_size"}),
 
+    Option("rgw_put_obj_transform_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Number of threads compressing and encrypting uploads")
+    .set_long_description(
+        "Compression and encryption of uploaded data run on a pool of this many threads, "
+        "shared by all requests, so that consecutive chunks of an upload are transformed "
+        "concurrently while the next one is received. With 0 they run inline on the "
+        "request thread. The pool competes with the frontend threads for cpu, so it "
+        "should be sized to the cores they leave idle.")
+    .add_see_also("rgw_put_obj_transform_max_pending"),
+
+    Option("rgw_put_obj_transform_max_pending", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_description("Max chunks of an upload being compressed or encrypted at once")
+    .set_long_description(
+        "Bounds the memory a single upload holds in compression and encryption, at "
+        "about this many times rgw_max_chunk_size.")
+    .add_see_also({"rgw_put_obj_transform_threads", "rgw_max_chunk_size"}),
+
     Option("rgw_max_put_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(5_G)
     .set_description("Max size (in bytes) of regular (non multi-part) object upload.")
@@ -5536,6 +5616,24 @@ std::vector<Option> get_rgw_options() {
     .set_default(8)
     .set_description("Max number of concurrent RADOS requests when handling bucket shards."),
 
+    Option("rgw_bucket_index_complete_batch_window_ms", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Time to gather bucket index completions to a shard into one request")
+    .set_long_description(
+        "When nonzero, the bucket index updates that complete object writes and "
+        "deletes are held for up to this many milliseconds, and those to the same "
+        "bucket index shard are applied together in one OSD op. This raises the "
+        "write rate a shard can take, while delaying when objects are listed. "
+        "It requires OSDs that support the bucket_complete_ops method; if they "
+        "don't, completions go back to being sent one at a time.")
+    .add_see_also("rgw_bucket_index_complete_batch_max_entries"),
+
+    Option("rgw_bucket_index_complete_batch_max_entries", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(128)
+    .set_min(1)
+    .set_description("Max bucket index completions sent in one request")
+    .add_see_also("rgw_bucket_index_complete_batch_window_ms"),
+
     Option("rgw_enable_quota_threads", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description("Enables the quota maintenance thread.")
@@ -5595,8 +5693,23 @@ std::vector<Option> get_rgw_options() {
     .set_default(10000)
     .set_description("Max number of items in RGW metadata cache.")
     .set_long_description(
-        "When full, the RGW metadata cache evicts least recently used entries.")
-    .add_see_also("rgw_cache_enabled"),
+        "When full, the RGW metadata cache evicts entries that were not used "
+        "recently. The limit is split evenly between the cache shards.")
+    .add_see_also({"rgw_cache_enabled", "rgw_cache_max_bytes", "rgw_cache_shards"}),
+
+    Option("rgw_cache_max_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(256_M)
+    .set_description("Max size of the RGW metadata cache, 0 for no limit.")
+    .set_long_description(
+        "The size of the cached data and attributes, and of the entries "
+        "themselves. The limit is split evenly between the cache shards.")
+    .add_see_also({"rgw_cache_lru_size", "rgw_cache_shards"}),
+
+    Option("rgw_cache_shards", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(32)
+    .set_min(1)
+    .set_description("Number of independently locked shards of the RGW metadata cache.")
+    .add_see_also({"rgw_cache_lru_size", "rgw_cache_max_bytes"}),
 
     Option("rgw_socket_path", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("")
@@ -5660,6 +5773,27 @@ std::vector<Option> get_rgw_options() {
     .set_default(0)
     .set_description("Delay after processing of bucket listing chunks (i.e., per 1000 entries) in milliseconds"),
 
+    Option("rgw_lc_max_worker", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(3)
+    .set_min(1)
+    .set_description("Number of lifecycle worker threads")
+    .set_long_description(
+        "Number of threads processing lifecycle in parallel. Each worker "
+        "claims the next bucket from the lifecycle shards, so this many "
+        "buckets are processed at once by each RGW instance.")
+    .add_see_also("rgw_lc_max_wp_worker"),
+
+    Option("rgw_lc_max_wp_worker", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(3)
+    .set_min(1)
+    .set_description("Number of threads processing the index shards of a bucket")
+    .set_long_description(
+        "Number of threads each lifecycle worker uses to process a bucket. "
+        "Every thread lists and applies the rules to a different bucket index "
+        "shard, and checkpoints its listing position so that an interrupted "
+        "run resumes where it stopped.")
+    .add_see_also("rgw_lc_max_worker"),
+
     Option("rgw_lc_max_objs", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(32)
     .set_description("Number of lifecycle data shards")
@@ -6284,12 +6418,24 @@ std::vector<Option> get_rgw_options() {
     .add_see_also({"rgw_gc_max_objs", "rgw_gc_obj_min_wait", "rgw_gc_processor_max_time", "rgw_gc_max_concurrent_io", "rgw_gc_max_trim_chunk"}),
 
     Option("rgw_gc_max_concurrent_io", Option::TYPE_INT, Option::LEVEL_ADVANCED)
-    .set_default(10)
+    .set_default(64)
     .set_description("Max concurrent RADOS IO operations for garbage collection")
     .set_long_description(
         "The maximum number of concurrent IO operations that the RGW garbage collection "
-        "thread will use when purging old data.")
-    .add_see_also({"rgw_gc_max_objs", "rgw_gc_obj_min_wait", "rgw_gc_processor_max_time", "rgw_gc_max_trim_chunk"}),
+        "thread will use when purging old data. With rgw_gc_io_target_latency set, the "
+        "number in use starts at 10 and is adjusted up to this limit.")
+    .add_see_also({"rgw_gc_max_objs", "rgw_gc_obj_min_wait", "rgw_gc_processor_max_time", "rgw_gc_max_trim_chunk", "rgw_gc_io_target_latency"}),
+
+    Option("rgw_gc_io_target_latency", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.1)
+    .set_description("Target latency, in seconds, of garbage collection IO operations")
+    .set_long_description(
+        "The garbage collector adds to the number of IO operations it keeps in flight "
+        "while their average latency stays below this target, and halves it when the "
+        "target is exceeded, so that purging a large backlog uses the capacity the OSDs "
+        "have to spare without slowing down client IO. Zero disables the tuning, and "
+        "always allows rgw_gc_max_concurrent_io operations.")
+    .add_see_also({"rgw_gc_max_concurrent_io"}),
 
     Option("rgw_gc_max_trim_chunk", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(16)
@@ -6336,7 +6482,19 @@ std::vector<Option> get_rgw_options() {
     Option("rgw_get_obj_window_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(16_M)
     .set_description("RGW object read window size")
-    .set_long_description("The window size in bytes for a single object read request"),
+    .set_long_description("The window size in bytes for a single object read request")
+    .add_see_also("rgw_get_obj_max_window_size"),
+
+    Option("rgw_get_obj_max_window_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(128_M)
+    .set_description("RGW object read max window size")
+    .set_long_description(
+        "An object read starts with rgw_get_obj_window_size bytes in flight, "
+        "and doubles that for as long as the data gets to the client faster, "
+        "up to this size. The reads that complete out of order are held in "
+        "memory until the ones before them complete, for up to the same "
+        "size again.")
+    .add_see_also("rgw_get_obj_window_size"),
 
     Option("rgw_get_obj_max_req_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(4_M)
@@ -6391,6 +6549,30 @@ std::vector<Option> get_rgw_options() {
         "the rgw_curl_low_speed_limit for the library to consider it too slow and abort. "
         "Set it zero to disable this."),
 
+    Option("rgw_http_client_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(2)
+    .set_min(1)
+    .set_description("Number of threads of each http client manager")
+    .set_long_description(
+        "Requests sent by RGW, such as those of multisite sync, are spread "
+        "over this many threads, each keeping its own pool of open connections."),
+
+    Option("rgw_http_client_idle_connections", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(32)
+    .set_description("Max idle connections kept open by each http client thread")
+    .set_long_description(
+        "Connections are kept open after a request, to be reused by the next "
+        "request to the same endpoint. When more than this many are open, the "
+        "oldest is closed. Set it zero for the libcurl default."),
+
+    Option("rgw_http_client_http2", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Use HTTP/2 for https requests sent by RGW")
+    .set_long_description(
+        "If true, the http client negotiates HTTP/2 with https endpoints that "
+        "support it, and multiplexes concurrent requests to an endpoint over "
+        "one connection. Requires libcurl built with HTTP/2 support."),
+
     Option("rgw_copy_obj_progress", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description("Send progress report through copy operation")
@@ -6457,6 +6639,16 @@ std::vector<Option> get_rgw_options() {
     .set_long_description(
         "Maximum number of entries in the quota stats cache."),
 
+    Option("rgw_quota_max_async_refreshes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(32)
+    .set_description("Max concurrent background refreshes of the quota stats cache")
+    .set_long_description(
+        "Cached bucket and user stats are refreshed in the background before "
+        "they expire. This limits how many of those reads may be in flight at "
+        "once; entries that come due above the limit are refreshed by a later "
+        "request. Changes made through this gateway are added to the cached "
+        "stats in the meantime."),
+
     Option("rgw_bucket_default_quota_max_objects", Option::TYPE_INT, Option::LEVEL_BASIC)
     .set_default(-1)
     .set_description("Default quota for max objects in a bucket")
@@ -6535,6 +6727,17 @@ std::vector<Option> get_rgw_options() {
     .set_default(10000)
     .set_description("Max number of parts in multipart upload"),
 
+    Option("rgw_multipart_compact_manifest", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Use a compact encoding for the manifests of completed multipart uploads")
+    .set_long_description(
+        "An upload with parts of different sizes has a manifest rule for "
+        "every part, all of which are kept in the head object's attributes. "
+        "The compact encoding takes a fraction of the space, but gateways "
+        "from older releases can't read objects written with it, so only "
+        "enable it once all gateways have been upgraded.")
+    .add_see_also("rgw_multipart_part_upload_limit"),
+
     Option("rgw_max_slo_entries", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1000)
     .set_description("Max number of entries in Swift Static Large Object manifest"),
@@ -6607,6 +6810,32 @@ std::vector<Option> get_rgw_options() {
     .set_default(120)
     .set_description(""),
 
+    Option("rgw_bucket_full_sync_list_max_keys", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1000)
+    .set_min_max(1, 100000)
+    .set_description("Number of entries requested per listing in bucket full sync")
+    .set_long_description("The number of object entries requested from the source zone in each listing of a bucket shard during full sync. The source zone caps this at its own rgw_max_listing_results.")
+    .add_see_also("rgw_max_listing_results"),
+
+    Option("rgw_bucket_full_sync_min_spawn_window", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(20)
+    .set_min(1)
+    .set_description("Minimum number of concurrent object fetches per bucket shard in full sync")
+    .add_see_also("rgw_bucket_full_sync_max_spawn_window"),
+
+    Option("rgw_bucket_full_sync_max_spawn_window", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(128)
+    .set_min(1)
+    .set_description("Maximum number of concurrent object fetches per bucket shard in full sync")
+    .set_long_description("Full sync of a bucket shard starts with rgw_bucket_full_sync_min_spawn_window concurrent object fetches. The window grows while the latency of the fetches stays close to the lowest latency seen, and shrinks when it rises, up to this many fetches.")
+    .add_see_also("rgw_bucket_full_sync_min_spawn_window"),
+
+    Option("rgw_bucket_full_sync_marker_window", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(100)
+    .set_min(1)
+    .set_description("Number of objects synced between full sync marker updates")
+    .set_long_description("The full sync position of a bucket shard is written to the log pool after this many of its objects have completed. A larger window means fewer writes, but more objects fetched again if sync restarts."),
+
     Option("rgw_sync_log_trim_interval", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1200)
     .set_description("Sync log trim interval")
@@ -6728,6 +6957,24 @@ std::vector<Option> get_rgw_options() {
     .add_tag("performance")
     .add_service("rgw"),
 
+    Option("rgw_reshard_online", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Keep the bucket index writable while it is resharded")
+    .set_long_description(
+        "The changes made to the bucket index while its entries are copied "
+        "to the new shards are logged, and replayed onto the new shards. "
+        "The writes are only blocked while the last changes are replayed, "
+        "before the new bucket instance is used. OSDs that don't support "
+        "this block the writes for the whole reshard.")
+    .add_service("rgw")
+    .add_see_also("rgw_reshard_online_cutover_entries"),
+
+    Option("rgw_reshard_online_cutover_entries", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1000)
+    .set_description("Number of index changes left to replay for an online reshard to block the writes and complete")
+    .add_service("rgw")
+    .add_see_also("rgw_reshard_online"),
+
     Option("rgw_reshard_max_aio", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(128)
     .set_min(16)
@@ -6766,6 +7013,28 @@ std::vector<Option> get_rgw_options() {
     .set_default(1000)
     .set_description("Minimum number of entries to request from rados for bucket listing"),
 
+    Option("rgw_list_bucket_min_shard_entries", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_description("Minimum number of entries to request from each bucket "
+                     "index shard for an ordered bucket listing")
+    .set_long_description("An ordered listing of a sharded bucket first asks "
+                          "each shard for about twice its share of the "
+                          "entries, but not less than this, and asks again "
+                          "with twice as many only the shards whose entries "
+                          "ran out.")
+    .add_see_also("rgw_list_bucket_min_readahead"),
+
+    Option("rgw_list_bucket_cls_delimiter", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Let the bucket index skip common prefixes when listing "
+                     "with a delimiter")
+    .set_long_description("When true, an ordered listing with a delimiter "
+                          "passes it to the bucket index objects, which return "
+                          "a single entry for each common prefix and seek past "
+                          "the entries under it. OSDs which don't support it "
+                          "return every entry, and the prefixes are then "
+                          "collapsed by the gateway."),
+
     Option("rgw_rest_getusage_op_compat", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description("REST GetUsage request backward compatibility"),
@@ -6932,7 +7201,7 @@ std::vector<Option> get_rgw_options() {
     Option("rgw_scheduler_type", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("throttler")
     .set_description("Set the type of dmclock scheduler, defaults to throttler "
-		     "Other valid values are dmclock which is experimental"),
+		     "Other valid values are dmclock and dmclock-tenant which are experimental"),
 
     Option("rgw_dmclock_admin_res", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(100.0)
@@ -7006,6 +7275,37 @@ std::vector<Option> get_rgw_options() {
     .add_see_also("rgw_dmclock_metadata_res")
     .add_see_also("rgw_dmclock_metadata_wgt"),
 
+    Option("rgw_dmclock_tenant_res", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.0)
+    .set_description("mclock reservation for each tenant not named in rgw_dmclock_tenant_qos")
+    .add_see_also("rgw_dmclock_tenant_qos"),
+
+    Option("rgw_dmclock_tenant_wgt", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(1.0)
+    .set_description("mclock weight for each tenant not named in rgw_dmclock_tenant_qos")
+    .add_see_also("rgw_dmclock_tenant_qos"),
+
+    Option("rgw_dmclock_tenant_lim", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.0)
+    .set_description("mclock limit for each tenant not named in rgw_dmclock_tenant_qos")
+    .add_see_also("rgw_dmclock_tenant_qos"),
+
+    Option("rgw_dmclock_tenant_qos", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("")
+    .set_description("mclock reservation, weight and limit of tenants and buckets")
+    .set_long_description("A comma separated list of <tenant>=<res>:<wgt>:<lim> "
+                          "and <tenant>/<bucket>=<res>:<wgt>:<lim> entries, used by "
+                          "the dmclock-tenant scheduler. Requests to a bucket "
+                          "named here are scheduled apart from the rest of its "
+                          "tenant. A tenant whose requesting user has a "
+                          "user.rgw.dmclock-qos attr of <res>:<wgt>:<lim> is "
+                          "scheduled by that instead. Changes apply to running "
+                          "gateways.")
+    .add_see_also("rgw_scheduler_type")
+    .add_see_also("rgw_dmclock_tenant_res")
+    .add_see_also("rgw_dmclock_tenant_wgt")
+    .add_see_also("rgw_dmclock_tenant_lim"),
+
   });
 }
 
@@ -8248,6 +8548,24 @@ std::vector<Option> get_mds_client_options() {
     Option("crimson_debug_pg_always_active", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(true)
     .set_description("remove me once crimson peering works"),
+
+    Option("crimson_osd_objectstore", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("cyanstore")
+    .set_enum_allowed({"cyanstore", "blockstore"})
+    .set_flag(Option::FLAG_CREATE)
+    .set_description("backend type for a crimson OSD")
+    .set_long_description("cyanstore keeps everything in memory and persists it on umount; blockstore stores data on the block device or file at osd_data/block, split into one shard per reactor"),
+
+    Option("crimson_blockstore_size", Option::TYPE_SIZE, Option::LEVEL_DEV)
+    .set_default(10_G)
+    .set_flag(Option::FLAG_CREATE)
+    .set_description("size of the file created for blockstore if osd_data/block is an empty regular file"),
+
+    Option("crimson_blockstore_journal_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(256_M)
+    .set_flag(Option::FLAG_CREATE)
+    .set_description("size of the blockstore metadata journal, divided evenly among its shards")
+    .set_long_description("The journal of each shard is split in two halves; when the active half fills up a checkpoint of all metadata of the shard is written to the other one, so each half must be large enough to hold the metadata of every object in the shard."),
   });
 }
 
@@ -0,0 +1,1581 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "block_store.h"
+
+#include <numeric>
+#include <optional>
+
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+
+#include <seastar/core/do_with.hh>
+#include <seastar/core/fstream.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/core/reactor.hh>
+
+#include "include/intarith.h"
+
+#include "crimson/common/config_proxy.h"
+#include "crimson/common/log.h"
+#include "crimson/os/cyan_collection.h"
+
+namespace {
+  seastar::logger& logger() {
+    return ceph::get_logger(ceph_subsys_filestore);
+  }
+
+  constexpr uint64_t JOURNAL_MAGIC = 0x63626c6b6a726e6cull;  // "cblkjrnl"
+  const std::string SUPERBLOCK_MAGIC = "crimson blockstore v1\n";
+  // magic, seq, type, payload length, payload crc
+  constexpr unsigned RECORD_HEADER_LEN = 8 + 8 + 1 + 4 + 4;
+  constexpr unsigned SUPERBLOCK_SLOTS = 2;
+  // meta files are small, read_meta() only looks at their first block
+  constexpr size_t MAX_META_LEN = 4096;
+}
+
+namespace ceph::os {
+
+using ceph::common::local_conf;
+using ceph::encode;
+using ceph::decode;
+
+void BlockStore::onode_t::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(size, bl);
+  encode(blocks, bl);
+  encode(xattr, bl);
+  encode(omap_header, bl);
+  encode(omap, bl);
+  ENCODE_FINISH(bl);
+}
+
+void BlockStore::onode_t::decode(bufferlist::const_iterator& p)
+{
+  DECODE_START(1, p);
+  decode(size, p);
+  decode(blocks, p);
+  decode(xattr, p);
+  decode(omap_header, p);
+  decode(omap, p);
+  DECODE_FINISH(p);
+}
+
+void BlockStore::onode_t::encode_meta(bufferlist& bl) const
+{
+  encode(size, bl);
+  encode(blocks, bl);
+  encode(xattr, bl);
+  encode(omap_header, bl);
+}
+
+void BlockStore::onode_t::decode_meta(bufferlist::const_iterator& p)
+{
+  decode(size, p);
+  decode(blocks, p);
+  decode(xattr, p);
+  decode(omap_header, p);
+}
+
+void BlockStore::omap_delta_t::setkeys(
+  const std::map<std::string, bufferlist>& aset)
+{
+  for (auto& [key, value] : aset) {
+    rm.erase(key);
+    set[key] = value;
+  }
+}
+
+void BlockStore::omap_delta_t::rmkeys(const std::set<std::string>& keys)
+{
+  for (auto& key : keys) {
+    set.erase(key);
+    rm.insert(key);
+  }
+}
+
+void BlockStore::omap_delta_t::clear_all()
+{
+  clear = true;
+  set.clear();
+  rm.clear();
+}
+
+void BlockStore::omap_delta_t::apply(
+  std::map<std::string, bufferlist>& omap) const
+{
+  if (clear) {
+    omap.clear();
+  }
+  for (auto& key : rm) {
+    omap.erase(key);
+  }
+  for (auto& [key, value] : set) {
+    omap[key] = value;
+  }
+}
+
+void BlockStore::omap_delta_t::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(clear, bl);
+  encode(set, bl);
+  encode(rm, bl);
+  ENCODE_FINISH(bl);
+}
+
+void BlockStore::omap_delta_t::decode(bufferlist::const_iterator& p)
+{
+  DECODE_START(1, p);
+  decode(clear, p);
+  decode(set, p);
+  decode(rm, p);
+  DECODE_FINISH(p);
+}
+
+void BlockStore::superblock_t::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(epoch, bl);
+  encode(fsid, bl);
+  encode(size, bl);
+  encode(journal_off, bl);
+  encode(journal_len, bl);
+  encode(active, bl);
+  encode(start_seq, bl);
+  ENCODE_FINISH(bl);
+}
+
+void BlockStore::superblock_t::decode(bufferlist::const_iterator& p)
+{
+  DECODE_START(1, p);
+  decode(epoch, p);
+  decode(fsid, p);
+  decode(size, p);
+  decode(journal_off, p);
+  decode(journal_len, p);
+  decode(active, p);
+  decode(start_seq, p);
+  DECODE_FINISH(p);
+}
+
+BlockStore::BlockStore(const std::string& path, unsigned nshards)
+  : path{path},
+    nshards{nshards},
+    shard{nshards > 1 ? seastar::engine().cpu_id() : 0}
+{}
+
+BlockStore::~BlockStore() = default;
+
+unsigned BlockStore::shard_of(const coll_t& cid, unsigned nshards)
+{
+  // a pg and its temp collection go together, everything else to shard 0
+  spg_t pgid;
+  if (!cid.is_pg_prefix(&pgid)) {
+    return 0;
+  }
+  return pgid.pgid.ps() % nshards;
+}
+
+seastar::future<> BlockStore::_open_device(bool create)
+{
+  auto flags = seastar::open_flags::rw;
+  if (create) {
+    flags = flags | seastar::open_flags::create;
+  }
+  return seastar::open_file_dma(path + "/block", flags).then(
+    [this](seastar::file f) {
+      dev = std::move(f);
+    });
+}
+
+uint64_t BlockStore::_set_region(uint64_t dev_size)
+{
+  const uint64_t region_len = p2align<uint64_t>(dev_size / nshards,
+						block_size);
+  base = shard * region_len;
+  return region_len;
+}
+
+seastar::future<> BlockStore::_dma_write(uint64_t off, const bufferlist& bl)
+{
+  ceph_assert(bl.length() % block_size == 0);
+  ceph::bufferptr bp{ceph::buffer::create_aligned(
+    bl.length(), dev.memory_dma_alignment())};
+  bl.copy(0, bl.length(), bp.c_str());
+  return dev.dma_write(base + off, bp.c_str(), bp.length()).then(
+    [bp](size_t written) {
+      if (written != bp.length()) {
+	throw std::runtime_error("short write");
+      }
+    });
+}
+
+seastar::future<ceph::bufferptr> BlockStore::_dma_read(uint64_t off,
+						       uint64_t len)
+{
+  return dev.dma_read_exactly<char>(base + off, len).then(
+    [len](seastar::temporary_buffer<char> buf) {
+      if (buf.size() != len) {
+	throw std::runtime_error("short read");
+      }
+      return ceph::bufferptr{ceph::buffer::create(std::move(buf))};
+    });
+}
+
+seastar::future<> BlockStore::_write_superblock()
+{
+  // never overwrite the newest valid superblock
+  ++sb.epoch;
+  bufferlist bl;
+  encode(SUPERBLOCK_MAGIC, bl);
+  encode(sb, bl);
+  uint32_t crc = bl.crc32c(-1);
+  encode(crc, bl);
+  ceph_assert(bl.length() <= block_size);
+  bl.append_zero(block_size - bl.length());
+  const uint64_t slot = sb.epoch % SUPERBLOCK_SLOTS;
+  return _dma_write(slot * block_size, bl).then([this] {
+    return dev.flush();
+  });
+}
+
+namespace {
+  std::optional<BlockStore::superblock_t> decode_superblock(bufferlist& bl)
+  {
+    auto p = bl.cbegin();
+    std::string magic;
+    try {
+      decode(magic, p);
+      if (magic != SUPERBLOCK_MAGIC) {
+	return {};
+      }
+      BlockStore::superblock_t sb;
+      decode(sb, p);
+      bufferlist crc_bl;
+      crc_bl.substr_of(bl, 0, p.get_off());
+      uint32_t crc;
+      decode(crc, p);
+      if (crc != crc_bl.crc32c(-1)) {
+	return {};
+      }
+      return sb;
+    } catch (ceph::buffer::error& e) {
+      return {};
+    }
+  }
+}
+
+seastar::future<> BlockStore::_read_superblock()
+{
+  return _dma_read(0, SUPERBLOCK_SLOTS * block_size).then(
+    [this](ceph::bufferptr bp) {
+    std::optional<superblock_t> newest;
+    for (unsigned slot = 0; slot < SUPERBLOCK_SLOTS; ++slot) {
+      bufferlist bl;
+      bl.append(ceph::bufferptr(bp, slot * block_size, block_size));
+      auto slot_sb = decode_superblock(bl);
+      if (!slot_sb) {
+	logger().info("{} no valid superblock in slot {}", __func__, slot);
+	continue;
+      }
+      if (!newest || slot_sb->epoch > newest->epoch) {
+	newest = std::move(slot_sb);
+      }
+    }
+    if (!newest) {
+      throw std::runtime_error("unable to decode superblock");
+    }
+    sb = *newest;
+    logger().info("{} epoch {} fsid {} size {} journal {}~{} active {} seq {}",
+		  __func__, sb.epoch, sb.fsid, sb.size, sb.journal_off,
+		  sb.journal_len, sb.active, sb.start_seq);
+  });
+}
+
+bufferlist BlockStore::_make_record(uint8_t type, uint64_t seq,
+				    const bufferlist& payload)
+{
+  bufferlist bl;
+  encode(JOURNAL_MAGIC, bl);
+  encode(seq, bl);
+  encode(type, bl);
+  encode(static_cast<uint32_t>(payload.length()), bl);
+  encode(payload.crc32c(seq), bl);
+  ceph_assert(bl.length() == RECORD_HEADER_LEN);
+  bl.append(payload);
+  bl.append_zero(p2roundup<uint64_t>(bl.length(), block_size) - bl.length());
+  return bl;
+}
+
+bufferlist BlockStore::_encode_checkpoint() const
+{
+  bufferlist bl;
+  encode(static_cast<uint32_t>(colls.size()), bl);
+  for (auto& [cid, c] : colls) {
+    encode(cid, bl);
+    encode(c.bits, bl);
+    encode(c.onodes, bl);
+  }
+  return bl;
+}
+
+bufferlist BlockStore::_encode_delta(const TransContext& txc)
+{
+  std::map<coll_t, int> created;
+  std::set<coll_t> removed;
+  for (auto& cid : txc.dirty_colls) {
+    if (auto c = colls.find(cid); c != colls.end()) {
+      created[cid] = c->second.bits;
+    } else {
+      removed.insert(cid);
+    }
+  }
+  bufferlist updated;
+  uint32_t num_updated = 0;
+  std::set<std::pair<coll_t, ghobject_t>> removed_onodes;
+  const omap_delta_t no_omap_changes;
+  for (auto& [cid, oid] : txc.dirty_onodes) {
+    if (auto o = _get_onode(cid, oid); o) {
+      encode(cid, updated);
+      encode(oid, updated);
+      o->encode_meta(updated);
+      auto delta = txc.omap_deltas.find({cid, oid});
+      encode(delta != txc.omap_deltas.end() ? delta->second : no_omap_changes,
+	     updated);
+      ++num_updated;
+    } else {
+      removed_onodes.emplace(cid, oid);
+    }
+  }
+  bufferlist bl;
+  encode(created, bl);
+  encode(num_updated, bl);
+  bl.claim_append(updated);
+  encode(removed_onodes, bl);
+  encode(removed, bl);
+  return bl;
+}
+
+void BlockStore::_apply_record(uint8_t type, bufferlist& payload)
+{
+  auto p = payload.cbegin();
+  if (type == RECORD_CHECKPOINT) {
+    colls.clear();
+    uint32_t n;
+    decode(n, p);
+    while (n--) {
+      coll_t cid;
+      decode(cid, p);
+      auto& c = colls[cid];
+      decode(c.bits, p);
+      decode(c.onodes, p);
+    }
+  } else if (type == RECORD_DELTA) {
+    std::map<coll_t, int> created;
+    decode(created, p);
+    for (auto& [cid, bits] : created) {
+      colls[cid].bits = bits;
+    }
+    uint32_t n;
+    decode(n, p);
+    while (n--) {
+      coll_t cid;
+      ghobject_t oid;
+      decode(cid, p);
+      decode(oid, p);
+      auto& o = colls[cid].onodes[oid];
+      o.decode_meta(p);
+      omap_delta_t delta;
+      decode(delta, p);
+      delta.apply(o.omap);
+    }
+    std::set<std::pair<coll_t, ghobject_t>> removed_onodes;
+    decode(removed_onodes, p);
+    for (auto& [cid, oid] : removed_onodes) {
+      if (auto c = colls.find(cid); c != colls.end()) {
+	c->second.onodes.erase(oid);
+      }
+    }
+    std::set<coll_t> removed;
+    decode(removed, p);
+    for (auto& cid : removed) {
+      colls.erase(cid);
+    }
+  } else {
+    throw std::runtime_error(fmt::format("bad journal record type {}",
+					 static_cast<unsigned>(type)));
+  }
+}
+
+seastar::future<> BlockStore::_replay()
+{
+  journal_pos = sb.half_off(sb.active);
+  next_seq = sb.start_seq;
+  const uint64_t end = journal_pos + sb.journal_len / 2;
+  return seastar::repeat([this, end] {
+    if (journal_pos + block_size > end) {
+      return seastar::make_ready_future<seastar::stop_iteration>(
+	seastar::stop_iteration::yes);
+    }
+    return _dma_read(journal_pos, block_size).then(
+      [this, end](ceph::bufferptr first) {
+      bufferlist header;
+      header.append(first);
+      auto p = header.cbegin();
+      uint64_t magic, seq;
+      uint8_t type;
+      uint32_t len, crc;
+      decode(magic, p);
+      decode(seq, p);
+      decode(type, p);
+      decode(len, p);
+      decode(crc, p);
+      uint64_t record_len = p2roundup<uint64_t>(RECORD_HEADER_LEN + len,
+						block_size);
+      if (magic != JOURNAL_MAGIC || seq != next_seq ||
+	  journal_pos + record_len > end) {
+	return seastar::make_ready_future<seastar::stop_iteration>(
+	  seastar::stop_iteration::yes);
+      }
+      auto rest = record_len > block_size ?
+	_dma_read(journal_pos + block_size, record_len - block_size) :
+	seastar::make_ready_future<ceph::bufferptr>();
+      return rest.then(
+	[this, first=std::move(first), seq, type, len, crc, record_len]
+	(ceph::bufferptr rest) {
+	bufferlist bl;
+	bl.append(first);
+	if (rest.length()) {
+	  bl.append(std::move(rest));
+	}
+	bufferlist payload;
+	payload.substr_of(bl, RECORD_HEADER_LEN, len);
+	if (payload.crc32c(seq) != crc) {
+	  logger().info("_replay: bad crc on record {} at {}", seq, journal_pos);
+	  return seastar::stop_iteration::yes;
+	}
+	logger().debug("_replay: record {} type {} at {}~{}",
+		       seq, static_cast<unsigned>(type), journal_pos, record_len);
+	if (seq == sb.start_seq && type != RECORD_CHECKPOINT) {
+	  throw std::runtime_error("journal does not start with a checkpoint");
+	}
+	_apply_record(type, payload);
+	journal_pos += record_len;
+	++next_seq;
+	return seastar::stop_iteration::no;
+      });
+    });
+  }).then([this] {
+    if (next_seq == sb.start_seq) {
+      throw std::runtime_error("unable to read journal checkpoint");
+    }
+    logger().info("_replay: replayed up to seq {}, journal at {}",
+		  next_seq - 1, journal_pos);
+  });
+}
+
+void BlockStore::_rebuild_freelist()
+{
+  free_blocks.clear();
+  pending_release.clear();
+  inflight.clear();
+  const uint64_t first = sb.data_off() / block_size;
+  free_blocks.insert(first, sb.size / block_size - first);
+  interval_set<uint64_t> used;
+  for (auto& [cid, c] : colls) {
+    c.ch = new Collection{cid};
+    c.ch->bits = c.bits;
+    for (auto& [oid, o] : c.onodes) {
+      for (auto& [lblk, pblk] : o.blocks) {
+	std::ignore = lblk;
+	used.insert(pblk, 1);
+      }
+    }
+  }
+  free_blocks.subtract(used);
+  used_blocks = used.size();
+}
+
+seastar::future<> BlockStore::mkfs()
+{
+  return read_meta("fsid").then([this](int r, std::string fsid_str) {
+    if (r == -ENOENT) {
+      sb.fsid.generate_random();
+      return write_meta("fsid", fmt::format("{}", sb.fsid));
+    } else if (r < 0) {
+      throw std::runtime_error("read_meta");
+    } else {
+      logger().info("mkfs already has fsid {}", fsid_str);
+      if (!sb.fsid.parse(fsid_str.c_str())) {
+	throw std::runtime_error("failed to parse fsid");
+      }
+      return seastar::now();
+    }
+  }).then([this] {
+    return _open_device(true);
+  }).then([this] {
+    return dev.size();
+  }).then([this](uint64_t size) {
+    if (size) {
+      return seastar::make_ready_future<uint64_t>(size);
+    }
+    size = local_conf().get_val<Option::size_t>("crimson_blockstore_size");
+    return dev.truncate(size).then([size] {
+      return size;
+    });
+  }).then([this](uint64_t size) {
+    sb.size = _set_region(size);
+    sb.journal_off = SUPERBLOCK_SLOTS * block_size;
+    sb.journal_len = p2align<uint64_t>(
+      local_conf().get_val<Option::size_t>("crimson_blockstore_journal_size") /
+      nshards,
+      2 * block_size);
+    if (sb.journal_len < 4 * block_size ||
+	sb.data_off() + block_size > sb.size) {
+      throw std::runtime_error(fmt::format(
+	"shard size {} is too small for a {} byte journal",
+	sb.size, sb.journal_len));
+    }
+    sb.active = 0;
+    sb.start_seq = 1;
+    colls.clear();
+    auto record = _make_record(RECORD_CHECKPOINT, sb.start_seq,
+			       _encode_checkpoint());
+    return _dma_write(sb.half_off(0), record);
+  }).then([this] {
+    // make sure a stale record from a previous mkfs cannot be replayed
+    bufferlist zero;
+    zero.append_zero(block_size);
+    return _dma_write(sb.half_off(1), zero);
+  }).then([this] {
+    // nor a stale superblock with a newer epoch be picked up
+    bufferlist zero;
+    zero.append_zero(SUPERBLOCK_SLOTS * block_size);
+    return _dma_write(0, zero);
+  }).then([this] {
+    return dev.flush();
+  }).then([this] {
+    sb.epoch = 0;
+    return _write_superblock();
+  }).then([this] {
+    return dev.close();
+  }).then([this] {
+    if (shard != 0) {
+      // the meta files are shared by the shards
+      return seastar::now();
+    }
+    return write_meta("shards", std::to_string(nshards)).then([this] {
+      return write_meta("type", "blockstore");
+    });
+  });
+}
+
+seastar::future<> BlockStore::mount()
+{
+  return read_meta("shards").then([this](int r, std::string value) {
+    if (r < 0) {
+      throw std::runtime_error("unable to read the number of shards");
+    }
+    // the device is split by the number of shards it was created with
+    if (std::stoul(value) != nshards) {
+      throw std::runtime_error(fmt::format(
+	"store has {} shards, but is mounted with {}", value, nshards));
+    }
+    return _open_device(false);
+  }).then([this] {
+    return dev.size();
+  }).then([this](uint64_t size) {
+    const uint64_t region_len = _set_region(size);
+    return _read_superblock().then([this, region_len] {
+      if (sb.size != region_len) {
+	throw std::runtime_error(fmt::format(
+	  "superblock size {} does not match the {} byte slice of the device",
+	  sb.size, region_len));
+      }
+    });
+  }).then([this] {
+    return _replay();
+  }).then([this] {
+    _rebuild_freelist();
+    logger().info("mount: shard {}: {} collections, {} blocks used, "
+		  "{} blocks free", shard, colls.size(), used_blocks,
+		  free_blocks.size());
+  });
+}
+
+seastar::future<> BlockStore::umount()
+{
+  // wait for the transactions in flight
+  return seastar::with_semaphore(txn_sem, 1, [this] {
+    return dev.flush().then([this] {
+      return dev.close();
+    }).then([this] {
+      colls.clear();
+      new_coll_map.clear();
+    });
+  });
+}
+
+BlockStore::onode_t* BlockStore::_get_onode(const coll_t& cid,
+					    const ghobject_t& oid)
+{
+  auto c = colls.find(cid);
+  if (c == colls.end()) {
+    return nullptr;
+  }
+  auto o = c->second.onodes.find(oid);
+  if (o == c->second.onodes.end()) {
+    return nullptr;
+  }
+  return &o->second;
+}
+
+seastar::future<std::vector<ghobject_t>, ghobject_t>
+BlockStore::list_objects(CollectionRef c,
+			 const ghobject_t& start,
+			 const ghobject_t& end,
+			 uint64_t limit)
+{
+  logger().debug("{} {} {} {} {}",
+		 __func__, c->cid, start, end, limit);
+  std::vector<ghobject_t> objects;
+  objects.reserve(limit);
+  ghobject_t next = ghobject_t::get_max();
+  if (auto cs = colls.find(c->cid); cs != colls.end()) {
+    auto& onodes = cs->second.onodes;
+    for (auto p = onodes.lower_bound(start); p != onodes.end(); ++p) {
+      if (p->first >= end || objects.size() >= limit) {
+	next = p->first;
+	break;
+      }
+      objects.push_back(p->first);
+    }
+  }
+  return seastar::make_ready_future<std::vector<ghobject_t>, ghobject_t>(
+    std::move(objects), next);
+}
+
+BlockStore::CollectionRef BlockStore::create_new_collection(const coll_t& cid)
+{
+  auto c = new Collection{cid};
+  return new_coll_map[cid] = c;
+}
+
+BlockStore::CollectionRef BlockStore::open_collection(const coll_t& cid)
+{
+  auto cp = colls.find(cid);
+  if (cp == colls.end())
+    return {};
+  return cp->second.ch;
+}
+
+std::vector<coll_t> BlockStore::list_collections()
+{
+  std::vector<coll_t> collections;
+  for (auto& coll : colls) {
+    collections.push_back(coll.first);
+  }
+  return collections;
+}
+
+seastar::future<ceph::bufferptr> BlockStore::_read_block(uint64_t pblk)
+{
+  if (auto p = inflight.find(pblk); p != inflight.end()) {
+    return seastar::make_ready_future<ceph::bufferptr>(p->second);
+  }
+  ++reads_in_flight;
+  return _dma_read(pblk * block_size, block_size).finally([this] {
+    --reads_in_flight;
+    _maybe_release();
+  });
+}
+
+seastar::future<bufferlist> BlockStore::_read_onode(const onode_t& o,
+						    uint64_t offset,
+						    uint64_t len)
+{
+  const uint64_t first = offset / block_size;
+  const uint64_t last = (offset + len - 1) / block_size;
+  // the block map may change once we yield, so resolve every block now
+  struct run_t {
+    uint64_t index;  ///< into blocks
+    uint64_t pblk;
+    uint64_t num;
+  };
+  std::vector<ceph::bufferptr> blocks(last - first + 1);
+  std::vector<run_t> runs;
+  ceph::bufferptr zero{ceph::buffer::create(block_size)};
+  zero.zero();
+  auto p = o.blocks.lower_bound(first);
+  for (uint64_t lblk = first; lblk <= last; ++lblk) {
+    const uint64_t index = lblk - first;
+    if (p == o.blocks.end() || p->first != lblk) {
+      blocks[index] = zero;
+      continue;
+    }
+    const uint64_t pblk = p->second;
+    ++p;
+    if (auto f = inflight.find(pblk); f != inflight.end()) {
+      blocks[index] = f->second;
+    } else if (!runs.empty() &&
+	       runs.back().index + runs.back().num == index &&
+	       runs.back().pblk + runs.back().num == pblk) {
+      ++runs.back().num;
+    } else {
+      runs.push_back(run_t{index, pblk, 1});
+    }
+  }
+  ++reads_in_flight;
+  return seastar::do_with(std::move(blocks), std::move(runs),
+    [this, offset, len, first](auto& blocks, auto& runs) {
+      return seastar::parallel_for_each(runs, [this, &blocks](auto& run) {
+	return _dma_read(run.pblk * block_size, run.num * block_size).then(
+	  [&blocks, &run](ceph::bufferptr bp) {
+	    for (uint64_t i = 0; i < run.num; ++i) {
+	      blocks[run.index + i] = ceph::bufferptr(bp, i * block_size,
+						      block_size);
+	    }
+	  });
+      }).then([&blocks, offset, len, first] {
+	bufferlist all;
+	for (auto& bp : blocks) {
+	  all.append(bp);
+	}
+	bufferlist bl;
+	bl.substr_of(all, offset - first * block_size, len);
+	return bl;
+      });
+    }).finally([this] {
+      --reads_in_flight;
+      _maybe_release();
+    });
+}
+
+seastar::future<bufferlist> BlockStore::read(CollectionRef c,
+					     const ghobject_t& oid,
+					     uint64_t offset,
+					     size_t len,
+					     uint32_t op_flags)
+{
+  logger().debug("{} {} {} {}~{}",
+		 __func__, c->cid, oid, offset, len);
+  if (!c->exists) {
+    throw std::runtime_error(fmt::format("collection does not exist: {}", c->cid));
+  }
+  auto o = _get_onode(c->cid, oid);
+  if (!o) {
+    throw std::runtime_error(fmt::format("object does not exist: {}", oid));
+  }
+  if (offset >= o->size)
+    return seastar::make_ready_future<bufferlist>();
+  size_t l = len;
+  if (l == 0 && offset == 0)  // note: len == 0 means read the entire object
+    l = o->size;
+  else if (offset + l > o->size)
+    l = o->size - offset;
+  return _read_onode(*o, offset, l);
+}
+
+seastar::future<ceph::bufferptr> BlockStore::get_attr(CollectionRef c,
+						      const ghobject_t& oid,
+						      std::string_view name)
+{
+  logger().debug("{} {} {}",
+		 __func__, c->cid, oid);
+  auto o = _get_onode(c->cid, oid);
+  if (!o) {
+    return seastar::make_exception_future<ceph::bufferptr>(
+      EnoentException(fmt::format("object does not exist: {}", oid)));
+  }
+  if (auto found = o->xattr.find(name); found != o->xattr.end()) {
+    return seastar::make_ready_future<ceph::bufferptr>(found->second);
+  } else {
+    return seastar::make_exception_future<ceph::bufferptr>(
+      EnoentException(fmt::format("attr does not exist: {}/{}", oid, name)));
+  }
+}
+
+seastar::future<BlockStore::attrs_t> BlockStore::get_attrs(CollectionRef c,
+							   const ghobject_t& oid)
+{
+  logger().debug("{} {} {}",
+		 __func__, c->cid, oid);
+  auto o = _get_onode(c->cid, oid);
+  if (!o) {
+    throw std::runtime_error(fmt::format("object does not exist: {}", oid));
+  }
+  return seastar::make_ready_future<attrs_t>(o->xattr);
+}
+
+seastar::future<BlockStore::omap_values_t>
+BlockStore::omap_get_values(CollectionRef c,
+			    const ghobject_t& oid,
+			    std::vector<std::string>&& keys)
+{
+  logger().debug("{} {} {}",
+		 __func__, c->cid, oid);
+  auto o = _get_onode(c->cid, oid);
+  if (!o) {
+    throw std::runtime_error(fmt::format("object does not exist: {}", oid));
+  }
+  omap_values_t values;
+  for (auto& key : keys) {
+    if (auto found = o->omap.find(key); found != o->omap.end()) {
+      values.insert(*found);
+    }
+  }
+  return seastar::make_ready_future<omap_values_t>(std::move(values));
+}
+
+seastar::future<> BlockStore::do_transaction(CollectionRef ch,
+					     Transaction&& t)
+{
+  return do_shard_transaction(std::move(t)).then([](coll_changes_t) {});
+}
+
+seastar::future<BlockStore::coll_changes_t>
+BlockStore::do_shard_transaction(Transaction&& t)
+{
+  return seastar::with_semaphore(txn_sem, 1,
+    [this, t=std::move(t)]() mutable {
+    return seastar::do_with(std::move(t), TransContext{},
+      [this](Transaction& t, TransContext& txc) {
+      return seastar::do_with(t.begin(), [this, &txc](auto& i) {
+	return seastar::do_until([&i] { return !i.have_op(); },
+				 [this, &txc, &i] {
+	  return _do_op(txc, i);
+	});
+      }).then_wrapped([this, &txc](seastar::future<> ops) {
+	// the data writes of the ops before a failed one are still in
+	// flight, and use txc and its buffers
+	return _wait_txc_data(txc).then_wrapped(
+	  [ops=std::move(ops)](seastar::future<> data) mutable {
+	  if (ops.failed()) {
+	    data.ignore_ready_future();
+	    return std::move(ops);
+	  }
+	  return data;
+	});
+      }).handle_exception([this, &txc](std::exception_ptr eptr) {
+	logger().error("do_transaction: rolling back: {}", eptr);
+	_rollback_txc(txc);
+	return seastar::make_exception_future<>(eptr);
+      }).then([this, &txc] {
+	return _journal_txc(txc).handle_exception([](std::exception_ptr eptr) {
+	  // the device may hold any part of the record or the checkpoint
+	  logger().error("do_transaction: failed to journal: {}", eptr);
+	  abort();
+	});
+      }).then([this, &txc] {
+	_finish_txc(txc);
+	coll_changes_t changes;
+	for (auto& cid : txc.dirty_colls) {
+	  if (auto c = colls.find(cid); c != colls.end()) {
+	    changes[cid] = c->second.bits;
+	  } else {
+	    changes[cid] = std::nullopt;
+	  }
+	}
+	return changes;
+      });
+    });
+  });
+}
+
+seastar::future<> BlockStore::_do_op(TransContext& txc,
+				     Transaction::iterator& i)
+{
+  Transaction::Op* op = i.decode_op();
+  int r = 0;
+  switch (op->op) {
+  case Transaction::OP_NOP:
+  case Transaction::OP_SETALLOCHINT:
+  case Transaction::OP_COLL_HINT:
+    break;
+  case Transaction::OP_REMOVE:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      r = _remove(txc, cid, oid);
+    }
+    break;
+  case Transaction::OP_TOUCH:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      r = _touch(txc, cid, oid);
+    }
+    break;
+  case Transaction::OP_WRITE:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      uint64_t off = op->off;
+      bufferlist bl;
+      i.decode_bl(bl);
+      ceph_assert(op->len == bl.length());
+      return _write(txc, cid, oid, off, std::move(bl));
+    }
+  case Transaction::OP_ZERO:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      bufferlist bl;
+      bl.append_zero(op->len);
+      return _write(txc, cid, oid, op->off, std::move(bl));
+    }
+  case Transaction::OP_TRUNCATE:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      uint64_t size = op->off;
+      r = _truncate(txc, cid, oid, size);
+      if (r == 0 && size % block_size) {
+	// keep the bytes past EOF in the last block zeroed, so that
+	// extending the object later does not expose stale data
+	auto o = _get_onode(cid, oid);
+	if (o->blocks.count(size / block_size)) {
+	  bufferlist bl;
+	  bl.append_zero(block_size - size % block_size);
+	  return _write(txc, cid, oid, size, std::move(bl)).then(
+	    [this, cid, oid, size] {
+	    _get_onode(cid, oid)->size = size;
+	  });
+	}
+      }
+    }
+    break;
+  case Transaction::OP_SETATTR:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      std::string name = i.decode_string();
+      bufferlist bl;
+      i.decode_bl(bl);
+      std::map<std::string, ceph::bufferptr> to_set;
+      to_set[name] = ceph::bufferptr(bl.c_str(), bl.length());
+      r = _setattrs(txc, cid, oid, to_set);
+    }
+    break;
+  case Transaction::OP_SETATTRS:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      std::map<std::string, ceph::bufferptr> aset;
+      i.decode_attrset(aset);
+      r = _setattrs(txc, cid, oid, aset);
+    }
+    break;
+  case Transaction::OP_RMATTR:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      std::string name = i.decode_string();
+      r = _rmattr(txc, cid, oid, name);
+    }
+    break;
+  case Transaction::OP_MKCOLL:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      r = _create_collection(txc, cid, op->split_bits);
+    }
+    break;
+  case Transaction::OP_RMCOLL:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      r = _remove_collection(txc, cid);
+    }
+    break;
+  case Transaction::OP_OMAP_CLEAR:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      r = _omap_clear(txc, cid, oid);
+    }
+    break;
+  case Transaction::OP_OMAP_SETKEYS:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      std::map<std::string, bufferlist> aset;
+      i.decode_attrset(aset);
+      r = _omap_setkeys(txc, cid, oid, aset);
+    }
+    break;
+  case Transaction::OP_OMAP_RMKEYS:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      std::set<std::string> keys;
+      i.decode_keyset(keys);
+      r = _omap_rmkeys(txc, cid, oid, keys);
+    }
+    break;
+  case Transaction::OP_OMAP_SETHEADER:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      bufferlist bl;
+      i.decode_bl(bl);
+      r = _omap_setheader(txc, cid, oid, bl);
+    }
+    break;
+  default:
+    logger().error("bad op {}", static_cast<unsigned>(op->op));
+    abort();
+  }
+  if (r < 0) {
+    logger().error("op {} failed with {}", static_cast<unsigned>(op->op), r);
+    abort();
+  }
+  return seastar::now();
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> BlockStore::_allocate(uint64_t num)
+{
+  if (free_blocks.size() < num) {
+    throw std::runtime_error(fmt::format("out of space allocating {} blocks",
+					 num));
+  }
+  std::vector<std::pair<uint64_t, uint64_t>> extents;
+  while (num) {
+    auto p = free_blocks.begin();
+    uint64_t start = p.get_start();
+    uint64_t len = std::min<uint64_t>(p.get_len(), num);
+    free_blocks.erase(start, len);
+    extents.emplace_back(start, len);
+    num -= len;
+  }
+  used_blocks += std::accumulate(
+    extents.begin(), extents.end(), uint64_t(0),
+    [](uint64_t sum, auto& e) { return sum + e.second; });
+  return extents;
+}
+
+seastar::future<> BlockStore::_write(TransContext& txc,
+				     const coll_t& cid,
+				     const ghobject_t& oid,
+				     uint64_t offset,
+				     bufferlist&& bl)
+{
+  logger().debug("{} {} {} {} ~ {}",
+		 __func__, cid, oid, offset, bl.length());
+  auto c = colls.find(cid);
+  if (c == colls.end()) {
+    logger().error("{} collection {} does not exist", __func__, cid);
+    abort();
+  }
+  _save_onode(txc, cid, oid);
+  auto& o = c->second.onodes[oid];
+  txc.dirty_onodes.emplace(cid, oid);
+  const uint64_t len = bl.length();
+  if (len == 0) {
+    return seastar::now();
+  }
+  const uint64_t first = offset / block_size;
+  const uint64_t last = (offset + len - 1) / block_size;
+  // read the partially overwritten blocks at either end
+  auto read_edge = [this, &o](uint64_t lblk, bool partial) {
+    if (!partial) {
+      return seastar::make_ready_future<ceph::bufferptr>();
+    }
+    auto p = o.blocks.find(lblk);
+    if (p == o.blocks.end()) {
+      return seastar::make_ready_future<ceph::bufferptr>();
+    }
+    return _read_block(p->second);
+  };
+  const bool head_partial = offset % block_size;
+  const bool tail_partial = (offset + len) % block_size;
+  auto head = read_edge(first, head_partial || (first == last && tail_partial));
+  auto tail = read_edge(last, first != last && tail_partial);
+  return seastar::when_all_succeed(std::move(head), std::move(tail)).then(
+    [this, &txc, &o, offset, first, last, bl=std::move(bl)]
+    (ceph::bufferptr head, ceph::bufferptr tail) {
+    const uint64_t num = last - first + 1;
+    ceph::bufferptr buf{ceph::buffer::create_aligned(
+      num * block_size, dev.memory_dma_alignment())};
+    buf.zero();
+    if (head.length()) {
+      buf.copy_in(0, block_size, head.c_str());
+    }
+    if (tail.length()) {
+      buf.copy_in((num - 1) * block_size, block_size, tail.c_str());
+    }
+    bl.copy(0, bl.length(), buf.c_str() + offset - first * block_size);
+
+    uint64_t lblk = first;
+    for (auto [pblk, count] : _allocate(num)) {
+      for (uint64_t i = 0; i < count; ++i, ++lblk) {
+	ceph::bufferptr block{buf, unsigned((lblk - first) * block_size),
+			      unsigned(block_size)};
+	inflight[pblk + i] = block;
+	txc.written.push_back(pblk + i);
+	auto [p, inserted] = o.blocks.emplace(lblk, pblk + i);
+	if (!inserted) {
+	  txc.released.insert(p->second, 1);
+	  p->second = pblk + i;
+	}
+      }
+      const char* data = buf.c_str() + (lblk - count - first) * block_size;
+      txc.writes.push_back(
+	dev.dma_write(base + pblk * block_size, data, count * block_size).then(
+	  [buf, count](size_t written) {
+	  if (written != count * block_size) {
+	    throw std::runtime_error("short write");
+	  }
+	}));
+    }
+    o.size = std::max(o.size, offset + bl.length());
+  });
+}
+
+int BlockStore::_remove(TransContext& txc, const coll_t& cid,
+			const ghobject_t& oid)
+{
+  logger().debug("{} cid={} oid={}",
+		 __func__, cid, oid);
+  auto c = colls.find(cid);
+  if (c == colls.end())
+    return -ENOENT;
+  auto o = c->second.onodes.find(oid);
+  if (o == c->second.onodes.end())
+    return -ENOENT;
+  _save_omap(_save_onode(txc, cid, oid), o->second);
+  _punch(txc, o->second, 0);
+  c->second.onodes.erase(o);
+  txc.dirty_onodes.emplace(cid, oid);
+  // in case the object is created again by the same transaction
+  txc.omap_deltas[{cid, oid}].clear_all();
+  return 0;
+}
+
+int BlockStore::_touch(TransContext& txc, const coll_t& cid,
+		       const ghobject_t& oid)
+{
+  logger().debug("{} cid={} oid={}",
+		 __func__, cid, oid);
+  auto c = colls.find(cid);
+  if (c == colls.end())
+    return -ENOENT;
+  _save_onode(txc, cid, oid);
+  c->second.onodes[oid];
+  txc.dirty_onodes.emplace(cid, oid);
+  return 0;
+}
+
+void BlockStore::_punch(TransContext& txc, onode_t& o, uint64_t first_blk)
+{
+  for (auto p = o.blocks.lower_bound(first_blk); p != o.blocks.end(); ) {
+    txc.released.insert(p->second, 1);
+    p = o.blocks.erase(p);
+  }
+}
+
+int BlockStore::_truncate(TransContext& txc, const coll_t& cid,
+			  const ghobject_t& oid, uint64_t size)
+{
+  logger().debug("{} cid={} oid={} size={}",
+		 __func__, cid, oid, size);
+  auto o = _get_onode(cid, oid);
+  if (!o)
+    return -ENOENT;
+  _save_onode(txc, cid, oid);
+  _punch(txc, *o, p2roundup(size, block_size) / block_size);
+  o->size = size;
+  txc.dirty_onodes.emplace(cid, oid);
+  return 0;
+}
+
+int BlockStore::_setattrs(TransContext& txc, const coll_t& cid,
+			  const ghobject_t& oid,
+			  std::map<std::string,ceph::bufferptr>& aset)
+{
+  logger().debug("{} cid={} oid={}",
+		 __func__, cid, oid);
+  auto o = _get_onode(cid, oid);
+  if (!o)
+    return -ENOENT;
+  _save_onode(txc, cid, oid);
+  for (auto& [name, value] : aset) {
+    o->xattr[name] = value;
+  }
+  txc.dirty_onodes.emplace(cid, oid);
+  return 0;
+}
+
+int BlockStore::_rmattr(TransContext& txc, const coll_t& cid,
+			const ghobject_t& oid, const std::string& name)
+{
+  logger().debug("{} cid={} oid={} name={}",
+		 __func__, cid, oid, name);
+  auto o = _get_onode(cid, oid);
+  if (!o)
+    return -ENOENT;
+  if (auto p = o->xattr.find(name); p != o->xattr.end()) {
+    _save_onode(txc, cid, oid);
+    o->xattr.erase(p);
+  } else {
+    return -ENODATA;
+  }
+  txc.dirty_onodes.emplace(cid, oid);
+  return 0;
+}
+
+int BlockStore::_omap_setkeys(TransContext& txc, const coll_t& cid,
+			      const ghobject_t& oid,
+			      std::map<std::string,bufferlist>& aset)
+{
+  logger().debug("{} cid={} oid={}",
+		 __func__, cid, oid);
+  auto o = _get_onode(cid, oid);
+  if (!o)
+    return -ENOENT;
+  auto& undo = _save_onode(txc, cid, oid);
+  for (auto& [key, value] : aset) {
+    _save_omap_key(undo, *o, key);
+    o->omap[key] = value;
+  }
+  txc.dirty_onodes.emplace(cid, oid);
+  txc.omap_deltas[{cid, oid}].setkeys(aset);
+  return 0;
+}
+
+int BlockStore::_omap_rmkeys(TransContext& txc, const coll_t& cid,
+			     const ghobject_t& oid,
+			     const std::set<std::string>& keys)
+{
+  logger().debug("{} cid={} oid={}",
+		 __func__, cid, oid);
+  auto o = _get_onode(cid, oid);
+  if (!o)
+    return -ENOENT;
+  auto& undo = _save_onode(txc, cid, oid);
+  for (auto& key : keys) {
+    _save_omap_key(undo, *o, key);
+    o->omap.erase(key);
+  }
+  txc.dirty_onodes.emplace(cid, oid);
+  txc.omap_deltas[{cid, oid}].rmkeys(keys);
+  return 0;
+}
+
+int BlockStore::_omap_setheader(TransContext& txc, const coll_t& cid,
+				const ghobject_t& oid, bufferlist& header)
+{
+  logger().debug("{} cid={} oid={}",
+		 __func__, cid, oid);
+  auto o = _get_onode(cid, oid);
+  if (!o)
+    return -ENOENT;
+  _save_onode(txc, cid, oid);
+  o->omap_header = header;
+  txc.dirty_onodes.emplace(cid, oid);
+  return 0;
+}
+
+int BlockStore::_omap_clear(TransContext& txc, const coll_t& cid,
+			    const ghobject_t& oid)
+{
+  logger().debug("{} cid={} oid={}",
+		 __func__, cid, oid);
+  auto o = _get_onode(cid, oid);
+  if (!o)
+    return -ENOENT;
+  _save_omap(_save_onode(txc, cid, oid), *o);
+  o->omap_header.clear();
+  txc.dirty_onodes.emplace(cid, oid);
+  txc.omap_deltas[{cid, oid}].clear_all();
+  return 0;
+}
+
+int BlockStore::_create_collection(TransContext& txc, const coll_t& cid,
+				   int bits)
+{
+  if (shard_of(cid, nshards) != shard) {
+    logger().error("{} collection {} belongs to shard {}, not {}",
+		   __func__, cid, shard_of(cid, nshards), shard);
+    return -EINVAL;
+  }
+  _save_coll(txc, cid);
+  auto result = colls.emplace(cid, coll_state_t{});
+  if (!result.second)
+    return -EEXIST;
+  auto& c = result.first->second;
+  if (auto p = new_coll_map.find(cid); p != new_coll_map.end()) {
+    c.ch = p->second;
+    new_coll_map.erase(p);
+  } else {
+    c.ch = new Collection{cid};
+  }
+  c.ch->bits = c.bits = bits;
+  txc.dirty_colls.insert(cid);
+  return 0;
+}
+
+int BlockStore::_remove_collection(TransContext& txc, const coll_t& cid)
+{
+  auto c = colls.find(cid);
+  if (c == colls.end())
+    return -ENOENT;
+  if (!c->second.onodes.empty())
+    return -ENOTEMPTY;
+  _save_coll(txc, cid);
+  c->second.ch->exists = false;
+  colls.erase(c);
+  txc.dirty_colls.insert(cid);
+  return 0;
+}
+
+seastar::future<> BlockStore::_wait_txc_data(TransContext& txc)
+{
+  return seastar::when_all(txc.writes.begin(), txc.writes.end()).then(
+    [this](std::vector<seastar::future<>> writes) {
+    std::exception_ptr eptr;
+    for (auto& f : writes) {
+      if (!f.failed()) {
+	continue;
+      }
+      auto e = f.get_exception();
+      if (!eptr) {
+	eptr = e;
+      }
+    }
+    if (eptr) {
+      return seastar::make_exception_future<>(eptr);
+    }
+    // the journal record must not become stable before the data it
+    // points to
+    return writes.empty() ? seastar::now() : dev.flush();
+  });
+}
+
+seastar::future<> BlockStore::_journal_txc(TransContext& txc)
+{
+  return seastar::futurize_apply([this, &txc] {
+    if (txc.dirty_colls.empty() && txc.dirty_onodes.empty()) {
+      return seastar::now();
+    }
+    auto record = _make_record(RECORD_DELTA, next_seq, _encode_delta(txc));
+    const uint64_t end = sb.half_off(sb.active) + sb.journal_len / 2;
+    if (journal_pos + record.length() <= end) {
+      const uint64_t pos = journal_pos;
+      journal_pos += record.length();
+      ++next_seq;
+      return _dma_write(pos, record).then([this] {
+	return dev.flush();
+      });
+    }
+    // the active half is full: start over in the other half with a
+    // checkpoint, which covers this transaction as well
+    const uint8_t other = sb.active ^ 1;
+    const uint64_t seq = next_seq++;
+    record = _make_record(RECORD_CHECKPOINT, seq, _encode_checkpoint());
+    if (record.length() > sb.journal_len / 2) {
+      throw std::runtime_error(fmt::format(
+	"checkpoint of {} bytes does not fit in the journal",
+	record.length()));
+    }
+    logger().info("_journal_txc: checkpoint {} to journal half {}",
+		  seq, static_cast<unsigned>(other));
+    journal_pos = sb.half_off(other) + record.length();
+    return _dma_write(sb.half_off(other), record).then([this] {
+      return dev.flush();
+    }).then([this, other, seq] {
+      sb.active = other;
+      sb.start_seq = seq;
+      return _write_superblock();
+    });
+  });
+}
+
+void BlockStore::_finish_txc(TransContext& txc)
+{
+  for (auto pblk : txc.written) {
+    inflight.erase(pblk);
+  }
+  pending_release.union_of(txc.released);
+  _maybe_release();
+}
+
+void BlockStore::_rollback_txc(TransContext& txc)
+{
+  // collections first, as the onodes go back into them
+  for (auto& [cid, prev] : txc.coll_undo) {
+    if (prev) {
+      prev->ch->exists = true;
+      colls[cid] = std::move(*prev);
+    } else if (auto c = colls.find(cid); c != colls.end()) {
+      // the caller may retry with the handle it created
+      new_coll_map[cid] = c->second.ch;
+      colls.erase(c);
+    }
+  }
+  for (auto& [key, undo] : txc.onode_undo) {
+    auto& [cid, oid] = key;
+    auto c = colls.find(cid);
+    if (!undo.existed) {
+      if (c != colls.end()) {
+	c->second.onodes.erase(oid);
+      }
+      continue;
+    }
+    ceph_assert(c != colls.end());
+    auto& o = c->second.onodes[oid];
+    o.size = undo.prev.size;
+    o.blocks = std::move(undo.prev.blocks);
+    o.xattr = std::move(undo.prev.xattr);
+    o.omap_header = std::move(undo.prev.omap_header);
+    if (undo.omap_saved) {
+      o.omap = std::move(undo.prev.omap);
+    }
+    for (auto& [k, v] : undo.omap_prev) {
+      if (v) {
+	o.omap[k] = std::move(*v);
+      } else {
+	o.omap.erase(k);
+      }
+    }
+  }
+  // no onode references the blocks written any more, and the ones it
+  // would have released are still in use
+  for (auto pblk : txc.written) {
+    inflight.erase(pblk);
+    pending_release.insert(pblk, 1);
+  }
+  _maybe_release();
+}
+
+BlockStore::onode_undo_t& BlockStore::_save_onode(TransContext& txc,
+						  const coll_t& cid,
+						  const ghobject_t& oid)
+{
+  auto [p, inserted] = txc.onode_undo.try_emplace({cid, oid});
+  auto& undo = p->second;
+  if (inserted) {
+    if (auto o = _get_onode(cid, oid); o) {
+      undo.existed = true;
+      undo.prev.size = o->size;
+      undo.prev.blocks = o->blocks;
+      undo.prev.xattr = o->xattr;
+      undo.prev.omap_header = o->omap_header;
+    }
+  }
+  return undo;
+}
+
+void BlockStore::_save_omap_key(onode_undo_t& undo, const onode_t& o,
+				const std::string& key)
+{
+  // only the keys the transaction changes are saved, instead of the omap
+  if (undo.omap_saved || undo.omap_prev.count(key)) {
+    return;
+  }
+  std::optional<bufferlist> prev;
+  if (auto p = o.omap.find(key); p != o.omap.end()) {
+    prev = p->second;
+  }
+  undo.omap_prev.emplace(key, std::move(prev));
+}
+
+void BlockStore::_save_omap(onode_undo_t& undo, onode_t& o)
+{
+  if (!undo.omap_saved) {
+    undo.prev.omap = std::move(o.omap);
+    undo.omap_saved = true;
+  }
+  o.omap.clear();
+}
+
+void BlockStore::_save_coll(TransContext& txc, const coll_t& cid)
+{
+  if (txc.coll_undo.count(cid)) {
+    return;
+  }
+  std::optional<coll_state_t> prev;
+  if (auto c = colls.find(cid); c != colls.end()) {
+    prev = c->second;
+  }
+  txc.coll_undo.emplace(cid, std::move(prev));
+}
+
+void BlockStore::_maybe_release()
+{
+  // a read may still be looking at a block released after it started
+  if (reads_in_flight || pending_release.empty()) {
+    return;
+  }
+  used_blocks -= pending_release.size();
+  free_blocks.union_of(pending_release);
+  pending_release.clear();
+}
+
+seastar::future<> BlockStore::write_meta(const std::string& key,
+					 const std::string& value)
+{
+  // like safe_write_file(), write to a temporary file, and rename it over
+  // the old one once it is stable
+  const std::string fn = path + "/" + key;
+  const std::string tmp = fn + ".tmp";
+  return seastar::open_file_dma(tmp, seastar::open_flags::wo |
+				seastar::open_flags::create |
+				seastar::open_flags::truncate).then(
+    [v=value + "\n"](seastar::file f) mutable {
+    return seastar::do_with(seastar::make_file_output_stream(std::move(f)),
+			    std::move(v),
+      [](seastar::output_stream<char>& out, const std::string& v) {
+      return out.write(v).then([&out] {
+	return out.flush();
+      }).finally([&out] {
+	// flushes the file before closing it
+	return out.close();
+      });
+    });
+  }).then([fn, tmp] {
+    return seastar::engine().rename_file(tmp, fn);
+  }).then([this] {
+    return seastar::engine().fsync_directory(path);
+  }).handle_exception([key](std::exception_ptr eptr) {
+    logger().error("write_meta({}) failed: {}", key, eptr);
+    return seastar::make_exception_future<>(std::runtime_error{
+      fmt::format("unable to write_meta({})", key)});
+  });
+}
+
+seastar::future<int, std::string> BlockStore::read_meta(const std::string& key)
+{
+  const std::string fn = path + "/" + key;
+  return seastar::engine().file_exists(fn).then([fn](bool exists) {
+    if (!exists) {
+      return seastar::make_ready_future<int, std::string>(-ENOENT,
+							  std::string{});
+    }
+    return seastar::open_file_dma(fn, seastar::open_flags::ro).then(
+      [](seastar::file f) {
+      return f.size().then([f](uint64_t size) mutable {
+	return seastar::do_with(seastar::make_file_input_stream(std::move(f)),
+	  [size](seastar::input_stream<char>& in) {
+	  return in.read_exactly(std::min<uint64_t>(size, MAX_META_LEN)).finally([&in] {
+	    return in.close();
+	  });
+	});
+      });
+    }).then([](seastar::temporary_buffer<char> buf) {
+      std::string value{buf.get(), buf.size()};
+      // drop trailing newlines
+      while (!value.empty() && isspace(value.back())) {
+	value.pop_back();
+      }
+      return seastar::make_ready_future<int, std::string>(0, std::move(value));
+    });
+  });
+}
+
+uuid_d BlockStore::get_fsid() const
+{
+  return sb.fsid;
+}
+
+}
@@ -0,0 +1,284 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <seastar/core/file.hh>
+#include <seastar/core/future.hh>
+#include <seastar/core/semaphore.hh>
+
+#include "include/interval_set.h"
+#include "include/uuid.h"
+#include "os/Transaction.h"
+#include "crimson/os/futurized_store.h"
+
+namespace ceph::os {
+
+/**
+ * a persistent store driven by the seastar reactor
+ *
+ * All I/O goes through seastar's DMA file API, so no call blocks the
+ * reactor.  The device (or file) at $path/block is laid out as
+ *
+ *   [0, 2 * block_size)                superblock, in two slots
+ *   [2 * block_size, data_off)         metadata journal, in two halves
+ *   [data_off, size)                   object data, in block_size units
+ *
+ * Object data is never overwritten in place.  A write goes to newly
+ * allocated blocks; once those are stable a journal record carrying the
+ * post-image of every onode and collection the transaction touched, but
+ * only the keys it changed of their omaps, is appended, and only then are
+ * the blocks the onodes used to reference released.  When the active
+ * journal half fills up, a checkpoint of all metadata is written at the
+ * start of the other half, and the superblock is switched over to it.
+ * Superblock updates alternate between the two slots, so that a torn
+ * write leaves the previous one intact.  Mount reads the newest valid
+ * superblock and the checkpoint it points to, and replays the records
+ * following it.
+ *
+ * A transaction whose ops or data writes fail is rolled back: the
+ * metadata it changed is restored and the blocks it wrote are freed, so
+ * nothing of it reaches the journal.  A failure to write the journal
+ * itself is fatal.
+ *
+ * All metadata lives in memory, and the free list is rebuilt from the
+ * block maps at mount.  An instance owns its device and must only be
+ * used from the reactor that mounted it.
+ *
+ * When the store is split into shards, one per reactor (see
+ * ShardedBlockStore), each shard owns an equal slice of the device, laid
+ * out as above, and the collections mapped to it by shard_of().
+ */
+class BlockStore final : public FuturizedStore {
+public:
+  static constexpr uint64_t block_size = 4096;
+
+  struct onode_t {
+    uint64_t size = 0;
+    std::map<uint64_t, uint64_t> blocks;  ///< logical -> physical block
+    std::map<std::string, ceph::bufferptr, std::less<>> xattr;
+    bufferlist omap_header;
+    std::map<std::string, bufferlist> omap;
+
+    void encode(bufferlist& bl) const;
+    void decode(bufferlist::const_iterator& p);
+    /// everything but the omap, which is journaled as an omap_delta_t
+    void encode_meta(bufferlist& bl) const;
+    void decode_meta(bufferlist::const_iterator& p);
+  };
+
+  /// the omap changes of a transaction to an onode
+  struct omap_delta_t {
+    bool clear = false;  ///< the omap was cleared before the changes below
+    std::map<std::string, bufferlist> set;
+    std::set<std::string> rm;
+
+    void setkeys(const std::map<std::string, bufferlist>& aset);
+    void rmkeys(const std::set<std::string>& keys);
+    void clear_all();
+    void apply(std::map<std::string, bufferlist>& omap) const;
+    void encode(bufferlist& bl) const;
+    void decode(bufferlist::const_iterator& p);
+  };
+
+  struct superblock_t {
+    uint64_t epoch = 0;          ///< bumped on every write, the newest wins
+    uuid_d fsid;
+    uint64_t size = 0;           ///< device size
+    uint64_t journal_off = 0;
+    uint64_t journal_len = 0;    ///< both halves
+    uint8_t active = 0;          ///< active journal half
+    uint64_t start_seq = 0;      ///< seq of the checkpoint in the active half
+
+    uint64_t data_off() const {
+      return journal_off + journal_len;
+    }
+    uint64_t half_off(uint8_t half) const {
+      return journal_off + half * (journal_len / 2);
+    }
+    void encode(bufferlist& bl) const;
+    void decode(bufferlist::const_iterator& p);
+  };
+
+  /// @p nshards > 1 for the shard of the calling reactor
+  BlockStore(const std::string& path, unsigned nshards = 1);
+  ~BlockStore() final;
+
+  /// the shard owning @p cid, by placement group
+  static unsigned shard_of(const coll_t& cid, unsigned nshards);
+
+  // required by sharded<>
+  seastar::future<> stop() {
+    return seastar::now();
+  }
+
+  seastar::future<> mount() final;
+  seastar::future<> umount() final;
+
+  seastar::future<> mkfs() final;
+  seastar::future<bufferlist> read(CollectionRef c,
+				   const ghobject_t& oid,
+				   uint64_t offset,
+				   size_t len,
+				   uint32_t op_flags = 0) final;
+  seastar::future<ceph::bufferptr> get_attr(CollectionRef c,
+					    const ghobject_t& oid,
+					    std::string_view name) final;
+  seastar::future<attrs_t> get_attrs(CollectionRef c, const ghobject_t& oid) final;
+  seastar::future<omap_values_t> omap_get_values(
+    CollectionRef c,
+    const ghobject_t& oid,
+    std::vector<std::string>&& keys) final;
+  seastar::future<std::vector<ghobject_t>, ghobject_t> list_objects(
+    CollectionRef c,
+    const ghobject_t& start,
+    const ghobject_t& end,
+    uint64_t limit) final;
+  CollectionRef create_new_collection(const coll_t& cid) final;
+  CollectionRef open_collection(const coll_t& cid) final;
+  std::vector<coll_t> list_collections() final;
+
+  seastar::future<> do_transaction(CollectionRef ch,
+				   Transaction&& txn) final;
+  /// the collections a transaction created, with their bits, or removed
+  using coll_changes_t = std::map<coll_t, std::optional<int>>;
+  /// do_transaction(), telling ShardedBlockStore what to update its
+  /// collection handles with
+  seastar::future<coll_changes_t> do_shard_transaction(Transaction&& txn);
+
+  seastar::future<> write_meta(const std::string& key,
+			       const std::string& value) final;
+  seastar::future<int, std::string> read_meta(const std::string& key) final;
+  uuid_d get_fsid() const final;
+
+  uint64_t get_used_bytes() const {
+    return used_blocks * block_size;
+  }
+
+private:
+  struct coll_state_t {
+    CollectionRef ch;
+    int bits = 0;
+    std::map<ghobject_t, onode_t> onodes;
+  };
+
+  /// an onode as it was before a transaction changed it
+  struct onode_undo_t {
+    bool existed = false;
+    onode_t prev;  ///< all but the omap, unless omap_saved
+    /// prev.omap holds the omap as it was when the transaction cleared or
+    /// removed it
+    bool omap_saved = false;
+    /// the values of the keys changed before that, nullopt if absent
+    std::map<std::string, std::optional<bufferlist>> omap_prev;
+  };
+
+  /// what a transaction changed, and which blocks it wrote and freed
+  struct TransContext {
+    std::set<coll_t> dirty_colls;
+    std::set<std::pair<coll_t, ghobject_t>> dirty_onodes;
+    std::map<std::pair<coll_t, ghobject_t>, omap_delta_t> omap_deltas;
+    std::vector<seastar::future<>> writes;
+    std::vector<uint64_t> written;   ///< blocks in the inflight map
+    interval_set<uint64_t> released;
+    /// to roll back with, nullopt for a collection created by it
+    std::map<coll_t, std::optional<coll_state_t>> coll_undo;
+    std::map<std::pair<coll_t, ghobject_t>, onode_undo_t> onode_undo;
+  };
+
+  enum {
+    RECORD_CHECKPOINT = 1,
+    RECORD_DELTA = 2,
+  };
+
+  const std::string path;
+  const unsigned nshards;
+  const unsigned shard;
+  seastar::file dev;
+  uint64_t base = 0;  ///< device offset of this shard
+  superblock_t sb;
+  uint64_t journal_pos = 0;  ///< next record goes here
+  uint64_t next_seq = 0;
+
+  std::map<coll_t, coll_state_t> colls;
+  std::map<coll_t, CollectionRef> new_coll_map;
+
+  interval_set<uint64_t> free_blocks;    ///< free physical blocks
+  uint64_t used_blocks = 0;
+  /// blocks written by transactions which are not committed yet
+  std::map<uint64_t, ceph::bufferptr> inflight;
+  /// blocks freed by committed transactions, waiting for reads to drain
+  interval_set<uint64_t> pending_release;
+  unsigned reads_in_flight = 0;
+  /// transactions are applied and committed one at a time
+  seastar::semaphore txn_sem{1};
+
+  onode_t* _get_onode(const coll_t& cid, const ghobject_t& oid);
+  seastar::future<> _open_device(bool create);
+  /// the size of this shard, given the size of the device
+  uint64_t _set_region(uint64_t dev_size);
+  seastar::future<> _dma_write(uint64_t off, const bufferlist& bl);
+  seastar::future<ceph::bufferptr> _dma_read(uint64_t off, uint64_t len);
+  seastar::future<> _write_superblock();
+  seastar::future<> _read_superblock();
+  seastar::future<> _replay();
+  void _apply_record(uint8_t type, bufferlist& payload);
+  void _rebuild_freelist();
+
+  bufferlist _encode_checkpoint() const;
+  bufferlist _encode_delta(const TransContext& txc);
+  bufferlist _make_record(uint8_t type, uint64_t seq, const bufferlist& payload);
+  seastar::future<> _wait_txc_data(TransContext& txc);
+  seastar::future<> _journal_txc(TransContext& txc);
+  void _finish_txc(TransContext& txc);
+  void _rollback_txc(TransContext& txc);
+  onode_undo_t& _save_onode(TransContext& txc, const coll_t& cid,
+			    const ghobject_t& oid);
+  void _save_omap_key(onode_undo_t& undo, const onode_t& o,
+		      const std::string& key);
+  void _save_omap(onode_undo_t& undo, onode_t& o);
+  void _save_coll(TransContext& txc, const coll_t& cid);
+  void _maybe_release();
+
+  std::vector<std::pair<uint64_t, uint64_t>> _allocate(uint64_t num);
+  seastar::future<ceph::bufferptr> _read_block(uint64_t pblk);
+  seastar::future<bufferlist> _read_onode(const onode_t& o,
+					  uint64_t offset, uint64_t len);
+  seastar::future<> _do_op(TransContext& txc, Transaction::iterator& i);
+
+  int _remove(TransContext& txc, const coll_t& cid, const ghobject_t& oid);
+  int _touch(TransContext& txc, const coll_t& cid, const ghobject_t& oid);
+  seastar::future<> _write(TransContext& txc, const coll_t& cid,
+			   const ghobject_t& oid,
+			   uint64_t offset, bufferlist&& bl);
+  int _truncate(TransContext& txc, const coll_t& cid, const ghobject_t& oid,
+		uint64_t size);
+  void _punch(TransContext& txc, onode_t& o, uint64_t first_blk);
+  int _setattrs(TransContext& txc, const coll_t& cid, const ghobject_t& oid,
+		std::map<std::string,ceph::bufferptr>& aset);
+  int _rmattr(TransContext& txc, const coll_t& cid, const ghobject_t& oid,
+	      const std::string& name);
+  int _omap_setkeys(TransContext& txc, const coll_t& cid,
+		    const ghobject_t& oid,
+		    std::map<std::string,bufferlist>& aset);
+  int _omap_rmkeys(TransContext& txc, const coll_t& cid,
+		   const ghobject_t& oid,
+		   const std::set<std::string>& keys);
+  int _omap_setheader(TransContext& txc, const coll_t& cid,
+		      const ghobject_t& oid, bufferlist& header);
+  int _omap_clear(TransContext& txc, const coll_t& cid, const ghobject_t& oid);
+  int _create_collection(TransContext& txc, const coll_t& cid, int bits);
+  int _remove_collection(TransContext& txc, const coll_t& cid);
+};
+
+WRITE_CLASS_ENCODER(BlockStore::onode_t)
+WRITE_CLASS_ENCODER(BlockStore::omap_delta_t)
+WRITE_CLASS_ENCODER(BlockStore::superblock_t)
+
+}
@@ -78,30 +78,30 @@ seastar::future<> CyanStore::umount()
 
 seastar::future<> CyanStore::mkfs()
 {
-  string fsid_str;
-  int r = read_meta("fsid", &fsid_str);
-  if (r == -ENOENT) {
-    osd_fsid.generate_random();
-    write_meta("fsid", fmt::format("{}", osd_fsid));
-  } else if (r < 0) {
-    throw std::runtime_error("read_meta");
-  } else {
-    logger().info("{} already has fsid {}", __func__, fsid_str);
-    if (!osd_fsid.parse(fsid_str.c_str())) {
-      throw std::runtime_error("failed to parse fsid");
+  return read_meta("fsid").then([this](int r, std::string fsid_str) {
+    if (r == -ENOENT) {
+      osd_fsid.generate_random();
+      return write_meta("fsid", fmt::format("{}", osd_fsid));
+    } else if (r < 0) {
+      throw std::runtime_error("read_meta");
+    } else {
+      logger().info("mkfs already has fsid {}", fsid_str);
+      if (!osd_fsid.parse(fsid_str.c_str())) {
+        throw std::runtime_error("failed to parse fsid");
+      }
+      return seastar::now();
     }
-  }
-
-  string fn = path + "/collections";
-  bufferlist bl;
-  set<coll_t> collections;
-  ceph::encode(collections, bl);
-  r = bl.write_file(fn.c_str());
-  if (r < 0)
-    throw std::runtime_error("write_file");
+  }).then([this] {
+    string fn = path + "/collections";
+    bufferlist bl;
+    set<coll_t> collections;
+    ceph::encode(collections, bl);
+    int r = bl.write_file(fn.c_str());
+    if (r < 0)
+      throw std::runtime_error("write_file");
 
-  write_meta("type", "memstore");
-  return seastar::now();
+    return write_meta("type", "memstore");
+  });
 }
 
 seastar::future<std::vector<ghobject_t>, ghobject_t>
@@ -402,8 +402,8 @@ int CyanStore::_create_collection(const coll_t& cid, int bits)
   return 0;
 }
 
-void CyanStore::write_meta(const std::string& key,
-                           const std::string& value)
+seastar::future<> CyanStore::write_meta(const std::string& key,
+                                        const std::string& value)
 {
   std::string v = value;
   v += "\n";
@@ -412,23 +412,23 @@ void CyanStore::write_meta(const std::string& key,
       r < 0) {
     throw std::runtime_error{fmt::format("unable to write_meta({})", key)};
   }
+  return seastar::now();
 }
 
-int CyanStore::read_meta(const std::string& key,
-                          std::string* value)
+seastar::future<int, std::string> CyanStore::read_meta(const std::string& key)
 {
   char buf[4096];
   int r = safe_read_file(path.c_str(), key.c_str(),
                          buf, sizeof(buf));
   if (r <= 0) {
-    return r;
+    return seastar::make_ready_future<int, std::string>(r, std::string{});
   }
   // drop trailing newlines
   while (r && isspace(buf[r-1])) {
     --r;
   }
-  *value = string{buf, static_cast<size_t>(r)};
-  return 0;
+  return seastar::make_ready_future<int, std::string>(
+    0, std::string{buf, static_cast<size_t>(r)});
 }
 
 uuid_d CyanStore::get_fsid() const
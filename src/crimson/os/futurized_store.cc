@@ -0,0 +1,25 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "futurized_store.h"
+
+#include "crimson/os/cyan_store.h"
+#include "crimson/os/sharded_block_store.h"
+
+#include <fmt/format.h>
+
+namespace ceph::os {
+
+std::unique_ptr<FuturizedStore> FuturizedStore::create(const std::string& type,
+						       const std::string& data)
+{
+  if (type == "cyanstore") {
+    return std::make_unique<CyanStore>(data);
+  } else if (type == "blockstore") {
+    return std::make_unique<ShardedBlockStore>(data);
+  } else {
+    throw std::runtime_error(fmt::format("unknown objectstore type: {}", type));
+  }
+}
+
+}
@@ -0,0 +1,264 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "sharded_block_store.h"
+
+#include <boost/range/irange.hpp>
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+
+#include <seastar/core/future-util.hh>
+#include <seastar/core/reactor.hh>
+
+#include "crimson/common/log.h"
+#include "crimson/os/cyan_collection.h"
+
+namespace {
+  seastar::logger& logger() {
+    return ceph::get_logger(ceph_subsys_filestore);
+  }
+}
+
+namespace ceph::os {
+
+ShardedBlockStore::ShardedBlockStore(const std::string& path)
+  : path{path},
+    nshards{seastar::smp::count}
+{}
+
+ShardedBlockStore::~ShardedBlockStore() = default;
+
+seastar::future<> ShardedBlockStore::_start()
+{
+  return shards.start(path, nshards);
+}
+
+template <class Func>
+seastar::future<> ShardedBlockStore::_invoke_on_all_from_first(Func func)
+{
+  return shards.invoke_on(0, func).then([this, func] {
+    return seastar::parallel_for_each(boost::irange(1u, nshards),
+				      [this, func](unsigned cpu) {
+      return shards.invoke_on(cpu, func);
+    });
+  });
+}
+
+template <class Func>
+auto ShardedBlockStore::_with_shard(CollectionRef c, Func&& func)
+{
+  return shards.invoke_on(BlockStore::shard_of(c->cid, nshards),
+    [cid=c->cid, func=std::forward<Func>(func)](BlockStore& store) mutable {
+    // the handles are per reactor, so use the shard's own
+    auto ch = store.open_collection(cid);
+    if (!ch) {
+      throw std::runtime_error(fmt::format("collection does not exist: {}",
+					   cid));
+    }
+    return func(store, ch);
+  });
+}
+
+seastar::future<> ShardedBlockStore::mkfs()
+{
+  return _start().then([this] {
+    // shard 0 creates the fsid and the device the others share
+    return _invoke_on_all_from_first([](BlockStore& store) {
+      return store.mkfs();
+    });
+  }).then([this] {
+    return shards.invoke_on(0, [](BlockStore& store) {
+      return store.get_fsid();
+    });
+  }).then([this](uuid_d shard_fsid) {
+    fsid = shard_fsid;
+    logger().info("mkfs: {} shards", nshards);
+  }).finally([this] {
+    return shards.stop();
+  });
+}
+
+seastar::future<> ShardedBlockStore::mount()
+{
+  return _start().then([this] {
+    return shards.invoke_on_all([](BlockStore& store) {
+      return store.mount();
+    });
+  }).then([this] {
+    return shards.invoke_on(0, [](BlockStore& store) {
+      return store.get_fsid();
+    });
+  }).then([this](uuid_d shard_fsid) {
+    fsid = shard_fsid;
+    return seastar::parallel_for_each(boost::irange(0u, nshards),
+				      [this](unsigned cpu) {
+      return shards.invoke_on(cpu, [](BlockStore& store) {
+	std::vector<std::pair<coll_t, int>> found;
+	for (auto& cid : store.list_collections()) {
+	  found.emplace_back(cid, store.open_collection(cid)->bits);
+	}
+	return found;
+      }).then([this](std::vector<std::pair<coll_t, int>> found) {
+	for (auto& [cid, bits] : found) {
+	  auto c = new Collection{cid};
+	  c->bits = bits;
+	  colls[cid] = c;
+	}
+      });
+    });
+  }).handle_exception([this](std::exception_ptr eptr) {
+    colls.clear();
+    return shards.stop().then([eptr] {
+      return seastar::make_exception_future<>(eptr);
+    });
+  });
+}
+
+seastar::future<> ShardedBlockStore::umount()
+{
+  return shards.invoke_on_all([](BlockStore& store) {
+    return store.umount();
+  }).finally([this] {
+    colls.clear();
+    new_coll_map.clear();
+    return shards.stop();
+  });
+}
+
+seastar::future<bufferlist> ShardedBlockStore::read(CollectionRef c,
+						    const ghobject_t& oid,
+						    uint64_t offset,
+						    size_t len,
+						    uint32_t op_flags)
+{
+  return _with_shard(c, [oid, offset, len, op_flags](BlockStore& store,
+						     CollectionRef ch) {
+    return store.read(ch, oid, offset, len, op_flags);
+  });
+}
+
+seastar::future<ceph::bufferptr> ShardedBlockStore::get_attr(
+  CollectionRef c,
+  const ghobject_t& oid,
+  std::string_view name)
+{
+  return _with_shard(c, [oid, name=std::string{name}](BlockStore& store,
+						      CollectionRef ch) {
+    return store.get_attr(ch, oid, name);
+  });
+}
+
+seastar::future<ShardedBlockStore::attrs_t> ShardedBlockStore::get_attrs(
+  CollectionRef c,
+  const ghobject_t& oid)
+{
+  return _with_shard(c, [oid](BlockStore& store, CollectionRef ch) {
+    return store.get_attrs(ch, oid);
+  });
+}
+
+seastar::future<ShardedBlockStore::omap_values_t>
+ShardedBlockStore::omap_get_values(CollectionRef c,
+				   const ghobject_t& oid,
+				   std::vector<std::string>&& keys)
+{
+  return _with_shard(c, [oid, keys=std::move(keys)](BlockStore& store,
+						    CollectionRef ch) mutable {
+    return store.omap_get_values(ch, oid, std::move(keys));
+  });
+}
+
+seastar::future<std::vector<ghobject_t>, ghobject_t>
+ShardedBlockStore::list_objects(CollectionRef c,
+				const ghobject_t& start,
+				const ghobject_t& end,
+				uint64_t limit)
+{
+  return _with_shard(c, [start, end, limit](BlockStore& store,
+					    CollectionRef ch) {
+    return store.list_objects(ch, start, end, limit);
+  });
+}
+
+ShardedBlockStore::CollectionRef
+ShardedBlockStore::create_new_collection(const coll_t& cid)
+{
+  auto c = new Collection{cid};
+  return new_coll_map[cid] = c;
+}
+
+ShardedBlockStore::CollectionRef
+ShardedBlockStore::open_collection(const coll_t& cid)
+{
+  auto cp = colls.find(cid);
+  if (cp == colls.end())
+    return {};
+  return cp->second;
+}
+
+std::vector<coll_t> ShardedBlockStore::list_collections()
+{
+  std::vector<coll_t> collections;
+  for (auto& coll : colls) {
+    collections.push_back(coll.first);
+  }
+  return collections;
+}
+
+seastar::future<> ShardedBlockStore::do_transaction(CollectionRef ch,
+						    Transaction&& t)
+{
+  return shards.invoke_on(BlockStore::shard_of(ch->cid, nshards),
+    [t=std::move(t)](BlockStore& store) mutable {
+    return store.do_shard_transaction(std::move(t));
+  }).then([this](BlockStore::coll_changes_t changes) {
+    _apply_coll_changes(changes);
+  });
+}
+
+void ShardedBlockStore::_apply_coll_changes(
+  const BlockStore::coll_changes_t& changes)
+{
+  for (auto& [cid, bits] : changes) {
+    if (!bits) {
+      if (auto c = colls.find(cid); c != colls.end()) {
+	c->second->exists = false;
+	colls.erase(c);
+      }
+      continue;
+    }
+    auto [c, inserted] = colls.emplace(cid, CollectionRef{});
+    if (inserted) {
+      if (auto p = new_coll_map.find(cid); p != new_coll_map.end()) {
+	c->second = p->second;
+	new_coll_map.erase(p);
+      } else {
+	c->second = new Collection{cid};
+      }
+    }
+    c->second->bits = *bits;
+  }
+}
+
+seastar::future<> ShardedBlockStore::write_meta(const std::string& key,
+						const std::string& value)
+{
+  return shards.invoke_on(0, [key, value](BlockStore& store) {
+    return store.write_meta(key, value);
+  });
+}
+
+seastar::future<int, std::string>
+ShardedBlockStore::read_meta(const std::string& key)
+{
+  return shards.invoke_on(0, [key](BlockStore& store) {
+    return store.read_meta(key);
+  });
+}
+
+uuid_d ShardedBlockStore::get_fsid() const
+{
+  return fsid;
+}
+
+}
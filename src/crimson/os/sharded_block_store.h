@@ -0,0 +1,91 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <seastar/core/future.hh>
+#include <seastar/core/sharded.hh>
+
+#include "include/uuid.h"
+#include "crimson/os/block_store.h"
+#include "crimson/os/futurized_store.h"
+
+namespace ceph::os {
+
+/**
+ * a BlockStore split into one shard per reactor
+ *
+ * Each shard owns a slice of the device and the collections
+ * BlockStore::shard_of() maps to it, so the placement groups are spread
+ * over the reactors and none of their I/O or metadata is shared.  Reads
+ * and transactions are forwarded to the shard of their collection; a
+ * transaction must only touch collections of the shard of the one it is
+ * queued under.
+ *
+ * The collection handles live on the reactor the store was created on,
+ * which must be the only one using it.
+ */
+class ShardedBlockStore final : public FuturizedStore {
+public:
+  ShardedBlockStore(const std::string& path);
+  ~ShardedBlockStore() final;
+
+  seastar::future<> mount() final;
+  seastar::future<> umount() final;
+
+  seastar::future<> mkfs() final;
+  seastar::future<bufferlist> read(CollectionRef c,
+				   const ghobject_t& oid,
+				   uint64_t offset,
+				   size_t len,
+				   uint32_t op_flags = 0) final;
+  seastar::future<ceph::bufferptr> get_attr(CollectionRef c,
+					    const ghobject_t& oid,
+					    std::string_view name) final;
+  seastar::future<attrs_t> get_attrs(CollectionRef c, const ghobject_t& oid) final;
+  seastar::future<omap_values_t> omap_get_values(
+    CollectionRef c,
+    const ghobject_t& oid,
+    std::vector<std::string>&& keys) final;
+  seastar::future<std::vector<ghobject_t>, ghobject_t> list_objects(
+    CollectionRef c,
+    const ghobject_t& start,
+    const ghobject_t& end,
+    uint64_t limit) final;
+  CollectionRef create_new_collection(const coll_t& cid) final;
+  CollectionRef open_collection(const coll_t& cid) final;
+  std::vector<coll_t> list_collections() final;
+
+  seastar::future<> do_transaction(CollectionRef ch,
+				   Transaction&& txn) final;
+
+  seastar::future<> write_meta(const std::string& key,
+			       const std::string& value) final;
+  seastar::future<int, std::string> read_meta(const std::string& key) final;
+  uuid_d get_fsid() const final;
+
+private:
+  const std::string path;
+  const unsigned nshards;
+  seastar::sharded<BlockStore> shards;
+  uuid_d fsid;
+
+  /// the collections of all shards, updated as transactions commit
+  std::map<coll_t, CollectionRef> colls;
+  std::map<coll_t, CollectionRef> new_coll_map;
+
+  seastar::future<> _start();
+  /// run @p func on shard 0, then on the others in parallel
+  template <class Func>
+  seastar::future<> _invoke_on_all_from_first(Func func);
+  /// run @p func with the shard owning @p c and its handle there
+  template <class Func>
+  auto _with_shard(CollectionRef c, Func&& func);
+  void _apply_coll_changes(const BlockStore::coll_changes_t& changes);
+};
+
+}
@@ -23,7 +23,7 @@
 #include "crimson/net/Messenger.h"
 #include "crimson/os/cyan_collection.h"
 #include "crimson/os/cyan_object.h"
-#include "crimson/os/cyan_store.h"
+#include "crimson/os/futurized_store.h"
 #include "os/Transaction.h"
 #include "crimson/osd/heartbeat.h"
 #include "crimson/osd/osd_meta.h"
@@ -41,7 +41,7 @@ namespace {
 }
 
 using ceph::common::local_conf;
-using ceph::os::CyanStore;
+using ceph::os::FuturizedStore;
 
 OSD::OSD(int id, uint32_t nonce,
          ceph::net::Messenger& cluster_msgr,
@@ -57,7 +57,8 @@ OSD::OSD(int id, uint32_t nonce,
     mgrc{new ceph::mgr::Client{public_msgr, *this}},
     heartbeat{new Heartbeat{*this, *monc, hb_front_msgr, hb_back_msgr}},
     heartbeat_timer{[this] { update_heartbeat_peers(); }},
-    store{std::make_unique<ceph::os::CyanStore>(
+    store{FuturizedStore::create(
+      local_conf().get_val<std::string>("crimson_osd_objectstore"),
       local_conf().get_val<std::string>("osd_data"))}
 {
   osdmaps[0] = boost::make_local_shared<OSDMap>();
@@ -116,8 +117,10 @@ seastar::future<> OSD::mkfs(uuid_d cluster_fsid)
     meta_coll->store_superblock(t, superblock);
     return store->do_transaction(meta_coll->collection(), std::move(t));
   }).then([cluster_fsid, this] {
-    store->write_meta("ceph_fsid", cluster_fsid.to_string());
-    store->write_meta("whoami", std::to_string(whoami));
+    return store->write_meta("ceph_fsid", cluster_fsid.to_string());
+  }).then([this] {
+    return store->write_meta("whoami", std::to_string(whoami));
+  }).then([cluster_fsid, this] {
     fmt::print("created object store {} for osd.{} fsid {}\n",
                local_conf().get_val<std::string>("osd_data"),
                whoami, cluster_fsid);
@@ -38,7 +38,7 @@ namespace ceph::net {
 }
 
 namespace ceph::os {
-  class CyanStore;
+  class FuturizedStore;
   struct Collection;
   class Transaction;
 }
@@ -68,7 +68,7 @@ class OSD : public ceph::net::Dispatcher,
   SimpleLRU<epoch_t, bufferlist, false> map_bl_cache;
   cached_map_t osdmap;
   // TODO: use a wrapper for ObjectStore
-  std::unique_ptr<ceph::os::CyanStore> store;
+  std::unique_ptr<ceph::os::FuturizedStore> store;
   std::unique_ptr<OSDMeta> meta_coll;
 
   std::unordered_map<spg_t, Ref<PG>> pgs;
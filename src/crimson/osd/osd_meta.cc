@@ -3,7 +3,7 @@
 #include <fmt/format.h>
 
 #include "crimson/os/cyan_collection.h"
-#include "crimson/os/cyan_store.h"
+#include "crimson/os/futurized_store.h"
 #include "os/Transaction.h"
 
 void OSDMeta::create(ceph::os::Transaction& t)
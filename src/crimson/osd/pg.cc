@@ -27,7 +27,7 @@
 #include "crimson/net/Connection.h"
 #include "crimson/net/Messenger.h"
 #include "crimson/os/cyan_collection.h"
-#include "crimson/os/cyan_store.h"
+#include "crimson/os/futurized_store.h"
 #include "os/Transaction.h"
 #include "crimson/osd/exceptions.h"
 #include "crimson/osd/pg_meta.h"
@@ -66,7 +66,7 @@ PG::PG(spg_t pgid,
   // TODO
 }
 
-seastar::future<> PG::read_state(ceph::os::CyanStore* store)
+seastar::future<> PG::read_state(ceph::os::FuturizedStore* store)
 {
   return PGMeta{store, pgid}.load().then(
     [this](pg_info_t pg_info_, PastIntervals past_intervals_) {
@@ -31,7 +31,7 @@ namespace ceph::net {
 }
 
 namespace ceph::os {
-  class CyanStore;
+  class FuturizedStore;
 }
 
 class PG : public boost::intrusive_ref_counter<
@@ -87,7 +87,7 @@ public:
 	      const vector<int>& acting,
 	      const map<pg_shard_t, pg_info_t>& all_info) const;
   std::pair<choose_acting_t, pg_shard_t> choose_acting();
-  seastar::future<> read_state(ceph::os::CyanStore* store);
+  seastar::future<> read_state(ceph::os::FuturizedStore* store);
 
   // peering/recovery
   bool should_send_notify() const;
@@ -16,7 +16,7 @@
 struct hobject_t;
 namespace ceph::os {
   class Collection;
-  class CyanStore;
+  class FuturizedStore;
 }
 
 class PGBackend
@@ -26,11 +26,11 @@ protected:
   using ec_profile_t = std::map<std::string, std::string>;
 
 public:
-  PGBackend(shard_id_t shard, CollectionRef coll, ceph::os::CyanStore* store);
+  PGBackend(shard_id_t shard, CollectionRef coll, ceph::os::FuturizedStore* store);
   virtual ~PGBackend() = default;
   static std::unique_ptr<PGBackend> create(const spg_t pgid,
 					   const pg_pool_t& pool,
-					   ceph::os::CyanStore* store,
+					   ceph::os::FuturizedStore* store,
 					   const ec_profile_t& ec_profile);
   using cached_os_t = boost::local_shared_ptr<ObjectState>;
   seastar::future<cached_os_t> get_object_state(const hobject_t& oid);
@@ -59,7 +59,7 @@ public:
 protected:
   const shard_id_t shard;
   CollectionRef coll;
-  ceph::os::CyanStore* store;
+  ceph::os::FuturizedStore* store;
 
 private:
   using cached_ss_t = boost::local_shared_ptr<SnapSet>;
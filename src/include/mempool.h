@@ -165,6 +165,8 @@ namespace mempool {
   f(osdmap_mapping)		      \
   f(pgmap)			      \
   f(mds_co)			      \
+  f(memstore_data)		      \
+  f(memstore_meta)		      \
   f(unittest_1)			      \
   f(unittest_2)
 
@@ -46,7 +46,8 @@ BlueFS::BlueFS(CephContext* cct)
   : cct(cct),
     bdev(MAX_BDEV),
     ioc(MAX_BDEV),
-    block_all(MAX_BDEV)
+    block_all(MAX_BDEV),
+    migrate_thread(this)
 {
   discard_cb[BDEV_WAL] = wal_discard_cb;
   discard_cb[BDEV_DB] = db_discard_cb;
@@ -153,6 +154,27 @@ void BlueFS::_init_logger()
 		    "Bytes requested in prefetch read mode", NULL,
 		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
 
+  b.add_u64_counter(l_bluefs_read_disk_bytes_wal, "read_disk_bytes_wal",
+		    "Bytes read from WAL device", NULL,
+		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluefs_read_disk_bytes_db, "read_disk_bytes_db",
+		    "Bytes read from DB device", NULL,
+		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluefs_read_disk_bytes_slow, "read_disk_bytes_slow",
+		    "Bytes read from slow device", NULL,
+		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+
+  b.add_u64_counter(l_bluefs_promote_count, "promote_count",
+		    "Hot files moved from slow to DB device");
+  b.add_u64_counter(l_bluefs_promote_bytes, "promote_bytes",
+		    "Bytes moved from slow to DB device", NULL,
+		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluefs_demote_count, "demote_count",
+		    "Cold files moved from DB to slow device");
+  b.add_u64_counter(l_bluefs_demote_bytes, "demote_bytes",
+		    "Bytes moved from DB to slow device", NULL,
+		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -506,6 +528,7 @@ int BlueFS::mount()
            << std::hex << log_writer->pos << std::dec
            << dendl;
 
+  _migrate_start();
   return 0;
 
  out:
@@ -517,6 +540,7 @@ void BlueFS::umount()
 {
   dout(1) << __func__ << dendl;
 
+  _migrate_stop();
   sync_metadata();
 
   _close_writer(log_writer);
@@ -1325,6 +1349,233 @@ BlueFS::FileRef BlueFS::_get_file(uint64_t ino)
   }
 }
 
+void BlueFS::_migrate_start()
+{
+  if (cct->_conf->bluefs_migrate_interval <= 0 ||
+      !bdev[BDEV_DB] || !bdev[BDEV_SLOW]) {
+    return;
+  }
+  dout(10) << __func__ << dendl;
+  migrate_stop = false;
+  migrate_thread.create("bluefs_migrate");
+}
+
+void BlueFS::_migrate_stop()
+{
+  if (!migrate_thread.is_started()) {
+    return;
+  }
+  dout(10) << __func__ << dendl;
+  {
+    std::lock_guard l(migrate_lock);
+    migrate_stop = true;
+    migrate_cond.notify_all();
+  }
+  migrate_thread.join();
+  migrate_stop = false;
+}
+
+void BlueFS::_migrate_thread()
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock l(migrate_lock);
+  while (!migrate_stop) {
+    l.unlock();
+    uint64_t moved = _migrate_pass();
+    dout(20) << __func__ << " moved 0x" << std::hex << moved << std::dec
+	     << dendl;
+    l.lock();
+    if (migrate_stop) {
+      break;
+    }
+    auto wait = ceph::make_timespan(cct->_conf->bluefs_migrate_interval);
+    migrate_cond.wait_for(l, wait);
+  }
+  dout(10) << __func__ << " finish" << dendl;
+}
+
+unsigned BlueFS::_get_file_bdev(const bluefs_fnode_t& fnode)
+{
+  uint64_t per_dev[MAX_BDEV] = {0};
+  unsigned best = fnode.prefer_bdev;
+  for (auto& e : fnode.extents) {
+    per_dev[e.bdev] += e.length;
+    if (per_dev[e.bdev] > per_dev[best]) {
+      best = e.bdev;
+    }
+  }
+  return best;
+}
+
+uint64_t BlueFS::_migrate_pass()
+{
+  uint64_t max_bytes = cct->_conf->bluefs_migrate_max_bytes;
+  uint64_t min_heat = cct->_conf->bluefs_migrate_min_heat;
+  double reserve_ratio = cct->_conf->bluefs_migrate_db_reserve_ratio;
+
+  vector<pair<uint64_t,FileRef>> hot;   ///< on slow device, hottest first
+  vector<pair<uint64_t,FileRef>> cold;  ///< on db device, coldest first
+  uint64_t db_free = 0;
+  uint64_t db_reserve = 0;
+  {
+    std::lock_guard l(lock);
+    if (!alloc[BDEV_DB] || !alloc[BDEV_SLOW]) {
+      return 0;
+    }
+    for (auto& d : dir_map) {
+      for (auto& p : d.second->file_map) {
+	FileRef f = p.second;
+	f->heat = f->heat / 2 + f->read_bytes.exchange(0);
+	// only immutable, fully synced SSTs are worth moving
+	if (!boost::algorithm::ends_with(p.first, ".sst") ||
+	    f->fnode.ino <= 1 ||
+	    f->num_writers.load() ||
+	    f->dirty_seq) {
+	  continue;
+	}
+	unsigned dev = _get_file_bdev(f->fnode);
+	if (dev == BDEV_SLOW && f->heat >= min_heat) {
+	  hot.emplace_back(f->heat, f);
+	} else if (dev == BDEV_DB && f->heat < min_heat) {
+	  cold.emplace_back(f->heat, f);
+	}
+      }
+    }
+    db_free = alloc[BDEV_DB]->get_free();
+    db_reserve = block_all[BDEV_DB].size() * reserve_ratio;
+  }
+  std::sort(hot.begin(), hot.end(),
+	    [](const auto& a, const auto& b) { return a.first > b.first; });
+  std::sort(cold.begin(), cold.end(),
+	    [](const auto& a, const auto& b) { return a.first < b.first; });
+  dout(10) << __func__ << " " << hot.size() << " hot, " << cold.size()
+	   << " cold candidates, db free 0x" << std::hex << db_free
+	   << " reserve 0x" << db_reserve << std::dec << dendl;
+
+  uint64_t moved = 0;
+  auto c = cold.begin();
+  auto demote = [&](uint64_t heat_limit) {
+    if (c == cold.end() || c->first >= heat_limit || moved >= max_bytes) {
+      return false;
+    }
+    uint64_t len = c->second->fnode.get_allocated();
+    if (_migrate_file(c->second, BDEV_SLOW) == 0) {
+      db_free += len;
+      moved += len;
+      logger->inc(l_bluefs_demote_count);
+      logger->inc(l_bluefs_demote_bytes, len);
+    }
+    ++c;
+    return true;
+  };
+
+  // keep the db device from filling up with cold data
+  while (db_free < db_reserve && demote(min_heat))
+    ;
+
+  for (auto& h : hot) {
+    if (moved >= max_bytes) {
+      break;
+    }
+    uint64_t len = h.second->fnode.get_allocated();
+    // make room by pushing out files colder than this one
+    while (db_free < db_reserve + len && demote(h.first))
+      ;
+    if (db_free < db_reserve + len) {
+      continue;
+    }
+    if (_migrate_file(h.second, BDEV_DB) == 0) {
+      db_free -= len;
+      moved += len;
+      logger->inc(l_bluefs_promote_count);
+      logger->inc(l_bluefs_promote_bytes, len);
+    }
+  }
+  return moved;
+}
+
+int BlueFS::_migrate_file(FileRef f, unsigned dev_target)
+{
+  bool buffered = cct->_conf->bluefs_buffered_io;
+  bluefs_fnode_t old_fnode;
+  bluefs_fnode_t new_fnode;
+  PExtentVector extents;
+  {
+    std::lock_guard l(lock);
+    if (f->deleted || f->num_writers.load() || f->dirty_seq) {
+      return -EBUSY;
+    }
+    old_fnode = f->fnode;
+    if (alloc[dev_target]->get_free() < old_fnode.get_allocated()) {
+      return -ENOSPC;
+    }
+    int r = _allocate_without_fallback(dev_target, old_fnode.get_allocated(),
+				       &extents);
+    if (r < 0) {
+      return r;
+    }
+  }
+  for (auto& e : extents) {
+    new_fnode.append_extent(bluefs_extent_t(dev_target, e.offset, e.length));
+  }
+  dout(10) << __func__ << " " << old_fnode << " to bdev " << dev_target
+	   << dendl;
+
+  // the file is immutable, so copy its data without holding the lock
+  uint64_t copy_len = std::min(round_up_to(old_fnode.size, super.block_size),
+			       old_fnode.get_allocated());
+  uint64_t off = 0;
+  while (off < copy_len) {
+    uint64_t s_off = 0, d_off = 0;
+    auto s = old_fnode.seek(off, &s_off);
+    auto d = new_fnode.seek(off, &d_off);
+    uint64_t l = std::min({s->length - s_off, d->length - d_off,
+			   copy_len - off,
+			   (uint64_t)cct->_conf->bluefs_max_prefetch});
+    bufferlist bl;
+    int r = bdev[s->bdev]->read(s->offset + s_off, l, &bl, ioc[s->bdev],
+				buffered);
+    if (r < 0) {
+      derr << __func__ << " failed to read 0x" << std::hex
+	   << s->offset + s_off << "~" << l << std::dec
+	   << " from " << (int)s->bdev << dendl;
+      std::lock_guard g(lock);
+      alloc[dev_target]->release(extents);
+      return r;
+    }
+    r = bdev[d->bdev]->write(d->offset + d_off, bl, buffered);
+    ceph_assert(r == 0);
+    off += l;
+  }
+  bdev[dev_target]->flush();
+
+  std::unique_lock l(lock);
+  auto same_extent = [](const bluefs_extent_t& a, const bluefs_extent_t& b) {
+    return a.bdev == b.bdev && a.offset == b.offset && a.length == b.length;
+  };
+  if (f->deleted || f->num_writers.load() || f->dirty_seq ||
+      !std::equal(f->fnode.extents.begin(), f->fnode.extents.end(),
+		  old_fnode.extents.begin(), old_fnode.extents.end(),
+		  same_extent)) {
+    dout(10) << __func__ << " raced with update of " << f->fnode
+	     << ", dropping copy" << dendl;
+    alloc[dev_target]->release(extents);
+    return -EAGAIN;
+  }
+  {
+    std::unique_lock e_lock(f->extents_lock);
+    f->fnode.swap_extents(new_fnode);
+  }
+  // new_fnode now holds the old extents; free them once the update is stable
+  for (auto& e : new_fnode.extents) {
+    pending_release[e.bdev].insert(e.offset, e.length);
+  }
+  log_t.op_file_update(f->fnode);
+  int r = _flush_and_sync_log(l);
+  ceph_assert(r == 0);
+  return 0;
+}
+
 void BlueFS::_drop_link(FileRef file)
 {
   dout(20) << __func__ << " had refs " << file->refs
@@ -1378,10 +1629,13 @@ int BlueFS::_read_random(
   logger->inc(l_bluefs_read_random_count, 1);
   logger->inc(l_bluefs_read_random_bytes, len);
 
+  h->file->read_bytes += len;
+
   std::shared_lock s_lock(h->lock);
   while (len > 0) {
     if (off < buf->bl_off || off >= buf->get_buf_end()) {
       s_lock.unlock();
+      std::shared_lock e_lock(h->file->extents_lock);
       uint64_t x_off = 0;
       auto p = h->file->fnode.seek(off, &x_off);
       uint64_t l = std::min(p->length - x_off, static_cast<uint64_t>(len));
@@ -1391,6 +1645,8 @@ int BlueFS::_read_random(
       int r = bdev[p->bdev]->read_random(p->offset + x_off, l, out,
 					 cct->_conf->bluefs_buffered_io);
       ceph_assert(r == 0);
+      _count_disk_read(p->bdev, l);
+      e_lock.unlock();
       off += l;
       len -= l;
       ret += l;
@@ -1466,6 +1722,7 @@ int BlueFS::_read(
     logger->inc(l_bluefs_read_prefetch_count, 1);
     logger->inc(l_bluefs_read_prefetch_bytes, len);
   }
+  h->file->read_bytes += len;
 
   if (outbl)
     outbl->clear();
@@ -1477,6 +1734,7 @@ int BlueFS::_read(
     if (off < buf->bl_off || off >= buf->get_buf_end()) {
       s_lock.unlock();
       std::unique_lock u_lock(h->lock);
+      std::shared_lock e_lock(h->file->extents_lock);
       buf->bl.clear();
       buf->bl_off = off & super.block_mask();
       uint64_t x_off = 0;
@@ -1496,6 +1754,8 @@ int BlueFS::_read(
       int r = bdev[p->bdev]->read(p->offset + x_off, l, &buf->bl, ioc[p->bdev],
 				  cct->_conf->bluefs_buffered_io);
       ceph_assert(r == 0);
+      _count_disk_read(p->bdev, l);
+      e_lock.unlock();
       u_lock.unlock();
       s_lock.lock();
     }
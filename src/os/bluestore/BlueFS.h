@@ -8,6 +8,7 @@
 
 #include "bluefs_types.h"
 #include "common/RefCountedObj.h"
+#include "common/Thread.h"
 #include "BlockDevice.h"
 
 #include "boost/intrusive/list.hpp"
@@ -49,6 +50,13 @@ enum {
   l_bluefs_read_bytes,
   l_bluefs_read_prefetch_count,
   l_bluefs_read_prefetch_bytes,
+  l_bluefs_read_disk_bytes_wal,
+  l_bluefs_read_disk_bytes_db,
+  l_bluefs_read_disk_bytes_slow,
+  l_bluefs_promote_count,
+  l_bluefs_promote_bytes,
+  l_bluefs_demote_count,
+  l_bluefs_demote_bytes,
 
   l_bluefs_last,
 };
@@ -94,6 +102,14 @@ public:
     std::atomic_int num_readers, num_writers;
     std::atomic_int num_reading;
 
+    std::atomic<uint64_t> read_bytes; ///< bytes read since last migrate pass
+    uint64_t heat;                    ///< decayed read bytes (under BlueFS::lock)
+
+    /// protects fnode.extents against the migrator while reading data
+    ceph::shared_mutex extents_lock {
+     ceph::make_shared_mutex(std::string(), false, false, false)
+    };
+
     File()
       : RefCountedObject(NULL, 0),
 	refs(0),
@@ -102,7 +118,9 @@ public:
 	deleted(false),
 	num_readers(0),
 	num_writers(0),
-	num_reading(0)
+	num_reading(0),
+	read_bytes(0),
+	heat(0)
       {}
     ~File() override {
       ceph_assert(num_readers.load() == 0);
@@ -305,9 +323,51 @@ private:
 
   BlueFSDeviceExpander* slow_dev_expander = nullptr;
 
+  /*
+   * Hot/cold SST migration between BDEV_SLOW and BDEV_DB.
+   *
+   * Reads are accounted per file; a background thread periodically
+   * decays the counts and moves the hottest SSTs that spilled over to
+   * the slow device back to the db device (and the coldest ones out of
+   * the db device when it runs short of space).
+   */
+  struct MigrateThread : public Thread {
+    BlueFS *fs;
+    explicit MigrateThread(BlueFS *f) : fs(f) {}
+    void *entry() override {
+      fs->_migrate_thread();
+      return NULL;
+    }
+  } migrate_thread;
+  ceph::mutex migrate_lock = ceph::make_mutex("BlueFS::migrate_lock");
+  ceph::condition_variable migrate_cond;
+  bool migrate_stop = false;
+
+  void _migrate_start();
+  void _migrate_stop();
+  void _migrate_thread();
+  /// pick and move hot/cold files; returns number of bytes moved
+  uint64_t _migrate_pass();
+  int _migrate_file(FileRef f, unsigned dev_target);
+  /// device holding the majority of a file's data
+  unsigned _get_file_bdev(const bluefs_fnode_t& fnode);
+
   void _init_logger();
   void _shutdown_logger();
   void _update_logger_stats();
+  void _count_disk_read(unsigned id, uint64_t len) {
+    switch (id) {
+    case BDEV_WAL:
+      logger->inc(l_bluefs_read_disk_bytes_wal, len);
+      break;
+    case BDEV_DB:
+      logger->inc(l_bluefs_read_disk_bytes_db, len);
+      break;
+    case BDEV_SLOW:
+      logger->inc(l_bluefs_read_disk_bytes_slow, len);
+      break;
+    }
+  }
 
   void _init_alloc();
   void _stop_alloc();
@@ -471,6 +531,11 @@ public:
   void flush_log();
   void compact_log();
 
+  /// run a single hot/cold migration pass; returns bytes moved
+  uint64_t migrate_hot_files() {
+    return _migrate_pass();
+  }
+
   /// sync any uncommitted state to disk
   void sync_metadata();
 
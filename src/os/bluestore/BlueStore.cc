@@ -3670,6 +3670,9 @@ void *BlueStore::MempoolThread::entry()
     pcm->insert("kv", binned_kv_cache);
     pcm->insert("meta", meta_cache);
     pcm->insert("data", data_cache);
+    if (store->cache_compressed_ratio > 0) {
+      pcm->insert("compressed", compressed_data_cache);
+    }
   }
 
   utime_t next_balance = ceph_clock_now();
@@ -3722,6 +3725,7 @@ void BlueStore::MempoolThread::_adjust_cache_settings()
   }
   meta_cache->set_cache_ratio(store->cache_meta_ratio);
   data_cache->set_cache_ratio(store->cache_data_ratio);
+  compressed_data_cache->set_cache_ratio(store->cache_compressed_ratio);
 }
 
 void BlueStore::MempoolThread::_trim_shards(bool interval_stats)
@@ -3740,12 +3744,16 @@ void BlueStore::MempoolThread::_trim_shards(bool interval_stats)
      static_cast<int64_t>(store->cache_meta_ratio * cache_size);
   int64_t data_alloc =
      static_cast<int64_t>(store->cache_data_ratio * cache_size);
+  int64_t compressed_alloc =
+     static_cast<int64_t>(store->cache_compressed_ratio * cache_size);
 
   if (pcm != nullptr && binned_kv_cache != nullptr) {
     cache_size = pcm->get_tuned_mem();
     kv_alloc = binned_kv_cache->get_committed_size();
     meta_alloc = meta_cache->get_committed_size();
     data_alloc = data_cache->get_committed_size();
+    compressed_alloc = store->cache_compressed_ratio > 0 ?
+      compressed_data_cache->get_committed_size() : 0;
   }
   
   if (interval_stats) {
@@ -3776,6 +3784,10 @@ void BlueStore::MempoolThread::_trim_shards(bool interval_stats)
   for (auto i : store->cache_shards) {
     i->trim(max_shard_onodes, max_shard_buffer);
   }
+  ldout(cct, 30) << __func__ << " compressed_alloc: " << compressed_alloc
+                 << " compressed_used: "
+                 << compressed_data_cache->_get_used_bytes() << dendl;
+  store->compressed_cache->trim(compressed_alloc);
 }
 
 // =======================================================
@@ -4268,16 +4280,27 @@ int BlueStore::_set_cache_sizes()
     return -EINVAL;
   }
 
-  if (cache_meta_ratio + cache_kv_ratio > 1.0) {
+  cache_compressed_ratio = cct->_conf->bluestore_cache_compressed_ratio;
+  if (cache_compressed_ratio < 0 || cache_compressed_ratio > 1.0) {
+    derr << __func__ << " bluestore_cache_compressed_ratio ("
+	 << cache_compressed_ratio << ") must be in range [0,1.0]" << dendl;
+    return -EINVAL;
+  }
+
+  if (cache_meta_ratio + cache_kv_ratio + cache_compressed_ratio > 1.0) {
     derr << __func__ << " bluestore_cache_meta_ratio (" << cache_meta_ratio
          << ") + bluestore_cache_kv_ratio (" << cache_kv_ratio
-         << ") = " << cache_meta_ratio + cache_kv_ratio << "; must be <= 1.0"
+         << ") + bluestore_cache_compressed_ratio (" << cache_compressed_ratio
+         << ") = "
+	 << cache_meta_ratio + cache_kv_ratio + cache_compressed_ratio
+	 << "; must be <= 1.0"
          << dendl;
     return -EINVAL;
   }
 
   cache_data_ratio =
-    (double)1.0 - (double)cache_meta_ratio - (double)cache_kv_ratio;
+    (double)1.0 - (double)cache_meta_ratio - (double)cache_kv_ratio -
+    (double)cache_compressed_ratio;
   if (cache_data_ratio < 0) {
     // deal with floating point imprecision
     cache_data_ratio = 0;
@@ -4287,6 +4310,7 @@ int BlueStore::_set_cache_sizes()
           << " meta " << cache_meta_ratio
 	  << " kv " << cache_kv_ratio
 	  << " data " << cache_data_ratio
+	  << " compressed " << cache_compressed_ratio
 	  << dendl;
   return 0;
 }
@@ -4427,6 +4451,25 @@ void BlueStore::_init_logger()
 	    "Sum for bytes of read hit in the cache", NULL, 0, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluestore_buffer_miss_bytes, "bluestore_buffer_miss_bytes",
 	    "Sum for bytes of read missed in the cache", NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_compressed_cache_bytes,
+	    "bluestore_compressed_cache_bytes",
+	    "Number of compressed bytes in cache", NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_compressed_cache_entries,
+	    "bluestore_compressed_cache_entries",
+	    "Number of compressed blobs in cache");
+  b.add_u64_counter(l_bluestore_compressed_cache_hits,
+		    "bluestore_compressed_cache_hits",
+		    "Sum for compressed blob reads served from cache");
+  b.add_u64_counter(l_bluestore_compressed_cache_misses,
+		    "bluestore_compressed_cache_misses",
+		    "Sum for compressed blob reads missed in cache");
+  b.add_u64_counter(l_bluestore_compressed_cache_hit_bytes,
+		    "bluestore_compressed_cache_hit_bytes",
+		    "Sum for compressed bytes served from cache",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_time_avg(l_bluestore_compressed_cache_decompress_lat,
+		 "compressed_cache_decompress_lat",
+		 "Average latency of decompressing cached blobs");
 
   b.add_u64_counter(l_bluestore_write_big, "bluestore_write_big",
 		    "Large aligned writes into fresh blobs");
@@ -6547,6 +6590,7 @@ void BlueStore::set_cache_shards(unsigned num)
     cache_shards[i] = Cache::create(cct, cct->_conf->bluestore_cache_type,
 				    logger);
   }
+  compressed_cache.reset(new CompressedCache(cct, num));
 }
 
 int BlueStore::_mount(bool kv_only, bool open_db)
@@ -8303,6 +8347,10 @@ void BlueStore::_update_cache_logger()
   logger->set(l_bluestore_blobs, num_blobs);
   logger->set(l_bluestore_buffers, num_buffers);
   logger->set(l_bluestore_buffer_bytes, num_buffer_bytes);
+  logger->set(l_bluestore_compressed_cache_bytes,
+	      compressed_cache->get_bytes());
+  logger->set(l_bluestore_compressed_cache_entries,
+	      compressed_cache->get_num_entries());
 }
 
 // ---------------
@@ -8654,6 +8702,10 @@ int BlueStore::_do_read(
                              // measure the whole block below.
                              // The error isn't that much...
   vector<bufferlist> compressed_blob_bls;
+  vector<bool> compressed_blob_cached;
+  bool use_compressed_cache = compressed_cache->enabled() &&
+    (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+		 CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0;
   IOContext ioc(cct, NULL, true); // allow EIO
   for (auto& p : blobs2read) {
     const BlobRef& bptr = p.first;
@@ -8668,6 +8720,18 @@ int BlueStore::_do_read(
       }
       compressed_blob_bls.push_back(bufferlist());
       bufferlist& bl = compressed_blob_bls.back();
+      if (use_compressed_cache) {
+	if (compressed_cache->lookup(bptr->get_blob(), &bl)) {
+	  dout(20) << __func__ << "    compressed cache hit 0x" << std::hex
+		   << bl.length() << std::dec << dendl;
+	  logger->inc(l_bluestore_compressed_cache_hits);
+	  logger->inc(l_bluestore_compressed_cache_hit_bytes, bl.length());
+	  compressed_blob_cached.push_back(true);
+	  continue;
+	}
+	logger->inc(l_bluestore_compressed_cache_misses);
+      }
+      compressed_blob_cached.push_back(false);
       r = bptr->get_blob().map(
 	0, bptr->get_blob().get_ondisk_length(),
 	[&](uint64_t offset, uint64_t length) {
@@ -8748,6 +8812,7 @@ int BlueStore::_do_read(
 
   // enumerate and decompress desired blobs
   auto p = compressed_blob_bls.begin();
+  auto pcached = compressed_blob_cached.begin();
   blobs2read_t::iterator b2r_it = blobs2read.begin();
   while (b2r_it != blobs2read.end()) {
     const BlobRef& bptr = b2r_it->first;
@@ -8757,8 +8822,11 @@ int BlueStore::_do_read(
     if (bptr->get_blob().is_compressed()) {
       ceph_assert(p != compressed_blob_bls.end());
       bufferlist& compressed_bl = *p++;
-      if (_verify_csum(o, &bptr->get_blob(), 0, compressed_bl,
-        	       r2r.front().regs.front().logical_offset) < 0) {
+      bool cached = *pcached++;
+      // cached payloads were verified when they were added
+      if (!cached &&
+	  _verify_csum(o, &bptr->get_blob(), 0, compressed_bl,
+		       r2r.front().regs.front().logical_offset) < 0) {
         // Handles spurious read errors caused by a kernel bug.
         // We sometimes get all-zero pages as a result of the read under
         // high memory pressure. Retrying the failing read succeeds in most 
@@ -8770,9 +8838,16 @@ int BlueStore::_do_read(
         return _do_read(c, o, offset, length, bl, op_flags, retry_count + 1);
       }
       bufferlist raw_bl;
+      auto decompress_start = mono_clock::now();
       r = _decompress(compressed_bl, &raw_bl);
       if (r < 0)
 	return r;
+      if (cached) {
+	logger->tinc(l_bluestore_compressed_cache_decompress_lat,
+		     mono_clock::now() - decompress_start);
+      } else if (use_compressed_cache) {
+	compressed_cache->insert(bptr->get_blob(), compressed_bl);
+      }
       if (buffered) {
 	bptr->shared_blob->bc.did_read(bptr->shared_blob->get_cache(), 0,
 				       raw_bl);
@@ -10208,6 +10283,7 @@ void BlueStore::_txc_finish(TransContext *txc)
 void BlueStore::_txc_release_alloc(TransContext *txc)
 {
   // it's expected we're called with lazy_release_lock already taken!
+  compressed_cache->invalidate(txc->released);
   if (likely(!cct->_conf->bluestore_debug_no_reuse_blocks)) {
     int r = 0;
     if (cct->_conf->bdev_enable_discard && cct->_conf->bdev_async_discard) {
@@ -13711,6 +13787,7 @@ void BlueStore::_flush_cache()
     i->trim_all();
     ceph_assert(i->empty());
   }
+  compressed_cache->clear();
   for (auto& p : coll_map) {
     if (!p.second->onode_map.empty()) {
       derr << __func__ << " stray onodes on " << p.first << dendl;
@@ -13736,6 +13813,7 @@ int BlueStore::flush_cache(ostream *os)
   for (auto i : cache_shards) {
     i->trim_all();
   }
+  compressed_cache->clear();
 
   return 0;
 }
@@ -43,6 +43,7 @@
 #include "bluestore_types.h"
 #include "BlockDevice.h"
 #include "BlueFS.h"
+#include "CompressedCache.h"
 #include "common/EventTrace.h"
 
 class Allocator;
@@ -127,6 +128,12 @@ enum {
   l_bluestore_omap_upper_bound_lat,
   l_bluestore_omap_lower_bound_lat,
   l_bluestore_omap_next_lat,
+  l_bluestore_compressed_cache_bytes,
+  l_bluestore_compressed_cache_entries,
+  l_bluestore_compressed_cache_hits,
+  l_bluestore_compressed_cache_misses,
+  l_bluestore_compressed_cache_hit_bytes,
+  l_bluestore_compressed_cache_decompress_lat,
   l_bluestore_last
 };
 
@@ -1918,6 +1925,9 @@ private:
 
   vector<Cache*> cache_shards;
 
+  /// compressed blob payloads, behind the (decompressed) buffer cache
+  std::unique_ptr<CompressedCache> compressed_cache;
+
   /// protect zombie_osr_set
   ceph::mutex zombie_osr_lock = ceph::make_mutex("BlueStore::zombie_osr_lock");
   std::map<coll_t,OpSequencerRef> zombie_osr_set; ///< set of OpSequencers for deleted collections
@@ -2008,6 +2018,7 @@ private:
   double cache_meta_ratio = 0;   ///< cache ratio dedicated to metadata
   double cache_kv_ratio = 0;     ///< cache ratio dedicated to kv (e.g., rocksdb)
   double cache_data_ratio = 0;   ///< cache ratio dedicated to object data
+  double cache_compressed_ratio = 0; ///< cache ratio dedicated to compressed data
   bool cache_autotune = false;   ///< cache autotune setting
   double cache_autotune_interval = 0; ///< time to wait between cache rebalancing
   uint64_t osd_memory_target = 0;   ///< OSD memory target when autotuning cache
@@ -2137,11 +2148,24 @@ private:
     };
     std::shared_ptr<DataCache> data_cache;
 
+    struct CompressedDataCache : public MempoolCache {
+      CompressedDataCache(BlueStore *s) : MempoolCache(s) {};
+
+      virtual uint64_t _get_used_bytes() const {
+        return store->compressed_cache->get_bytes();
+      }
+      virtual string get_cache_name() const {
+        return "BlueStore Compressed Data Cache";
+      }
+    };
+    std::shared_ptr<CompressedDataCache> compressed_data_cache;
+
   public:
     explicit MempoolThread(BlueStore *s)
       : store(s),
         meta_cache(new MetaCache(s)),
-        data_cache(new DataCache(s)) {}
+        data_cache(new DataCache(s)),
+        compressed_data_cache(new CompressedDataCache(s)) {}
 
     void *entry() override;
     void init() {
@@ -0,0 +1,157 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "CompressedCache.h"
+#include "common/debug.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef dout_prefix
+#define dout_prefix *_dout << "bluestore.CompressedCache(" << this << ") "
+
+CompressedCache::CompressedCache(CephContext *cct, size_t num_shards)
+  : cct(cct),
+    shards(std::max<size_t>(num_shards, 1))
+{
+}
+
+void CompressedCache::Shard::_rm(std::map<uint64_t, Entry>::iterator p)
+{
+  bytes -= p->second.data.length();
+  lru.erase(p->second.lru_pos);
+  entries.erase(p);
+}
+
+void CompressedCache::Shard::_trim(uint64_t max)
+{
+  while (bytes > max && !lru.empty()) {
+    auto p = entries.find(lru.back());
+    ceph_assert(p != entries.end());
+    _rm(p);
+  }
+}
+
+bool CompressedCache::_matches(const Entry& e, const bluestore_blob_t& blob)
+{
+  auto& extents = blob.get_extents();
+  if (e.extents.size() != extents.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < extents.size(); ++i) {
+    if (e.extents[i].offset != extents[i].offset ||
+	e.extents[i].length != extents[i].length) {
+      return false;
+    }
+  }
+  return e.csum_data.length() == blob.csum_data.length() &&
+    (e.csum_data.length() == 0 ||
+     memcmp(e.csum_data.c_str(), blob.csum_data.c_str(),
+	    e.csum_data.length()) == 0);
+}
+
+bool CompressedCache::lookup(const bluestore_blob_t& blob, bufferlist *out)
+{
+  if (!enabled() || !blob.is_compressed() || blob.get_extents().empty()) {
+    return false;
+  }
+  uint64_t key = blob.get_extents().front().offset;
+  auto& shard = _get_shard(key);
+  std::lock_guard l(shard.lock);
+  auto p = shard.entries.find(key);
+  if (p == shard.entries.end()) {
+    return false;
+  }
+  if (!_matches(p->second, blob)) {
+    ldout(cct, 20) << __func__ << " stale entry at 0x" << std::hex << key
+		   << std::dec << dendl;
+    uint64_t len = p->second.data.length();
+    shard._rm(p);
+    bytes -= len;
+    --num_entries;
+    return false;
+  }
+  shard.lru.splice(shard.lru.begin(), shard.lru, p->second.lru_pos);
+  *out = p->second.data;
+  return true;
+}
+
+void CompressedCache::insert(const bluestore_blob_t& blob,
+			     const bufferlist& bl)
+{
+  if (!enabled() || !blob.is_compressed() || blob.get_extents().empty()) {
+    return;
+  }
+  uint64_t key = blob.get_extents().front().offset;
+  auto& shard = _get_shard(key);
+  std::lock_guard l(shard.lock);
+  uint64_t before = shard.bytes;
+  size_t before_entries = shard.entries.size();
+  auto p = shard.entries.find(key);
+  if (p != shard.entries.end()) {
+    shard._rm(p);
+  }
+  Entry& e = shard.entries[key];
+  e.extents = blob.get_extents();
+  if (blob.csum_data.length()) {
+    e.csum_data = buffer::copy(blob.csum_data.c_str(),
+			       blob.csum_data.length());
+  }
+  e.data = bl;
+  e.data.rebuild();
+  e.data.reassign_to_mempool(mempool::mempool_bluestore_cache_data);
+  shard.lru.push_front(key);
+  e.lru_pos = shard.lru.begin();
+  shard.bytes += e.data.length();
+  shard._trim(max_bytes / shards.size());
+  bytes += shard.bytes - before;
+  num_entries += shard.entries.size() - before_entries;
+}
+
+void CompressedCache::invalidate(const interval_set<uint64_t>& released)
+{
+  if (num_entries == 0) {
+    return;
+  }
+  for (auto& shard : shards) {
+    std::lock_guard l(shard.lock);
+    if (shard.entries.empty()) {
+      continue;
+    }
+    uint64_t before = shard.bytes;
+    size_t before_entries = shard.entries.size();
+    for (auto r = released.begin(); r != released.end(); ++r) {
+      auto p = shard.entries.lower_bound(r.get_start());
+      while (p != shard.entries.end() && p->first < r.get_end()) {
+	shard._rm(p++);
+      }
+    }
+    bytes -= before - shard.bytes;
+    num_entries -= before_entries - shard.entries.size();
+  }
+}
+
+void CompressedCache::trim(uint64_t max)
+{
+  max_bytes = max;
+  uint64_t per_shard = max / shards.size();
+  for (auto& shard : shards) {
+    std::lock_guard l(shard.lock);
+    uint64_t before = shard.bytes;
+    size_t before_entries = shard.entries.size();
+    shard._trim(per_shard);
+    bytes -= before - shard.bytes;
+    num_entries -= before_entries - shard.entries.size();
+  }
+}
+
+void CompressedCache::clear()
+{
+  for (auto& shard : shards) {
+    std::lock_guard l(shard.lock);
+    bytes -= shard.bytes;
+    num_entries -= shard.entries.size();
+    shard.entries.clear();
+    shard.lru.clear();
+    shard.bytes = 0;
+  }
+}
@@ -0,0 +1,100 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_OS_BLUESTORE_COMPRESSEDCACHE_H
+#define CEPH_OS_BLUESTORE_COMPRESSEDCACHE_H
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "include/interval_set.h"
+#include "os/bluestore/bluestore_types.h"
+
+/**
+ * Second-level cache of compressed blob payloads.
+ *
+ * The BufferSpace of a shared blob only holds decompressed data.  This
+ * cache keeps the on-disk (compressed) representation of compressed
+ * blobs so that a miss in the buffer cache can be served by
+ * decompressing from memory instead of reading from the device.  Since
+ * compressed data is typically 3-4x smaller, this lets us hold a lot
+ * more data in the same amount of memory.
+ *
+ * Entries are keyed by the physical offset of the blob's first extent
+ * and validated against the blob's full extent list and checksum data
+ * on lookup.  Space released to the allocator must be passed to
+ * invalidate() before it can be reused.
+ */
+class CompressedCache {
+  struct Entry {
+    PExtentVector extents;  ///< blob extents when the entry was added
+    bufferptr csum_data;    ///< blob checksums when the entry was added
+    bufferlist data;        ///< compressed payload (incl. header)
+    std::list<uint64_t>::iterator lru_pos;
+  };
+
+  struct Shard {
+    ceph::mutex lock = ceph::make_mutex("CompressedCache::Shard::lock");
+    std::map<uint64_t, Entry> entries;  ///< first pextent offset -> entry
+    std::list<uint64_t> lru;            ///< most recently used first
+    uint64_t bytes = 0;
+
+    void _rm(std::map<uint64_t, Entry>::iterator p);
+    void _trim(uint64_t max);
+  };
+
+  CephContext *cct;
+  std::vector<Shard> shards;
+  std::atomic<uint64_t> bytes = {0};
+  std::atomic<uint64_t> num_entries = {0};
+  std::atomic<uint64_t> max_bytes = {0};
+
+  Shard& _get_shard(uint64_t key) {
+    // physical offsets are at least min_alloc_size aligned
+    return shards[(key >> 12) % shards.size()];
+  }
+  static bool _matches(const Entry& e, const bluestore_blob_t& blob);
+
+public:
+  CompressedCache(CephContext *cct, size_t num_shards);
+
+  bool enabled() const {
+    return max_bytes > 0;
+  }
+  uint64_t get_bytes() const {
+    return bytes;
+  }
+  uint64_t get_num_entries() const {
+    return num_entries;
+  }
+  uint64_t get_max_bytes() const {
+    return max_bytes;
+  }
+
+  /// look up the compressed payload of @p blob; returns true on hit
+  bool lookup(const bluestore_blob_t& blob, bufferlist *out);
+
+  /// add the (checksum verified) compressed payload of @p blob
+  void insert(const bluestore_blob_t& blob, const bufferlist& bl);
+
+  /// drop any entries that start within the released extents
+  void invalidate(const interval_set<uint64_t>& released);
+
+  /// set a new size target and trim to it
+  void trim(uint64_t max);
+
+  void clear();
+};
+
+#endif
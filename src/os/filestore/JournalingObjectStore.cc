@@ -4,6 +4,7 @@
 
 #include "common/errno.h"
 #include "common/debug.h"
+#include "common/Thread.h"
 
 #define dout_context cct
 #define dout_subsys ceph_subsys_journal
@@ -67,6 +68,21 @@ int JournalingObjectStore::journal_replay(uint64_t fs_op_seq)
 
   replaying = true;
 
+  std::unique_ptr<JournalReplayer> replayer;
+  if (cct->_conf->journal_replay_threads > 1) {
+    dout(3) << "journal_replay: applying with "
+	    << cct->_conf->journal_replay_threads << " threads" << dendl;
+    replayer.reset(new JournalReplayer(
+      cct, cct->_conf->journal_replay_threads,
+      cct->_conf->journal_replay_max_bytes,
+      [this](vector<ObjectStore::Transaction>& tls, uint64_t seq) {
+	int r = do_transactions(tls, seq);
+	apply_manager.op_apply_finish(seq);
+	dout(3) << "journal_replay: r = " << r << ", applied op seq "
+		<< seq << dendl;
+      }));
+  }
+
   int count = 0;
   while (1) {
     bufferlist bl;
@@ -82,6 +98,17 @@ int JournalingObjectStore::journal_replay(uint64_t fs_op_seq)
     }
     ceph_assert(op_seq == seq-1);
 
+    if (replayer) {
+      dout(3) << "journal_replay: queueing op seq " << seq << dendl;
+      // ops must start in journal order so that a commit never covers an
+      // op which is still queued
+      apply_manager.op_apply_start(seq);
+      replayer->queue(seq, bl);
+      op_seq = seq;
+      count++;
+      continue;
+    }
+
     dout(3) << "journal_replay: applying op seq " << seq << dendl;
     auto p = bl.cbegin();
     vector<ObjectStore::Transaction> tls;
@@ -99,6 +126,11 @@ int JournalingObjectStore::journal_replay(uint64_t fs_op_seq)
     dout(3) << "journal_replay: r = " << r << ", op_seq now " << op_seq << dendl;
   }
 
+  if (replayer) {
+    replayer->drain();
+    replayer.reset();
+  }
+
   if (count)
     dout(3) << "journal_replay: total = " << count << dendl;
 
@@ -269,3 +301,126 @@ void JournalingObjectStore::_op_journal_transactions(
     apply_manager.add_waiter(op, onjournal);
   }
 }
+
+
+// ------------------------------------------
+
+#undef dout_prefix
+#define dout_prefix *_dout << "journal replayer "
+
+JournalReplayer::JournalReplayer(CephContext *cct, unsigned num_threads,
+				 uint64_t max_bytes, apply_func&& apply)
+  : cct(cct), max_bytes(max_bytes), apply(std::move(apply))
+{
+  threads.reserve(num_threads);
+  for (unsigned i = 0; i < num_threads; ++i) {
+    threads.push_back(make_named_thread("jrn_replay",
+					&JournalReplayer::worker, this));
+  }
+}
+
+JournalReplayer::~JournalReplayer()
+{
+  drain();
+  {
+    std::lock_guard l(lock);
+    stopping = true;
+    ready_cond.notify_all();
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+void JournalReplayer::queue(uint64_t seq, bufferlist& bl)
+{
+  // decode outside of the lock, the workers only need it to schedule
+  auto e = new Entry;
+  e->seq = seq;
+  e->bytes = bl.length();
+  auto p = bl.cbegin();
+  while (!p.end()) {
+    e->tls.emplace_back(p);
+    auto i = e->tls.back().begin();
+    e->colls.insert(i.colls.begin(), i.colls.end());
+  }
+
+  std::unique_lock l(lock);
+  if (e->colls.empty()) {
+    // nothing to order it by, apply it by itself
+    dout(10) << __func__ << " " << seq << " touches no collection, draining"
+	     << dendl;
+    done_cond.wait(l, [this] { return queued == 0; });
+    l.unlock();
+    apply(e->tls, seq);
+    delete e;
+    return;
+  }
+  // an entry larger than max_bytes still goes through once the queue is empty
+  done_cond.wait(l, [this, e] {
+    return queued == 0 || queued_bytes + e->bytes <= max_bytes;
+  });
+  ++queued;
+  queued_bytes += e->bytes;
+  for (auto& c : e->colls) {
+    auto& q = coll_queues[c];
+    if (!q.empty()) {
+      ++e->blocked_by;
+    }
+    q.push_back(e);
+  }
+  dout(20) << __func__ << " " << seq << " colls " << e->colls
+	   << " blocked_by " << e->blocked_by << dendl;
+  if (e->blocked_by == 0) {
+    ready.push_back(e);
+    ready_cond.notify_one();
+  }
+}
+
+void JournalReplayer::drain()
+{
+  std::unique_lock l(lock);
+  done_cond.wait(l, [this] { return queued == 0; });
+}
+
+void JournalReplayer::worker()
+{
+  std::unique_lock l(lock);
+  while (true) {
+    ready_cond.wait(l, [this] { return stopping || !ready.empty(); });
+    if (ready.empty()) {
+      break;
+    }
+    Entry *e = ready.front();
+    ready.pop_front();
+    l.unlock();
+    dout(20) << __func__ << " applying " << e->seq << dendl;
+    apply(e->tls, e->seq);
+    l.lock();
+    _finish(e);
+  }
+}
+
+void JournalReplayer::_finish(Entry *e)
+{
+  for (auto& c : e->colls) {
+    auto q = coll_queues.find(c);
+    ceph_assert(q != coll_queues.end());
+    ceph_assert(q->second.front() == e);
+    q->second.pop_front();
+    if (q->second.empty()) {
+      coll_queues.erase(q);
+      continue;
+    }
+    Entry *next = q->second.front();
+    ceph_assert(next->blocked_by > 0);
+    if (--next->blocked_by == 0) {
+      ready.push_back(next);
+      ready_cond.notify_one();
+    }
+  }
+  --queued;
+  queued_bytes -= e->bytes;
+  delete e;
+  done_cond.notify_all();
+}
@@ -15,12 +15,69 @@
 #ifndef CEPH_JOURNALINGOBJECTSTORE_H
 #define CEPH_JOURNALINGOBJECTSTORE_H
 
+#include <deque>
+#include <functional>
+#include <thread>
+
 #include "os/ObjectStore.h"
 #include "Journal.h"
 #include "FileJournal.h"
 #include "common/RWLock.h"
+#include "common/ceph_mutex.h"
 #include "osd/OpRequest.h"
 
+/**
+ * Applies replayed journal entries on a pool of threads.
+ *
+ * Entries are queued in journal order.  An entry is applied once every
+ * earlier entry touching any of its collections has been, so entries of
+ * different PGs are applied in parallel, while the transactions of each
+ * collection, and hence of each Sequencer, are applied in the order they
+ * were journaled.  An entry touching no collection at all is applied by
+ * itself, after everything queued before it.
+ */
+class JournalReplayer {
+public:
+  typedef std::function<void(vector<ObjectStore::Transaction>&,
+			     uint64_t)> apply_func;
+
+  JournalReplayer(CephContext *cct, unsigned num_threads, uint64_t max_bytes,
+		  apply_func&& apply);
+  ~JournalReplayer();
+
+  /// decode entry @p seq and queue it, blocking while max_bytes are queued
+  void queue(uint64_t seq, bufferlist& bl);
+  /// wait for all queued entries to be applied
+  void drain();
+
+private:
+  struct Entry {
+    uint64_t seq;
+    uint64_t bytes;
+    vector<ObjectStore::Transaction> tls;
+    set<coll_t> colls;
+    unsigned blocked_by = 0;  ///< colls with an earlier entry queued
+  };
+
+  CephContext *cct;
+  const uint64_t max_bytes;
+  const apply_func apply;
+
+  ceph::mutex lock = ceph::make_mutex("JournalReplayer::lock");
+  ceph::condition_variable ready_cond;  ///< workers wait for ready entries
+  ceph::condition_variable done_cond;   ///< queue() and drain() wait here
+  /// entries of each collection, in journal order
+  map<coll_t, std::deque<Entry*>> coll_queues;
+  std::deque<Entry*> ready;
+  uint64_t queued_bytes = 0;
+  unsigned queued = 0;
+  bool stopping = false;
+  vector<std::thread> threads;
+
+  void worker();
+  void _finish(Entry *e);
+};
+
 class JournalingObjectStore : public ObjectStore {
 protected:
   Journal *journal;
@@ -24,6 +24,7 @@
 #include "include/types.h"
 #include "include/stringify.h"
 #include "include/unordered_map.h"
+#include "include/intarith.h"
 #include "common/errno.h"
 #include "MemStore.h"
 #include "include/compat.h"
@@ -43,6 +44,7 @@ bool operator>(const MemStore::CollectionRef& l,
 
 int MemStore::mount()
 {
+  PageAllocator::set_use_hugetlb(cct->_conf->memstore_page_set_hugetlb);
   int r = _load();
   if (r < 0)
     return r;
@@ -1579,6 +1581,10 @@ struct MemStore::PageSetObject : public Object {
             uint64_t dstoff) override;
   int truncate(uint64_t offset) override;
 
+  /// copy [srcoff,srcoff+len) of src to dstoff, without sharing pages
+  void copy_range(PageSetObject *src, uint64_t srcoff, uint64_t len,
+                  uint64_t dstoff);
+
   void encode(bufferlist& bl) const override {
     ENCODE_START(1, 1, bl);
     encode(data_len, bl);
@@ -1682,10 +1688,47 @@ int MemStore::PageSetObject::write(uint64_t offset, const bufferlist &src)
 
 int MemStore::PageSetObject::clone(Object *src, uint64_t srcoff,
                                    uint64_t len, uint64_t dstoff)
+{
+  auto src_obj = static_cast<PageSetObject*>(src);
+  const auto page_size = data.get_page_size();
+  const uint64_t end = dstoff + len;
+  if (src_obj->data.get_page_size() != page_size ||
+      srcoff % page_size != dstoff % page_size ||
+      len < page_size) {
+    copy_range(src_obj, srcoff, len, dstoff);
+  } else {
+    // share the whole pages in the range, and copy the partial ones
+    // at either end
+    const uint64_t head = p2nphase<uint64_t>(srcoff, page_size);
+    uint64_t shared = p2align<uint64_t>(len - head, page_size);
+    // a partial last page may be shared too if the bytes following the
+    // range are zeroes on both sides, i.e. past the end of both objects
+    if (srcoff + len == src_obj->data_len && end >= data_len &&
+        head + shared < len) {
+      shared += page_size;
+    }
+    if (head) {
+      copy_range(src_obj, srcoff, head, dstoff);
+    }
+    data.clone_range(src_obj->data, srcoff + head, shared, dstoff + head);
+    if (head + shared < len) {
+      copy_range(src_obj, srcoff + head + shared, len - head - shared,
+                 dstoff + head + shared);
+    }
+  }
+
+  // update object size
+  if (data_len < end)
+    data_len = end;
+  return 0;
+}
+
+void MemStore::PageSetObject::copy_range(PageSetObject *src, uint64_t srcoff,
+                                         uint64_t len, uint64_t dstoff)
 {
   const int64_t delta = dstoff - srcoff;
 
-  auto &src_data = static_cast<PageSetObject*>(src)->data;
+  auto &src_data = src->data;
   const uint64_t src_page_size = src_data.get_page_size();
 
   auto &dst_data = data;
@@ -1763,11 +1806,6 @@ int MemStore::PageSetObject::clone(Object *src, uint64_t srcoff,
     }
     dst_pages.clear(); // drop page refs
   }
-
-  // update object size
-  if (data_len < dstoff)
-    data_len = dstoff;
-  return 0;
 }
 
 int MemStore::PageSetObject::truncate(uint64_t size)
@@ -1786,6 +1824,11 @@ int MemStore::PageSetObject::truncate(uint64_t size)
   if (tls_pages.empty())
     return 0;
 
+  if (tls_pages.front()->is_shared()) {
+    // get a private copy of a page shared with a clone
+    tls_pages.clear();
+    data.alloc_range(size, page_offset + page_size - size, tls_pages);
+  }
   auto page = tls_pages.begin();
   auto data = (*page)->data;
   std::fill(data + (size - page_offset), data + page_size, 0);
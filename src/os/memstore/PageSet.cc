@@ -0,0 +1,151 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.	See file COPYING.
+ *
+ */
+
+#include <cstddef>
+#include <map>
+#include <new>
+#include <sys/mman.h>
+
+#include "include/intarith.h"
+#include "PageSet.h"
+
+MEMPOOL_DEFINE_OBJECT_FACTORY(Page, memstore_page, memstore_meta);
+
+namespace {
+  std::atomic<bool> use_hugetlb = {false};
+}
+
+PageAllocator& PageAllocator::get(size_t page_size)
+{
+  static std::mutex lock;
+  // never freed, pages may outlive static destructors
+  static auto allocators = new std::map<size_t, PageAllocator*>;
+
+  const size_t slot_size = p2roundup<size_t>(page_size,
+					     alignof(std::max_align_t));
+  std::lock_guard<std::mutex> l(lock);
+  auto& alloc = (*allocators)[slot_size];
+  if (!alloc) {
+    alloc = new PageAllocator(slot_size);
+  }
+  return *alloc;
+}
+
+void PageAllocator::set_use_hugetlb(bool use)
+{
+  use_hugetlb = use;
+}
+
+PageArena *PageAllocator::new_arena()
+{
+  const size_t bytes = p2roundup(slot_size, arena_size);
+  void *p = MAP_FAILED;
+  bool hugetlb = false;
+#ifdef MAP_HUGETLB
+  if (use_hugetlb) {
+    p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    hugetlb = (p != MAP_FAILED);
+  }
+#endif
+  if (p == MAP_FAILED) {
+    // over-allocate so that the arena can start on a huge page boundary
+    const size_t len = bytes + arena_size;
+    auto raw = static_cast<char*>(::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+					 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (raw == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    auto aligned = reinterpret_cast<char*>(
+      p2roundup(reinterpret_cast<uintptr_t>(raw), uintptr_t(arena_size)));
+    if (aligned > raw) {
+      ::munmap(raw, aligned - raw);
+    }
+    if (raw + len > aligned + bytes) {
+      ::munmap(aligned + bytes, raw + len - (aligned + bytes));
+    }
+    p = aligned;
+#ifdef MADV_HUGEPAGE
+    ::madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+  }
+  mempool::get_pool(mempool::mempool_memstore_data).adjust_count(1, bytes);
+  ++num_arenas;
+  return new PageArena(this, static_cast<char*>(p), bytes,
+		       bytes / slot_size, hugetlb);
+}
+
+void PageAllocator::free_arena(PageArena *arena)
+{
+  mempool::get_pool(mempool::mempool_memstore_data).adjust_count(
+    -1, -(ssize_t)arena->bytes);
+  --num_arenas;
+  ::munmap(arena->base, arena->bytes);
+  delete arena;
+}
+
+char *PageAllocator::allocate(PageArena **parena, uint32_t *pslot)
+{
+  std::lock_guard<std::mutex> l(lock);
+  PageArena *arena;
+  if (!partial.empty()) {
+    arena = &partial.front();
+  } else if (spare) {
+    arena = spare;
+    spare = nullptr;
+    partial.push_back(*arena);
+  } else {
+    arena = new_arena();
+    partial.push_back(*arena);
+  }
+  uint32_t slot;
+  if (!arena->free_slots.empty()) {
+    slot = arena->free_slots.back();
+    arena->free_slots.pop_back();
+  } else {
+    slot = arena->next_slot++;
+  }
+  if (++arena->used == arena->num_slots) {
+    partial.erase(partial.iterator_to(*arena));
+  }
+  arena->refs[slot] = 1;
+  *parena = arena;
+  *pslot = slot;
+  return arena->base + slot * slot_size;
+}
+
+void PageAllocator::release(PageArena *arena, uint32_t slot)
+{
+  std::lock_guard<std::mutex> l(lock);
+  if (arena->used == arena->num_slots) {
+    partial.push_front(*arena);
+  }
+  arena->free_slots.push_back(slot);
+  if (--arena->used > 0) {
+    return;
+  }
+  // keep a single empty arena around to avoid mmap churn
+  partial.erase(partial.iterator_to(*arena));
+  arena->free_slots.clear();
+  arena->next_slot = 0;
+  if (spare) {
+    free_arena(arena);
+  } else {
+#ifdef MADV_DONTNEED
+    if (!arena->hugetlb) {
+      // give the memory back, the mapping stays valid
+      ::madvise(arena->base, arena->bytes, MADV_DONTNEED);
+    }
+#endif
+    spare = arena;
+  }
+}
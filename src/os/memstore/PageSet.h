@@ -18,12 +18,92 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <boost/intrusive/avl_set.hpp>
+#include <boost/intrusive/list.hpp>
 #include <boost/intrusive_ptr.hpp>
 
 #include "include/encoding.h"
+#include "include/mempool.h"
+
+class PageAllocator;
+
+/// a mapping, normally a single huge page, carved into page-sized slots
+struct PageArena {
+  PageAllocator *const alloc;
+  char *const base;
+  const size_t bytes;
+  const uint32_t num_slots;
+  const bool hugetlb;      ///< explicitly backed by MAP_HUGETLB
+  /// number of Pages sharing the data of each slot
+  std::unique_ptr<std::atomic<uint32_t>[]> refs;
+
+  // protected by PageAllocator::lock
+  std::vector<uint32_t> free_slots;
+  uint32_t next_slot = 0;  ///< slots at or past this were never handed out
+  uint32_t used = 0;
+  boost::intrusive::list_member_hook<> partial_item;
+
+  PageArena(PageAllocator *alloc, char *base, size_t bytes,
+            uint32_t num_slots, bool hugetlb)
+    : alloc(alloc), base(base), bytes(bytes), num_slots(num_slots),
+      hugetlb(hugetlb), refs(new std::atomic<uint32_t>[num_slots]) {}
+};
+
+/**
+ * Hands out page data for a given page size from 2MB arenas.
+ *
+ * Allocating pages one by one from the heap costs a malloc header and
+ * a TLB entry per 4K of data.  Arenas are mmapped and aligned so that
+ * the kernel can back them with transparent huge pages, or with
+ * explicitly reserved ones if set_use_hugetlb(true) was called.  Page
+ * data is reference counted per slot so that cloned pages can share it
+ * until one of them is written to.  Arena memory is accounted to the
+ * memstore_data mempool.
+ */
+class PageAllocator {
+ public:
+  static constexpr size_t arena_size = 2 << 20;
+
+  /// get the (shared) allocator for the given page size
+  static PageAllocator& get(size_t page_size);
+  static void set_use_hugetlb(bool use);
+
+  size_t get_slot_size() const { return slot_size; }
+  size_t get_num_arenas() const { return num_arenas; }
+
+  /// allocate the data for a page, with a single reference
+  char *allocate(PageArena **arena, uint32_t *slot);
+  void get_ref(PageArena *arena, uint32_t slot) {
+    ++arena->refs[slot];
+  }
+  void put_ref(PageArena *arena, uint32_t slot) {
+    if (--arena->refs[slot] == 0)
+      release(arena, slot);
+  }
+
+  PageAllocator(const PageAllocator&) = delete;
+  const PageAllocator& operator=(const PageAllocator&) = delete;
+
+ private:
+  explicit PageAllocator(size_t slot_size) : slot_size(slot_size) {}
+
+  void release(PageArena *arena, uint32_t slot);
+  PageArena *new_arena();
+  void free_arena(PageArena *arena);
+
+  const size_t slot_size;
+  std::mutex lock;
+  /// arenas with free slots
+  boost::intrusive::list<PageArena,
+    boost::intrusive::member_hook<PageArena,
+                                  boost::intrusive::list_member_hook<>,
+                                  &PageArena::partial_item>> partial;
+  PageArena *spare = nullptr;  ///< an empty arena we keep around
+  size_t num_arenas = 0;
+};
 
 struct Page {
   char *const data;
@@ -62,25 +142,40 @@ struct Page {
     decode(offset, p);
   }
 
+  /// true if the data is shared with a clone, and must not be modified
+  bool is_shared() const {
+    return arena->refs[slot] > 1;
+  }
+
   static Ref create(size_t page_size, uint64_t offset = 0) {
-    // ensure proper alignment of the Page
-    const auto align = alignof(Page);
-    page_size = (page_size + align - 1) & ~(align - 1);
-    // allocate the Page and its data in a single buffer
-    auto buffer = new char[page_size + sizeof(Page)];
-    // place the Page structure at the end of the buffer
-    return new (buffer + page_size) Page(buffer, offset);
+    return create(PageAllocator::get(page_size), offset);
+  }
+  static Ref create(PageAllocator &alloc, uint64_t offset = 0) {
+    PageArena *arena;
+    uint32_t slot;
+    char *data = alloc.allocate(&arena, &slot);
+    return new Page(data, arena, slot, offset);
+  }
+  /// create a page at @p offset which shares the data of @p src
+  static Ref share(const Page &src, uint64_t offset) {
+    src.arena->alloc->get_ref(src.arena, src.slot);
+    return new Page(src.data, src.arena, src.slot, offset);
   }
 
   // copy disabled
   Page(const Page&) = delete;
   const Page& operator=(const Page&) = delete;
 
+  MEMPOOL_CLASS_HELPERS();
+
  private: // private constructor, use create() instead
-  Page(char *data, uint64_t offset) : data(data), offset(offset), nrefs(1) {}
+  PageArena *const arena;
+  const uint32_t slot;
 
-  static void operator delete(void *p) {
-    delete[] reinterpret_cast<Page*>(p)->data;
+  Page(char *data, PageArena *arena, uint32_t slot, uint64_t offset)
+    : data(data), offset(offset), nrefs(1), arena(arena), slot(slot) {}
+  ~Page() {
+    arena->alloc->put_ref(arena, slot);
   }
 };
 
@@ -102,6 +197,7 @@ class PageSet {
 
   page_set pages;
   uint64_t page_size;
+  PageAllocator *alloc;
 
   typedef std::mutex lock_type;
   lock_type mutex;
@@ -114,6 +210,22 @@ class PageSet {
     }
   }
 
+  // replace a page whose data is shared with a clone by a private copy,
+  // which the caller is about to write [offset,offset+length) of
+  iterator unshare(iterator cur, uint64_t offset, uint64_t length) {
+    Page *old = &*cur;
+    auto page = Page::create(*alloc, old->offset);
+    const uint64_t begin = std::max(offset, old->offset) - old->offset;
+    const uint64_t end = std::min(offset + length,
+                                  old->offset + page_size) - old->offset;
+    std::copy(old->data, old->data + begin, page->data);
+    std::copy(old->data + end, old->data + page_size, page->data + end);
+    pages.replace_node(cur, *page);
+    // readers holding a ref to the old page keep its data alive
+    old->put();
+    return pages.iterator_to(*page);
+  }
+
   int count_pages(uint64_t offset, uint64_t len) const {
     // count the overlapping pages
     int count = 0;
@@ -129,9 +241,11 @@ class PageSet {
   }
 
  public:
-  explicit PageSet(size_t page_size) : page_size(page_size) {}
+  explicit PageSet(size_t page_size)
+    : page_size(page_size), alloc(&PageAllocator::get(page_size)) {}
   PageSet(PageSet &&rhs)
-    : pages(std::move(rhs.pages)), page_size(rhs.page_size) {}
+    : pages(std::move(rhs.pages)), page_size(rhs.page_size),
+      alloc(rhs.alloc) {}
   ~PageSet() {
     free_pages(pages.begin(), pages.end());
   }
@@ -161,7 +275,7 @@ class PageSet {
       typename page_set::insert_commit_data commit;
       auto insert = pages.insert_check(cur, page_offset, page_cmp(), commit);
       if (insert.second) {
-        auto page = Page::create(page_size, page_offset);
+        auto page = Page::create(*alloc, page_offset);
         cur = pages.insert_commit(*page, commit);
 
         // assume that the caller will write to the range [offset,length),
@@ -176,6 +290,9 @@ class PageSet {
           std::fill(page->data, page->data + offset - page->offset, 0);
       } else { // exists
         cur = insert.first;
+        // copy-on-write if the data is shared with a clone
+        if (cur->is_shared())
+          cur = unshare(cur, offset, length);
       }
       // add a reference to output vector
       out->reset(&*cur);
@@ -196,6 +313,38 @@ class PageSet {
       range.push_back(&*cur++);
   }
 
+  // share the pages of src in [srcoff,srcoff+len) at dstoff, replacing
+  // any pages in the destination range; holes in the source become holes
+  // in the destination.  the range must be page aligned.  the data is
+  // copied on the next write to either side, so callers must not write
+  // to a page returned by alloc_range() concurrently with a clone of it
+  void clone_range(PageSet &src, uint64_t srcoff, uint64_t len,
+                   uint64_t dstoff) {
+    ceph_assert(src.page_size == page_size);
+    ceph_assert((srcoff | dstoff | len) % page_size == 0);
+    std::unique_lock<lock_type> l1(mutex, std::defer_lock);
+    std::unique_lock<lock_type> l2(src.mutex, std::defer_lock);
+    if (&src == this)
+      l1.lock();
+    else
+      std::lock(l1, l2);
+
+    // take refs first, the ranges may overlap if src is this set
+    page_vector range;
+    src.get_range(srcoff, len, range);
+
+    auto cur = pages.lower_bound(dstoff, page_cmp());
+    while (cur != pages.end() && cur->offset < dstoff + len) {
+      Page *page = &*cur;
+      cur = pages.erase(cur);
+      page->put();
+    }
+    for (auto &src_page : range) {
+      auto page = Page::share(*src_page, src_page->offset - srcoff + dstoff);
+      pages.insert(cur, *page);
+    }
+  }
+
   void free_pages_after(uint64_t offset) {
     std::lock_guard<lock_type> lock(mutex);
     auto cur = pages.lower_bound(offset & ~(page_size-1), page_cmp());
@@ -218,11 +367,12 @@ class PageSet {
     using ceph::decode;
     ceph_assert(empty());
     decode(page_size, p);
+    alloc = &PageAllocator::get(page_size);
     unsigned count;
     decode(count, p);
     auto cur = pages.end();
     for (unsigned i = 0; i < count; i++) {
-      auto page = Page::create(page_size);
+      auto page = Page::create(*alloc);
       page->decode(p, page_size);
       cur = pages.insert_before(cur, *page);
     }
@@ -1165,6 +1165,21 @@ static void show_reshard_status(
     formatter->dump_string("new_bucket_instance_id",
 			   entry.new_bucket_instance_id);
     formatter->dump_int("num_shards", entry.num_shards);
+    if (!ceph::real_clock::is_zero(entry.start_time)) {
+      utime_t start_time(entry.start_time);
+      utime_t update_time(entry.update_time);
+      encode_json("start_time", start_time, formatter);
+      encode_json("update_time", update_time, formatter);
+      formatter->dump_unsigned("num_entries_copied", entry.num_entries_copied);
+      formatter->dump_unsigned("num_entries_replayed",
+			       entry.num_entries_replayed);
+      const double elapsed = (update_time - start_time);
+      if (elapsed > 0) {
+	formatter->dump_float("entries_per_sec",
+			      (entry.num_entries_copied +
+			       entry.num_entries_replayed) / elapsed);
+      }
+    }
     formatter->close_section();
   }
   formatter->close_section();
@@ -6159,7 +6174,7 @@ next:
       map<string, rgw_bucket_dir_entry> result;
       int r =
 	store->cls_bucket_list_ordered(bucket_info, RGW_NO_SHARD, marker,
-				       prefix, 1000, true,
+				       prefix, string(), 1000, true,
 				       result, &is_truncated, &marker,
 				       bucket_object_check_filter);
 
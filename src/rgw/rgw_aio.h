@@ -91,6 +91,9 @@ class Aio {
   // wait for all outstanding completions and return their results
   virtual AioResultList drain() = 0;
 
+  // change the total cost of the operations that may be in flight
+  virtual void set_window(uint64_t window) = 0;
+
   static OpFunc librados_op(librados::ObjectReadOperation&& op,
                             optional_yield y);
   static OpFunc librados_op(librados::ObjectWriteOperation&& op,
@@ -110,6 +110,12 @@ AioResultList BlockingAioThrottle::drain()
   return std::move(completed);
 }
 
+void BlockingAioThrottle::set_window(uint64_t w)
+{
+  std::scoped_lock lock{mutex};
+  window = w;
+}
+
 #ifdef HAVE_BOOST_CONTEXT
 
 template <typename CompletionToken>
@@ -202,6 +208,11 @@ AioResultList YieldingAioThrottle::drain()
   }
   return std::move(completed);
 }
+
+void YieldingAioThrottle::set_window(uint64_t w)
+{
+  window = w;
+}
 #endif // HAVE_BOOST_CONTEXT
 
 } // namespace rgw
@@ -27,7 +27,7 @@ namespace rgw {
 
 class Throttle {
  protected:
-  const uint64_t window;
+  uint64_t window;
   uint64_t pending_size = 0;
 
   AioResultList pending;
@@ -76,6 +76,8 @@ class BlockingAioThrottle final : public Aio, private Throttle {
   AioResultList wait() override final;
 
   AioResultList drain() override final;
+
+  void set_window(uint64_t w) override final;
 };
 
 #ifdef HAVE_BOOST_CONTEXT
@@ -111,6 +113,8 @@ class YieldingAioThrottle final : public Aio, private Throttle {
   AioResultList wait() override final;
 
   AioResultList drain() override final;
+
+  void set_window(uint64_t w) override final;
 };
 #endif // HAVE_BOOST_CONTEXT
 
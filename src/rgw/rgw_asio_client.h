@@ -51,6 +51,13 @@ class ClientIO : public io::RestfulClient,
     return write_data(buf, len);
   }
 
+  size_t send_body_buffers(const ceph::bufferlist& bl) override {
+    return write_buffers(bl);
+  }
+
+  // send all buffers of bl in a single gathered write, without copying them
+  virtual size_t write_buffers(const ceph::bufferlist& bl) = 0;
+
   RGWEnv& get_env() noexcept override {
     return env;
   }
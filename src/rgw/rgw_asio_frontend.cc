@@ -1,11 +1,13 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include <algorithm>
 #include <atomic>
 #include <thread>
 #include <vector>
 
 #include <boost/asio.hpp>
+#include <boost/container/small_vector.hpp>
 #define BOOST_COROUTINES_NO_DEPRECATION_WARNING
 #include <boost/asio/spawn.hpp>
 #include <boost/intrusive/list.hpp>
@@ -21,6 +23,7 @@
 #endif
 
 #include "rgw_dmclock_async_scheduler.h"
+#include "rgw_dmclock_tenant_scheduler.h"
 
 #define dout_subsys ceph_subsys_rgw
 
@@ -59,6 +62,57 @@ class StreamIO : public rgw::asio::ClientIO {
     return bytes;
   }
 
+  // consecutive buffers smaller than this are copied together, instead of
+  // handing the kernel lots of tiny iovecs
+  static constexpr size_t coalesce_limit = 4096;
+
+  size_t write_buffers(const ceph::bufferlist& bl) override {
+    size_t small_bytes = 0;
+    for (const auto& ptr : bl.buffers()) {
+      if (ptr.length() < coalesce_limit) {
+        small_bytes += ptr.length();
+      }
+    }
+    std::unique_ptr<char[]> staging;
+    size_t staged = 0;
+    bool in_run = false; // whether the last buffer was a small one
+
+    boost::container::small_vector<boost::asio::const_buffer, 16> buffers;
+    for (const auto& ptr : bl.buffers()) {
+      const size_t len = ptr.length();
+      if (len == 0) {
+        continue;
+      }
+      if (len >= coalesce_limit || !in_run) {
+        buffers.emplace_back(ptr.c_str(), len);
+        in_run = len < coalesce_limit;
+        continue;
+      }
+      // a run of small buffers: move it to the staging area and extend it
+      if (!staging) {
+        staging.reset(new char[small_bytes]);
+      }
+      auto& run = buffers.back();
+      auto run_data = static_cast<const char*>(run.data());
+      if (run_data < staging.get() || run_data >= staging.get() + staged) {
+        run_data = static_cast<const char*>(
+            std::memcpy(staging.get() + staged, run_data, run.size()));
+        staged += run.size();
+      }
+      std::memcpy(staging.get() + staged, ptr.c_str(), len);
+      staged += len;
+      run = boost::asio::const_buffer(run_data, run.size() + len);
+    }
+
+    boost::system::error_code ec;
+    auto bytes = boost::asio::async_write(stream, buffers, yield[ec]);
+    if (ec) {
+      ldout(cct, 4) << "write_buffers failed: " << ec.message() << dendl;
+      throw rgw::io::Exception(ec.value(), std::system_category());
+    }
+    return bytes;
+  }
+
   size_t recv_body(char* buf, size_t max) override {
     auto& message = parser.get();
     auto& body_remaining = message.body();
@@ -83,6 +137,11 @@ class StreamIO : public rgw::asio::ClientIO {
 
 using SharedMutex = ceph::async::SharedMutex<boost::asio::io_context::executor_type>;
 
+// lets several sockets bind the same address, for the kernel to balance
+// incoming connections between them
+using reuse_port = boost::asio::detail::socket_option::boolean<
+    SOL_SOCKET, SO_REUSEPORT>;
+
 template <typename Stream>
 void handle_connection(boost::asio::io_context& context,
                        RGWProcessEnv& env, Stream& stream,
@@ -229,32 +288,45 @@ namespace dmc = rgw::dmclock;
 class AsioFrontend {
   RGWProcessEnv env;
   RGWFrontendConfig* conf;
-  boost::asio::io_context context;
+
+  using Executor = boost::asio::io_context::executor_type;
+
+  // an io_context with the threads that run it, and the connections it
+  // accepted. there's a single shard unless io_contexts is configured, in
+  // which case every shard accepts on its own SO_REUSEPORT listeners and
+  // keeps its connections, along with their librados completions
+  struct Shard {
+    boost::asio::io_context context;
+    SharedMutex pause_mutex;
+    bool paused = false; // pause_mutex is held by pause()
+    ConnectionList connections;
+    // work guard to keep run() threads busy while listeners are paused
+    std::optional<boost::asio::executor_work_guard<Executor>> work;
+
+    explicit Shard(int concurrency_hint)
+      : context(concurrency_hint), pause_mutex(context.get_executor()) {}
+  };
+  std::vector<std::unique_ptr<Shard>> shards;
+
 #ifdef WITH_RADOSGW_BEAST_OPENSSL
   boost::optional<ssl::context> ssl_context;
   int init_ssl();
 #endif
-  SharedMutex pause_mutex;
   std::unique_ptr<rgw::dmclock::Scheduler> scheduler;
 
   struct Listener {
+    Shard& shard;
     tcp::endpoint endpoint;
     tcp::acceptor acceptor;
     tcp::socket socket;
     bool use_ssl = false;
     bool use_nodelay = false;
 
-    explicit Listener(boost::asio::io_context& context)
-      : acceptor(context), socket(context) {}
+    explicit Listener(Shard& shard)
+      : shard(shard), acceptor(shard.context), socket(shard.context) {}
   };
   std::vector<Listener> listeners;
 
-  ConnectionList connections;
-
-  // work guard to keep run() threads busy while listeners are paused
-  using Executor = boost::asio::io_context::executor_type;
-  std::optional<boost::asio::executor_work_guard<Executor>> work;
-
   std::vector<std::thread> threads;
   std::atomic<bool> going_down{false};
 
@@ -266,8 +338,29 @@ class AsioFrontend {
  public:
   AsioFrontend(const RGWProcessEnv& env, RGWFrontendConfig* conf,
 	       dmc::SchedulerCtx& sched_ctx)
-    : env(env), conf(conf), pause_mutex(context.get_executor())
+    : env(env), conf(conf)
   {
+    const int thread_count = ctx()->_conf->rgw_thread_pool_size;
+    int shard_count = 1;
+    auto& config = conf->get_config_map();
+    auto contexts = config.find("io_contexts");
+    if (contexts != config.end()) {
+      shard_count = std::atoi(contexts->second.c_str());
+      if (shard_count <= 0) {
+        shard_count = std::thread::hardware_concurrency();
+      }
+    }
+    // every shard needs a thread to run it
+    shard_count = std::clamp(shard_count, 1, std::max(thread_count, 1));
+    const int shard_threads = (thread_count + shard_count - 1) / shard_count;
+    shards.reserve(shard_count);
+    for (int i = 0; i < shard_count; i++) {
+      shards.push_back(std::make_unique<Shard>(shard_threads));
+    }
+    // timers of the dmclock scheduler run on the first shard, its
+    // completions go to the executor of each request
+    auto& context = shards.front()->context;
+
     auto sched_t = dmc::get_scheduler_t(ctx());
     switch(sched_t){
     case dmc::scheduler_t::dmclock:
@@ -278,6 +371,11 @@ class AsioFrontend {
                                               *sched_ctx.get_dmc_client_config(),
                                               dmc::AtLimit::Reject));
       break;
+    case dmc::scheduler_t::dmclock_tenant:
+      scheduler.reset(new dmc::TenantScheduler(ctx(),
+                                               context,
+                                               std::ref(sched_ctx.get_dmc_client_counters())));
+      break;
     case dmc::scheduler_t::none:
       lderr(ctx()) << "Got invalid scheduler type for beast, defaulting to throttler" << dendl;
       [[fallthrough]];
@@ -399,10 +497,10 @@ int AsioFrontend::init()
       lderr(ctx()) << "failed to parse port=" << i->second << dendl;
       return -ec.value();
     }
-    listeners.emplace_back(context);
+    listeners.emplace_back(*shards.front());
     listeners.back().endpoint.port(port);
 
-    listeners.emplace_back(context);
+    listeners.emplace_back(*shards.front());
     listeners.back().endpoint = tcp::endpoint(tcp::v6(), port);
   }
 
@@ -413,7 +511,7 @@ int AsioFrontend::init()
       lderr(ctx()) << "failed to parse endpoint=" << i->second << dendl;
       return -ec.value();
     }
-    listeners.emplace_back(context);
+    listeners.emplace_back(*shards.front());
     listeners.back().endpoint = endpoint;
   }
   // parse tcp nodelay
@@ -423,7 +521,19 @@ int AsioFrontend::init()
       l.use_nodelay = (nodelay->second == "1");
     }
   }
-  
+
+  // the other shards accept on the same endpoints
+  const size_t count = listeners.size();
+  listeners.reserve(count * shards.size());
+  for (auto shard = std::next(shards.begin()); shard != shards.end(); ++shard) {
+    for (size_t i = 0; i < count; i++) {
+      listeners.emplace_back(**shard);
+      auto& l = listeners.back();
+      l.endpoint = listeners[i].endpoint;
+      l.use_ssl = listeners[i].use_ssl;
+      l.use_nodelay = listeners[i].use_nodelay;
+    }
+  }
 
   bool socket_bound = false;
   // start listeners
@@ -450,6 +560,14 @@ int AsioFrontend::init()
     }
 
     l.acceptor.set_option(tcp::acceptor::reuse_address(true));
+    if (shards.size() > 1) {
+      l.acceptor.set_option(reuse_port(true), ec);
+      if (ec) {
+        lderr(ctx()) << "failed to set SO_REUSEPORT socket option: "
+            << ec.message() << dendl;
+        return -ec.value();
+      }
+    }
     l.acceptor.bind(l.endpoint, ec);
     if (ec) {
       lderr(ctx()) << "failed to bind address " << l.endpoint
@@ -532,11 +650,11 @@ int AsioFrontend::init_ssl()
       lderr(ctx()) << "failed to parse ssl_port=" << i->second << dendl;
       return -ec.value();
     }
-    listeners.emplace_back(context);
+    listeners.emplace_back(*shards.front());
     listeners.back().endpoint.port(port);
     listeners.back().use_ssl = true;
 
-    listeners.emplace_back(context);
+    listeners.emplace_back(*shards.front());
     listeners.back().endpoint = tcp::endpoint(tcp::v6(), port);
     listeners.back().use_ssl = true;
   }
@@ -552,7 +670,7 @@ int AsioFrontend::init_ssl()
       lderr(ctx()) << "failed to parse ssl_endpoint=" << i->second << dendl;
       return -ec.value();
     }
-    listeners.emplace_back(context);
+    listeners.emplace_back(*shards.front());
     listeners.back().endpoint = endpoint;
     listeners.back().use_ssl = true;
   }
@@ -577,13 +695,15 @@ void AsioFrontend::accept(Listener& l, boost::system::error_code ec)
                             accept(l, ec);
                           });
 
-  // spawn a coroutine to handle the connection
+  // spawn a coroutine to handle the connection on the shard that accepted
+  // it, so that it's only ever resumed by that shard's threads
+  auto& shard = l.shard;
 #ifdef WITH_RADOSGW_BEAST_OPENSSL
   if (l.use_ssl) {
-    boost::asio::spawn(context,
-      [this, s=std::move(socket)] (boost::asio::yield_context yield) mutable {
+    boost::asio::spawn(shard.context,
+      [this, &shard, s=std::move(socket)] (boost::asio::yield_context yield) mutable {
         Connection conn{s};
-        auto c = connections.add(conn);
+        auto c = shard.connections.add(conn);
         // wrap the socket in an ssl stream
         ssl::stream<tcp::socket&> stream{s, *ssl_context};
         boost::beast::flat_buffer buffer;
@@ -596,8 +716,8 @@ void AsioFrontend::accept(Listener& l, boost::system::error_code ec)
           return;
         }
         buffer.consume(bytes);
-        handle_connection(context, env, stream, buffer, true, pause_mutex,
-                          scheduler.get(), ec, yield);
+        handle_connection(shard.context, env, stream, buffer, true,
+                          shard.pause_mutex, scheduler.get(), ec, yield);
         if (!ec) {
           // ssl shutdown (ignoring errors)
           stream.async_shutdown(yield[ec]);
@@ -608,14 +728,14 @@ void AsioFrontend::accept(Listener& l, boost::system::error_code ec)
 #else
   {
 #endif // WITH_RADOSGW_BEAST_OPENSSL
-    boost::asio::spawn(context,
-      [this, s=std::move(socket)] (boost::asio::yield_context yield) mutable {
+    boost::asio::spawn(shard.context,
+      [this, &shard, s=std::move(socket)] (boost::asio::yield_context yield) mutable {
         Connection conn{s};
-        auto c = connections.add(conn);
+        auto c = shard.connections.add(conn);
         boost::beast::flat_buffer buffer;
         boost::system::error_code ec;
-        handle_connection(context, env, s, buffer, false, pause_mutex,
-                          scheduler.get(), ec, yield);
+        handle_connection(shard.context, env, s, buffer, false,
+                          shard.pause_mutex, scheduler.get(), ec, yield);
         s.shutdown(tcp::socket::shutdown_both, ec);
       });
   }
@@ -627,14 +747,18 @@ int AsioFrontend::run()
   const int thread_count = cct->_conf->rgw_thread_pool_size;
   threads.reserve(thread_count);
 
-  ldout(cct, 4) << "frontend spawning " << thread_count << " threads" << dendl;
+  ldout(cct, 4) << "frontend spawning " << thread_count << " threads for "
+      << shards.size() << " io_contexts" << dendl;
 
   // the worker threads call io_context::run(), which will return when there's
   // no work left. hold a work guard to keep these threads going until join()
-  work.emplace(boost::asio::make_work_guard(context));
+  for (auto& shard : shards) {
+    shard->work.emplace(boost::asio::make_work_guard(shard->context));
+  }
 
   for (int i = 0; i < thread_count; i++) {
-    threads.emplace_back([=] {
+    auto& context = shards[i % shards.size()]->context;
+    threads.emplace_back([&context] {
       // request warnings on synchronous librados calls in this thread
       is_asio_thread = true;
       boost::system::error_code ec;
@@ -656,8 +780,10 @@ void AsioFrontend::stop()
     listener.acceptor.close(ec);
   }
   // close all connections
-  connections.close(ec);
-  pause_mutex.cancel();
+  for (auto& shard : shards) {
+    shard->connections.close(ec);
+    shard->pause_mutex.cancel();
+  }
 }
 
 void AsioFrontend::join()
@@ -665,7 +791,9 @@ void AsioFrontend::join()
   if (!going_down) {
     stop();
   }
-  work.reset();
+  for (auto& shard : shards) {
+    shard->work.reset();
+  }
 
   ldout(ctx(), 4) << "frontend joining threads..." << dendl;
   for (auto& thread : threads) {
@@ -685,10 +813,23 @@ void AsioFrontend::pause()
   }
 
   // pause and wait for outstanding requests to complete
-  pause_mutex.lock(ec);
+  for (auto& shard : shards) {
+    shard->pause_mutex.lock(ec);
+    if (ec) {
+      break;
+    }
+    shard->paused = true;
+  }
 
   if (ec) {
     ldout(ctx(), 1) << "frontend failed to pause: " << ec.message() << dendl;
+    // let the shards that did pause go on serving requests
+    for (auto& shard : shards) {
+      if (shard->paused) {
+        shard->pause_mutex.unlock();
+        shard->paused = false;
+      }
+    }
   } else {
     ldout(ctx(), 4) << "frontend paused" << dendl;
   }
@@ -701,7 +842,12 @@ void AsioFrontend::unpause(RGWRados* const store,
   env.auth_registry = std::move(auth_registry);
 
   // unpause to unblock connections
-  pause_mutex.unlock();
+  for (auto& shard : shards) {
+    if (shard->paused) {
+      shard->pause_mutex.unlock();
+      shard->paused = false;
+    }
+  }
 
   // start accepting connections again
   for (auto& l : listeners) {
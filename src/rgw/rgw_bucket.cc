@@ -1167,7 +1167,7 @@ int RGWBucket::check_object_index(RGWBucketAdminOpState& op_state,
     map<string, rgw_bucket_dir_entry> result;
 
     int r = store->cls_bucket_list_ordered(bucket_info, RGW_NO_SHARD,
-					   marker, prefix, 1000, true,
+					   marker, prefix, string(), 1000, true,
 					   result, &is_truncated, &marker,
 					   bucket_object_check_filter);
     if (r == -ENOENT) {
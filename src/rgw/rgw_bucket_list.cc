@@ -0,0 +1,117 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <algorithm>
+
+#include "rgw_bucket_list.h"
+
+namespace rgw {
+
+BucketListMerge::BucketListMerge(std::map<int, std::string> oids,
+				 uint32_t num_entries,
+				 uint32_t min_shard_entries,
+				 fetch_func&& fetch)
+  : num_entries(std::max(num_entries, 1u)),
+    min_shard_entries(std::max(min_shard_entries, 1u)),
+    fetch(std::move(fetch)),
+    oids(std::move(oids))
+{}
+
+int BucketListMerge::init(const cls_rgw_obj_key& start)
+{
+  const uint32_t num_shards = std::max<size_t>(oids.size(), 1);
+  // twice the share of an even spread, to absorb some skew without a
+  // second round trip
+  const uint32_t page = std::min(
+    num_entries,
+    std::max(min_shard_entries,
+	     2 * ((num_entries + num_shards - 1) / num_shards)));
+
+  std::map<int, rgw_cls_list_ret> results;
+  int r = fetch(start, page, oids, results);
+  if (r < 0) {
+    return r;
+  }
+  ++num_fetches;
+
+  shards.reserve(results.size());
+  for (auto& [id, ret] : results) {
+    shards.push_back(Shard{id, oids[id], page, {}, {}, {}});
+    _set_page(shards.size() - 1, std::move(ret));
+  }
+  return 0;
+}
+
+void BucketListMerge::_set_page(size_t i, rgw_cls_list_ret&& ret)
+{
+  auto& shard = shards[i];
+  shard.ret = std::move(ret);
+  auto& m = shard.ret.dir.m;
+  num_fetched += m.size();
+  shard.cur = m.begin();
+  if (!m.empty()) {
+    shard.last = m.rbegin()->second.key;
+    heads.emplace(shard.cur->first, i);
+  }
+  // a truncated shard always returns entries.  if one didn't, it is
+  // treated as done rather than asked again
+}
+
+int BucketListMerge::_refill(size_t i)
+{
+  auto& shard = shards[i];
+  const uint32_t remaining = consumed < num_entries ?
+    num_entries - consumed : 1;
+  shard.page = std::min(shard.page * 2,
+			std::max(remaining, min_shard_entries));
+
+  std::map<int, std::string> shard_oids{{shard.id, shard.oid}};
+  std::map<int, rgw_cls_list_ret> results;
+  int r = fetch(shard.last, shard.page, shard_oids, results);
+  if (r < 0) {
+    return r;
+  }
+  ++num_fetches;
+  _set_page(i, std::move(results[shard.id]));
+  return 0;
+}
+
+int BucketListMerge::peek(const std::string **key,
+			  rgw_bucket_dir_entry **entry,
+			  const std::string **oid)
+{
+  // the next entry of an exhausted shard may sort before all the heads
+  while (!exhausted.empty()) {
+    int r = _refill(exhausted.back());
+    if (r < 0) {
+      return r;
+    }
+    exhausted.pop_back();
+  }
+  if (heads.empty()) {
+    return -ENOENT;
+  }
+  auto& shard = shards[heads.begin()->second];
+  *key = &shard.cur->first;
+  *entry = &shard.cur->second;
+  *oid = &shard.oid;
+  return 0;
+}
+
+void BucketListMerge::pop()
+{
+  ceph_assert(!heads.empty());
+  const size_t i = heads.begin()->second;
+  heads.erase(heads.begin());
+  ++consumed;
+
+  auto& shard = shards[i];
+  if (++shard.cur != shard.ret.dir.m.end()) {
+    heads.emplace(shard.cur->first, i);
+  } else if (shard.ret.is_truncated) {
+    // only fetch more once the next entry is asked for
+    exhausted.push_back(i);
+  }
+}
+
+} // namespace rgw
@@ -0,0 +1,88 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_RGW_BUCKET_LIST_H
+#define CEPH_RGW_BUCKET_LIST_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cls/rgw/cls_rgw_ops.h"
+
+namespace rgw {
+
+/**
+ * Merges the ordered listings of the shards of a bucket index.
+ *
+ * Object names are hashed to shards, so a shard holds about 1/num_shards
+ * of the entries of any range of names.  Instead of asking every shard for
+ * as many entries as the caller wants, each shard is asked for a small
+ * page at first.  Only a shard whose page ran out while its entries were
+ * still needed is asked for more, with a page twice as large each time,
+ * and nothing is fetched once the caller stops consuming entries.
+ */
+class BucketListMerge {
+ public:
+  /// list up to num_entries entries after start from each of the oids,
+  /// as CLSRGWIssueBucketList does
+  using fetch_func = std::function<int(const cls_rgw_obj_key& start,
+				       uint32_t num_entries,
+				       std::map<int, std::string>& oids,
+				       std::map<int, rgw_cls_list_ret>& results)>;
+
+  BucketListMerge(std::map<int, std::string> oids, uint32_t num_entries,
+		  uint32_t min_shard_entries, fetch_func&& fetch);
+
+  /// fetch the first page of every shard, listing the entries after start
+  int init(const cls_rgw_obj_key& start);
+
+  /// get the next entry in order, fetching more of its shard if needed.
+  /// returns -ENOENT once all shards are exhausted
+  int peek(const std::string **key, rgw_bucket_dir_entry **entry,
+	   const std::string **oid);
+  /// consume the entry returned by peek()
+  void pop();
+
+  /// true if any shard has entries which were not consumed
+  bool is_truncated() const {
+    return !heads.empty() || !exhausted.empty();
+  }
+
+  uint64_t get_num_fetches() const { return num_fetches; }
+  uint64_t get_num_fetched() const { return num_fetched; }
+
+ private:
+  struct Shard {
+    int id;
+    std::string oid;
+    uint32_t page;  ///< entries asked for in the last fetch
+    rgw_cls_list_ret ret;
+    std::map<std::string, rgw_bucket_dir_entry>::iterator cur;
+    cls_rgw_obj_key last;  ///< the last entry fetched, to continue after
+  };
+
+  const uint32_t num_entries;
+  const uint32_t min_shard_entries;
+  const fetch_func fetch;
+  std::map<int, std::string> oids;
+
+  std::vector<Shard> shards;
+  /// the next entry of every shard which has one in memory.  shards may
+  /// share a key when they each return the same common prefix
+  std::multimap<std::string, size_t> heads;
+  /// shards whose page ran out, with more entries on the OSD
+  std::vector<size_t> exhausted;
+  uint32_t consumed = 0;
+
+  uint64_t num_fetches = 0;
+  uint64_t num_fetched = 0;
+
+  void _set_page(size_t i, rgw_cls_list_ret&& ret);
+  int _refill(size_t i);
+};
+
+} // namespace rgw
+
+#endif
@@ -3,22 +3,65 @@
 
 #include "rgw_cache.h"
 #include "rgw_perf_counters.h"
+#include "include/scope_guard.h"
 
 #include <errno.h>
 
 #define dout_subsys ceph_subsys_rgw
 
 
-int ObjectCache::get(const string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cache_entry_info *cache_info)
+// the bytes an entry holds on to, beyond the name and the map node
+static uint64_t entry_size(const string& name, const ObjectCacheInfo& info)
+{
+  uint64_t size = sizeof(ObjectCacheEntry) + name.size() + info.data.length();
+  for (auto& [k, v] : info.xattrs) {
+    size += k.size() + v.length();
+  }
+  return size;
+}
+
+void ObjectCache::set_ctx(CephContext *_cct)
+{
+  cct = _cct;
+  const uint64_t num_shards = std::max<uint64_t>(
+    1, cct->_conf.get_val<uint64_t>("rgw_cache_shards"));
+  shards.clear();
+  for (uint64_t i = 0; i < num_shards; ++i) {
+    shards.emplace_back(new Shard);
+  }
+  shard_max_entries = std::max<uint64_t>(
+    1, cct->_conf->rgw_cache_lru_size / num_shards);
+  shard_max_bytes = cct->_conf.get_val<Option::size_t>(
+    "rgw_cache_max_bytes") / num_shards;
+  expiry = std::chrono::seconds(cct->_conf.get_val<uint64_t>(
+				  "rgw_cache_expiry_interval"));
+}
+
+void ObjectCache::lock_all()
 {
-  RWLock::RLocker l(lock);
+  for (auto& shard : shards) {
+    shard->lock.get_write();
+  }
+}
 
+void ObjectCache::unlock_all()
+{
+  for (auto& shard : shards) {
+    shard->lock.unlock();
+  }
+}
+
+int ObjectCache::get(const string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cache_entry_info *cache_info)
+{
   if (!enabled) {
     return -ENOENT;
   }
 
-  auto iter = cache_map.find(name);
-  if (iter == cache_map.end()) {
+  Shard& shard = get_shard(name);
+  RWLock::RLocker l(shard.lock);
+
+  auto iter = shard.cache_map.find(name);
+  if (iter == shard.cache_map.end()) {
     ldout(cct, 10) << "cache get: name=" << name << " : miss" << dendl;
     if (perfcounter)
       perfcounter->inc(l_rgw_cache_miss);
@@ -27,15 +70,12 @@ int ObjectCache::get(const string& name, ObjectCacheInfo& info, uint32_t mask, r
   if (expiry.count() &&
        (ceph::coarse_mono_clock::now() - iter->second.info.time_added) > expiry) {
     ldout(cct, 10) << "cache get: name=" << name << " : expiry miss" << dendl;
-    lock.unlock();
-    lock.get_write();
+    shard.lock.unlock();
+    shard.lock.get_write();
     // check that wasn't already removed by other thread
-    iter = cache_map.find(name);
-    if (iter != cache_map.end()) {
-      for (auto &kv : iter->second.chained_entries)
-        kv.first->invalidate(kv.second);
-      remove_lru(name, iter->second.lru_iter);
-      cache_map.erase(iter);
+    iter = shard.cache_map.find(name);
+    if (iter != shard.cache_map.end()) {
+      remove_entry(shard, iter);
     }
     if(perfcounter)
       perfcounter->inc(l_rgw_cache_miss);
@@ -43,29 +83,9 @@ int ObjectCache::get(const string& name, ObjectCacheInfo& info, uint32_t mask, r
   }
 
   ObjectCacheEntry *entry = &iter->second;
+  entry->referenced = true;
 
-  if (lru_counter - entry->lru_promotion_ts > lru_window) {
-    ldout(cct, 20) << "cache get: touching lru, lru_counter=" << lru_counter
-                   << " promotion_ts=" << entry->lru_promotion_ts << dendl;
-    lock.unlock();
-    lock.get_write(); /* promote lock to writer */
-
-    /* need to redo this because entry might have dropped off the cache */
-    iter = cache_map.find(name);
-    if (iter == cache_map.end()) {
-      ldout(cct, 10) << "lost race! cache get: name=" << name << " : miss" << dendl;
-      if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
-      return -ENOENT;
-    }
-
-    entry = &iter->second;
-    /* check again, we might have lost a race here */
-    if (lru_counter - entry->lru_promotion_ts > lru_window) {
-      touch_lru(name, *entry, iter->second.lru_iter);
-    }
-  }
-
-  ObjectCacheInfo& src = iter->second.info;
+  ObjectCacheInfo& src = entry->info;
   if ((src.flags & mask) != mask) {
     ldout(cct, 10) << "cache get: name=" << name << " : type miss (requested=0x"
                    << std::hex << mask << ", cached=0x" << src.flags
@@ -90,20 +110,37 @@ int ObjectCache::get(const string& name, ObjectCacheInfo& info, uint32_t mask, r
 bool ObjectCache::chain_cache_entry(std::initializer_list<rgw_cache_entry_info*> cache_info_entries,
 				    RGWChainedCache::Entry *chained_entry)
 {
-  RWLock::WLocker l(lock);
-
   if (!enabled) {
     return false;
   }
 
+  // the entries may live in different shards, lock them all in order
+  std::set<Shard*> locked;
+  for (auto cache_info : cache_info_entries) {
+    locked.insert(&get_shard(cache_info->cache_locator));
+  }
+  std::vector<Shard*> ordered;
+  for (auto& shard : shards) {
+    if (locked.count(shard.get())) {
+      shard->lock.get_write();
+      ordered.push_back(shard.get());
+    }
+  }
+  auto unlock = make_scope_guard([&ordered] {
+    for (auto shard : ordered) {
+      shard->lock.unlock();
+    }
+  });
+
   std::vector<ObjectCacheEntry*> entries;
   entries.reserve(cache_info_entries.size());
   /* first verify that all entries are still valid */
   for (auto cache_info : cache_info_entries) {
     ldout(cct, 10) << "chain_cache_entry: cache_locator="
 		   << cache_info->cache_locator << dendl;
-    auto iter = cache_map.find(cache_info->cache_locator);
-    if (iter == cache_map.end()) {
+    Shard& shard = get_shard(cache_info->cache_locator);
+    auto iter = shard.cache_map.find(cache_info->cache_locator);
+    if (iter == shard.cache_map.end()) {
       ldout(cct, 20) << "chain_cache_entry: couldn't find cache locator" << dendl;
       return false;
     }
@@ -132,8 +169,6 @@ bool ObjectCache::chain_cache_entry(std::initializer_list<rgw_cache_entry_info*>
 
 void ObjectCache::put(const string& name, ObjectCacheInfo& info, rgw_cache_entry_info *cache_info)
 {
-  RWLock::WLocker l(lock);
-
   if (!enabled) {
     return;
   }
@@ -141,23 +176,36 @@ void ObjectCache::put(const string& name, ObjectCacheInfo& info, rgw_cache_entry
   ldout(cct, 10) << "cache put: name=" << name << " info.flags=0x"
                  << std::hex << info.flags << std::dec << dendl;
 
-  auto [iter, inserted] = cache_map.emplace(name, ObjectCacheEntry{});
+  Shard& shard = get_shard(name);
+  RWLock::WLocker l(shard.lock);
+
+  auto [iter, inserted] = shard.cache_map.try_emplace(name);
   ObjectCacheEntry& entry = iter->second;
   entry.info.time_added = ceph::coarse_mono_clock::now();
   if (inserted) {
-    entry.lru_iter = lru.end();
+    entry.name = &iter->first;
+    // behind the hand, so it is the last one the hand gets to
+    shard.clock.insert(shard.hand, entry);
+    ldout(cct, 10) << "adding " << name << " to cache" << dendl;
+  } else {
+    entry.referenced = true;
   }
   ObjectCacheInfo& target = entry.info;
 
-  invalidate_lru(entry);
+  invalidate_chained(entry);
 
   entry.chained_entries.clear();
   entry.gen++;
 
-  touch_lru(name, entry, entry.lru_iter);
-
   target.status = info.status;
 
+  auto account = make_scope_guard([&] {
+    shard.bytes -= entry.size;
+    entry.size = entry_size(name, target);
+    shard.bytes += entry.size;
+    evict(shard, &entry);
+  });
+
   if (info.status < 0) {
     target.flags = 0;
     target.xattrs.clear();
@@ -204,80 +252,61 @@ void ObjectCache::put(const string& name, ObjectCacheInfo& info, rgw_cache_entry
 
 bool ObjectCache::remove(const string& name)
 {
-  RWLock::WLocker l(lock);
-
   if (!enabled) {
     return false;
   }
 
-  auto iter = cache_map.find(name);
-  if (iter == cache_map.end())
+  Shard& shard = get_shard(name);
+  RWLock::WLocker l(shard.lock);
+
+  auto iter = shard.cache_map.find(name);
+  if (iter == shard.cache_map.end())
     return false;
 
   ldout(cct, 10) << "removing " << name << " from cache" << dendl;
-  ObjectCacheEntry& entry = iter->second;
-
-  for (auto& kv : entry.chained_entries) {
-    kv.first->invalidate(kv.second);
-  }
-
-  remove_lru(name, iter->second.lru_iter);
-  cache_map.erase(iter);
+  remove_entry(shard, iter);
   return true;
 }
 
-void ObjectCache::touch_lru(const string& name, ObjectCacheEntry& entry,
-			    std::list<string>::iterator& lru_iter)
+void ObjectCache::evict(Shard& shard, const ObjectCacheEntry *keep)
 {
-  while (lru_size > (size_t)cct->_conf->rgw_cache_lru_size) {
-    auto iter = lru.begin();
-    if ((*iter).compare(name) == 0) {
-      /*
-       * if the entry we're touching happens to be at the lru end, don't remove it,
-       * lru shrinking can wait for next time
-       */
-      break;
+  // every entry but @p keep is passed over at most twice: once to clear
+  // its referenced mark, and once to evict it
+  size_t steps = 2 * shard.clock.size();
+  while ((shard.cache_map.size() > shard_max_entries ||
+	  (shard_max_bytes && shard.bytes > shard_max_bytes)) &&
+	 steps-- > 0) {
+    if (shard.hand == shard.clock.end()) {
+      shard.hand = shard.clock.begin();
     }
-    auto map_iter = cache_map.find(*iter);
-    ldout(cct, 10) << "removing entry: name=" << *iter << " from cache LRU" << dendl;
-    if (map_iter != cache_map.end()) {
-      ObjectCacheEntry& entry = map_iter->second;
-      invalidate_lru(entry);
-      cache_map.erase(map_iter);
+    ObjectCacheEntry& entry = *shard.hand;
+    if (&entry == keep || entry.referenced.exchange(false)) {
+      ++shard.hand;
+      continue;
     }
-    lru.pop_front();
-    lru_size--;
-  }
-
-  if (lru_iter == lru.end()) {
-    lru.push_back(name);
-    lru_size++;
-    lru_iter--;
-    ldout(cct, 10) << "adding " << name << " to cache LRU end" << dendl;
-  } else {
-    ldout(cct, 10) << "moving " << name << " to cache LRU end" << dendl;
-    lru.erase(lru_iter);
-    lru.push_back(name);
-    lru_iter = lru.end();
-    --lru_iter;
+    ldout(cct, 10) << "evicting " << *entry.name << " from cache" << dendl;
+    remove_entry(shard, shard.cache_map.find(*entry.name));
+    if (perfcounter)
+      perfcounter->inc(l_rgw_cache_evict);
   }
-
-  lru_counter++;
-  entry.lru_promotion_ts = lru_counter;
 }
 
-void ObjectCache::remove_lru(const string& name,
-			     std::list<string>::iterator& lru_iter)
+void ObjectCache::remove_entry(Shard& shard,
+			       std::unordered_map<string, ObjectCacheEntry>::iterator iter)
 {
-  if (lru_iter == lru.end())
-    return;
+  ObjectCacheEntry& entry = iter->second;
+  invalidate_chained(entry);
 
-  lru.erase(lru_iter);
-  lru_size--;
-  lru_iter = lru.end();
+  auto clock_iter = shard.clock.iterator_to(entry);
+  if (shard.hand == clock_iter) {
+    ++shard.hand;
+  }
+  shard.clock.erase(clock_iter);
+  shard.bytes -= entry.size;
+  shard.cache_map.erase(iter);
 }
 
-void ObjectCache::invalidate_lru(ObjectCacheEntry& entry)
+void ObjectCache::invalidate_chained(ObjectCacheEntry& entry)
 {
   for (auto iter = entry.chained_entries.begin();
        iter != entry.chained_entries.end(); ++iter) {
@@ -288,43 +317,48 @@ void ObjectCache::invalidate_lru(ObjectCacheEntry& entry)
 
 void ObjectCache::set_enabled(bool status)
 {
-  RWLock::WLocker l(lock);
+  lock_all();
 
   enabled = status;
 
   if (!enabled) {
     do_invalidate_all();
   }
+  unlock_all();
 }
 
 void ObjectCache::invalidate_all()
 {
-  RWLock::WLocker l(lock);
-
+  lock_all();
   do_invalidate_all();
+  unlock_all();
 }
 
 void ObjectCache::do_invalidate_all()
 {
-  cache_map.clear();
-  lru.clear();
-
-  lru_size = 0;
-  lru_counter = 0;
-  lru_window = 0;
+  for (auto& shard : shards) {
+    shard->clock.clear();
+    shard->hand = shard->clock.end();
+    shard->cache_map.clear();
+    shard->bytes = 0;
+  }
 
+  RWLock::RLocker l(chained_lock);
   for (auto& cache : chained_cache) {
     cache->invalidate_all();
   }
 }
 
 void ObjectCache::chain_cache(RGWChainedCache *cache) {
-  RWLock::WLocker l(lock);
+  RWLock::WLocker l(chained_lock);
   chained_cache.push_back(cache);
 }
 
 void ObjectCache::unchain_cache(RGWChainedCache *cache) {
-  RWLock::WLocker l(lock);
+  // no shard may call into the cache once it's unregistered
+  lock_all();
+  auto unlock = make_scope_guard([this] { unlock_all(); });
+  RWLock::WLocker l(chained_lock);
 
   auto iter = chained_cache.begin();
   for (; iter != chained_cache.end(); ++iter) {
@@ -338,8 +372,11 @@ void ObjectCache::unchain_cache(RGWChainedCache *cache) {
 
 ObjectCache::~ObjectCache()
 {
+  for (auto& shard : shards) {
+    // the entries must leave the clock before they are destroyed
+    shard->clock.clear();
+  }
   for (auto cache : chained_cache) {
     cache->unregistered();
   }
 }
-
@@ -13,6 +13,8 @@
 #include "include/ceph_assert.h"
 #include "common/RWLock.h"
 
+#include <boost/intrusive/list.hpp>
+
 enum {
   UPDATE_OBJ,
   REMOVE_OBJ,
@@ -146,37 +148,72 @@ public:
 
 struct ObjectCacheEntry {
   ObjectCacheInfo info;
-  std::list<string>::iterator lru_iter;
-  uint64_t lru_promotion_ts;
-  uint64_t gen;
+  uint64_t gen = 0;
   std::vector<pair<RGWChainedCache *, string> > chained_entries;
 
-  ObjectCacheEntry() : lru_promotion_ts(0), gen(0) {}
+  // the key of the entry in its shard's map
+  const string *name = nullptr;
+  // bytes accounted to the entry against rgw_cache_max_bytes
+  uint64_t size = 0;
+  // set on each hit, cleared when the clock hand passes over the entry
+  std::atomic<bool> referenced = {false};
+  boost::intrusive::list_member_hook<> clock_item;
+
+  ObjectCacheEntry() = default;
 };
 
+/*
+ * The cache is split in shards by the hash of the names, each with its
+ * own lock and its share of the entry and byte limits.  Hits only take a
+ * shard's lock for reading: they mark the entry referenced, and the CLOCK
+ * hand of the shard skips referenced entries, clearing the mark, when
+ * looking for one to evict.
+ */
 class ObjectCache {
-  std::unordered_map<string, ObjectCacheEntry> cache_map;
-  std::list<string> lru;
-  unsigned long lru_size;
-  unsigned long lru_counter;
-  unsigned long lru_window;
-  RWLock lock;
+  typedef boost::intrusive::list<
+    ObjectCacheEntry,
+    boost::intrusive::member_hook<ObjectCacheEntry,
+				  boost::intrusive::list_member_hook<>,
+				  &ObjectCacheEntry::clock_item>> clock_list_t;
+
+  struct Shard {
+    std::unordered_map<string, ObjectCacheEntry> cache_map;
+    clock_list_t clock;
+    clock_list_t::iterator hand = clock.end();
+    uint64_t bytes = 0;
+    RWLock lock;
+
+    Shard() : lock("ObjectCache::Shard::lock") {}
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  uint64_t shard_max_entries = 0;
+  uint64_t shard_max_bytes = 0;
+
+  // protects chained_cache, taken after the shard locks
+  RWLock chained_lock;
   CephContext *cct;
 
   vector<RGWChainedCache *> chained_cache;
 
-  bool enabled;
+  std::atomic<bool> enabled;
   ceph::timespan expiry;
 
-  void touch_lru(const string& name, ObjectCacheEntry& entry,
-		 std::list<string>::iterator& lru_iter);
-  void remove_lru(const string& name, std::list<string>::iterator& lru_iter);
-  void invalidate_lru(ObjectCacheEntry& entry);
+  Shard& get_shard(const string& name) {
+    return *shards[std::hash<string>{}(name) % shards.size()];
+  }
+  void lock_all();
+  void unlock_all();
+
+  void evict(Shard& shard, const ObjectCacheEntry *keep);
+  void remove_entry(Shard& shard,
+		    std::unordered_map<string, ObjectCacheEntry>::iterator iter);
+  void invalidate_chained(ObjectCacheEntry& entry);
 
   void do_invalidate_all();
 
 public:
-  ObjectCache() : lru_size(0), lru_counter(0), lru_window(0), lock("ObjectCache"), cct(NULL), enabled(false) { }
+  ObjectCache() : chained_lock("ObjectCache::chained_lock"), cct(NULL), enabled(false) { }
   ~ObjectCache();
   int get(const std::string& name, ObjectCacheInfo& bl, uint32_t mask, rgw_cache_entry_info *cache_info);
   std::optional<ObjectCacheInfo> get(const std::string& name) {
@@ -187,10 +224,13 @@ public:
 
   template<typename F>
   void for_each(const F& f) {
-    RWLock::RLocker l(lock);
-    if (enabled) {
-      auto now  = ceph::coarse_mono_clock::now();
-      for (const auto& [name, entry] : cache_map) {
+    if (!enabled) {
+      return;
+    }
+    auto now  = ceph::coarse_mono_clock::now();
+    for (auto& shard : shards) {
+      RWLock::RLocker l(shard->lock);
+      for (const auto& [name, entry] : shard->cache_map) {
         if (expiry.count() && (now - entry.info.time_added) < expiry) {
           f(name, entry);
         }
@@ -200,12 +240,7 @@ public:
 
   void put(const std::string& name, ObjectCacheInfo& bl, rgw_cache_entry_info *cache_info);
   bool remove(const std::string& name);
-  void set_ctx(CephContext *_cct) {
-    cct = _cct;
-    lru_window = cct->_conf->rgw_cache_lru_size / 2;
-    expiry = std::chrono::seconds(cct->_conf.get_val<uint64_t>(
-						"rgw_cache_expiry_interval"));
-  }
+  void set_ctx(CephContext *_cct);
   bool chain_cache_entry(std::initializer_list<rgw_cache_entry_info*> cache_info_entries,
 			 RGWChainedCache::Entry *chained_entry);
 
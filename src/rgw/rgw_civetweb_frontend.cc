@@ -27,6 +27,10 @@ RGWCivetWebFrontend::RGWCivetWebFrontend(RGWProcessEnv& env,
   case dmc::scheduler_t::none: [[fallthrough]];
   case dmc::scheduler_t::throttler:
     break;
+  case dmc::scheduler_t::dmclock_tenant:
+    lderr(cct()) << "the dmclock-tenant scheduler is only supported by beast, "
+        "civetweb requests will not be scheduled" << dendl;
+    break;
   case dmc::scheduler_t::dmclock:
     // TODO: keep track of server ready state and use that here civetweb
     // internally tracks in the ctx the threads used and free, while it is
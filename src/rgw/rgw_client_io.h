@@ -147,6 +147,18 @@ public:
    * of response's body. On failure throws rgw::io::Exception. */
   virtual size_t send_body(const char* buf, size_t len) = 0;
 
+  /* Generate a part of response's body from all buffers of @bl. Front-ends
+   * able to write a scatter-gather list override this to send @bl without
+   * copying it; by default each buffer goes through send_body() in turn.
+   * On failure throws rgw::io::Exception. */
+  virtual size_t send_body_buffers(const ceph::bufferlist& bl) {
+    size_t sent = 0;
+    for (const auto& ptr : bl.buffers()) {
+      sent += send_body(ptr.c_str(), ptr.length());
+    }
+    return sent;
+  }
+
   /* Flushes all already generated data to a direct client of RadosGW.
    * On failure throws rgw::io::Exception containing errno. */
   virtual void flush() = 0;
@@ -241,6 +253,10 @@ public:
     return get_decoratee().send_body(buf, len);
   }
 
+  size_t send_body_buffers(const ceph::bufferlist& bl) override {
+    return get_decoratee().send_body_buffers(bl);
+  }
+
   void flush() override {
     return get_decoratee().flush();
   }
@@ -122,6 +122,17 @@ public:
     return sent;
   }
 
+  size_t send_body_buffers(const ceph::bufferlist& bl) override {
+    const auto sent = DecoratedRestfulClient<T>::send_body_buffers(bl);
+    lsubdout(cct, rgw, 30) << "AccountingFilter::send_body_buffers: e="
+        << (enabled ? "1" : "0") << ", sent=" << sent << ", total="
+        << total_sent << dendl;
+    if (enabled) {
+      total_sent += sent;
+    }
+    return sent;
+  }
+
   size_t complete_request() override {
     const auto sent = DecoratedRestfulClient<T>::complete_request();
     lsubdout(cct, rgw, 30) << "AccountingFilter::complete_request: e="
@@ -173,6 +184,7 @@ public:
   size_t send_chunked_transfer_encoding() override;
   size_t complete_header() override;
   size_t send_body(const char* buf, size_t len) override;
+  size_t send_body_buffers(const ceph::bufferlist& bl) override;
   size_t complete_request() override;
 };
 
@@ -191,6 +203,21 @@ size_t BufferingFilter<T>::send_body(const char* const buf,
   return DecoratedRestfulClient<T>::send_body(buf, len);
 }
 
+template <typename T>
+size_t BufferingFilter<T>::send_body_buffers(const ceph::bufferlist& bl)
+{
+  if (buffer_data) {
+    /* Only the references are taken, the data isn't copied. */
+    data.append(bl);
+
+    lsubdout(cct, rgw, 30) << "BufferingFilter<T>::send_body_buffers: defer count = "
+        << bl.length() << dendl;
+    return 0;
+  }
+
+  return DecoratedRestfulClient<T>::send_body_buffers(bl);
+}
+
 template <typename T>
 size_t BufferingFilter<T>::send_content_length(const uint64_t len)
 {
@@ -238,12 +265,9 @@ size_t BufferingFilter<T>::complete_request()
   }
 
   if (buffer_data) {
-    /* We are sending each buffer separately to avoid extra memory shuffling
+    /* We are sending the buffers as they are to avoid extra memory shuffling
      * that would occur on data.c_str() to provide a continuous memory area. */
-    for (const auto& ptr : data.buffers()) {
-      sent += DecoratedRestfulClient<T>::send_body(ptr.c_str(),
-                                                   ptr.length());
-    }
+    sent += DecoratedRestfulClient<T>::send_body_buffers(data);
     data.clear();
     buffer_data = false;
     lsubdout(cct, rgw, 30) << "BufferingFilter::complete_request: buffer_data: sent="
@@ -302,6 +326,25 @@ public:
     }
   }
 
+  size_t send_body_buffers(const ceph::bufferlist& bl) override {
+    if (! chunking_enabled) {
+      return DecoratedRestfulClient<T>::send_body_buffers(bl);
+    } else {
+      static constexpr char HEADER_END[] = "\r\n";
+      char chunk_size[32];
+      const auto chunk_size_len = snprintf(chunk_size, sizeof(chunk_size),
+                                           "%" PRIx64 "\r\n",
+                                           uint64_t(bl.length()));
+      size_t sent = 0;
+
+      sent += DecoratedRestfulClient<T>::send_body(chunk_size, chunk_size_len);
+      sent += DecoratedRestfulClient<T>::send_body_buffers(bl);
+      sent += DecoratedRestfulClient<T>::send_body(HEADER_END,
+                                                   sizeof(HEADER_END) - 1);
+      return sent;
+    }
+  }
+
   size_t complete_request() override {
     size_t sent = 0;
 
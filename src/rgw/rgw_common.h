@@ -113,6 +113,9 @@ using ceph::crypto::MD5;
 #define RGW_ATTR_IAM_POLICY	RGW_ATTR_PREFIX "iam-policy"
 #define RGW_ATTR_USER_POLICY    RGW_ATTR_PREFIX "user-policy"
 
+/* dmclock-tenant scheduler: "res:wgt:lim" of the user's tenant */
+#define RGW_ATTR_DMCLOCK_QOS    RGW_ATTR_PREFIX "dmclock-qos"
+
 /* RGW File Attributes */
 #define RGW_ATTR_UNIX_KEY1      RGW_ATTR_PREFIX "unix-key1"
 #define RGW_ATTR_UNIX1          RGW_ATTR_PREFIX "unix1"
@@ -515,6 +518,7 @@ enum RGWOpType {
   RGW_OP_PUBSUB_NOTIF_CREATE,
   RGW_OP_PUBSUB_NOTIF_DELETE,
   RGW_OP_PUBSUB_NOTIF_LIST,
+  RGW_OP_SELECT_OBJ_CONTENT,
 };
 
 class RGWAccessControlPolicy;
@@ -1333,6 +1337,7 @@ enum RGWBucketFlags {
   BUCKET_VERSIONS_SUSPENDED = 0x4,
   BUCKET_DATASYNC_DISABLED = 0X8,
   BUCKET_MFA_ENABLED = 0X10,
+  BUCKET_INLINE_DATA = 0x20, /* small objects may be stored in their index entry */
 };
 
 enum RGWBucketIndexType {
@@ -1503,6 +1508,7 @@ struct RGWBucketInfo {
   bool versioning_enabled() const { return (versioning_status() & (BUCKET_VERSIONED | BUCKET_VERSIONS_SUSPENDED)) == BUCKET_VERSIONED; }
   bool mfa_enabled() const { return (versioning_status() & BUCKET_MFA_ENABLED) != 0; }
   bool datasync_flag_enabled() const { return (flags & BUCKET_DATASYNC_DISABLED) == 0; }
+  bool inline_data_enabled() const { return (flags & BUCKET_INLINE_DATA) != 0; }
 
   bool has_swift_versioning() const {
     /* A bucket may be versioned through one mechanism only. */
@@ -7,41 +7,68 @@
 
 //------------RGWPutObj_Compress---------------
 
+RGWPutObj_Compress::RGWPutObj_Compress(CephContext* cct_,
+                                       CompressorRef compressor,
+                                       rgw::putobj::DataProcessor *next,
+                                       rgw::putobj::TransformPool *pool,
+                                       size_t max_pending,
+                                       optional_yield y)
+  : Pipe(next), cct(cct_), compressor(compressor),
+    queue(pool, max_pending,
+          [this] (int r, bufferlist&& in, bufferlist&& out, uint64_t ofs) {
+            return handle_compressed(r, std::move(in), std::move(out), ofs);
+          }, y)
+{}
+
 int RGWPutObj_Compress::process(bufferlist&& in, uint64_t logical_offset)
 {
-  bufferlist out;
-  if (in.length() > 0) {
-    // compression stuff
-    if ((logical_offset > 0 && compressed) || // if previous part was compressed
-        (logical_offset == 0)) {              // or it's the first part
-      ldout(cct, 10) << "Compression for rgw is enabled, compress part " << in.length() << dendl;
-      int cr = compressor->compress(in, out);
-      if (cr < 0) {
-        if (logical_offset > 0) {
-          lderr(cct) << "Compression failed with exit code " << cr
-              << " for next part, compression process failed" << dendl;
-          return -EIO;
-        }
-        compressed = false;
-        ldout(cct, 5) << "Compression failed with exit code " << cr
-            << " for first part, storing uncompressed" << dendl;
-        out.claim(in);
-      } else {
-        compressed = true;
-    
-        compression_block newbl;
-        size_t bs = blocks.size();
-        newbl.old_ofs = logical_offset;
-        newbl.new_ofs = bs > 0 ? blocks[bs-1].len + blocks[bs-1].new_ofs : 0;
-        newbl.len = out.length();
-        blocks.push_back(newbl);
-      }
-    } else {
-      compressed = false;
-      out.claim(in);
+  if (in.length() == 0) {
+    int r = queue.drain();
+    if (r < 0) {
+      return r;
     }
-    // end of compression stuff
+    return Pipe::process({}, logical_offset);
   }
+  if (skip) {
+    return queue.submit(std::move(in), logical_offset, nullptr);
+  }
+  ldout(cct, 10) << "Compression for rgw is enabled, compress part " << in.length() << dendl;
+  return queue.submit(std::move(in), logical_offset,
+                      [c = compressor] (bufferlist& in, bufferlist& out) {
+                        return c->compress(in, out);
+                      });
+}
+
+// called in order for each part
+int RGWPutObj_Compress::handle_compressed(int r, bufferlist&& in,
+                                          bufferlist&& out,
+                                          uint64_t logical_offset)
+{
+  if (logical_offset > 0 && !compressed) {
+    // the first part was stored uncompressed, and so must the rest. parts
+    // already queued when that was found are compressed for nothing
+    return Pipe::process(std::move(in), logical_offset);
+  }
+  if (r < 0) {
+    if (logical_offset > 0) {
+      lderr(cct) << "Compression failed with exit code " << r
+          << " for next part, compression process failed" << dendl;
+      return -EIO;
+    }
+    skip = true;
+    ldout(cct, 5) << "Compression failed with exit code " << r
+        << " for first part, storing uncompressed" << dendl;
+    return Pipe::process(std::move(in), logical_offset);
+  }
+  compressed = true;
+
+  compression_block newbl;
+  size_t bs = blocks.size();
+  newbl.old_ofs = logical_offset;
+  newbl.new_ofs = bs > 0 ? blocks[bs-1].len + blocks[bs-1].new_ofs : 0;
+  newbl.len = out.length();
+  blocks.push_back(newbl);
+
   return Pipe::process(std::move(out), logical_offset);
 }
 
@@ -8,6 +8,7 @@
 
 #include "compressor/Compressor.h"
 #include "rgw_putobj.h"
+#include "rgw_putobj_transform.h"
 #include "rgw_op.h"
 
 class RGWGetObj_Decompress : public RGWGetObj_Filter
@@ -36,12 +37,22 @@ class RGWPutObj_Compress : public rgw::putobj::Pipe
 {
   CephContext* cct;
   bool compressed{false};
+  bool skip{false}; // the first part failed to compress, store the rest as-is
   CompressorRef compressor;
   std::vector<compression_block> blocks;
+  rgw::putobj::TransformQueue queue;
+
+  int handle_compressed(int r, bufferlist&& in, bufferlist&& out,
+                        uint64_t logical_offset);
 public:
+  // with a pool, consecutive parts are compressed concurrently and up to
+  // max_pending of them are buffered. with a yield context, waiting for
+  // them suspends the request's coroutine
   RGWPutObj_Compress(CephContext* cct_, CompressorRef compressor,
-                     rgw::putobj::DataProcessor *next)
-    : Pipe(next), cct(cct_), compressor(compressor) {}
+                     rgw::putobj::DataProcessor *next,
+                     rgw::putobj::TransformPool *pool = nullptr,
+                     size_t max_pending = 1,
+                     optional_yield y = null_yield);
 
   int process(bufferlist&& data, uint64_t logical_offset) override;
 
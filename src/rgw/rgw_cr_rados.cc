@@ -787,6 +787,38 @@ int RGWRadosTimelogAddCR::request_complete()
   return r;
 }
 
+RGWRadosTimelogListCR::RGWRadosTimelogListCR(RGWRados *_store, const string& _oid,
+                                             const string& _marker, int _max_entries,
+                                             list<cls_log_entry> *_entries,
+                                             string *_out_marker, bool *_truncated)
+  : RGWSimpleCoroutine(_store->ctx()), store(_store), oid(_oid),
+    marker(_marker), max_entries(_max_entries), entries(_entries),
+    out_marker(_out_marker), truncated(_truncated)
+{
+  set_description() << "timelog list oid=" << oid << " marker=" << marker
+      << " max_entries=" << max_entries;
+}
+
+int RGWRadosTimelogListCR::send_request()
+{
+  set_status() << "sending request";
+
+  entries->clear();
+  cn = stack->create_completion_notifier();
+  return store->time_log_list(oid, real_time{}, real_time{}, max_entries,
+                              *entries, marker, out_marker, truncated,
+                              cn->completion());
+}
+
+int RGWRadosTimelogListCR::request_complete()
+{
+  int r = cn->completion()->get_return_value();
+
+  set_status() << "request complete; ret=" << r;
+
+  return r;
+}
+
 RGWRadosTimelogTrimCR::RGWRadosTimelogTrimCR(RGWRados *store,
                                              const std::string& oid,
                                              const real_time& start_time,
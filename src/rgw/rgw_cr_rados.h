@@ -1263,6 +1263,27 @@ public:
   int request_complete() override;
 };
 
+class RGWRadosTimelogListCR : public RGWSimpleCoroutine {
+  RGWRados *store;
+  string oid;
+  string marker;
+  int max_entries;
+  list<cls_log_entry> *entries;
+  string *out_marker;
+  bool *truncated;
+
+  boost::intrusive_ptr<RGWAioCompletionNotifier> cn;
+
+public:
+  RGWRadosTimelogListCR(RGWRados *_store, const string& _oid,
+                        const string& _marker, int _max_entries,
+                        list<cls_log_entry> *_entries, string *_out_marker,
+                        bool *_truncated);
+
+  int send_request() override;
+  int request_complete() override;
+};
+
 class RGWRadosTimelogTrimCR : public RGWSimpleCoroutine {
   RGWRados *store;
   boost::intrusive_ptr<RGWAioCompletionNotifier> cn;
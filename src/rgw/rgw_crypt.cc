@@ -201,8 +201,16 @@ private:
   static const uint8_t IV[AES_256_IVSIZE];
   CephContext* cct;
   uint8_t key[AES_256_KEYSIZE];
+  CryptoAccelRef crypto_accel; /* looked up once, encrypt() may run on many threads */
 public:
   explicit AES_256_CBC(CephContext* cct): cct(cct) {
+    static std::atomic<bool> failed_to_get_crypto(false);
+    if (! failed_to_get_crypto.load())
+    {
+      crypto_accel = get_crypto_accel(cct);
+      if (!crypto_accel)
+        failed_to_get_crypto = true;
+    }
   }
   ~AES_256_CBC() {
     memset(key, 0, AES_256_KEYSIZE);
@@ -285,14 +293,6 @@ public:
                      const unsigned char (&key)[AES_256_KEYSIZE],
                      bool encrypt)
   {
-    static std::atomic<bool> failed_to_get_crypto(false);
-    CryptoAccelRef crypto_accel;
-    if (! failed_to_get_crypto.load())
-    {
-      crypto_accel = get_crypto_accel(cct);
-      if (!crypto_accel)
-        failed_to_get_crypto = true;
-    }
     bool result = true;
     unsigned char iv[AES_256_IVSIZE];
     for (size_t offset = 0; result && (offset < size); offset += CHUNK_SIZE) {
@@ -680,11 +680,21 @@ int RGWGetObj_BlockDecrypt::flush() {
 
 RGWPutObj_BlockEncrypt::RGWPutObj_BlockEncrypt(CephContext* cct,
                                                rgw::putobj::DataProcessor *next,
-                                               std::unique_ptr<BlockCrypt> crypt)
+                                               std::unique_ptr<BlockCrypt> crypt,
+                                               rgw::putobj::TransformPool *pool,
+                                               size_t max_pending,
+                                               optional_yield y)
   : Pipe(next),
     cct(cct),
     crypt(std::move(crypt)),
-    block_size(this->crypt->get_block_size())
+    block_size(this->crypt->get_block_size()),
+    queue(pool, max_pending,
+          [this] (int r, bufferlist&& in, bufferlist&& out, uint64_t ofs) {
+            if (r < 0) {
+              return r;
+            }
+            return Pipe::process(std::move(out), ofs);
+          }, y)
 {
 }
 
@@ -704,18 +714,25 @@ int RGWPutObj_BlockEncrypt::process(bufferlist&& data, uint64_t logical_offset)
     proc_size = cache.length();
   }
   if (proc_size > 0) {
-    bufferlist in, out;
+    bufferlist in;
     cache.splice(0, proc_size, &in);
-    if (!crypt->encrypt(in, 0, proc_size, out, logical_offset)) {
-      return -ERR_INTERNAL_ERROR;
-    }
-    int r = Pipe::process(std::move(out), logical_offset);
+    /* BlockCrypt is stateless, parts can be encrypted concurrently */
+    int r = queue.submit(std::move(in), logical_offset,
+                         [this, logical_offset] (bufferlist& in, bufferlist& out) {
+                           if (!crypt->encrypt(in, 0, in.length(), out, logical_offset)) {
+                             return -ERR_INTERNAL_ERROR;
+                           }
+                           return 0;
+                         });
     logical_offset += proc_size;
     if (r < 0)
       return r;
   }
 
   if (flush) {
+    int r = queue.drain();
+    if (r < 0)
+      return r;
     /*replicate 0-sized handle_data*/
     return Pipe::process({}, logical_offset);
   }
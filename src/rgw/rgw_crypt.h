@@ -12,6 +12,7 @@
 #include <rgw/rgw_rest.h>
 #include <rgw/rgw_rest_s3.h>
 #include "rgw_putobj.h"
+#include "rgw_putobj_transform.h"
 #include <boost/utility/string_view.hpp>
 
 /**
@@ -125,10 +126,19 @@ class RGWPutObj_BlockEncrypt : public rgw::putobj::Pipe
                                           for operations when enough data is accumulated */
   bufferlist cache; /**< stores extra data that could not (yet) be processed by BlockCrypt */
   const size_t block_size; /**< snapshot of \ref BlockCrypt.get_block_size() */
+  rgw::putobj::TransformQueue queue; /**< encrypts on a pool, declared last so it drains first */
 public:
+  /**
+   * With a \ref pool, consecutive parts are encrypted concurrently,
+   * with up to \ref max_pending of them buffered. With a yield context
+   * \ref y, waiting for them suspends the request's coroutine.
+   */
   RGWPutObj_BlockEncrypt(CephContext* cct,
                          rgw::putobj::DataProcessor *next,
-                         std::unique_ptr<BlockCrypt> crypt);
+                         std::unique_ptr<BlockCrypt> crypt,
+                         rgw::putobj::TransformPool *pool = nullptr,
+                         size_t max_pending = 1,
+                         optional_yield y = null_yield);
 
   int process(bufferlist&& data, uint64_t logical_offset) override;
 }; /* RGWPutObj_BlockEncrypt */
@@ -2412,6 +2412,7 @@ class RGWListBucketShardCR: public RGWCoroutine {
   const rgw_bucket_shard& bs;
   const string instance_key;
   rgw_obj_key marker_position;
+  const string max_keys;
 
   bucket_list_result *result;
 
@@ -2420,6 +2421,7 @@ public:
                        rgw_obj_key& _marker_position, bucket_list_result *_result)
     : RGWCoroutine(_sync_env->cct), sync_env(_sync_env), bs(bs),
       instance_key(bs.get_key()), marker_position(_marker_position),
+      max_keys(std::to_string(cct->_conf.get_val<uint64_t>("rgw_bucket_full_sync_list_max_keys"))),
       result(_result) {}
 
   int operate() override {
@@ -2431,6 +2433,7 @@ public:
 					{ "objs-container" , "true" },
 					{ "key-marker" , marker_position.name.c_str() },
 					{ "version-id-marker" , marker_position.instance.c_str() },
+					{ "max-keys" , max_keys.c_str() },
 	                                { NULL, NULL } };
         // don't include tenant in the url, it's already part of instance_key
         string p = string("/") + bs.bucket.name;
@@ -2499,10 +2502,9 @@ class RGWBucketFullSyncShardMarkerTrack : public RGWSyncShardMarkerTrack<rgw_obj
 public:
   RGWBucketFullSyncShardMarkerTrack(RGWDataSyncEnv *_sync_env,
                          const string& _marker_oid,
-                         const rgw_bucket_shard_full_sync_marker& _marker) : RGWSyncShardMarkerTrack(BUCKET_SYNC_UPDATE_MARKER_WINDOW),
-                                                                sync_env(_sync_env),
-                                                                marker_oid(_marker_oid),
-                                                                sync_marker(_marker) {}
+                         const rgw_bucket_shard_full_sync_marker& _marker)
+    : RGWSyncShardMarkerTrack(_sync_env->cct->_conf.get_val<uint64_t>("rgw_bucket_full_sync_marker_window")),
+      sync_env(_sync_env), marker_oid(_marker_oid), sync_marker(_marker) {}
 
   void set_tn(RGWSyncTraceNodeRef& _tn) {
     tn = _tn;
@@ -2736,6 +2738,9 @@ public:
         tn->unset_flag(RGW_SNS_FLAG_ACTIVE);
         if (retcode >= 0) {
           tn->log(10, "success");
+          if (sync_env->counters) {
+            sync_env->counters->inc(sync_counters::l_bucket_sync_objects);
+          }
         } else {
           tn->log(10, SSTR("failed, retcode=" << retcode << " (" << cpp_strerror(-retcode) << ")"));
         }
@@ -2790,6 +2795,17 @@ class RGWBucketShardFullSyncCR : public RGWCoroutine {
   rgw_zone_set zones_trace;
 
   RGWSyncTraceNodeRef tn;
+
+  RGWSyncSpawnWindow spawn_window;
+  unsigned reported_window{0};
+  std::map<RGWCoroutinesStack*, ceph::mono_time> spawn_times;
+
+  ceph::mono_time start_time;
+  uint64_t synced_entries{0};
+
+  void report_window(unsigned window);
+  void update_spawn_window(ceph::timespan latency);
+  void collect_children();
 public:
   RGWBucketShardFullSyncCR(RGWDataSyncEnv *_sync_env, const rgw_bucket_shard& bs,
                            RGWBucketInfo *_bucket_info,
@@ -2802,21 +2818,107 @@ public:
       marker_tracker(sync_env, status_oid, sync_info.full_marker),
       status_oid(status_oid),
       tn(sync_env->sync_tracer->add_node(tn_parent, "full_sync",
-                                         SSTR(bucket_shard_str{bs}))) {
+                                         SSTR(bucket_shard_str{bs}))),
+      spawn_window(cct->_conf.get_val<uint64_t>("rgw_bucket_full_sync_min_spawn_window"),
+                   cct->_conf.get_val<uint64_t>("rgw_bucket_full_sync_max_spawn_window")) {
     zones_trace.insert(sync_env->source_zone);
     marker_tracker.set_tn(tn);
   }
+  ~RGWBucketShardFullSyncCR() override {
+    report_window(0);
+  }
 
   int operate() override;
 };
 
-int RGWBucketShardFullSyncCR::operate()
+bool RGWSyncSpawnWindow::update(ceph::timespan latency)
+{
+  min_latency = std::min(min_latency, latency);
+  if (avg_latency == ceph::timespan::zero()) {
+    avg_latency = latency;
+  } else {
+    avg_latency = (avg_latency * 7 + latency) / 8;
+  }
+  if (++completions < window) {
+    return false;
+  }
+  completions = 0;
+  const unsigned old_window = window;
+  if (avg_latency < min_latency * 2) {
+    window = std::min(max_window, window + std::max(1u, window / 8));
+  } else {
+    window = std::max(min_window, window * 3 / 4);
+  }
+  return window != old_window;
+}
+
+// the gauges hold the sum over the shards in full sync, so each shard
+// adds the change of its own window, and takes it back when it's done
+void RGWBucketShardFullSyncCR::report_window(unsigned window)
+{
+  if (!sync_env->counters || window == reported_window) {
+    return;
+  }
+  if (reported_window == 0) {
+    sync_env->counters->inc(sync_counters::l_bucket_full_sync_shards);
+  } else if (window == 0) {
+    sync_env->counters->dec(sync_counters::l_bucket_full_sync_shards);
+  }
+  if (window > reported_window) {
+    sync_env->counters->inc(sync_counters::l_bucket_full_sync_window,
+                            window - reported_window);
+  } else {
+    sync_env->counters->dec(sync_counters::l_bucket_full_sync_window,
+                            reported_window - window);
+  }
+  reported_window = window;
+}
+
+void RGWBucketShardFullSyncCR::update_spawn_window(ceph::timespan latency)
+{
+  if (sync_env->counters) {
+    sync_env->counters->tinc(sync_counters::l_bucket_full_sync_latency, latency);
+  }
+  const unsigned old_window = spawn_window.get();
+  if (spawn_window.update(latency)) {
+    tn->log(20, SSTR("spawn window " << old_window << " -> " << spawn_window.get()
+        << " avg_latency=" << spawn_window.get_avg_latency()
+        << " min_latency=" << spawn_window.get_min_latency()));
+    report_window(spawn_window.get());
+  }
+}
+
+void RGWBucketShardFullSyncCR::collect_children()
 {
   int ret;
+  RGWCoroutinesStack *stack;
+  while (collect_next(&ret, &stack)) {
+    if (ret < 0) {
+      tn->log(10, "a sync operation returned error");
+      sync_status = ret;
+      /* we have reported this error */
+    }
+    auto i = spawn_times.find(stack);
+    if (i == spawn_times.end()) {
+      continue;
+    }
+    const auto latency = ceph::mono_clock::now() - i->second;
+    spawn_times.erase(i);
+    if (ret >= 0) {
+      ++synced_entries;
+      update_spawn_window(latency);
+    }
+  }
+}
+
+int RGWBucketShardFullSyncCR::operate()
+{
   reenter(this) {
     list_marker = sync_info.full_marker.position;
 
     total_entries = sync_info.full_marker.count;
+    start_time = ceph::mono_clock::now();
+    report_window(spawn_window.get());
     do {
       if (!lease_cr->is_locked()) {
         drain_all();
@@ -2849,24 +2951,19 @@ int RGWBucketShardFullSyncCR::operate()
           tn->log(0, SSTR("ERROR: cannot start syncing " << entry->key << ". Duplicate entry?"));
         } else {
           using SyncCR = RGWBucketSyncSingleEntryCR<rgw_obj_key, rgw_obj_key>;
-          yield spawn(new SyncCR(sync_env, bucket_info, bs, entry->key,
-                                 false, /* versioned, only matters for object removal */
-                                 entry->versioned_epoch, entry->mtime,
-                                 entry->owner, entry->get_modify_op(), CLS_RGW_STATE_COMPLETE,
-                                 entry->key, &marker_tracker, zones_trace, tn),
-                      false);
+          yield {
+            auto stack = spawn(new SyncCR(sync_env, bucket_info, bs, entry->key,
+                                          false, /* versioned, only matters for object removal */
+                                          entry->versioned_epoch, entry->mtime,
+                                          entry->owner, entry->get_modify_op(), CLS_RGW_STATE_COMPLETE,
+                                          entry->key, &marker_tracker, zones_trace, tn),
+                               false);
+            spawn_times[stack] = ceph::mono_clock::now();
+          }
         }
-        while (num_spawned() > BUCKET_SYNC_SPAWN_WINDOW) {
+        while (num_spawned() > spawn_window.get()) {
           yield wait_for_child();
-          bool again = true;
-          while (again) {
-            again = collect(&ret, nullptr);
-            if (ret < 0) {
-              tn->log(10, "a sync operation returned error");
-              sync_status = ret;
-              /* we have reported this error */
-            }
-          }
+          collect_children();
         }
       }
     } while (list_result.is_truncated && sync_status == 0);
@@ -2874,17 +2971,21 @@ int RGWBucketShardFullSyncCR::operate()
     /* wait for all operations to complete */
     while (num_spawned()) {
       yield wait_for_child();
-      bool again = true;
-      while (again) {
-        again = collect(&ret, nullptr);
-        if (ret < 0) {
-          tn->log(10, "a sync operation returned error");
-          sync_status = ret;
-          /* we have reported this error */
-        }
-      }
+      collect_children();
     }
     tn->unset_flag(RGW_SNS_FLAG_ACTIVE);
+    {
+      const auto elapsed = ceph::mono_clock::now() - start_time;
+      const double secs = std::chrono::duration<double>(elapsed).count();
+      const uint64_t rate = secs > 0 ? synced_entries / secs : 0;
+      tn->log(5, SSTR("full sync synced " << synced_entries << " objects in "
+          << secs << "s (" << rate << " objects/s), spawn window "
+          << spawn_window.get()));
+      if (sync_env->counters) {
+        sync_env->counters->inc(sync_counters::l_bucket_full_sync_rate, rate);
+      }
+      report_window(0);
+    }
     if (!lease_cr->is_locked()) {
       return set_cr_error(-ECANCELED);
     }
@@ -3129,6 +3230,13 @@ int RGWBucketShardIncrementalSyncCR::operate()
               versioned_epoch = entry->ver.epoch;
             }
             tn->log(20, SSTR("entry->timestamp=" << entry->timestamp));
+            if (sync_env->counters && !real_clock::is_zero(entry->timestamp)) {
+              const auto now = real_clock::now();
+              if (now > entry->timestamp) {
+                sync_env->counters->tinc(sync_counters::l_bucket_inc_sync_lag,
+                                         now - entry->timestamp);
+              }
+            }
             using SyncCR = RGWBucketSyncSingleEntryCR<string, rgw_obj_key>;
             spawn(new SyncCR(sync_env, bucket_info, bs, key,
                              entry->is_versioned(), versioned_epoch,
@@ -483,6 +483,34 @@ struct rgw_bucket_shard_sync_info {
 };
 WRITE_CLASS_ENCODER(rgw_bucket_shard_sync_info)
 
+/*
+ * the number of object syncs a bucket shard keeps in flight in full sync.
+ * it adapts to their latency: it grows while the smoothed latency stays
+ * within twice the lowest seen, and shrinks once it doesn't
+ */
+class RGWSyncSpawnWindow {
+  const unsigned min_window;
+  const unsigned max_window;
+  unsigned window;
+  unsigned completions{0};
+  ceph::timespan min_latency = ceph::timespan::max();
+  ceph::timespan avg_latency = ceph::timespan::zero();
+
+public:
+  RGWSyncSpawnWindow(unsigned min_window, unsigned max_window)
+    : min_window(std::max(min_window, 1u)),
+      max_window(std::max(this->min_window, max_window)),
+      window(this->min_window) {}
+
+  unsigned get() const { return window; }
+  ceph::timespan get_min_latency() const { return min_latency; }
+  ceph::timespan get_avg_latency() const { return avg_latency; }
+
+  /// account for the latency of a completed sync, and adjust the window at
+  /// most once per window of completions. returns true if it changed
+  bool update(ceph::timespan latency);
+};
+
 struct rgw_bucket_index_marker_info {
   string bucket_ver;
   string master_ver;
@@ -158,6 +158,24 @@ void RGWObjManifest::generate_test_instances(std::list<RGWObjManifest*>& o)
 
   o.push_back(m);
 
+  /* a multipart upload with parts of different sizes */
+  m = new RGWObjManifest;
+  m->prefix = "object.upload";
+  m->set_compact_rules(true);
+  uint64_t ofs = 0;
+  for (int i = 0; i < 10; i++) {
+    uint64_t part_size = (5 + i) * 1024 * 1024;
+    RGWObjManifestRule rule(i + 1, ofs, part_size, 4 * 1024 * 1024);
+    if (i == 3) {
+      rule.override_prefix = "object.retried.4";
+    }
+    m->rules[ofs] = rule;
+    ofs += part_size;
+  }
+  m->obj_size = ofs;
+
+  o.push_back(m);
+
   o.push_back(new RGWObjManifest);
 }
 
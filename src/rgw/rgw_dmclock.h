@@ -16,6 +16,8 @@
 
 #ifndef RGW_DMCLOCK_H
 #define RGW_DMCLOCK_H
+#include <optional>
+#include <string_view>
 #include "dmclock/src/dmclock_server.h"
 
 namespace rgw::dmclock {
@@ -32,10 +34,22 @@ enum class client_id {
 using crimson::dmclock::Cost;
 using crimson::dmclock::ClientInfo;
 
+/// the tenant and bucket named by a request, for schedulers that give
+/// tenants their own reservation, weight and limit
+struct qos_target {
+  std::string_view tenant;
+  std::string_view bucket;
+  /// the requester is a user of tenant, so user_qos is the tenant's qos
+  bool from_user = false;
+  /// the user's RGW_ATTR_DMCLOCK_QOS, if it has one
+  std::optional<ClientInfo> user_qos;
+};
+
 enum class scheduler_t {
                         none,
                         throttler,
-                        dmclock
+                        dmclock,
+                        dmclock_tenant
 };
 
 inline scheduler_t get_scheduler_t(CephContext* const cct)
@@ -43,6 +57,8 @@ inline scheduler_t get_scheduler_t(CephContext* const cct)
   const auto scheduler_type = cct->_conf.get_val<std::string>("rgw_scheduler_type");
   if (scheduler_type == "dmclock")
     return scheduler_t::dmclock;
+  else if (scheduler_type == "dmclock-tenant")
+    return scheduler_t::dmclock_tenant;
   else if (scheduler_type == "throttler")
     return scheduler_t::throttler;
   else
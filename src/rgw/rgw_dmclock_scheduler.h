@@ -68,20 +68,36 @@ using SchedulerCompleter = Completer<std::function<void()>>;
 
 class Scheduler  {
 public:
+  auto schedule_request(const client_id& client, const qos_target& target,
+			const ReqParams& params, const Time& time,
+			const Cost& cost, optional_yield yield)
+  {
+    int r = schedule_request_impl(client,target,params,time,cost,yield);
+    return std::make_pair(r,SchedulerCompleter(std::bind(&Scheduler::request_complete,this)));
+  }
   auto schedule_request(const client_id& client, const ReqParams& params,
 			const Time& time, const Cost& cost,
 			optional_yield yield)
   {
-    int r = schedule_request_impl(client,params,time,cost,yield);
-    return std::make_pair(r,SchedulerCompleter(std::bind(&Scheduler::request_complete,this)));
+    return schedule_request(client, qos_target{}, params, time, cost, yield);
   }
   virtual void request_complete() {};
+  /// whether the scheduler distinguishes requests by their qos_target,
+  /// which may take a lookup to find
+  virtual bool uses_qos_target() const { return false; }
 
   virtual ~Scheduler() {};
 private:
   virtual int schedule_request_impl(const client_id&, const ReqParams&,
 				    const Time&, const Cost&,
 				    optional_yield) = 0;
+  // schedulers that don't distinguish tenants ignore the target
+  virtual int schedule_request_impl(const client_id& client,
+				    const qos_target& target,
+				    const ReqParams& params, const Time& time,
+				    const Cost& cost, optional_yield yield) {
+    return schedule_request_impl(client, params, time, cost, yield);
+  }
 };
 
 } // namespace rgw::dmclock
@@ -102,6 +102,9 @@ public:
       dmc_client_config = std::make_shared<ClientConfig>(cct);
       // we don't have a move only cref std::function yet
       dmc_client_counters = std::make_optional<ClientCounters>(cct);
+    } else if (sched_t == scheduler_t::dmclock_tenant) {
+      // op classes are weighted by the tenant scheduler itself
+      dmc_client_counters = std::make_optional<ClientCounters>(cct);
     }
   }
   // We need to construct a std::function from a NonCopyable object
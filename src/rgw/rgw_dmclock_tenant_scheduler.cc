@@ -0,0 +1,367 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#include <cstdlib>
+#include <utility>
+
+#include "include/str_list.h"
+#include "common/dout.h"
+#include "rgw_dmclock_tenant_scheduler.h"
+
+#define dout_subsys ceph_subsys_rgw
+
+namespace rgw::dmclock {
+
+std::optional<ClientInfo> parse_tenant_qos(std::string_view s)
+{
+  std::vector<std::string> fields;
+  get_str_vec(std::string{s}, ":", fields);
+  if (fields.size() != 3) {
+    return std::nullopt;
+  }
+  double values[3];
+  for (size_t i = 0; i < 3; i++) {
+    char *end = nullptr;
+    values[i] = std::strtod(fields[i].c_str(), &end);
+    if (end == fields[i].c_str() || *end != '\0' || values[i] < 0) {
+      return std::nullopt;
+    }
+  }
+  return ClientInfo(values[0], values[1], values[2]);
+}
+
+TenantInfos::TenantInfos(CephContext *cct, const ConfigProxy& conf)
+  : defaults(conf.get_val<double>("rgw_dmclock_tenant_res"),
+             conf.get_val<double>("rgw_dmclock_tenant_wgt"),
+             conf.get_val<double>("rgw_dmclock_tenant_lim"))
+{
+  // "tenant=res:wgt:lim, tenant/bucket=res:wgt:lim"
+  std::list<std::string> items;
+  get_str_list(conf.get_val<std::string>("rgw_dmclock_tenant_qos"), ", ",
+               items);
+  for (const auto& item : items) {
+    const auto eq = item.rfind('=');
+    std::optional<ClientInfo> info;
+    if (eq != std::string::npos) {
+      info = parse_tenant_qos(std::string_view{item}.substr(eq + 1));
+    }
+    if (!info) {
+      lderr(cct) << "ignoring invalid rgw_dmclock_tenant_qos entry "
+          << item << dendl;
+      continue;
+    }
+    entries.insert_or_assign(item.substr(0, eq), *info);
+  }
+}
+
+std::string TenantInfos::get_key(const qos_target& target) const
+{
+  if (!target.bucket.empty() && !entries.empty()) {
+    std::string key;
+    key.reserve(target.tenant.size() + 1 + target.bucket.size());
+    key.append(target.tenant).append("/").append(target.bucket);
+    if (entries.find(key) != entries.end()) {
+      return key;
+    }
+  }
+  return std::string{target.tenant};
+}
+
+const ClientInfo* TenantInfos::get(const std::string& key) const
+{
+  auto i = entries.find(key);
+  if (i != entries.end()) {
+    return &i->second;
+  }
+  return &defaults;
+}
+
+
+void TenantScheduler::ClassQueue::push(std::unique_ptr<Completion> c,
+                                       double weight)
+{
+  const auto i = static_cast<size_t>(c->client);
+  // start after the last request of the class, or now if it was idle
+  const double start = std::max(vtime, last_tag[i]);
+  const double tag = start + c->cost / std::max(weight, 0.001);
+  last_tag[i] = tag;
+  classes[i].push_back(Entry{tag, std::move(c)});
+  ++count;
+}
+
+auto TenantScheduler::ClassQueue::pop() -> std::unique_ptr<Completion>
+{
+  std::deque<Entry>* next = nullptr;
+  for (auto& q : classes) {
+    if (!q.empty() && (!next || q.front().tag < next->front().tag)) {
+      next = &q;
+    }
+  }
+  ceph_assert(next);
+  vtime = next->front().tag;
+  auto c = std::move(next->front().completion);
+  next->pop_front();
+  --count;
+  return c;
+}
+
+
+TenantScheduler::TenantScheduler(CephContext *cct,
+                                 boost::asio::io_context& context,
+                                 GetClientCounters&& counters)
+  : cct(cct), counters(std::move(counters)),
+    infos(std::make_unique<TenantInfos>(cct, cct->_conf)),
+    queue([this] (const std::string& tenant) {
+            return get_tenant_info(tenant);
+          }, AtLimit::Reject),
+    timer(context),
+    max_requests(cct->_conf.get_val<int64_t>("rgw_max_concurrent_requests"))
+{
+  update_class_weights(cct->_conf);
+  if (max_requests <= 0) {
+    max_requests = std::numeric_limits<int64_t>::max();
+  }
+  cct->_conf.add_observer(this);
+}
+
+TenantScheduler::~TenantScheduler()
+{
+  cancel();
+  cct->_conf.remove_observer(this);
+}
+
+const ClientInfo* TenantScheduler::get_tenant_info(const std::string& tenant)
+{
+  std::lock_guard lock{config_lock};
+  if (auto i = user_infos.find(tenant); i != user_infos.end()) {
+    return i->second.get();
+  }
+  return infos->get(tenant);
+}
+
+static bool same_qos(const ClientInfo& a, const ClientInfo& b)
+{
+  return a.reservation == b.reservation && a.weight == b.weight &&
+      a.limit == b.limit;
+}
+
+void TenantScheduler::update_user_info(const qos_target& target)
+{
+  // the queue holds a pointer to the old info until it's updated
+  std::unique_ptr<ClientInfo> old;
+  {
+    std::lock_guard lock{config_lock};
+    auto i = user_infos.find(target.tenant);
+    if (!target.user_qos) {
+      if (i == user_infos.end()) {
+        return;
+      }
+      old = std::move(i->second);
+      user_infos.erase(i);
+    } else if (i == user_infos.end()) {
+      user_infos.emplace(std::string{target.tenant},
+                         std::make_unique<ClientInfo>(*target.user_qos));
+    } else if (same_qos(*i->second, *target.user_qos)) {
+      return;
+    } else {
+      old = std::exchange(i->second,
+                          std::make_unique<ClientInfo>(*target.user_qos));
+    }
+  }
+  queue.update_client_infos();
+}
+
+void TenantScheduler::update_class_weights(const ConfigProxy& conf)
+{
+  std::lock_guard lock{mutex};
+  class_weights[static_cast<size_t>(client_id::admin)] =
+      conf.get_val<double>("rgw_dmclock_admin_wgt");
+  class_weights[static_cast<size_t>(client_id::auth)] =
+      conf.get_val<double>("rgw_dmclock_auth_wgt");
+  class_weights[static_cast<size_t>(client_id::data)] =
+      conf.get_val<double>("rgw_dmclock_data_wgt");
+  class_weights[static_cast<size_t>(client_id::metadata)] =
+      conf.get_val<double>("rgw_dmclock_metadata_wgt");
+}
+
+const char** TenantScheduler::get_tracked_conf_keys() const
+{
+  static const char* keys[] = {
+    "rgw_dmclock_tenant_res",
+    "rgw_dmclock_tenant_wgt",
+    "rgw_dmclock_tenant_lim",
+    "rgw_dmclock_tenant_qos",
+    "rgw_dmclock_admin_wgt",
+    "rgw_dmclock_auth_wgt",
+    "rgw_dmclock_data_wgt",
+    "rgw_dmclock_metadata_wgt",
+    "rgw_max_concurrent_requests",
+    nullptr
+  };
+  return keys;
+}
+
+void TenantScheduler::handle_conf_change(const ConfigProxy& conf,
+                                         const std::set<std::string>& changed)
+{
+  if (changed.count("rgw_max_concurrent_requests")) {
+    auto new_max = conf.get_val<int64_t>("rgw_max_concurrent_requests");
+    max_requests = new_max > 0 ? new_max : std::numeric_limits<int64_t>::max();
+  }
+  update_class_weights(conf);
+
+  // the queue holds pointers into the old infos until it's updated
+  auto new_infos = std::make_unique<TenantInfos>(cct, conf);
+  {
+    std::lock_guard lock{config_lock};
+    infos.swap(new_infos);
+  }
+  queue.update_client_infos();
+  schedule(crimson::dmclock::TimeZero);
+}
+
+int TenantScheduler::schedule_request_impl(const client_id& client,
+                                           const qos_target& target,
+                                           const ReqParams& params,
+                                           const Time& time, const Cost& cost,
+                                           optional_yield yield_ctx)
+{
+  ceph_assert(yield_ctx);
+
+  auto &yield = yield_ctx.get_yield_context();
+  boost::system::error_code ec;
+  async_request(client, target, params, time, cost, yield[ec]);
+
+  if (ec) {
+    if (ec == boost::system::errc::resource_unavailable_try_again)
+      return -EAGAIN;
+    else
+      return -ec.value();
+  }
+  return 0;
+}
+
+void TenantScheduler::request_complete()
+{
+  --outstanding_requests;
+  schedule(crimson::dmclock::TimeZero);
+}
+
+void TenantScheduler::cancel()
+{
+  ClientSums sums;
+
+  queue.remove_by_req_filter([] (RequestRef&& request) {
+      return true;
+    });
+  {
+    std::lock_guard lock{mutex};
+    for (auto& [tenant, classes] : tenants) {
+      while (!classes.empty()) {
+        auto c = classes.pop();
+        inc(sums, c->client, c->cost);
+        Completion::dispatch(std::move(c),
+                             boost::asio::error::operation_aborted,
+                             PhaseType::priority);
+      }
+    }
+    tenants.clear();
+  }
+  timer.cancel();
+
+  for (size_t i = 0; i < client_count; i++) {
+    if (auto c = counters(static_cast<client_id>(i))) {
+      on_cancel(c, sums[i]);
+    }
+  }
+}
+
+void TenantScheduler::schedule(const Time& time)
+{
+  timer.expires_at(Clock::from_double(time));
+  timer.async_wait([this] (boost::system::error_code ec) {
+      // process requests unless the wait was canceled. note that a canceled
+      // wait may execute after this TenantScheduler destructs
+      if (ec != boost::asio::error::operation_aborted) {
+        process(get_time());
+      }
+    });
+}
+
+void TenantScheduler::process(const Time& now)
+{
+  // must run in the executor. we should only invoke completion handlers if the
+  // executor is running
+  assert(get_executor().running_in_this_thread());
+
+  ClientSums rsums, psums;
+
+  while (outstanding_requests < max_requests) {
+    auto pull = queue.pull_request(now);
+
+    if (pull.is_none()) {
+      // no pending requests, cancel the timer
+      timer.cancel();
+      break;
+    }
+    if (pull.is_future()) {
+      // update the timer based on the future time
+      schedule(pull.getTime());
+      break;
+    }
+    ++outstanding_requests;
+
+    // run the next request of the tenant picked
+    auto& r = pull.get_retn();
+    const auto phase = r.phase;
+    std::unique_ptr<Completion> completion;
+    {
+      std::lock_guard lock{mutex};
+      auto tenant = tenants.find(r.client);
+      ceph_assert(tenant != tenants.end());
+      completion = tenant->second.pop();
+      if (tenant->second.empty()) {
+        tenants.erase(tenant);
+      }
+    }
+    const auto client = completion->client;
+    const auto started = completion->started;
+    const auto cost = completion->cost;
+    Completion::post(std::move(completion), boost::system::error_code{},
+                     phase);
+
+    if (auto c = counters(client)) {
+      auto lat = Clock::from_double(now) - Clock::from_double(started);
+      if (phase == PhaseType::reservation) {
+        inc(rsums, client, cost);
+        c->tinc(queue_counters::l_res_latency, lat);
+      } else {
+        inc(psums, client, cost);
+        c->tinc(queue_counters::l_prio_latency, lat);
+      }
+    }
+  }
+
+  if (outstanding_requests >= max_requests) {
+    if (auto c = counters(client_id::count)) {
+      c->inc(throttle_counters::l_throttle);
+    }
+  }
+
+  for (size_t i = 0; i < client_count; i++) {
+    if (auto c = counters(static_cast<client_id>(i))) {
+      on_process(c, rsums[i], psums[i]);
+    }
+  }
+}
+
+} // namespace rgw::dmclock
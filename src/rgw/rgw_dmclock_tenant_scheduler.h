@@ -0,0 +1,228 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#ifndef RGW_DMCLOCK_TENANT_SCHEDULER_H
+#define RGW_DMCLOCK_TENANT_SCHEDULER_H
+
+#include <array>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <boost/asio.hpp>
+
+#include "common/async/completion.h"
+#include "common/ceph_mutex.h"
+#include "rgw_dmclock_scheduler.h"
+#include "rgw_dmclock_scheduler_ctx.h"
+
+namespace rgw::dmclock {
+  namespace async = ceph::async;
+
+/// parse "res:wgt:lim", as in rgw_dmclock_tenant_qos and RGW_ATTR_DMCLOCK_QOS
+std::optional<ClientInfo> parse_tenant_qos(std::string_view s);
+
+/// the reservation, weight and limit of each tenant, from
+/// rgw_dmclock_tenant_qos and the rgw_dmclock_tenant_* defaults. a bucket
+/// named as "tenant/bucket" is scheduled apart from the rest of its tenant
+struct TenantInfos {
+  ClientInfo defaults;
+  std::map<std::string, ClientInfo, std::less<>> entries;
+
+  TenantInfos(CephContext *cct, const ConfigProxy& conf);
+
+  /// return the dmclock client a request is scheduled as
+  std::string get_key(const qos_target& target) const;
+  const ClientInfo* get(const std::string& key) const;
+};
+
+/*
+ * A two level dmclock scheduler for use with boost::asio.
+ *
+ * Requests are first scheduled by a dmclock queue of tenants, with the
+ * reservation, weight and limit their users' RGW_ATTR_DMCLOCK_QOS gives
+ * them, or else those of TenantInfos. When a tenant is picked,
+ * the request it runs is picked from its op classes (admin, auth, data,
+ * metadata) by weighted fair queueing, using the rgw_dmclock_<class>_wgt
+ * weights.
+ */
+class TenantScheduler : public md_config_obs_t, public Scheduler {
+ public:
+  TenantScheduler(CephContext *cct, boost::asio::io_context& context,
+                  GetClientCounters&& counters);
+  ~TenantScheduler();
+
+  using executor_type = boost::asio::io_context::executor_type;
+
+  /// return the default executor for async_request() callbacks
+  executor_type get_executor() noexcept {
+    return timer.get_executor();
+  }
+
+  /// submit an async request for scheduling, see AsyncScheduler
+  template <typename CompletionToken>
+  auto async_request(const client_id& client, const qos_target& target,
+                     const ReqParams& params, const Time& time, Cost cost,
+                     CompletionToken&& token);
+
+  /// returns a throttle unit granted by async_request()
+  void request_complete() override;
+
+  bool uses_qos_target() const override { return true; }
+
+  /// cancel all queued requests, invoking their completion handlers with an
+  /// operation_aborted error and default-constructed result
+  void cancel();
+
+  const char** get_tracked_conf_keys() const override;
+  void handle_conf_change(const ConfigProxy& conf,
+                          const std::set<std::string>& changed) override;
+
+ private:
+  int schedule_request_impl(const client_id& client, const ReqParams& params,
+                            const Time& time, const Cost& cost,
+                            optional_yield yield_ctx) override {
+    return schedule_request_impl(client, qos_target{}, params, time, cost,
+                                 yield_ctx);
+  }
+  int schedule_request_impl(const client_id& client, const qos_target& target,
+                            const ReqParams& params, const Time& time,
+                            const Cost& cost,
+                            optional_yield yield_ctx) override;
+
+  /// the tenant queue holds one of these for each request, which itself
+  /// waits in its tenant's ClassQueue
+  struct TenantRequest {};
+  static constexpr bool IsDelayed = false;
+  using Queue = crimson::dmclock::PullPriorityQueue<std::string, TenantRequest,
+                                                    IsDelayed>;
+  using RequestRef = typename Queue::RequestRef;
+
+  using Signature = void(boost::system::error_code, PhaseType);
+  using Completion = async::Completion<Signature, async::AsBase<Request>>;
+
+  /// the requests of a tenant, by op class
+  class ClassQueue {
+    struct Entry {
+      double tag; //< virtual finish time
+      std::unique_ptr<Completion> completion;
+    };
+    std::array<std::deque<Entry>, client_count> classes;
+    std::array<double, client_count> last_tag{};
+    double vtime = 0; //< tag of the last request dequeued
+    size_t count = 0;
+   public:
+    void push(std::unique_ptr<Completion> c, double weight);
+    std::unique_ptr<Completion> pop();
+    bool empty() const { return count == 0; }
+  };
+
+  CephContext *const cct;
+  GetClientCounters counters; //< provides per-class perf counters
+
+  ceph::mutex config_lock = ceph::make_mutex("TenantScheduler::config_lock");
+  std::unique_ptr<TenantInfos> infos;
+  /// the qos of tenants, as last seen on a request of one of their users
+  std::map<std::string, std::unique_ptr<ClientInfo>, std::less<>> user_infos;
+
+  /// protects tenants and class_weights, held over adding to the queue so
+  /// that process() finds the request of each TenantRequest it pulls
+  ceph::mutex mutex = ceph::make_mutex("TenantScheduler::mutex");
+  std::map<std::string, ClassQueue, std::less<>> tenants;
+  std::array<double, client_count> class_weights;
+
+  Queue queue; //< dmclock priority queue of tenants
+
+  using Clock = ceph::coarse_real_clock;
+#if BOOST_VERSION < 107000
+  using Timer = boost::asio::basic_waitable_timer<Clock>;
+#else
+  using Timer = boost::asio::basic_waitable_timer<Clock,
+        boost::asio::wait_traits<Clock>, executor_type>;
+#endif
+  Timer timer; //< timer for the next scheduled request
+
+  /// max request throttle
+  std::atomic<int64_t> max_requests;
+  std::atomic<int64_t> outstanding_requests = 0;
+
+  const ClientInfo* get_tenant_info(const std::string& tenant);
+  /// record the user qos of a request from a user of its tenant
+  void update_user_info(const qos_target& target);
+  void update_class_weights(const ConfigProxy& conf);
+
+  /// set a timer to process the next request
+  void schedule(const Time& time);
+
+  /// process ready requests, then schedule the next pending request
+  void process(const Time& now);
+};
+
+
+template <typename CompletionToken>
+auto TenantScheduler::async_request(const client_id& client,
+                                    const qos_target& target,
+                                    const ReqParams& params,
+                                    const Time& time, Cost cost,
+                                    CompletionToken&& token)
+{
+  boost::asio::async_completion<CompletionToken, Signature> init(token);
+
+  auto ex1 = get_executor();
+  auto& handler = init.completion_handler;
+
+  auto completion = Completion::create(ex1, std::move(handler),
+                                       Request{client, time, cost});
+  if (target.from_user) {
+    update_user_info(target);
+  }
+  std::string tenant;
+  {
+    std::lock_guard lock{config_lock};
+    tenant = infos->get_key(target);
+  }
+  int r;
+  {
+    std::lock_guard lock{mutex};
+    auto req = std::make_unique<TenantRequest>();
+    r = queue.add_request(std::move(req), tenant, params, time, cost);
+    if (r == 0) {
+      const double weight = class_weights[static_cast<size_t>(client)];
+      tenants[tenant].push(std::move(completion), weight);
+    }
+  }
+  if (r == 0) {
+    // schedule an immediate call to process() on the executor
+    schedule(crimson::dmclock::TimeZero);
+    if (auto c = counters(client)) {
+      c->inc(queue_counters::l_qlen);
+      c->inc(queue_counters::l_cost, cost);
+    }
+  } else {
+    // post the error code
+    boost::system::error_code ec(r, boost::system::system_category());
+    async::post(std::move(completion), ec, PhaseType::priority);
+    if (auto c = counters(client)) {
+      c->inc(queue_counters::l_limit);
+      c->inc(queue_counters::l_limit_cost, cost);
+    }
+  }
+
+  return init.result.get();
+}
+
+} // namespace rgw::dmclock
+
+#endif /* RGW_DMCLOCK_TENANT_SCHEDULER_H */
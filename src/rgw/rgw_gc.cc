@@ -3,11 +3,13 @@
 
 #include "rgw_gc.h"
 #include "rgw_tools.h"
+#include "rgw_perf_counters.h"
 #include "include/rados/librados.hpp"
 #include "cls/rgw/cls_rgw_client.h"
 #include "cls/refcount/cls_refcount_client.h"
 #include "cls/lock/cls_lock_client.h"
 #include "include/random.h"
+#include "common/perf_counters.h"
 
 #include <list>
 #include <sstream>
@@ -34,12 +36,25 @@ void RGWGC::initialize(CephContext *_cct, RGWRados *_store) {
     char buf[32];
     snprintf(buf, 32, ".%d", i);
     obj_names[i].append(buf);
+
+    shard_perf.push_back(rgw_gc_shard_perf_start(cct, i));
   }
+  perf = rgw_gc_perf_start(cct);
 }
 
 void RGWGC::finalize()
 {
   delete[] obj_names;
+  obj_names = nullptr;
+
+  for (auto counters : shard_perf) {
+    rgw_gc_perf_stop(cct, counters);
+  }
+  shard_perf.clear();
+  if (perf) {
+    rgw_gc_perf_stop(cct, perf);
+    perf = nullptr;
+  }
 }
 
 int RGWGC::tag_index(const string& tag)
@@ -129,6 +144,37 @@ int RGWGC::list(int *index, string& marker, uint32_t max, bool expired_only, std
   return 0;
 }
 
+#define MAX_AIO_DEFAULT 10
+
+RGWGCIOWindow::RGWGCIOWindow(CephContext *cct)
+  : limit(std::max<int64_t>(cct->_conf->rgw_gc_max_concurrent_io, 1))
+{
+  const double target = cct->_conf.get_val<double>("rgw_gc_io_target_latency");
+  if (target > 0) {
+    target_latency = ceph::make_timespan(target);
+    window = std::min<size_t>(MAX_AIO_DEFAULT, limit);
+  } else {
+    window = limit;
+  }
+}
+
+bool RGWGCIOWindow::update(ceph::timespan latency)
+{
+  window_latency += latency;
+  if (++window_ios < window) {
+    return false;
+  }
+  const size_t old_window = window;
+  if (window_latency / window_ios > target_latency) {
+    window = std::max<size_t>(window / 2, 1);
+  } else if (window < limit) {
+    ++window;
+  }
+  window_latency = ceph::timespan::zero();
+  window_ios = 0;
+  return window != old_window;
+}
+
 class RGWGCIOManager {
   const DoutPrefixProvider* dpp;
   CephContext *cct;
@@ -144,20 +190,21 @@ class RGWGCIOManager {
     string oid;
     int index{-1};
     string tag;
+    ceph::mono_time start;
   };
 
   deque<IO> ios;
   vector<std::vector<string> > remove_tags;
 
-#define MAX_AIO_DEFAULT 10
-  size_t max_aio{MAX_AIO_DEFAULT};
+  RGWGCIOWindow window;
 
 public:
   RGWGCIOManager(const DoutPrefixProvider* _dpp, CephContext *_cct, RGWGC *_gc) : dpp(_dpp),
                                                   cct(_cct),
                                                   gc(_gc),
-                                                  remove_tags(cct->_conf->rgw_gc_max_objs) {
-    max_aio = cct->_conf->rgw_gc_max_concurrent_io;
+                                                  remove_tags(cct->_conf->rgw_gc_max_objs),
+                                                  window(cct) {
+    gc->perf->set(l_rgw_gc_io_window, window.get());
   }
 
   ~RGWGCIOManager() {
@@ -168,30 +215,41 @@ public:
 
   int schedule_io(IoCtx *ioctx, const string& oid, ObjectWriteOperation *op,
 		  int index, const string& tag) {
-    while (ios.size() > max_aio) {
+    while (ios.size() > window.get()) {
       if (gc->going_down()) {
         return 0;
       }
-      handle_next_completion();
+      /* the window is full, so the oldest removal is what we're waiting
+       * for: its latency is a fair sample for tuning the window */
+      handle_next_completion(true);
     }
 
     AioCompletion *c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
     int ret = ioctx->aio_operate(oid, c, op);
     if (ret < 0) {
+      c->release();
       return ret;
     }
-    ios.push_back(IO{IO::TailIO, c, oid, index, tag});
+    ios.push_back(IO{IO::TailIO, c, oid, index, tag, ceph::mono_clock::now()});
 
     return 0;
   }
 
-  void handle_next_completion() {
+  void handle_next_completion(bool sample_latency = false) {
     ceph_assert(!ios.empty());
     IO& io = ios.front();
     io.c->wait_for_safe();
     int ret = io.c->get_return_value();
     io.c->release();
 
+    if (io.type == IO::TailIO) {
+      const auto latency = ceph::mono_clock::now() - io.start;
+      gc->perf->tinc(l_rgw_gc_io_lat, latency);
+      if (sample_latency && window.adaptive() && window.update(latency)) {
+        gc->perf->set(l_rgw_gc_io_window, window.get());
+      }
+    }
+
     if (ret == -ENOENT) {
       ret = 0;
     }
@@ -207,9 +265,11 @@ public:
     if (ret < 0) {
       ldpp_dout(dpp, 0) << "WARNING: gc could not remove oid=" << io.oid <<
 	", ret=" << ret << dendl;
+      gc->perf->inc(l_rgw_gc_io_failed);
       goto done;
     }
 
+    gc->shard_perf[io.index]->inc(l_rgw_gc_shard_objs);
     schedule_tag_removal(io.index, io.tag);
 
   done:
@@ -256,6 +316,7 @@ public:
       rt.size() << ", entries=" << rt << dendl;
 
     int ret = gc->remove(index, rt, &index_io.c);
+    const size_t num_tags = rt.size();
     rt.clear();
     if (ret < 0) {
       /* we already cleared list of tags, this prevents us from
@@ -266,6 +327,7 @@ public:
       return;
     }
 
+    gc->shard_perf[index]->inc(l_rgw_gc_shard_entries, num_tags);
     ios.push_back(index_io);
   }
 
@@ -311,7 +373,8 @@ int RGWGC::process(int index, int max_secs, bool expired_only,
   string marker;
   string next_marker;
   bool truncated;
-  IoCtx *ctx = new IoCtx;
+  /* chains from many buckets share a few data pools */
+  std::map<string, IoCtx> ioctxs;
   do {
     int max = 100;
     std::list<cls_rgw_gc_obj_info> entries;
@@ -330,9 +393,17 @@ int RGWGC::process(int index, int max_secs, bool expired_only,
     if (ret < 0)
       goto done;
 
+    if (marker.empty()) {
+      /* the entries are listed by expiration time */
+      utime_t age;
+      if (!entries.empty()) {
+        age = ceph_clock_now() - utime_t(entries.front().time);
+      }
+      shard_perf[index]->tset(l_rgw_gc_shard_oldest, age);
+    }
+
     marker = next_marker;
 
-    string last_pool;
     std::list<cls_rgw_gc_obj_info>::iterator iter;
     for (iter = entries.begin(); iter != entries.end(); ++iter) {
       cls_rgw_gc_obj_info& info = *iter;
@@ -355,20 +426,19 @@ int RGWGC::process(int index, int max_secs, bool expired_only,
 	for (liter = chain.objs.begin(); liter != chain.objs.end(); ++liter) {
 	  cls_rgw_obj& obj = *liter;
 
-	  if (obj.pool != last_pool) {
-	    delete ctx;
-	    ctx = new IoCtx;
-	    ret = rgw_init_ioctx(store->get_rados_handle(), obj.pool, *ctx);
+	  auto ctx = ioctxs.find(obj.pool);
+	  if (ctx == ioctxs.end()) {
+	    IoCtx ioctx;
+	    ret = rgw_init_ioctx(store->get_rados_handle(), obj.pool, ioctx);
 	    if (ret < 0) {
-	      last_pool = "";
 	      ldpp_dout(this, 0) << "ERROR: failed to create ioctx pool=" <<
 		obj.pool << dendl;
 	      continue;
 	    }
-	    last_pool = obj.pool;
+	    ctx = ioctxs.emplace(obj.pool, std::move(ioctx)).first;
 	  }
 
-	  ctx->locator_set_key(obj.loc);
+	  ctx->second.locator_set_key(obj.loc);
 
 	  const string& oid = obj.key.name; /* just stored raw oid there */
 
@@ -377,7 +447,7 @@ int RGWGC::process(int index, int max_secs, bool expired_only,
 	  ObjectWriteOperation op;
 	  cls_refcount_put(op, info.tag, true);
 
-	  ret = io_manager.schedule_io(ctx, oid, &op, index, info.tag);
+	  ret = io_manager.schedule_io(&ctx->second, oid, &op, index, info.tag);
 	  if (ret < 0) {
 	    ldpp_dout(this, 0) <<
 	      "WARNING: failed to schedule deletion for oid=" << oid << dendl;
@@ -397,7 +467,6 @@ done:
    * hold the system if backend is unresponsive
    */
   l.unlock(&store->gc_pool_ctx, obj_names[index]);
-  delete ctx;
 
   return 0;
 }
@@ -17,14 +17,45 @@
 #include <atomic>
 
 class RGWGCIOManager;
+class PerfCounters;
+
+/*
+ * the number of tail removals the gc keeps in flight. with
+ * rgw_gc_io_target_latency set, it grows by one for every window of
+ * removals that completed within the target on average, and is halved
+ * otherwise, between 1 and rgw_gc_max_concurrent_io. without a target it
+ * stays at rgw_gc_max_concurrent_io
+ */
+class RGWGCIOWindow {
+  size_t window;
+  size_t limit;
+  ceph::timespan target_latency{0};
+  ceph::timespan window_latency{0};
+  size_t window_ios{0};
+
+public:
+  explicit RGWGCIOWindow(CephContext *cct);
+
+  size_t get() const { return window; }
+  bool adaptive() const { return target_latency != ceph::timespan::zero(); }
+
+  /// account for the latency of a removal, and adjust the window once per
+  /// window of removals. returns true if its size changed
+  bool update(ceph::timespan latency);
+};
 
 class RGWGC : public DoutPrefixProvider {
+  friend class RGWGCIOManager;
+
   CephContext *cct;
   RGWRados *store;
   int max_objs;
   string *obj_names;
   std::atomic<bool> down_flag = { false };
 
+  PerfCounters *perf = nullptr;
+  std::vector<PerfCounters*> shard_perf;
+
   int tag_index(const string& tag);
 
   class GCWorker : public Thread {
@@ -17,9 +17,12 @@
 #include "common/RefCountedObj.h"
 
 #include "rgw_coroutine.h"
+#include "rgw_perf_counters.h"
 #include "rgw_tools.h"
 
+#include <array>
 #include <atomic>
+#include <mutex>
 
 #define dout_context g_ceph_context
 #define dout_subsys ceph_subsys_rgw
@@ -41,6 +44,7 @@ struct rgw_http_req_data : public RefCountedObject {
   void *user_info{nullptr};
   bool registered{false};
   RGWHTTPManager *mgr{nullptr};
+  size_t shard{0};
   char error_buf[CURL_ERROR_SIZE];
   bool write_paused{false};
   bool read_paused{false};
@@ -202,6 +206,8 @@ void RGWCurlHandles::release_curl_handle(RGWCurlHandle* curl)
   if (cleaner_shutdown) {
     release_curl_handle_now(curl);
   } else {
+    // the share may be cleaned up before the saved handles
+    curl_easy_setopt(**curl, CURLOPT_SHARE, nullptr);
     curl_easy_reset(**curl);
     Mutex::Locker lock(cleaner_lock);
     curl->lastuse = mono_clock::now();
@@ -270,6 +276,24 @@ static void do_curl_easy_cleanup(RGWCurlHandle *curl_handle)
   handles->release_curl_handle(curl_handle);
 }
 
+/*
+ * every request shares a cache of tls sessions and dns lookups, so that new
+ * connections to a known endpoint resume a session instead of a full handshake
+ */
+static CURLSH *curl_share;
+static std::array<std::mutex, CURL_LOCK_DATA_LAST> curl_share_locks;
+
+static void curl_share_lock(CURL *, curl_lock_data data, curl_lock_access,
+                            void *)
+{
+  curl_share_locks[data].lock();
+}
+
+static void curl_share_unlock(CURL *, curl_lock_data data, void *)
+{
+  curl_share_locks[data].unlock();
+}
+
 // XXX make this part of the token cache?  (but that's swift-only;
 //	and this especially needs to integrates with s3...)
 
@@ -548,6 +572,19 @@ int RGWHTTPClient::init_request(rgw_http_req_data *_req_data)
     dout(20) << "ssl verification is set to off" << dendl;
   }
   curl_easy_setopt(easy_handle, CURLOPT_PRIVATE, (void *)req_data);
+  // keep pooled connections from going stale between requests
+  curl_easy_setopt(easy_handle, CURLOPT_TCP_KEEPALIVE, 1L);
+  if (curl_share) {
+    curl_easy_setopt(easy_handle, CURLOPT_SHARE, curl_share);
+  }
+#if LIBCURL_VERSION_NUM >= 0x072f00 // 7.47.0
+  if (cct->_conf.get_val<bool>("rgw_http_client_http2")) {
+    // negotiate http/2 over tls, and wait to multiplex over a connection
+    // that's being set up rather than opening another
+    curl_easy_setopt(easy_handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(easy_handle, CURLOPT_PIPEWAIT, 1L);
+  }
+#endif
 
   return 0;
 }
@@ -791,63 +828,90 @@ static int do_curl_wait(CephContext *cct, CURLM *handle, int signal_fd)
 
 void *RGWHTTPManager::ReqsThread::entry()
 {
-  manager->reqs_thread_entry();
+  manager->reqs_thread_entry(shard);
   return NULL;
 }
 
+RGWHTTPManager::Shard::Shard()
+  : multi_handle(curl_multi_init()),
+    reqs_lock("RGWHTTPManager::reqs_lock")
+{}
+
+RGWHTTPManager::Shard::~Shard()
+{
+  if (multi_handle)
+    curl_multi_cleanup((CURLM *)multi_handle);
+}
+
 /*
  * RGWHTTPManager has two modes of operation: threaded and non-threaded.
  */
 RGWHTTPManager::RGWHTTPManager(CephContext *_cct, RGWCompletionManager *_cm) : cct(_cct),
-                                                    completion_mgr(_cm), is_started(false),
-                                                    reqs_lock("RGWHTTPManager::reqs_lock"), num_reqs(0), max_threaded_req(0),
-                                                    reqs_thread(NULL)
+                                                    completion_mgr(_cm), is_started(false)
 {
-  multi_handle = (void *)curl_multi_init();
-  thread_pipe[0] = -1;
-  thread_pipe[1] = -1;
+  const auto num_shards = std::max<uint64_t>(1,
+      cct->_conf.get_val<uint64_t>("rgw_http_client_threads"));
+  const auto max_idle = cct->_conf.get_val<uint64_t>("rgw_http_client_idle_connections");
+  const bool http2 = cct->_conf.get_val<bool>("rgw_http_client_http2");
+
+  shards.reserve(num_shards);
+  for (uint64_t i = 0; i < num_shards; i++) {
+    auto& shard = shards.emplace_back(std::make_unique<Shard>());
+    auto multi = (CURLM *)shard->multi_handle;
+    if (max_idle > 0) {
+      curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)max_idle);
+    }
+#ifdef CURLPIPE_MULTIPLEX
+    if (http2) {
+      curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    }
+#endif
+  }
 }
 
 RGWHTTPManager::~RGWHTTPManager() {
   stop();
-  if (multi_handle)
-    curl_multi_cleanup((CURLM *)multi_handle);
 }
 
-void RGWHTTPManager::register_request(rgw_http_req_data *req_data)
+auto RGWHTTPManager::get_shard(rgw_http_req_data *req_data) -> Shard&
+{
+  return *shards[req_data->shard];
+}
+
+void RGWHTTPManager::register_request(Shard& shard, rgw_http_req_data *req_data)
 {
-  RWLock::WLocker rl(reqs_lock);
-  req_data->id = num_reqs;
+  RWLock::WLocker rl(shard.reqs_lock);
+  req_data->id = shard.num_reqs;
   req_data->registered = true;
-  reqs[num_reqs] = req_data;
-  num_reqs++;
-  ldout(cct, 20) << __func__ << " mgr=" << this << " req_data->id=" << req_data->id << ", curl_handle=" << req_data->curl_handle << dendl;
+  shard.reqs[shard.num_reqs] = req_data;
+  shard.num_reqs++;
+  ldout(cct, 20) << __func__ << " mgr=" << this << " shard=" << req_data->shard << " req_data->id=" << req_data->id << ", curl_handle=" << req_data->curl_handle << dendl;
 }
 
-bool RGWHTTPManager::unregister_request(rgw_http_req_data *req_data)
+bool RGWHTTPManager::unregister_request(Shard& shard, rgw_http_req_data *req_data)
 {
-  RWLock::WLocker rl(reqs_lock);
+  RWLock::WLocker rl(shard.reqs_lock);
   if (!req_data->registered) {
     return false;
   }
   req_data->get();
   req_data->registered = false;
-  unregistered_reqs.push_back(req_data);
-  ldout(cct, 20) << __func__ << " mgr=" << this << " req_data->id=" << req_data->id << ", curl_handle=" << req_data->curl_handle << dendl;
+  shard.unregistered_reqs.push_back(req_data);
+  ldout(cct, 20) << __func__ << " mgr=" << this << " shard=" << req_data->shard << " req_data->id=" << req_data->id << ", curl_handle=" << req_data->curl_handle << dendl;
   return true;
 }
 
-void RGWHTTPManager::complete_request(rgw_http_req_data *req_data)
+void RGWHTTPManager::complete_request(Shard& shard, rgw_http_req_data *req_data)
 {
-  RWLock::WLocker rl(reqs_lock);
-  _complete_request(req_data);
+  RWLock::WLocker rl(shard.reqs_lock);
+  _complete_request(shard, req_data);
 }
 
-void RGWHTTPManager::_complete_request(rgw_http_req_data *req_data)
+void RGWHTTPManager::_complete_request(Shard& shard, rgw_http_req_data *req_data)
 {
-  map<uint64_t, rgw_http_req_data *>::iterator iter = reqs.find(req_data->id);
-  if (iter != reqs.end()) {
-    reqs.erase(iter);
+  map<uint64_t, rgw_http_req_data *>::iterator iter = shard.reqs.find(req_data->id);
+  if (iter != shard.reqs.end()) {
+    shard.reqs.erase(iter);
   }
   {
     Mutex::Locker l(req_data->lock);
@@ -860,16 +924,16 @@ void RGWHTTPManager::_complete_request(rgw_http_req_data *req_data)
   req_data->put();
 }
 
-void RGWHTTPManager::finish_request(rgw_http_req_data *req_data, int ret)
+void RGWHTTPManager::finish_request(Shard& shard, rgw_http_req_data *req_data, int ret)
 {
   req_data->finish(ret);
-  complete_request(req_data);
+  complete_request(shard, req_data);
 }
 
-void RGWHTTPManager::_finish_request(rgw_http_req_data *req_data, int ret)
+void RGWHTTPManager::_finish_request(Shard& shard, rgw_http_req_data *req_data, int ret)
 {
   req_data->finish(ret);
-  _complete_request(req_data);
+  _complete_request(shard, req_data);
 }
 
 void RGWHTTPManager::_set_req_state(set_state& ss)
@@ -879,10 +943,10 @@ void RGWHTTPManager::_set_req_state(set_state& ss)
 /*
  * hook request to the curl multi handle
  */
-int RGWHTTPManager::link_request(rgw_http_req_data *req_data)
+int RGWHTTPManager::link_request(Shard& shard, rgw_http_req_data *req_data)
 {
   ldout(cct, 20) << __func__ << " req_data=" << req_data << " req_data->id=" << req_data->id << ", curl_handle=" << req_data->curl_handle << dendl;
-  CURLMcode mstatus = curl_multi_add_handle((CURLM *)multi_handle, req_data->get_easy_handle());
+  CURLMcode mstatus = curl_multi_add_handle((CURLM *)shard.multi_handle, req_data->get_easy_handle());
   if (mstatus) {
     dout(0) << "ERROR: failed on curl_multi_add_handle, status=" << mstatus << dendl;
     return -EIO;
@@ -894,71 +958,71 @@ int RGWHTTPManager::link_request(rgw_http_req_data *req_data)
  * unhook request from the curl multi handle, and finish request if it wasn't finished yet as
  * there will be no more processing on this request
  */
-void RGWHTTPManager::_unlink_request(rgw_http_req_data *req_data)
+void RGWHTTPManager::_unlink_request(Shard& shard, rgw_http_req_data *req_data)
 {
   if (req_data->curl_handle) {
-    curl_multi_remove_handle((CURLM *)multi_handle, req_data->get_easy_handle());
+    curl_multi_remove_handle((CURLM *)shard.multi_handle, req_data->get_easy_handle());
   }
   if (!req_data->_is_done()) {
-    _finish_request(req_data, -ECANCELED);
+    _finish_request(shard, req_data, -ECANCELED);
   }
 }
 
-void RGWHTTPManager::unlink_request(rgw_http_req_data *req_data)
+void RGWHTTPManager::unlink_request(Shard& shard, rgw_http_req_data *req_data)
 {
-  RWLock::WLocker wl(reqs_lock);
-  _unlink_request(req_data);
+  RWLock::WLocker wl(shard.reqs_lock);
+  _unlink_request(shard, req_data);
 }
 
-void RGWHTTPManager::manage_pending_requests()
+void RGWHTTPManager::manage_pending_requests(Shard& shard)
 {
-  reqs_lock.get_read();
-  if (max_threaded_req == num_reqs &&
-      unregistered_reqs.empty() &&
-      reqs_change_state.empty()) {
-    reqs_lock.unlock();
+  shard.reqs_lock.get_read();
+  if (shard.max_threaded_req == shard.num_reqs &&
+      shard.unregistered_reqs.empty() &&
+      shard.reqs_change_state.empty()) {
+    shard.reqs_lock.unlock();
     return;
   }
-  reqs_lock.unlock();
+  shard.reqs_lock.unlock();
 
-  RWLock::WLocker wl(reqs_lock);
+  RWLock::WLocker wl(shard.reqs_lock);
 
-  if (!unregistered_reqs.empty()) {
-    for (auto& r : unregistered_reqs) {
-      _unlink_request(r);
+  if (!shard.unregistered_reqs.empty()) {
+    for (auto& r : shard.unregistered_reqs) {
+      _unlink_request(shard, r);
       r->put();
     }
 
-    unregistered_reqs.clear();
+    shard.unregistered_reqs.clear();
   }
 
-  map<uint64_t, rgw_http_req_data *>::iterator iter = reqs.find(max_threaded_req);
+  map<uint64_t, rgw_http_req_data *>::iterator iter = shard.reqs.find(shard.max_threaded_req);
 
   list<std::pair<rgw_http_req_data *, int> > remove_reqs;
 
-  for (; iter != reqs.end(); ++iter) {
+  for (; iter != shard.reqs.end(); ++iter) {
     rgw_http_req_data *req_data = iter->second;
-    int r = link_request(req_data);
+    int r = link_request(shard, req_data);
     if (r < 0) {
       ldout(cct, 0) << "ERROR: failed to link http request" << dendl;
       remove_reqs.push_back(std::make_pair(iter->second, r));
     } else {
-      max_threaded_req = iter->first + 1;
+      shard.max_threaded_req = iter->first + 1;
     }
   }
 
-  if (!reqs_change_state.empty()) {
-    for (auto siter : reqs_change_state) {
+  if (!shard.reqs_change_state.empty()) {
+    for (auto siter : shard.reqs_change_state) {
       _set_req_state(siter);
     }
-    reqs_change_state.clear();
+    shard.reqs_change_state.clear();
   }
 
   for (auto piter : remove_reqs) {
     rgw_http_req_data *req_data = piter.first;
     int r = piter.second;
 
-    _finish_request(req_data, r);
+    _finish_request(shard, req_data, r);
   }
 }
 
@@ -977,20 +1041,24 @@ int RGWHTTPManager::add_request(RGWHTTPClient *client)
   req_data->client = client;
   req_data->control_io_id = client->get_io_id(RGWHTTPClient::HTTPCLIENT_IO_CONTROL);
   req_data->user_info = client->get_io_user_info();
+  if (is_started) {
+    req_data->shard = next_shard++ % shards.size();
+  }
+  auto& shard = get_shard(req_data);
 
-  register_request(req_data);
+  register_request(shard, req_data);
 
   if (!is_started) {
-    ret = link_request(req_data);
+    ret = link_request(shard, req_data);
     if (ret < 0) {
       req_data->put();
       req_data = NULL;
     }
     return ret;
   }
-  ret = signal_thread();
+  ret = signal_thread(shard);
   if (ret < 0) {
-    finish_request(req_data, ret);
+    finish_request(shard, req_data, ret);
   }
 
   return ret;
@@ -999,15 +1067,16 @@ int RGWHTTPManager::add_request(RGWHTTPClient *client)
 int RGWHTTPManager::remove_request(RGWHTTPClient *client)
 {
   rgw_http_req_data *req_data = client->get_req_data();
+  auto& shard = get_shard(req_data);
 
   if (!is_started) {
-    unlink_request(req_data);
+    unlink_request(shard, req_data);
     return 0;
   }
-  if (!unregister_request(req_data)) {
+  if (!unregister_request(shard, req_data)) {
     return 0;
   }
-  int ret = signal_thread();
+  int ret = signal_thread(shard);
   if (ret < 0) {
     return ret;
   }
@@ -1064,8 +1133,9 @@ int RGWHTTPManager::set_request_state(RGWHTTPClient *client, RGWHTTPRequestSetSt
     bitmask |= CURLPAUSE_RECV;
   }
 
-  reqs_change_state.push_back(set_state(req_data, bitmask));
-  int ret = signal_thread();
+  auto& shard = get_shard(req_data);
+  shard.reqs_change_state.push_back(set_state(req_data, bitmask));
+  int ret = signal_thread(shard);
   if (ret < 0) {
     return ret;
   }
@@ -1075,32 +1145,37 @@ int RGWHTTPManager::set_request_state(RGWHTTPClient *client, RGWHTTPRequestSetSt
 
 int RGWHTTPManager::start()
 {
-  if (pipe_cloexec(thread_pipe) < 0) {
-    int e = errno;
-    ldout(cct, 0) << "ERROR: pipe(): " << cpp_strerror(e) << dendl;
-    return -e;
-  }
+  for (auto& shard : shards) {
+    auto& thread_pipe = shard->thread_pipe;
+    if (pipe_cloexec(thread_pipe) < 0) {
+      int e = errno;
+      ldout(cct, 0) << "ERROR: pipe(): " << cpp_strerror(e) << dendl;
+      return -e;
+    }
 
-  // enable non-blocking reads
-  if (::fcntl(thread_pipe[0], F_SETFL, O_NONBLOCK) < 0) {
-    int e = errno;
-    ldout(cct, 0) << "ERROR: fcntl(): " << cpp_strerror(e) << dendl;
-    TEMP_FAILURE_RETRY(::close(thread_pipe[0]));
-    TEMP_FAILURE_RETRY(::close(thread_pipe[1]));
-    return -e;
-  }
+    // enable non-blocking reads
+    if (::fcntl(thread_pipe[0], F_SETFL, O_NONBLOCK) < 0) {
+      int e = errno;
+      ldout(cct, 0) << "ERROR: fcntl(): " << cpp_strerror(e) << dendl;
+      TEMP_FAILURE_RETRY(::close(thread_pipe[0]));
+      TEMP_FAILURE_RETRY(::close(thread_pipe[1]));
+      return -e;
+    }
 
 #ifdef HAVE_CURL_MULTI_WAIT
-  // on first initialization, use this pipe to detect whether we're using a
-  // buggy version of libcurl
-  std::call_once(detect_flag, detect_curl_multi_wait_bug, cct,
-                 static_cast<CURLM*>(multi_handle),
-                 thread_pipe[1], thread_pipe[0]);
+    // on first initialization, use this pipe to detect whether we're using a
+    // buggy version of libcurl
+    std::call_once(detect_flag, detect_curl_multi_wait_bug, cct,
+                   static_cast<CURLM*>(shard->multi_handle),
+                   thread_pipe[1], thread_pipe[0]);
 #endif
+  }
 
   is_started = true;
-  reqs_thread = new ReqsThread(this);
-  reqs_thread->create("http_manager");
+  for (auto& shard : shards) {
+    shard->reqs_thread = new ReqsThread(this, *shard);
+    shard->reqs_thread->create("http_manager");
+  }
   return 0;
 }
 
@@ -1114,18 +1189,27 @@ void RGWHTTPManager::stop()
 
   if (is_started) {
     going_down = true;
-    signal_thread();
-    reqs_thread->join();
-    delete reqs_thread;
-    TEMP_FAILURE_RETRY(::close(thread_pipe[1]));
-    TEMP_FAILURE_RETRY(::close(thread_pipe[0]));
+    for (auto& shard : shards) {
+      signal_thread(*shard);
+    }
+    for (auto& shard : shards) {
+      shard->reqs_thread->join();
+      delete shard->reqs_thread;
+      shard->reqs_thread = nullptr;
+      TEMP_FAILURE_RETRY(::close(shard->thread_pipe[1]));
+      TEMP_FAILURE_RETRY(::close(shard->thread_pipe[0]));
+    }
+    // once every shard has completed its requests
+    if (completion_mgr) {
+      completion_mgr->go_down();
+    }
   }
 }
 
-int RGWHTTPManager::signal_thread()
+int RGWHTTPManager::signal_thread(Shard& shard)
 {
   uint32_t buf = 0;
-  int ret = write(thread_pipe[1], (void *)&buf, sizeof(buf));
+  int ret = write(shard.thread_pipe[1], (void *)&buf, sizeof(buf));
   if (ret < 0) {
     ret = -errno;
     ldout(cct, 0) << "ERROR: " << __func__ << ": write() returned ret=" << ret << dendl;
@@ -1134,23 +1218,50 @@ int RGWHTTPManager::signal_thread()
   return 0;
 }
 
-void *RGWHTTPManager::reqs_thread_entry()
+// count whether the request reused a pooled connection, and the time taken
+// to connect and complete the tls handshake if it didn't
+static void update_connection_counters(CURL *e)
+{
+  if (!perfcounter) {
+    return;
+  }
+  long new_conns = 0;
+  double connect_time = 0, appconnect_time = 0;
+  curl_easy_getinfo(e, CURLINFO_NUM_CONNECTS, &new_conns);
+  curl_easy_getinfo(e, CURLINFO_CONNECT_TIME, &connect_time);
+  curl_easy_getinfo(e, CURLINFO_APPCONNECT_TIME, &appconnect_time);
+
+  perfcounter->inc(l_rgw_http_req);
+  if (new_conns == 0) {
+    perfcounter->inc(l_rgw_http_conn_reused);
+    return;
+  }
+  perfcounter->inc(l_rgw_http_conn_new, new_conns);
+  perfcounter->tinc(l_rgw_http_connect_lat, ceph::make_timespan(connect_time));
+  if (appconnect_time > connect_time) {
+    perfcounter->tinc(l_rgw_http_handshake_lat,
+                      ceph::make_timespan(appconnect_time - connect_time));
+  }
+}
+
+void *RGWHTTPManager::reqs_thread_entry(Shard& shard)
 {
   int still_running;
   int mstatus;
+  auto multi_handle = (CURLM *)shard.multi_handle;
 
   ldout(cct, 20) << __func__ << ": start" << dendl;
 
   while (!going_down) {
-    int ret = do_curl_wait(cct, (CURLM *)multi_handle, thread_pipe[0]);
+    int ret = do_curl_wait(cct, multi_handle, shard.thread_pipe[0]);
     if (ret < 0) {
       dout(0) << "ERROR: do_curl_wait() returned: " << ret << dendl;
       return NULL;
     }
 
-    manage_pending_requests();
+    manage_pending_requests(shard);
 
-    mstatus = curl_multi_perform((CURLM *)multi_handle, &still_running);
+    mstatus = curl_multi_perform(multi_handle, &still_running);
     switch (mstatus) {
       case CURLM_OK:
       case CURLM_CALL_MULTI_PERFORM:
@@ -1161,23 +1272,24 @@ void *RGWHTTPManager::reqs_thread_entry()
     }
     int msgs_left;
     CURLMsg *msg;
-    while ((msg = curl_multi_info_read((CURLM *)multi_handle, &msgs_left))) {
+    while ((msg = curl_multi_info_read(multi_handle, &msgs_left))) {
       if (msg->msg == CURLMSG_DONE) {
 	int result = msg->data.result;
 	CURL *e = msg->easy_handle;
 	rgw_http_req_data *req_data;
 	curl_easy_getinfo(e, CURLINFO_PRIVATE, (void **)&req_data);
-	curl_multi_remove_handle((CURLM *)multi_handle, e);
+	curl_multi_remove_handle(multi_handle, e);
 
 	long http_status;
 	curl_easy_getinfo(e, CURLINFO_RESPONSE_CODE, (void **)&http_status);
+        update_connection_counters(e);
 
 	int status = rgw_http_error_to_errno(http_status);
         if (result != CURLE_OK && http_status == 0) {
           status = -EAGAIN;
         }
         int id = req_data->id;
-	finish_request(req_data, status);
+	finish_request(shard, req_data, status);
         switch (result) {
           case CURLE_OK:
             break;
@@ -1194,30 +1306,33 @@ void *RGWHTTPManager::reqs_thread_entry()
   }
 
 
-  RWLock::WLocker rl(reqs_lock);
-  for (auto r : unregistered_reqs) {
-    _unlink_request(r);
+  RWLock::WLocker rl(shard.reqs_lock);
+  for (auto r : shard.unregistered_reqs) {
+    _unlink_request(shard, r);
   }
 
-  unregistered_reqs.clear();
+  shard.unregistered_reqs.clear();
 
-  auto all_reqs = std::move(reqs);
+  auto all_reqs = std::move(shard.reqs);
   for (auto iter : all_reqs) {
-    _unlink_request(iter.second);
+    _unlink_request(shard, iter.second);
   }
 
-  reqs.clear();
+  shard.reqs.clear();
 
-  if (completion_mgr) {
-    completion_mgr->go_down();
-  }
-  
   return 0;
 }
 
 void rgw_http_client_init(CephContext *cct)
 {
   curl_global_init(CURL_GLOBAL_ALL);
+  curl_share = curl_share_init();
+  if (curl_share) {
+    curl_share_setopt(curl_share, CURLSHOPT_LOCKFUNC, curl_share_lock);
+    curl_share_setopt(curl_share, CURLSHOPT_UNLOCKFUNC, curl_share_unlock);
+    curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  }
   rgw_http_manager = new RGWHTTPManager(cct);
   rgw_http_manager->start();
 }
@@ -1226,6 +1341,13 @@ void rgw_http_client_cleanup()
 {
   rgw_http_manager->stop();
   delete rgw_http_manager;
+  if (curl_share) {
+    CURLSHcode r = curl_share_cleanup(curl_share);
+    if (r != CURLSHE_OK) {
+      dout(0) << "WARNING: curl_share_cleanup() returned " << r << dendl;
+    }
+    curl_share = nullptr;
+  }
   curl_global_cleanup();
 }
 
@@ -11,6 +11,8 @@
 #include "rgw_string.h"
 
 #include <atomic>
+#include <memory>
+#include <vector>
 
 using param_pair_t = pair<string, string>;
 using param_vec_t = vector<param_pair_t>;
@@ -302,48 +304,62 @@ class RGWHTTPManager {
 
     set_state(rgw_http_req_data *_req, int _bitmask) : req(_req), bitmask(_bitmask) {}
   };
+
+  class ReqsThread;
+
+  /* requests are spread over rgw_http_client_threads shards, each with its
+   * own thread and curl multi handle. the multi handle's connection cache
+   * keeps connections to each endpoint open between requests */
+  struct Shard {
+    void *multi_handle;
+    RWLock reqs_lock;
+    map<uint64_t, rgw_http_req_data *> reqs;
+    list<rgw_http_req_data *> unregistered_reqs;
+    list<set_state> reqs_change_state;
+    int64_t num_reqs = 0;
+    int64_t max_threaded_req = 0;
+    int thread_pipe[2] = {-1, -1};
+    ReqsThread *reqs_thread = nullptr;
+
+    Shard();
+    ~Shard();
+  };
+
   CephContext *cct;
   RGWCompletionManager *completion_mgr;
-  void *multi_handle;
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::atomic<uint64_t> next_shard { 0 };
   bool is_started;
   std::atomic<unsigned> going_down { 0 };
   std::atomic<unsigned> is_stopped { 0 };
 
-  RWLock reqs_lock;
-  map<uint64_t, rgw_http_req_data *> reqs;
-  list<rgw_http_req_data *> unregistered_reqs;
-  list<set_state> reqs_change_state;
-  map<uint64_t, rgw_http_req_data *> complete_reqs;
-  int64_t num_reqs;
-  int64_t max_threaded_req;
-  int thread_pipe[2];
-
-  void register_request(rgw_http_req_data *req_data);
-  void complete_request(rgw_http_req_data *req_data);
-  void _complete_request(rgw_http_req_data *req_data);
-  bool unregister_request(rgw_http_req_data *req_data);
-  void _unlink_request(rgw_http_req_data *req_data);
-  void unlink_request(rgw_http_req_data *req_data);
-  void finish_request(rgw_http_req_data *req_data, int r);
-  void _finish_request(rgw_http_req_data *req_data, int r);
+  Shard& get_shard(rgw_http_req_data *req_data);
+
+  void register_request(Shard& shard, rgw_http_req_data *req_data);
+  void complete_request(Shard& shard, rgw_http_req_data *req_data);
+  void _complete_request(Shard& shard, rgw_http_req_data *req_data);
+  bool unregister_request(Shard& shard, rgw_http_req_data *req_data);
+  void _unlink_request(Shard& shard, rgw_http_req_data *req_data);
+  void unlink_request(Shard& shard, rgw_http_req_data *req_data);
+  void finish_request(Shard& shard, rgw_http_req_data *req_data, int r);
+  void _finish_request(Shard& shard, rgw_http_req_data *req_data, int r);
   void _set_req_state(set_state& ss);
-  int link_request(rgw_http_req_data *req_data);
+  int link_request(Shard& shard, rgw_http_req_data *req_data);
 
-  void manage_pending_requests();
+  void manage_pending_requests(Shard& shard);
 
   class ReqsThread : public Thread {
     RGWHTTPManager *manager;
+    Shard& shard;
 
   public:
-    explicit ReqsThread(RGWHTTPManager *_m) : manager(_m) {}
+    ReqsThread(RGWHTTPManager *_m, Shard& _s) : manager(_m), shard(_s) {}
     void *entry() override;
   };
 
-  ReqsThread *reqs_thread;
-
-  void *reqs_thread_entry();
+  void *reqs_thread_entry(Shard& shard);
 
-  int signal_thread();
+  int signal_thread(Shard& shard);
 
 public:
   RGWHTTPManager(CephContext *_cct, RGWCompletionManager *completion_mgr = NULL);
@@ -0,0 +1,177 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#include "rgw_index_completion.h"
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_rgw
+
+bool RGWIndexCompletionBatcher::Batch::conflicts(const complete_op_data& c) const
+{
+  if (keys.count(c.key)) {
+    return true;
+  }
+  for (auto& k : c.remove_objs) {
+    if (keys.count(k)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+RGWIndexCompletionBatcher::RGWIndexCompletionBatcher(CephContext *_cct,
+                                                     Backend *_backend)
+  : cct(_cct), backend(_backend),
+    window(std::chrono::milliseconds(
+        cct->_conf.get_val<uint64_t>("rgw_bucket_index_complete_batch_window_ms"))),
+    max_entries(std::max<uint64_t>(1,
+        cct->_conf.get_val<uint64_t>("rgw_bucket_index_complete_batch_max_entries")))
+{}
+
+void RGWIndexCompletionBatcher::send(std::unique_ptr<Batch>& batch)
+{
+  std::vector<rgw_cls_obj_complete_op> ops;
+  ops.reserve(batch->entries.size());
+  for (auto& c : batch->entries) {
+    rgw_cls_obj_complete_op& call = ops.emplace_back();
+    call.op = c->op;
+    call.tag = c->tag;
+    call.key = c->key;
+    call.ver = c->ver;
+    call.meta = c->dir_meta;
+    call.log_op = c->log_op;
+    call.bilog_flags = c->bilog_op;
+    call.remove_objs = c->remove_objs;
+    call.zones_trace = c->zones_trace;
+  }
+
+  ldout(cct, 20) << __func__ << "(): oid=" << batch->oid
+      << " entries=" << ops.size() << dendl;
+
+  int r = backend->send_batch(batch, ops);
+  if (r < 0) {
+    ldout(cct, 0) << "ERROR: " << __func__ << "(): failed to send bucket index completions, oid="
+        << batch->oid << " r=" << r << dendl;
+    for (auto& c : batch->entries) {
+      backend->retry_completion(std::move(c));
+    }
+  }
+}
+
+bool RGWIndexCompletionBatcher::add(int64_t pool, librados::IoCtx& index_ctx,
+                                    const std::string& oid,
+                                    std::unique_ptr<complete_op_data>& c)
+{
+  if (disabled) {
+    return false;
+  }
+  std::lock_guard l{lock};
+  if (stopping) {
+    return false;
+  }
+
+  BatchKey key{pool, oid};
+  auto& batch = pending[key];
+  if (batch && batch->conflicts(*c)) {
+    /* the ops on an object are ordered by the order their batches are sent
+     * in, so send the batch under the lock */
+    send(batch);
+    batch.reset();
+  }
+  if (!batch) {
+    batch = std::make_unique<Batch>();
+    batch->batcher = shared_from_this();
+    batch->index_ctx = index_ctx;
+    batch->oid = oid;
+    batch->deadline = ceph::mono_clock::now() + window;
+    cond.notify_one();
+  }
+  batch->keys.insert(c->key);
+  batch->keys.insert(c->remove_objs.begin(), c->remove_objs.end());
+  batch->entries.push_back(std::move(c));
+
+  if (batch->entries.size() >= max_entries) {
+    send(batch);
+    pending.erase(key);
+  }
+  return true;
+}
+
+void RGWIndexCompletionBatcher::handle_completion(std::unique_ptr<Batch> batch, int r)
+{
+  if (r >= 0) {
+    return;
+  }
+  if (r == -EOPNOTSUPP) {
+    if (!disabled.exchange(true)) {
+      ldout(cct, 0) << "WARNING: osds don't support batched bucket index completions, "
+          "sending them one at a time" << dendl;
+    }
+  } else if (r != -ERR_BUSY_RESHARDING) {
+    /* none of the batch was applied, and the ops that fail on their own are
+     * logged by the completion thread */
+    ldout(cct, 1) << __func__ << "(): bucket index completions failed, oid="
+        << batch->oid << " entries=" << batch->entries.size() << " r=" << r
+        << ", sending them one at a time" << dendl;
+  }
+  std::lock_guard l{lock};
+  if (stopping) {
+    return;
+  }
+  for (auto& c : batch->entries) {
+    backend->retry_completion(std::move(c));
+  }
+}
+
+void *RGWIndexCompletionBatcher::entry()
+{
+  std::unique_lock l{lock};
+  while (!stopping) {
+    if (pending.empty()) {
+      cond.wait(l);
+      continue;
+    }
+    const auto now = ceph::mono_clock::now();
+    auto next = ceph::mono_time::max();
+    for (auto i = pending.begin(); i != pending.end();) {
+      auto& batch = i->second;
+      if (batch->deadline > now) {
+        next = std::min(next, batch->deadline);
+        ++i;
+        continue;
+      }
+      send(batch);
+      i = pending.erase(i);
+    }
+    if (next != ceph::mono_time::max()) {
+      cond.wait_for(l, next - now);
+    }
+  }
+  return nullptr;
+}
+
+void RGWIndexCompletionBatcher::stop()
+{
+  {
+    std::lock_guard l{lock};
+    for (auto& [key, batch] : pending) {
+      send(batch);
+    }
+    pending.clear();
+    stopping = true;
+    cond.notify_one();
+  }
+  if (is_started()) {
+    join();
+  }
+}
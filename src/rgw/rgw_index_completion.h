@@ -0,0 +1,129 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "include/rados/librados.hpp"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+#include "cls/rgw/cls_rgw_ops.h"
+#include "rgw_common.h"
+
+class RGWIndexCompletionManager;
+
+struct complete_op_data {
+  Mutex lock{"complete_op_data"};
+  librados::AioCompletion *rados_completion{nullptr};
+  int manager_shard_id{-1};
+  RGWIndexCompletionManager *manager{nullptr};
+  rgw_obj obj;
+  RGWModifyOp op;
+  std::string tag;
+  rgw_bucket_entry_ver ver;
+  cls_rgw_obj_key key;
+  rgw_bucket_dir_entry_meta dir_meta;
+  std::list<cls_rgw_obj_key> remove_objs;
+  bool log_op;
+  uint16_t bilog_op;
+  rgw_zone_set zones_trace;
+
+  bool stopped{false};
+
+  void stop() {
+    Mutex::Locker l(lock);
+    stopped = true;
+  }
+};
+
+/*
+ * coalesces the complete ops sent to each bucket index shard within
+ * rgw_bucket_index_complete_batch_window_ms into one bucket_complete_ops call,
+ * which the osd applies in a single transaction. batches are sent in the
+ * order they're started, and never hold two ops on the same entry, so the
+ * ops on each object are applied in order. a batch that fails as a whole
+ * falls back to sending its ops one at a time
+ */
+class RGWIndexCompletionBatcher
+  : public Thread,
+    public std::enable_shared_from_this<RGWIndexCompletionBatcher> {
+public:
+  struct Batch {
+    std::shared_ptr<RGWIndexCompletionBatcher> batcher;
+    librados::IoCtx index_ctx;
+    std::string oid;
+    ceph::mono_time deadline;
+    std::vector<std::unique_ptr<complete_op_data>> entries;
+    std::set<cls_rgw_obj_key> keys; //< entries touched by the ops
+
+    bool conflicts(const complete_op_data& c) const;
+  };
+
+  /// sends the batches, and the completions that fall back to single ops
+  class Backend {
+  public:
+    virtual ~Backend() = default;
+    /// send the ops of the batch to its shard object, taking the batch and
+    /// passing the result to the batcher's handle_completion() on success
+    virtual int send_batch(std::unique_ptr<Batch>& batch,
+                           std::vector<rgw_cls_obj_complete_op>& ops) = 0;
+    /// apply a completion on its own, rechecking the bucket shard
+    virtual void retry_completion(std::unique_ptr<complete_op_data> c) = 0;
+  };
+
+private:
+  CephContext *cct;
+  Backend *backend;
+  const ceph::timespan window;
+  const size_t max_entries;
+
+  using BatchKey = std::pair<int64_t, std::string>; //< index pool and shard object
+
+  ceph::mutex lock = ceph::make_mutex("RGWIndexCompletionBatcher::lock");
+  ceph::condition_variable cond;
+  std::map<BatchKey, std::unique_ptr<Batch>> pending;
+  bool stopping{false};
+  std::atomic<bool> disabled{false};
+
+  void send(std::unique_ptr<Batch>& batch);
+
+public:
+  RGWIndexCompletionBatcher(CephContext *_cct, Backend *_backend);
+
+  /// whether the completion of a write to the bucket may be batched. the
+  /// writes to versioned buckets and object instances link the olh after
+  /// their completion, which mustn't be applied after the link
+  static bool batchable(const RGWBucketInfo& bucket_info,
+                        const rgw_obj_key& key) {
+    return !bucket_info.versioned() && key.instance.empty();
+  }
+
+  /// queue the completion for the next batch to the shard object of the
+  /// index pool, or return false for it to be sent on its own
+  bool add(int64_t pool, librados::IoCtx& index_ctx, const std::string& oid,
+           std::unique_ptr<complete_op_data>& c);
+  void handle_completion(std::unique_ptr<Batch> batch, int r);
+
+  void *entry() override;
+  /// send the pending batches and stop. completions of batches in flight
+  /// after this are dropped
+  void stop();
+};
@@ -4,6 +4,10 @@
 #include <string.h>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <set>
+#include <string_view>
+#include <thread>
 
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string.hpp>
@@ -272,6 +276,15 @@ int RGWLC::bucket_lc_prepare(int index)
       return ret;
     map<string, int>::iterator iter;
     for (iter = entries.begin(); iter != entries.end(); ++iter) {
+      /* a bucket whose last run was interrupted resumes from its markers,
+       * every other bucket is listed from the start */
+      if (iter->second != lc_processing && iter->second != lc_failed) {
+        ret = store->lc_pool_ctx.remove(lc_progress_oid_prefix + iter->first);
+        if (ret < 0 && ret != -ENOENT) {
+          ldpp_dout(this, 5) << "WARNING: RGWLC::bucket_lc_prepare() failed to remove "
+              << lc_progress_oid_prefix << iter->first << ", ret=" << ret << dendl;
+        }
+      }
       pair<string, int > entry(iter->first, lc_uninitial);
       ret = cls_rgw_lc_set_entry(store->lc_pool_ctx, obj_names[index],  entry);
       if (ret < 0) {
@@ -413,17 +426,19 @@ class LCObjsLister {
   RGWRados::Bucket target;
   RGWRados::Bucket::List list_op;
   bool is_truncated{false};
-  rgw_obj_key next_marker;
   string prefix;
   vector<rgw_bucket_dir_entry> objs;
-  vector<rgw_bucket_dir_entry>::iterator obj_iter;
+  size_t pos{0};
   rgw_bucket_dir_entry pre_obj;
   int64_t delay_ms;
+  int error{0};
 
 public:
-  LCObjsLister(RGWRados *_store, RGWBucketInfo& _bucket_info) :
+  LCObjsLister(RGWRados *_store, RGWBucketInfo& _bucket_info,
+	       int shard_id = RGW_NO_SHARD) :
       store(_store), bucket_info(_bucket_info),
       target(store, bucket_info), list_op(&target) {
+    target.set_shard_id(shard_id);
     list_op.params.list_versions = bucket_info.versioned();
     list_op.params.allow_unordered = true;
     delay_ms = store->ctx()->_conf.get_val<int64_t>("rgw_lc_thread_delay");
@@ -434,17 +449,27 @@ public:
     list_op.params.prefix = prefix;
   }
 
+  /* resume the listing after this key */
+  void set_marker(const rgw_obj_key& marker) {
+    list_op.params.marker = marker;
+  }
+
   int init() {
     return fetch();
   }
 
+  /* append the next chunk, dropping the entries already processed */
   int fetch() {
-    int ret = list_op.list_objects(1000, &objs, NULL, &is_truncated);
+    vector<rgw_bucket_dir_entry> chunk;
+    int ret = list_op.list_objects(1000, &chunk, NULL, &is_truncated);
     if (ret < 0) {
       return ret;
     }
 
-    obj_iter = objs.begin();
+    objs.erase(objs.begin(), objs.begin() + pos);
+    pos = 0;
+    objs.insert(objs.end(), std::make_move_iterator(chunk.begin()),
+		std::make_move_iterator(chunk.end()));
 
     return 0;
   }
@@ -454,46 +479,56 @@ public:
   }
 
   bool get_obj(rgw_bucket_dir_entry *obj) {
-    if (obj_iter == objs.end()) {
-      delay();
-      return false;
-    }
-    if (is_truncated && (obj_iter + 1)==objs.end()) {
-      list_op.params.marker = obj_iter->key;
-
+    /* read ahead while on the last entry, so that next_has_same_name()
+     * also sees the versions listed in the next chunk */
+    while (is_truncated && pos + 1 >= objs.size()) {
       int ret = fetch();
       if (ret < 0) {
         ldout(store->ctx(), 0) << "ERROR: list_op returned ret=" << ret << dendl;
-        return ret;
-      } else {
-        obj_iter = objs.begin();
+        error = ret;
+        return false;
       }
       delay();
     }
-    *obj = *obj_iter;
+    if (pos >= objs.size()) {
+      return false;
+    }
+    *obj = objs[pos];
     return true;
   }
 
+  /* the error that ended the listing early, if any */
+  int get_error() const {
+    return error;
+  }
+
   rgw_bucket_dir_entry get_prev_obj() {
     return pre_obj;
   }
 
   void next() {
-    pre_obj = *obj_iter;
-    ++obj_iter;
+    pre_obj = objs[pos];
+    ++pos;
   }
 
   bool next_has_same_name()
   {
-    if ((obj_iter + 1) == objs.end()) {
+    if (pos + 1 >= objs.size()) {
       /* this should have been called after get_obj() was called, so this should
        * only happen if is_truncated is false */
       return false;
     }
-    return (obj_iter->key.name.compare((obj_iter + 1)->key.name) == 0);
+    return (objs[pos].key.name.compare(objs[pos + 1].key.name) == 0);
   }
 };
 
+/* the tags of the object being processed, read once for all of its rules */
+struct lc_obj_tags {
+  bool valid{false};
+  rgw_obj_key key;
+  int ret{0};
+  bufferlist bl;
+};
 
 struct op_env {
   lc_op& op;
@@ -501,6 +536,7 @@ struct op_env {
   RGWLC *lc;
   RGWBucketInfo& bucket_info;
   LCObjsLister& ol;
+  lc_obj_tags *tags{nullptr};
 
   op_env(lc_op& _op, RGWRados *_store, RGWLC *_lc, RGWBucketInfo& _bucket_info,
          LCObjsLister& _ol) : op(_op), store(_store), lc(_lc), bucket_info(_bucket_info), ol(_ol) {}
@@ -616,7 +652,20 @@ static int check_tags(lc_op_ctx& oc, bool *skip)
     *skip = true;
 
     bufferlist tags_bl;
-    int ret = read_obj_tags(oc.store, oc.bucket_info, oc.obj, oc.rctx, tags_bl);
+    int ret;
+    auto tags = oc.env.tags;
+    if (tags) {
+      if (!tags->valid || !(tags->key == oc.obj.key)) {
+        tags->bl.clear();
+        tags->ret = read_obj_tags(oc.store, oc.bucket_info, oc.obj, oc.rctx, tags->bl);
+        tags->key = oc.obj.key;
+        tags->valid = true;
+      }
+      ret = tags->ret;
+      tags_bl = tags->bl;
+    } else {
+      ret = read_obj_tags(oc.store, oc.bucket_info, oc.obj, oc.rctx, tags_bl);
+    }
     if (ret < 0) {
       if (ret != -ENODATA) {
         ldout(oc.cct, 5) << "ERROR: read_obj_tags returned r=" << ret << dendl;
@@ -936,6 +985,133 @@ int LCOpRule::process(rgw_bucket_dir_entry& o, const DoutPrefixProvider *dpp)
 
 }
 
+LCShardProgress::LCShardProgress(IoCtx& _ioctx, const string& _oid,
+				 int num_shards, int shard_id,
+				 const string& prefix, uint32_t _interval)
+  : ioctx(_ioctx), oid(_oid),
+    /* markers saved before the bucket was resharded are never looked up
+     * again, and go away with the progress object */
+    key(std::to_string(num_shards) + "/" + std::to_string(shard_id) + "/" + prefix),
+    interval(std::max<uint32_t>(_interval, 1))
+{}
+
+int LCShardProgress::read(rgw_obj_key *marker)
+{
+  std::set<string> keys{key};
+  map<string, bufferlist> vals;
+  int ret = ioctx.omap_get_vals_by_keys(oid, keys, &vals);
+  if (ret < 0) {
+    return ret;
+  }
+  auto iter = vals.find(key);
+  if (iter == vals.end()) {
+    return -ENOENT;
+  }
+  try {
+    auto biter = iter->second.cbegin();
+    decode(*marker, biter);
+  } catch (buffer::error& err) {
+    return -EIO;
+  }
+  return 0;
+}
+
+int LCShardProgress::processed(const rgw_obj_key& entry, bool more_versions)
+{
+  if (++count < interval || more_versions) {
+    return 0;
+  }
+  count = 0;
+  map<string, bufferlist> vals;
+  encode(entry, vals[key]);
+  return ioctx.omap_set(oid, vals);
+}
+
+int LCShardProgress::finish()
+{
+  std::set<string> keys{key};
+  int ret = ioctx.omap_rm_keys(oid, keys);
+  if (ret == -ENOENT) {
+    return 0;
+  }
+  return ret;
+}
+
+int RGWLC::bucket_lc_process_shard(RGWBucketInfo& bucket_info,
+				   const string& progress_oid, int shard_id,
+				   const LCPrefixMatcher& matcher,
+				   const vector<lc_op*>& ops)
+{
+  for (auto& prefix : matcher.get_list_prefixes()) {
+    ldpp_dout(this, 20) << __func__ << "(): shard=" << shard_id
+			<< " prefix=" << prefix << dendl;
+    LCObjsLister ol(store, bucket_info, shard_id);
+    ol.set_prefix(prefix);
+
+    LCShardProgress progress(store->lc_pool_ctx, progress_oid,
+			     bucket_info.num_shards, shard_id, prefix);
+    rgw_obj_key marker;
+    int ret = progress.read(&marker);
+    if (ret == 0) {
+      ldpp_dout(this, 5) << __func__ << "(): resuming shard=" << shard_id
+			 << " prefix=" << prefix << " after " << marker << dendl;
+      ol.set_marker(marker);
+    }
+
+    ret = ol.init();
+    if (ret < 0) {
+      if (ret == (-ENOENT))
+        return 0;
+      ldpp_dout(this, 0) << "ERROR: store->list_objects():" <<dendl;
+      return ret;
+    }
+
+    lc_obj_tags tags;
+    vector<unique_ptr<op_env>> envs;
+    vector<unique_ptr<LCOpRule>> rules;
+    for (auto op : ops) {
+      envs.emplace_back(new op_env(*op, store, this, bucket_info, ol));
+      envs.back()->tags = &tags;
+      rules.emplace_back(new LCOpRule(*envs.back()));
+      rules.back()->build();
+    }
+
+    rgw_bucket_dir_entry o;
+    for (; ol.get_obj(&o); ol.next()) {
+      ldpp_dout(this, 20) << __func__ << "(): key=" << o.key << dendl;
+      rgw_obj_key obj_key(o.key);
+      matcher.match(obj_key.name, [&](size_t rule) {
+        int ret = rules[rule]->process(o, this);
+        if (ret < 0) {
+          ldpp_dout(this, 20) << "ERROR: orule.process() returned ret="
+			      << ret
+			      << dendl;
+        }
+      });
+
+      if (going_down()) {
+        return 0;
+      }
+
+      ret = progress.processed(obj_key, ol.next_has_same_name());
+      if (ret < 0) {
+        ldpp_dout(this, 5) << "WARNING: failed to save lc marker for shard="
+			   << shard_id << " ret=" << ret << dendl;
+      }
+    }
+    ret = ol.get_error();
+    if (ret < 0) {
+      if (ret == (-ENOENT))
+        return 0;
+      return ret;
+    }
+
+    progress.finish();
+  }
+
+  return 0;
+}
+
 int RGWLC::bucket_lc_process(string& shard_id)
 {
   RGWLifecycleConfiguration  config(cct);
@@ -982,56 +1158,61 @@ int RGWLC::bucket_lc_process(string& shard_id)
 		      << prefix_map.size()
 		      << dendl;
 
-  rgw_obj_key pre_marker;
-  rgw_obj_key next_marker;
-  for(auto prefix_iter = prefix_map.begin(); prefix_iter != prefix_map.end(); ++prefix_iter) {
-    auto& op = prefix_iter->second;
+  vector<lc_op*> ops;
+  LCPrefixMatcher matcher;
+  for (auto& [prefix, op] : prefix_map) {
     if (!is_valid_op(op)) {
       continue;
     }
-    ldpp_dout(this, 20) << __func__ << "(): prefix=" << prefix_iter->first << dendl;
-    if (prefix_iter != prefix_map.begin() && 
-        (prefix_iter->first.compare(0, prev(prefix_iter)->first.length(), prev(prefix_iter)->first) == 0)) {
-      next_marker = pre_marker;
-    } else {
-      pre_marker = next_marker;
+    matcher.add(prefix, ops.size());
+    ops.push_back(&op);
+  }
+
+  const string progress_oid = lc_progress_oid_prefix + shard_id;
+  if (!matcher.empty()) {
+    /* the bucket index shards are processed in parallel, each worker
+     * taking the next shard when it's done with its current one */
+    const int num_shards = std::max<int>(bucket_info.num_shards, 1);
+    const int num_workers = std::min<int64_t>(
+      std::max<int64_t>(cct->_conf.get_val<int64_t>("rgw_lc_max_wp_worker"), 1),
+      num_shards);
+    std::atomic<int> next_shard{0};
+    std::mutex lock;
+    int shard_ret = 0;
+    auto work = [&] {
+      for (int i = next_shard++; i < num_shards && !going_down(); i = next_shard++) {
+        int r = bucket_lc_process_shard(
+	  bucket_info, progress_oid,
+	  bucket_info.num_shards > 0 ? i : RGW_NO_SHARD, matcher, ops);
+        if (r < 0) {
+          std::lock_guard<std::mutex> l(lock);
+          if (shard_ret == 0) {
+            shard_ret = r;
+          }
+        }
+      }
+    };
+    vector<std::thread> threads;
+    for (int i = 1; i < num_workers; i++) {
+      threads.push_back(make_named_thread("lc_shard", work));
     }
-
-    LCObjsLister ol(store, bucket_info);
-    ol.set_prefix(prefix_iter->first);
-
-    ret = ol.init();
-
-    if (ret < 0) {
-      if (ret == (-ENOENT))
-        return 0;
-      ldpp_dout(this, 0) << "ERROR: store->list_objects():" <<dendl;
-      return ret;
+    work();
+    for (auto& t : threads) {
+      t.join();
     }
-
-    op_env oenv(op, store, this, bucket_info, ol);
-
-    LCOpRule orule(oenv);
-
-    orule.build();
-
-    rgw_bucket_dir_entry o;
-    for (; ol.get_obj(&o); ol.next()) {
-      ldpp_dout(this, 20) << __func__ << "(): key=" << o.key << dendl;
-      int ret = orule.process(o, this);
-      if (ret < 0) {
-        ldpp_dout(this, 20) << "ERROR: orule.process() returned ret="
-			    << ret
-			    << dendl;
-      }
-
-      if (going_down()) {
-        return 0;
-      }
+    if (shard_ret < 0) {
+      return shard_ret;
+    }
+    if (going_down()) {
+      /* left failed, so the next cycle resumes from the saved markers */
+      return -EINTR;
     }
   }
 
   ret = handle_multipart_expiration(&target, prefix_map);
+  if (ret == 0 && !going_down()) {
+    store->lc_pool_ctx.remove(progress_oid);
+  }
 
   return ret;
 }
@@ -1061,6 +1242,7 @@ int RGWLC::bucket_lc_post(int index, int max_lock_sec, pair<string, int >& entry
         ldpp_dout(this, 0) << "RGWLC::bucket_lc_post() failed to remove entry "
             << obj_names[index] << dendl;
       }
+      store->lc_pool_ctx.remove(lc_progress_oid_prefix + entry.first);
       goto clean;
     } else if (result < 0) {
       entry.second = lc_failed;
@@ -1197,19 +1379,23 @@ exit:
 
 void RGWLC::start_processor()
 {
-  worker = new LCWorker(this, cct, this);
-  worker->create("lifecycle_thr");
+  /* the workers claim buckets under the lc shard lock, so they process
+   * different buckets in parallel */
+  auto num_workers = cct->_conf.get_val<int64_t>("rgw_lc_max_worker");
+  for (int64_t i = 0; i < num_workers; i++) {
+    workers.emplace_back(std::make_unique<LCWorker>(this, cct, this));
+    workers.back()->create("lifecycle_thr");
+  }
 }
 
 void RGWLC::stop_processor()
 {
   down_flag = true;
-  if (worker) {
+  for (auto& worker : workers) {
     worker->stop();
     worker->join();
   }
-  delete worker;
-  worker = NULL;
+  workers.clear();
 }
 
 
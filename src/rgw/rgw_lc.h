@@ -5,8 +5,12 @@
 #define CEPH_RGW_LC_H
 
 #include <map>
+#include <memory>
 #include <string>
 #include <iostream>
+#include <set>
+#include <string_view>
+#include <vector>
 
 #include "common/debug.h"
 
@@ -28,6 +32,7 @@
 #define MAX_ID_LEN 255
 static string lc_oid_prefix = "lc";
 static string lc_index_lock_name = "lc_process";
+static string lc_progress_oid_prefix = "lc_progress.";
 
 extern const char* LC_STATUS[];
 
@@ -451,6 +456,84 @@ public:
 };
 WRITE_CLASS_ENCODER(RGWLifecycleConfiguration)
 
+/*
+ * Maps object names to the rules whose prefix they start with, so that a
+ * bucket is listed once for all the rules under a common prefix instead of
+ * once per rule. A name is looked up at each distinct prefix length, which
+ * visits the matching rules in the same order as the prefix map.
+ */
+class LCPrefixMatcher {
+  std::map<string, vector<size_t>, std::less<>> rules;
+  std::set<size_t> lengths;
+
+public:
+  void add(const string& prefix, size_t rule) {
+    rules[prefix].push_back(rule);
+    lengths.insert(prefix.size());
+  }
+
+  bool empty() const {
+    return rules.empty();
+  }
+
+  /* the prefixes to list: those that don't extend another rule's prefix */
+  vector<string> get_list_prefixes() const {
+    vector<string> prefixes;
+    for (auto& r : rules) {
+      if (prefixes.empty() ||
+	  r.first.compare(0, prefixes.back().size(), prefixes.back()) != 0) {
+        prefixes.push_back(r.first);
+      }
+    }
+    return prefixes;
+  }
+
+  template <typename F>
+  void match(std::string_view name, F&& f) const {
+    for (auto len : lengths) {
+      if (len > name.size()) {
+        break;
+      }
+      auto iter = rules.find(name.substr(0, len));
+      if (iter == rules.end()) {
+        continue;
+      }
+      for (auto rule : iter->second) {
+        f(rule);
+      }
+    }
+  }
+};
+
+/*
+ * The listing marker of one bucket index shard and prefix, saved in the
+ * bucket's lc_progress object every interval entries so that an interrupted
+ * run resumes where it stopped. A marker is only saved at the last version
+ * of a name, as the noncurrent rules look at the version listed before them.
+ */
+class LCShardProgress {
+  librados::IoCtx& ioctx;
+  const string oid;
+  const string key;
+  const uint32_t interval;
+  uint32_t count{0};
+
+public:
+  static constexpr uint32_t default_interval = 1000;
+
+  LCShardProgress(librados::IoCtx& _ioctx, const string& _oid,
+                  int num_shards, int shard_id, const string& prefix,
+                  uint32_t _interval = default_interval);
+
+  /* the key the listing resumes after, or -ENOENT */
+  int read(rgw_obj_key *marker);
+  /* count a processed entry, and save it as the marker once the interval
+   * is reached, unless more versions of its name follow */
+  int processed(const rgw_obj_key& entry, bool more_versions);
+  /* drop the marker once the shard is done */
+  int finish();
+};
+
 class RGWLC : public DoutPrefixProvider {
   CephContext *cct;
   RGWRados *store;
@@ -474,9 +557,10 @@ class RGWLC : public DoutPrefixProvider {
     int schedule_next_start_time(utime_t& start, utime_t& now);
   };
   
+  std::vector<std::unique_ptr<LCWorker>> workers;
+
   public:
-  LCWorker *worker;
-  RGWLC() : cct(NULL), store(NULL), worker(NULL) {}
+  RGWLC() : cct(NULL), store(NULL) {}
   ~RGWLC() {
     stop_processor();
     finalize();
@@ -509,6 +593,10 @@ class RGWLC : public DoutPrefixProvider {
 
   int handle_multipart_expiration(RGWRados::Bucket *target,
 				  const multimap<string, lc_op>& prefix_map);
+  int bucket_lc_process_shard(RGWBucketInfo& bucket_info,
+			      const string& progress_oid, int shard_id,
+			      const LCPrefixMatcher& matcher,
+			      const vector<lc_op*>& ops);
 };
 
 namespace rgw::lc {
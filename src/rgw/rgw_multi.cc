@@ -214,6 +214,154 @@ int list_multipart_parts(RGWRados *store, struct req_state *s,
   return list_multipart_parts(store, s->bucket_info, s->cct, upload_id, meta_oid, num_parts, marker, parts, next_marker, truncated, assume_unsorted);
 }
 
+RGWMultipartPartsReader::~RGWMultipartPartsReader()
+{
+  if (completion) {
+    /* the read still refers to our members */
+    completion->wait_for_complete();
+    completion->release();
+  }
+}
+
+int RGWMultipartPartsReader::init(const RGWBucketInfo& bucket_info,
+                                  const string& upload_id,
+                                  const string& meta_oid)
+{
+  rgw_obj obj;
+  obj.init_ns(bucket_info.bucket, meta_oid, RGW_OBJ_NS_MULTIPART);
+  obj.set_in_extra_data(true);
+  store->obj_to_raw(bucket_info.placement_rule, obj, &raw_obj);
+
+  if (!is_v2_upload_id(upload_id)) {
+    return read_unsorted(1);
+  }
+
+  int r = store->get_raw_obj_ref(raw_obj, &ref);
+  if (r < 0) {
+    return r;
+  }
+  sorted = true;
+
+  char buf[32];
+  snprintf(buf, sizeof(buf), "part.%08d", 0);
+  return start_read(buf);
+}
+
+int RGWMultipartPartsReader::start_read(const string& after)
+{
+  librados::ObjectReadOperation op;
+  vals.clear();
+  more = false;
+  rval = 0;
+  op.omap_get_vals2(after, max_parts, &vals, &more, &rval);
+
+  completion = librados::Rados::aio_create_completion(nullptr, nullptr, nullptr);
+  int r = ref.ioctx.aio_operate(ref.obj.oid, completion, &op, nullptr);
+  if (r < 0) {
+    completion->release();
+    completion = nullptr;
+  }
+  return r;
+}
+
+int RGWMultipartPartsReader::wait_read()
+{
+  completion->wait_for_complete();
+  int r = completion->get_return_value();
+  completion->release();
+  completion = nullptr;
+  if (r < 0) {
+    return r;
+  }
+  return rval;
+}
+
+int RGWMultipartPartsReader::read_unsorted(uint32_t first_num)
+{
+  auto obj_ctx = store->svc.sysobj->init_obj_ctx();
+  auto sysobj = obj_ctx.get_obj(raw_obj);
+
+  map<string, bufferlist> parts_map;
+  int r = sysobj.omap().get_all(&parts_map, null_yield);
+  if (r < 0) {
+    return r;
+  }
+
+  sorted = false;
+  unsorted_parts.clear();
+  for (auto& i : parts_map) {
+    RGWUploadPartInfo info;
+    try {
+      auto bli = i.second.cbegin();
+      decode(info, bli);
+    } catch (buffer::error& err) {
+      ldout(cct, 0) << "ERROR: could not part info, caught buffer::error" << dendl;
+      return -EIO;
+    }
+    if (info.num >= first_num) {
+      unsorted_parts[info.num] = std::move(info);
+    }
+  }
+  return 0;
+}
+
+int RGWMultipartPartsReader::next(map<uint32_t, RGWUploadPartInfo>& parts,
+                                  bool *truncated)
+{
+  parts.clear();
+
+  if (!sorted) {
+    auto i = unsorted_parts.begin();
+    for (uint32_t n = 0; n < max_parts && i != unsorted_parts.end(); ++n) {
+      parts.insert(unsorted_parts.extract(i++));
+    }
+    *truncated = !unsorted_parts.empty();
+    return 0;
+  }
+
+  int r = wait_read();
+  if (r < 0) {
+    return r;
+  }
+  map<string, bufferlist> page;
+  page.swap(vals);
+  const bool page_more = more && !page.empty();
+  if (page_more) {
+    r = start_read(page.rbegin()->first);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  const uint32_t page_start = expected_next;
+  for (auto& i : page) {
+    RGWUploadPartInfo info;
+    try {
+      auto bli = i.second.cbegin();
+      decode(info, bli);
+    } catch (buffer::error& err) {
+      ldout(cct, 0) << "ERROR: could not part info, caught buffer::error" << dendl;
+      return -EIO;
+    }
+    if (info.num != expected_next) {
+      /* a part is missing, or a gateway that doesn't sort the omap keys
+       * worked on this upload.  see list_multipart_parts() */
+      if (completion) {
+        wait_read();
+      }
+      r = read_unsorted(page_start);
+      if (r < 0) {
+        return r;
+      }
+      return next(parts, truncated);
+    }
+    ++expected_next;
+    parts[info.num] = std::move(info);
+  }
+  *truncated = page_more;
+  return 0;
+}
+
 int abort_multipart_upload(RGWRados *store, CephContext *cct, RGWObjectCtx *obj_ctx, RGWBucketInfo& bucket_info, RGWMPObj& mp_obj)
 {
   rgw_obj meta_obj;
@@ -224,12 +372,15 @@ int abort_multipart_upload(RGWRados *store, CephContext *cct, RGWObjectCtx *obj_
   list<rgw_obj_index_key> remove_objs;
   map<uint32_t, RGWUploadPartInfo> obj_parts;
   bool truncated;
-  int marker = 0;
   int ret;
 
+  RGWMultipartPartsReader parts_reader(store, cct, 1000);
+  ret = parts_reader.init(bucket_info, mp_obj.get_upload_id(), mp_obj.get_meta());
+  if (ret < 0)
+    return (ret == -ENOENT) ? -ERR_NO_SUCH_UPLOAD : ret;
+
   do {
-    ret = list_multipart_parts(store, bucket_info, cct, mp_obj.get_upload_id(), mp_obj.get_meta(), 1000,
-      marker, obj_parts, &marker, &truncated);
+    ret = parts_reader.next(obj_parts, &truncated);
     if (ret < 0)
       return (ret == -ENOENT) ? -ERR_NO_SUCH_UPLOAD : ret;
     for (auto obj_iter = obj_parts.begin(); obj_iter != obj_parts.end(); ++obj_iter) {
@@ -98,6 +98,49 @@ extern int list_multipart_parts(RGWRados *store, struct req_state *s,
                                 int *next_marker, bool *truncated,
                                 bool assume_unsorted = false);
 
+/**
+ * Reads the parts of a multipart upload in part number order, a page at a
+ * time.  When the upload's omap keys sort by part number, the read of the
+ * next page is in flight while the caller works on the current one.  The
+ * parts of older uploads are listed once, rather than once for every page
+ * as list_multipart_parts() has to.
+ */
+class RGWMultipartPartsReader {
+  RGWRados *store;
+  CephContext *cct;
+  const uint32_t max_parts;
+
+  rgw_raw_obj raw_obj;
+  rgw_rados_ref ref;
+  bool sorted{false};
+
+  /* the page being read ahead */
+  librados::AioCompletion *completion{nullptr};
+  map<string, bufferlist> vals;
+  bool more{false};
+  int rval{0};
+  uint32_t expected_next{1};
+
+  /* all the remaining parts of an unsorted upload */
+  map<uint32_t, RGWUploadPartInfo> unsorted_parts;
+
+  int start_read(const string& after);
+  int wait_read();
+  int read_unsorted(uint32_t first_num);
+
+public:
+  RGWMultipartPartsReader(RGWRados *_store, CephContext *_cct,
+                          uint32_t _max_parts)
+    : store(_store), cct(_cct), max_parts(_max_parts) {}
+  ~RGWMultipartPartsReader();
+
+  int init(const RGWBucketInfo& bucket_info, const string& upload_id,
+           const string& meta_oid);
+
+  /// return the next page of up to max_parts parts
+  int next(map<uint32_t, RGWUploadPartInfo>& parts, bool *truncated);
+};
+
 extern int abort_multipart_upload(RGWRados *store, CephContext *cct, RGWObjectCtx *obj_ctx,
                                 RGWBucketInfo& bucket_info, RGWMPObj& mp_obj);
 
@@ -2419,6 +2419,14 @@ void RGWSetBucketVersioning::execute()
   if (op_ret < 0)
     return;
 
+  if (s->bucket_info.inline_data_enabled() &&
+      (versioning_status == VersioningEnabled ||
+       versioning_status == VersioningSuspended)) {
+    ldpp_dout(this, 5) << "versioning is not supported on buckets with inline data" << dendl;
+    op_ret = -ERR_INVALID_BUCKET_STATE;
+    return;
+  }
+
   bool cur_mfa_status = (s->bucket_info.flags & BUCKET_MFA_ENABLED) != 0;
 
   mfa_set_status &= (mfa_status != cur_mfa_status);
@@ -3740,7 +3748,10 @@ void RGWPutObj::execute()
       ldpp_dout(this, 1) << "Cannot load plugin for compression type "
           << compression_type << dendl;
     } else {
-      compressor.emplace(s->cct, plugin, filter);
+      compressor.emplace(s->cct, plugin, filter,
+                         rgw::putobj::TransformPool::get(s->cct),
+                         rgw::putobj::TransformPool::get_max_pending(s->cct),
+                         s->yield);
       filter = &*compressor;
     }
   }
@@ -4035,7 +4046,10 @@ void RGWPostObj::execute()
           ldpp_dout(this, 1) << "Cannot load plugin for compression type "
                            << compression_type << dendl;
         } else {
-          compressor.emplace(s->cct, plugin, filter);
+          compressor.emplace(s->cct, plugin, filter,
+                         rgw::putobj::TransformPool::get(s->cct),
+                         rgw::putobj::TransformPool::get_max_pending(s->cct),
+                         s->yield);
           filter = &*compressor;
         }
       }
@@ -5635,7 +5649,6 @@ void RGWCompleteMultipart::execute()
   int total_parts = 0;
   int handled_parts = 0;
   int max_parts = 1000;
-  int marker = 0;
   bool truncated;
   RGWCompressionInfo cs_info;
   bool compressed = false;
@@ -5682,9 +5695,17 @@ void RGWCompleteMultipart::execute()
     return;
   }
 
+  /* the next page of parts is read while this one is added to the manifest */
+  RGWMultipartPartsReader parts_reader(store, s->cct, max_parts);
+  op_ret = parts_reader.init(s->bucket_info, upload_id, meta_oid);
+  if (op_ret == -ENOENT) {
+    op_ret = -ERR_NO_SUCH_UPLOAD;
+  }
+  if (op_ret < 0)
+    return;
+
   do {
-    op_ret = list_multipart_parts(store, s, upload_id, meta_oid, max_parts,
-				  marker, obj_parts, &marker, &truncated);
+    op_ret = parts_reader.next(obj_parts, &truncated);
     if (op_ret == -ENOENT) {
       op_ret = -ERR_NO_SUCH_UPLOAD;
     }
@@ -5784,6 +5805,9 @@ void RGWCompleteMultipart::execute()
   } while (truncated);
   hash.Final((unsigned char *)final_etag);
 
+  manifest.set_compact_rules(
+    s->cct->_conf.get_val<bool>("rgw_multipart_compact_manifest"));
+
   buf_to_hex((unsigned char *)final_etag, sizeof(final_etag), final_etag_str);
   snprintf(&final_etag_str[CEPH_CRYPTO_MD5_DIGESTSIZE * 2],  sizeof(final_etag_str) - CEPH_CRYPTO_MD5_DIGESTSIZE * 2,
            "-%lld", (long long)parts->parts.size());
@@ -6775,7 +6799,10 @@ int RGWBulkUploadOp::handle_file(const boost::string_ref path,
       ldpp_dout(this, 1) << "Cannot load plugin for rgw_compression_type "
           << compression_type << dendl;
     } else {
-      compressor.emplace(s->cct, plugin, filter);
+      compressor.emplace(s->cct, plugin, filter,
+                         rgw::putobj::TransformPool::get(s->cct),
+                         rgw::putobj::TransformPool::get_max_pending(s->cct),
+                         s->yield);
       filter = &*compressor;
     }
   }
@@ -30,6 +30,7 @@ int rgw_perf_start(CephContext *cct)
 
   plb.add_u64_counter(l_rgw_cache_hit, "cache_hit", "Cache hits");
   plb.add_u64_counter(l_rgw_cache_miss, "cache_miss", "Cache miss");
+  plb.add_u64_counter(l_rgw_cache_evict, "cache_evict", "Cache entries evicted");
 
   plb.add_u64_counter(l_rgw_keystone_token_cache_hit, "keystone_token_cache_hit", "Keystone token cache hits");
   plb.add_u64_counter(l_rgw_keystone_token_cache_miss, "keystone_token_cache_miss", "Keystone token cache miss");
@@ -42,7 +43,14 @@ int rgw_perf_start(CephContext *cct)
   plb.add_u64_counter(l_rgw_pubsub_push_ok, "pubsub_push_ok", "Pubsub events pushed to an endpoint");
   plb.add_u64_counter(l_rgw_pubsub_push_failed, "pubsub_push_failed", "Pubsub events failed to be pushed to an endpoint");
   plb.add_u64(l_rgw_pubsub_push_pending, "pubsub_push_pending", "Pubsub events pending reply from endpoint");
+  plb.add_u64_counter(l_rgw_pubsub_push_queued, "pubsub_push_queued", "Pubsub events queued for delivery to an endpoint");
   plb.add_u64_counter(l_rgw_pubsub_missing_conf, "pubsub_missing_conf", "Pubsub events could not be handled because of missing configuration");
+
+  plb.add_u64_counter(l_rgw_http_req, "http_req", "Requests sent by the http client");
+  plb.add_u64_counter(l_rgw_http_conn_new, "http_conn_new", "Connections opened by the http client");
+  plb.add_u64_counter(l_rgw_http_conn_reused, "http_conn_reused", "Http client requests that reused an open connection");
+  plb.add_time_avg(l_rgw_http_connect_lat, "http_connect_lat", "Http client connect latency");
+  plb.add_time_avg(l_rgw_http_handshake_lat, "http_handshake_lat", "Http client tls handshake latency");
   
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
@@ -56,3 +64,66 @@ void rgw_perf_stop(CephContext *cct)
   delete perfcounter;
 }
 
+PerfCounters *rgw_chained_cache_perf_start(CephContext *cct,
+					   const std::string& name)
+{
+  PerfCountersBuilder plb(cct, "rgw_cache_" + name, l_rgw_chained_cache_first,
+			  l_rgw_chained_cache_last);
+  plb.set_prio_default(PerfCountersBuilder::PRIO_USEFUL);
+
+  plb.add_u64_counter(l_rgw_chained_cache_hit, "hit", "Cache hits");
+  plb.add_u64_counter(l_rgw_chained_cache_miss, "miss", "Cache miss");
+  plb.add_u64_counter(l_rgw_chained_cache_invalidate, "invalidate",
+		      "Cache entries evicted or invalidated");
+
+  PerfCounters *counters = plb.create_perf_counters();
+  cct->get_perfcounters_collection()->add(counters);
+  return counters;
+}
+
+void rgw_chained_cache_perf_stop(CephContext *cct, PerfCounters *counters)
+{
+  cct->get_perfcounters_collection()->remove(counters);
+  delete counters;
+}
+
+PerfCounters *rgw_gc_perf_start(CephContext *cct)
+{
+  PerfCountersBuilder plb(cct, "rgw_gc", l_rgw_gc_first, l_rgw_gc_last);
+  plb.set_prio_default(PerfCountersBuilder::PRIO_USEFUL);
+
+  plb.add_u64(l_rgw_gc_io_window, "io_window",
+	      "Tail object removals allowed in flight");
+  plb.add_time_avg(l_rgw_gc_io_lat, "io_lat", "Tail object removal latency");
+  plb.add_u64_counter(l_rgw_gc_io_failed, "io_failed",
+		      "Tail object removals that failed");
+
+  PerfCounters *counters = plb.create_perf_counters();
+  cct->get_perfcounters_collection()->add(counters);
+  return counters;
+}
+
+PerfCounters *rgw_gc_shard_perf_start(CephContext *cct, int index)
+{
+  PerfCountersBuilder plb(cct, "rgw_gc_shard." + std::to_string(index),
+			  l_rgw_gc_shard_first, l_rgw_gc_shard_last);
+  plb.set_prio_default(PerfCountersBuilder::PRIO_USEFUL);
+
+  plb.add_u64_counter(l_rgw_gc_shard_entries, "entries",
+		      "Entries removed from the shard");
+  plb.add_u64_counter(l_rgw_gc_shard_objs, "objs",
+		      "Tail objects removed for the shard's entries");
+  plb.add_time(l_rgw_gc_shard_oldest, "oldest_expired",
+	       "Time since the oldest entry due for removal expired, "
+	       "when the shard was last processed");
+
+  PerfCounters *counters = plb.create_perf_counters();
+  cct->get_perfcounters_collection()->add(counters);
+  return counters;
+}
+
+void rgw_gc_perf_stop(CephContext *cct, PerfCounters *counters)
+{
+  cct->get_perfcounters_collection()->remove(counters);
+  delete counters;
+}
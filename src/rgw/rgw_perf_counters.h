@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <string>
+
 class CephContext;
 class PerfCounters;
 
@@ -11,6 +13,17 @@ extern PerfCounters *perfcounter;
 extern int rgw_perf_start(CephContext *cct);
 extern void rgw_perf_stop(CephContext *cct);
 
+// the counters of a cache chained to the metadata cache, e.g. bucket info
+extern PerfCounters *rgw_chained_cache_perf_start(CephContext *cct,
+						  const std::string& name);
+extern void rgw_chained_cache_perf_stop(CephContext *cct,
+					PerfCounters *counters);
+
+// the counters of the garbage collector, and of each of its shards
+extern PerfCounters *rgw_gc_perf_start(CephContext *cct);
+extern PerfCounters *rgw_gc_shard_perf_start(CephContext *cct, int index);
+extern void rgw_gc_perf_stop(CephContext *cct, PerfCounters *counters);
+
 enum {
   l_rgw_first = 15000,
   l_rgw_req,
@@ -29,6 +42,7 @@ enum {
 
   l_rgw_cache_hit,
   l_rgw_cache_miss,
+  l_rgw_cache_evict,
 
   l_rgw_keystone_token_cache_hit,
   l_rgw_keystone_token_cache_miss,
@@ -41,8 +55,38 @@ enum {
   l_rgw_pubsub_push_ok,
   l_rgw_pubsub_push_failed,
   l_rgw_pubsub_push_pending,
+  l_rgw_pubsub_push_queued,
   l_rgw_pubsub_missing_conf,
 
+  l_rgw_http_req,
+  l_rgw_http_conn_new,
+  l_rgw_http_conn_reused,
+  l_rgw_http_connect_lat,
+  l_rgw_http_handshake_lat,
+
   l_rgw_last,
 };
 
+enum {
+  l_rgw_chained_cache_first = 15500,
+  l_rgw_chained_cache_hit,
+  l_rgw_chained_cache_miss,
+  l_rgw_chained_cache_invalidate,
+  l_rgw_chained_cache_last,
+};
+
+enum {
+  l_rgw_gc_first = 15600,
+  l_rgw_gc_io_window,
+  l_rgw_gc_io_lat,
+  l_rgw_gc_io_failed,
+  l_rgw_gc_last,
+};
+
+enum {
+  l_rgw_gc_shard_first = 15700,
+  l_rgw_gc_shard_entries,
+  l_rgw_gc_shard_objs,
+  l_rgw_gc_shard_oldest,
+  l_rgw_gc_shard_last,
+};
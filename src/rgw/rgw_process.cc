@@ -6,8 +6,11 @@
 #include "common/WorkQueue.h"
 #include "include/scope_guard.h"
 
+#include <boost/algorithm/string/predicate.hpp>
+
 #include "rgw_rados.h"
 #include "rgw_dmclock_scheduler.h"
+#include "rgw_dmclock_tenant_scheduler.h"
 #include "rgw_rest.h"
 #include "rgw_frontend.h"
 #include "rgw_request.h"
@@ -40,7 +43,97 @@ void RGWProcess::RGWWQ::_dump_queue()
   }
 } /* RGWProcess::RGWWQ::_dump_queue */
 
-auto schedule_request(Scheduler *scheduler, req_state *s, RGWOp *op)
+std::string rgw_get_request_access_key(const req_state *s)
+{
+  static constexpr std::string_view v4_prefix = "AWS4-HMAC-SHA256 ";
+  static constexpr std::string_view v2_prefix = "AWS ";
+  static constexpr std::string_view credential = "Credential=";
+
+  const char *auth = s->info.env->get("HTTP_AUTHORIZATION");
+  if (auth) {
+    std::string_view a{auth};
+    if (boost::algorithm::starts_with(a, v4_prefix)) {
+      const auto pos = a.find(credential);
+      if (pos == a.npos) {
+        return {};
+      }
+      a.remove_prefix(pos + credential.size());
+      return std::string{a.substr(0, a.find('/'))};
+    }
+    if (boost::algorithm::starts_with(a, v2_prefix)) {
+      a.remove_prefix(v2_prefix.size());
+      return std::string{a.substr(0, a.find(':'))};
+    }
+    return {};
+  }
+  bool exists = false;
+  const auto& key = s->info.args.get("AWSAccessKeyId", &exists);
+  if (exists) {
+    return key;
+  }
+  const auto& cred = s->info.args.get("X-Amz-Credential");
+  return cred.substr(0, cred.find('/'));
+}
+
+/* the bucket_tenant and bucket_name of req_state are set once the request
+ * is authenticated, which is too late for the scheduler. returns whether
+ * the tenant is that of the requester, whose RGW_ATTR_DMCLOCK_QOS is then
+ * read into user_qos */
+static bool get_qos_target(RGWRados *store, req_state *s,
+                           std::string& tenant, std::string& bucket,
+                           std::optional<rgw::dmclock::ClientInfo>& user_qos)
+{
+  const auto& url_bucket = s->init_state.url_bucket;
+  const auto pos = url_bucket.find(':');
+  if (pos != std::string::npos) {
+    tenant = url_bucket.substr(0, pos);
+    bucket = url_bucket.substr(pos + 1);
+    return false;
+  }
+  bucket = url_bucket.empty() ? s->bucket_name : url_bucket;
+  if (!s->bucket_tenant.empty()) {
+    tenant = s->bucket_tenant;
+    return false;
+  }
+  if (!store) {
+    return false;
+  }
+  const auto access_key = rgw_get_request_access_key(s);
+  if (access_key.empty()) {
+    return false;
+  }
+  /* both lookups are served from the caches auth and the user policy
+   * loading read again once the request runs */
+  RGWUserInfo info;
+  int r = rgw_get_user_info_by_access_key(store, access_key, info);
+  if (r < 0) {
+    /* left to auth to reject */
+    ldpp_dout(s, 10) << "no user for access key " << access_key
+        << ", scheduling for the default tenant" << dendl;
+    return false;
+  }
+  tenant = info.user_id.tenant;
+
+  map<string, bufferlist> attrs;
+  r = rgw_get_user_attrs_by_uid(store, info.user_id, attrs);
+  if (r < 0) {
+    ldpp_dout(s, 10) << "failed to read the attrs of " << info.user_id
+        << ": " << cpp_strerror(-r) << ", scheduling with the configured qos"
+        << dendl;
+    return false;
+  }
+  if (auto a = attrs.find(RGW_ATTR_DMCLOCK_QOS); a != attrs.end()) {
+    user_qos = rgw::dmclock::parse_tenant_qos(a->second.to_str());
+    if (!user_qos) {
+      ldpp_dout(s, 0) << "WARNING: ignoring invalid " RGW_ATTR_DMCLOCK_QOS
+          " of " << info.user_id << dendl;
+    }
+  }
+  return true;
+}
+
+std::pair<int, rgw::dmclock::SchedulerCompleter>
+schedule_request(Scheduler *scheduler, RGWRados *store, req_state *s, RGWOp *op)
 {
   using rgw::dmclock::SchedulerCompleter;
   if (!scheduler)
@@ -48,9 +141,18 @@ auto schedule_request(Scheduler *scheduler, req_state *s, RGWOp *op)
 
   const auto client = op->dmclock_client();
   const auto cost = op->dmclock_cost();
+  std::string tenant, bucket;
+  std::optional<rgw::dmclock::ClientInfo> user_qos;
+  bool from_user = false;
+  if (scheduler->uses_qos_target()) {
+    from_user = get_qos_target(store, s, tenant, bucket, user_qos);
+  }
   ldpp_dout(op,10) << "scheduling with dmclock client=" << static_cast<int>(client)
-		   << " cost=" << cost << dendl;
-  return scheduler->schedule_request(client, {},
+		   << " cost=" << cost << " tenant=" << tenant
+		   << " bucket=" << bucket << dendl;
+  const auto target = rgw::dmclock::qos_target{tenant, bucket, from_user,
+                                               user_qos};
+  return scheduler->schedule_request(client, target, {},
                                      req_state::Clock::to_double(s->time),
                                      cost,
                                      s->yield);
@@ -232,7 +334,7 @@ int process_request(RGWRados* const store,
     abort_early(s, NULL, -ERR_METHOD_NOT_ALLOWED, handler);
     goto done;
   }
-  std::tie(ret,c) = schedule_request(scheduler, s, op);
+  std::tie(ret,c) = schedule_request(scheduler, store, s, op);
   if (ret < 0) {
     if (ret == -EAGAIN) {
       ret = -ERR_RATE_LIMITED;
@@ -11,6 +11,7 @@
 #include "rgw_user.h"
 #include "rgw_op.h"
 #include "rgw_rest.h"
+#include "rgw_dmclock_scheduler.h"
 
 #include "include/ceph_assert.h"
 
@@ -28,10 +29,6 @@
 
 extern void signal_shutdown();
 
-namespace rgw::dmclock {
-  class Scheduler;
-}
-
 struct RGWProcessEnv {
   RGWRados *store;
   RGWREST *rest;
@@ -184,6 +181,19 @@ extern int process_request(RGWRados* store,
                            rgw::dmclock::Scheduler *scheduler,
                            int* http_ret = nullptr);
 
+/* the access key id of the request's credentials, from its authorization
+ * header or the query of a presigned url, or empty if anonymous */
+extern std::string rgw_get_request_access_key(const req_state* s);
+
+/* schedule the request, before it's authenticated. schedulers that use the
+ * qos_target get the bucket from the url, which names it as "tenant:bucket"
+ * or as "bucket" of the tenant owning the access key; the key's user and
+ * its attrs, which may hold the tenant's qos, are looked up in that case,
+ * if a store is given */
+extern std::pair<int, rgw::dmclock::SchedulerCompleter>
+schedule_request(rgw::dmclock::Scheduler* scheduler, RGWRados* store,
+                 req_state* s, RGWOp* op);
+
 extern int rgw_process_authenticated(RGWHandler_REST* handler,
                                      RGWOp*& op,
                                      RGWRequest* req,
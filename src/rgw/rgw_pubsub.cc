@@ -393,6 +393,33 @@ int RGWUserPubSub::Sub::remove_sub(RGWObjVersionTracker *objv_tracker)
   return 0;
 }
 
+int RGWUserPubSub::Sub::remove_push_queue()
+{
+  RGWRados *store = ps->store;
+  const auto& pool = store->svc.zone->get_zone_params().log_pool;
+  const string queue_id = get_push_queue_id(ps->user, sub);
+
+  // the delivery threads resume the queues listed in the registry, so drop
+  // the entry before the queue
+  rgw_rados_ref ref;
+  int ret = store->get_raw_obj_ref(rgw_raw_obj(pool, pubsub_push_queue_registry_oid), &ref);
+  if (ret < 0) {
+    ldout(store->ctx(), 1) << "ERROR: failed to get ref for push queue registry: ret=" << ret << dendl;
+    return ret;
+  }
+  ret = ref.ioctx.omap_rm_keys(ref.obj.oid, {queue_id});
+  if (ret < 0 && ret != -ENOENT) {
+    ldout(store->ctx(), 1) << "ERROR: failed to remove push queue registry entry: ret=" << ret << dendl;
+    return ret;
+  }
+  ret = rgw_delete_system_obj(store, pool, pubsub_push_queue_oid_prefix + queue_id, nullptr);
+  if (ret < 0 && ret != -ENOENT) {
+    ldout(store->ctx(), 1) << "ERROR: failed to remove push queue: ret=" << ret << dendl;
+    return ret;
+  }
+  return 0;
+}
+
 int RGWUserPubSub::Sub::get_conf(rgw_pubsub_sub_config *result)
 {
   return read_sub(result, nullptr);
@@ -481,6 +508,12 @@ int RGWUserPubSub::Sub::unsubscribe(const string& _topic)
     }
   }
 
+  // before the subscription info, so that a failure can be retried
+  ret = remove_push_queue();
+  if (ret < 0) {
+    return ret;
+  }
+
   ret = remove_sub(&sobjv_tracker);
   if (ret < 0) {
     ldout(store->ctx(), 1) << "ERROR: failed to delete subscription info: ret=" << ret << dendl;
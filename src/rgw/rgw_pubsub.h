@@ -410,6 +410,10 @@ struct rgw_pubsub_user_topics {
 WRITE_CLASS_ENCODER(rgw_pubsub_user_topics)
 
 static std::string pubsub_user_oid_prefix = "pubsub.user.";
+// push queues of the subscriptions, and the registry listing them, written by
+// the pubsub sync module when push_queue is configured
+static std::string pubsub_push_queue_oid_prefix = "pubsub.queue.";
+static std::string pubsub_push_queue_registry_oid = "pubsub.queues";
 
 class RGWUserPubSub
 {
@@ -496,6 +500,8 @@ public:
     int read_sub(rgw_pubsub_sub_config *result, RGWObjVersionTracker *objv_tracker);
     int write_sub(const rgw_pubsub_sub_config& sub_conf, RGWObjVersionTracker *objv_tracker);
     int remove_sub(RGWObjVersionTracker *objv_tracker);
+    // drop the push queue of the subscription and its registry entry
+    int remove_push_queue();
   public:
     Sub(RGWUserPubSub *_ps, const string& _sub) : ps(_ps), sub(_sub) {
       ps->get_sub_meta_obj(sub, &sub_meta_obj);
@@ -570,6 +576,14 @@ public:
     *obj = rgw_raw_obj(store->svc.zone->get_zone_params().log_pool, sub_meta_oid(name));
   }
 
+  // id of the subscription in the push queue registry
+  static string get_push_queue_id(const rgw_user& user, const string& name) {
+    if (user.empty()) {
+      return name;
+    }
+    return user.to_str() + "/" + name;
+  }
+
   // get all topics defined for the user and populate them into "result"
   // return 0 on success or if no topics exist, error code otherwise
   int get_user_topics(rgw_pubsub_user_topics *result);
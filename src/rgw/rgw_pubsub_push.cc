@@ -5,6 +5,7 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <vector>
 #include "include/buffer_fwd.h"
 #include "common/Formatter.h"
 #include "rgw_common.h"
@@ -30,6 +31,69 @@ std::string json_format_pubsub_event(const EventType& event) {
   return ss.str();
 }
 
+// format a batch of events as a json array, under the plural name of the event type
+template<typename EventType>
+std::string json_format_pubsub_events(const std::vector<EventType>& events) {
+  std::stringstream ss;
+  JSONFormatter f(false);
+  {
+    Formatter::ObjectSection s(f, "");
+    Formatter::ArraySection as(f, EventType::json_type_plural);
+    for (const auto& event : events) {
+      encode_json(EventType::json_type_single, event, &f);
+    }
+  }
+  f.flush(ss);
+  return ss.str();
+}
+
+// BatchCR sends each event of a batch via its own coroutine, concurrently,
+// and fails with the first error any of them returned
+template<typename EventType>
+class BatchCR : public RGWCoroutine {
+  RGWPubSubEndpoint* const endpoint;
+  RGWDataSyncEnv* const sync_env;
+  const std::vector<EventType> events;
+  typename std::vector<EventType>::const_iterator iter;
+  int child_ret = 0;
+  int ret = 0;
+
+public:
+  BatchCR(RGWPubSubEndpoint* _endpoint, RGWDataSyncEnv* _sync_env,
+          const std::vector<EventType>& _events) :
+    RGWCoroutine(_sync_env->cct), endpoint(_endpoint), sync_env(_sync_env),
+    events(_events) {}
+
+  int operate() override {
+    reenter(this) {
+      for (iter = events.begin(); iter != events.end(); ++iter) {
+        spawn(endpoint->send_to_completion_async(*iter, sync_env), false);
+      }
+      while (num_spawned() > 0) {
+        yield wait_for_child();
+        while (collect_next(&child_ret)) {
+          if (child_ret < 0 && ret == 0) {
+            ret = child_ret;
+          }
+        }
+      }
+      if (ret < 0) {
+        return set_cr_error(ret);
+      }
+      return set_cr_done();
+    }
+    return 0;
+  }
+};
+
+RGWCoroutine* RGWPubSubEndpoint::send_batch_to_completion_async(const std::vector<rgw_pubsub_event>& events, RGWDataSyncEnv* env) {
+  return new BatchCR<rgw_pubsub_event>(this, env, events);
+}
+
+RGWCoroutine* RGWPubSubEndpoint::send_batch_to_completion_async(const std::vector<rgw_pubsub_s3_record>& records, RGWDataSyncEnv* env) {
+  return new BatchCR<rgw_pubsub_s3_record>(this, env, records);
+}
+
 class RGWPubSubHTTPEndpoint : public RGWPubSubEndpoint {
 private:
   const std::string endpoint;
@@ -76,14 +140,22 @@ private:
     // wait for reply
     int request_complete() override {
       if (perfcounter) perfcounter->dec(l_rgw_pubsub_push_pending);
+      const auto rc = get_req_retcode();
+      if (rc < 0) {
+        // no reply was received
+        return rc;
+      }
+      const auto status = get_http_status();
       if (ack_level == ACK_LEVEL_ANY) {
         return 0;
       } else if (ack_level == ACK_LEVEL_NON_ERROR) {
-        // TODO check result code to be non-error
-      } else {
-        // TODO: check that result code == ack_level
+        if (status < 400) {
+          return 0;
+        }
+      } else if (status == static_cast<long>(ack_level)) {
+        return 0;
       }
-      return -1;
+      return -EIO;
     }
   };
 
@@ -125,6 +197,15 @@ public:
     return new PostCR(json_format_pubsub_event(record), env, endpoint, ack_level, verify_ssl);
   }
 
+  // a batch is sent as a single json document holding all the events
+  RGWCoroutine* send_batch_to_completion_async(const std::vector<rgw_pubsub_event>& events, RGWDataSyncEnv* env) override {
+    return new PostCR(json_format_pubsub_events(events), env, endpoint, ack_level, verify_ssl);
+  }
+
+  RGWCoroutine* send_batch_to_completion_async(const std::vector<rgw_pubsub_s3_record>& records, RGWDataSyncEnv* env) override {
+    return new PostCR(json_format_pubsub_events(records), env, endpoint, ack_level, verify_ssl);
+  }
+
   std::string to_str() const override {
     std::string str("HTTP/S Endpoint");
     str += "\nURI: " + endpoint;
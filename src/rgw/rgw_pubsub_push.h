@@ -5,6 +5,7 @@
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <vector>
 #include "include/buffer_fwd.h"
 
 // TODO the env should be used as a template parameter to differentiate the source that triggers the pushes
@@ -38,6 +39,15 @@ public:
   // in async manner via a coroutine
   virtual RGWCoroutine* send_to_completion_async(const rgw_pubsub_s3_record& record, RGWDataSyncEnv* env) = 0;
 
+  // this method is used in order to send a batch of notifications (Ceph specific) and wait for
+  // completion of all of them in async manner via a coroutine. the coroutine fails if any of
+  // them failed. by default each notification is sent separately and concurrently
+  virtual RGWCoroutine* send_batch_to_completion_async(const std::vector<rgw_pubsub_event>& events, RGWDataSyncEnv* env);
+
+  // this method is used in order to send a batch of notifications (S3 compliant) and wait for
+  // completion of all of them in async manner via a coroutine
+  virtual RGWCoroutine* send_batch_to_completion_async(const std::vector<rgw_pubsub_s3_record>& records, RGWDataSyncEnv* env);
+
   // present as string
   virtual std::string to_str() const { return ""; }
   
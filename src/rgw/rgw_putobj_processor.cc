@@ -316,6 +316,18 @@ int AtomicObjectProcessor::complete(size_t accounted_size,
   obj_op.meta.zones_trace = zones_trace;
   obj_op.meta.modify_tail = true;
 
+  // small unconditional writes to the standard storage class can skip the
+  // head object, and store the data in the bucket index entry instead
+  const auto inline_max_size = store->ctx()->_conf.get_val<Option::size_t>(
+      "rgw_inline_data_max_size");
+  obj_op.meta.inline_data = bucket_info.inline_data_enabled() &&
+      actual_size <= inline_max_size &&
+      first_chunk.length() == actual_size &&
+      !olh_epoch && head_obj.key.instance.empty() && head_obj.key.ns.empty() &&
+      !if_match && !if_nomatch &&
+      rgw_placement_rule::get_canonical_storage_class(
+          tail_placement_rule.storage_class) == RGW_STORAGE_CLASS_STANDARD;
+
   r = obj_op.write_meta(actual_size, accounted_size, attrs);
   if (r < 0) {
     return r;
@@ -0,0 +1,199 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#include "rgw_putobj_transform.h"
+
+#include "common/Thread.h"
+#include "common/ceph_context.h"
+
+namespace rgw::putobj {
+
+TransformPool::TransformPool(unsigned num_threads)
+{
+  threads.reserve(num_threads);
+  for (unsigned i = 0; i < num_threads; i++) {
+    threads.push_back(make_named_thread("rgw_transform",
+                                        &TransformPool::worker, this));
+  }
+}
+
+TransformPool::~TransformPool()
+{
+  {
+    std::lock_guard lock{mutex};
+    stopping = true;
+  }
+  cond.notify_all();
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+void TransformPool::worker()
+{
+  std::unique_lock lock{mutex};
+  for (;;) {
+    cond.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (queue.empty()) {
+      return;
+    }
+    auto fn = std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
+    fn();
+    lock.lock();
+  }
+}
+
+void TransformPool::post(std::function<void()>&& fn)
+{
+  {
+    std::lock_guard lock{mutex};
+    queue.push_back(std::move(fn));
+  }
+  cond.notify_one();
+}
+
+TransformPool* TransformPool::get(CephContext* cct)
+{
+  const auto num_threads =
+      cct->_conf.get_val<uint64_t>("rgw_put_obj_transform_threads");
+  if (num_threads == 0) {
+    return nullptr;
+  }
+  return &cct->lookup_or_create_singleton_object<TransformPool>(
+      "rgw::putobj::TransformPool", true, num_threads);
+}
+
+size_t TransformPool::get_max_pending(CephContext* cct)
+{
+  return cct->_conf.get_val<uint64_t>("rgw_put_obj_transform_max_pending");
+}
+
+
+TransformQueue::~TransformQueue()
+{
+  // the results are dropped, but the transforms may still reference the
+  // owner's state
+  std::unique_lock lock{mutex};
+  for (auto& job : pending) {
+    cond.wait(lock, [&job] { return job->done; });
+  }
+}
+
+void TransformQueue::wait(std::unique_lock<ceph::mutex>& lock, const Job& job)
+{
+  if (job.done) {
+    return;
+  }
+#ifdef HAVE_BOOST_CONTEXT
+  if (y) {
+    // the pool thread that finishes the job posts the waiter to the
+    // coroutine's executor
+    using boost::asio::async_completion;
+    using Signature = void(boost::system::error_code);
+    boost::system::error_code ec;
+    auto yield = y.get_yield_context()[ec];
+    async_completion<decltype(yield), Signature> init(yield);
+    waiter = Waiter::create(y.get_io_context().get_executor(),
+                            std::move(init.completion_handler));
+    waiting = &job;
+    lock.unlock();
+    init.result.get();
+    lock.lock();
+    return;
+  }
+#endif
+  cond.wait(lock, [&job] { return job.done; });
+}
+
+int TransformQueue::complete_front()
+{
+  auto job = std::move(pending.front());
+  pending.pop_front();
+  {
+    std::unique_lock lock{mutex};
+    wait(lock, *job);
+  }
+  int r = complete(job->result, std::move(job->in), std::move(job->out),
+                   job->offset);
+  if (r < 0 && error == 0) {
+    error = r;
+  }
+  return r;
+}
+
+bool TransformQueue::front_done()
+{
+  std::lock_guard lock{mutex};
+  return pending.front()->done;
+}
+
+int TransformQueue::submit(bufferlist&& in, uint64_t offset,
+                           Transform&& transform)
+{
+  if (error < 0) {
+    return error;
+  }
+  while (pending.size() >= max_pending) {
+    int r = complete_front();
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  auto job = std::make_shared<Job>();
+  job->in = std::move(in);
+  job->offset = offset;
+  if (!transform) {
+    job->done = true;
+  } else if (!pool) {
+    job->result = transform(job->in, job->out);
+    job->done = true;
+  } else {
+    pool->post([this, job, transform = std::move(transform)] {
+        int r = transform(job->in, job->out);
+        std::lock_guard lock{mutex};
+        job->result = r;
+        job->done = true;
+        if (waiting == job.get()) {
+          waiting = nullptr;
+          ceph::async::post(std::move(waiter), boost::system::error_code{});
+        }
+        cond.notify_all();
+      });
+  }
+  pending.push_back(std::move(job));
+
+  // pass on whatever is ready, so the writes overlap with the transforms
+  while (!pending.empty() && front_done()) {
+    int r = complete_front();
+    if (r < 0) {
+      return r;
+    }
+  }
+  return 0;
+}
+
+int TransformQueue::drain()
+{
+  while (!pending.empty()) {
+    int r = complete_front();
+    if (r < 0) {
+      return r;
+    }
+  }
+  return error;
+}
+
+} // namespace rgw::putobj
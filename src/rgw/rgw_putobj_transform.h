@@ -0,0 +1,117 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "common/async/completion.h"
+#include "common/async/yield_context.h"
+#include "include/buffer.h"
+
+class CephContext;
+
+namespace rgw::putobj {
+
+// a set of threads shared by all requests, to run the cpu-heavy transforms
+// of object data (compression and encryption) off the frontend threads
+class TransformPool {
+  ceph::mutex mutex = ceph::make_mutex("rgw::putobj::TransformPool");
+  ceph::condition_variable cond;
+  std::deque<std::function<void()>> queue;
+  std::vector<std::thread> threads;
+  bool stopping = false;
+
+  void worker();
+ public:
+  explicit TransformPool(unsigned num_threads);
+  ~TransformPool();
+
+  void post(std::function<void()>&& fn);
+
+  // return the process-wide pool sized by rgw_put_obj_transform_threads,
+  // or nullptr if transforms should run inline
+  static TransformPool* get(CephContext* cct);
+  // the number of buffers each request may have in flight
+  static size_t get_max_pending(CephContext* cct);
+};
+
+// runs the transforms of a stream of buffers on a TransformPool, with up to
+// max_pending of them in flight. each result is passed to the completion in
+// the order the buffers were submitted, always on the submitting thread.
+// given a yield context, waiting for a result suspends the coroutine instead
+// of blocking its thread.
+//
+// the transforms run concurrently with the owner, so it must declare the
+// queue after anything they reference: the destructor waits for them.
+class TransformQueue {
+ public:
+  // transform a buffer, runs on a pool thread
+  using Transform = std::function<int(ceph::bufferlist& in, ceph::bufferlist& out)>;
+  // handle the result of a transform, with the original input
+  using Completion = std::function<int(int r, ceph::bufferlist&& in,
+                                       ceph::bufferlist&& out, uint64_t offset)>;
+
+  TransformQueue(TransformPool* pool, size_t max_pending,
+                 Completion&& complete, optional_yield y = null_yield)
+    : pool(pool), max_pending(std::max<size_t>(max_pending, 1)),
+      complete(std::move(complete)), y(y)
+  {}
+  ~TransformQueue();
+
+  // transform the buffer at the given offset. without a pool the transform
+  // runs inline, otherwise this waits for the oldest result when full. a
+  // null transform passes the input to the completion untouched, in order
+  int submit(ceph::bufferlist&& in, uint64_t offset, Transform&& transform);
+
+  // wait for all pending transforms, and complete them
+  int drain();
+
+ private:
+  struct Job {
+    ceph::bufferlist in;
+    ceph::bufferlist out;
+    uint64_t offset;
+    int result = 0;
+    bool done = false;
+  };
+
+  TransformPool* const pool;
+  const size_t max_pending;
+  Completion complete;
+  optional_yield y;
+  ceph::mutex mutex = ceph::make_mutex("rgw::putobj::TransformQueue");
+  ceph::condition_variable cond;
+  std::deque<std::shared_ptr<Job>> pending;
+  int error = 0; //< first error returned by a completion
+
+  // resumes the coroutine waiting for the job
+  using Waiter = ceph::async::Completion<void(boost::system::error_code)>;
+  std::unique_ptr<Waiter> waiter;
+  const Job* waiting = nullptr;
+
+  // wait for the job to finish, with the mutex locked
+  void wait(std::unique_lock<ceph::mutex>& lock, const Job& job);
+
+  // complete the oldest job, waiting for it if necessary
+  int complete_front();
+  bool front_done();
+};
+
+} // namespace rgw::putobj
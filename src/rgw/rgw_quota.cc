@@ -14,6 +14,7 @@
  */
 
 
+#include "include/random.h"
 #include "include/utime.h"
 #include "common/lru_map.h"
 #include "common/RefCountedObj.h"
@@ -24,46 +25,89 @@
 #include "rgw_common.h"
 #include "rgw_rados.h"
 #include "rgw_quota.h"
+#include "rgw_quota_cache.h"
 #include "rgw_bucket.h"
 #include "rgw_user.h"
 
 #include "services/svc_sys_obj.h"
 
+#include <array>
 #include <atomic>
 
 #define dout_context g_ceph_context
 #define dout_subsys ceph_subsys_rgw
 
 
-struct RGWQuotaCacheStats {
-  RGWStorageStats stats;
-  utime_t expiration;
-  utime_t async_refresh_time;
-};
+utime_t rgw_quota_async_refresh_time(const utime_t& loaded, double ttl)
+{
+  utime_t t = loaded;
+  t += ceph::util::generate_random_number(ttl / 4, ttl * 3 / 4);
+  return t;
+}
 
 template<class T>
 class RGWQuotaCache {
 protected:
   RGWRados *store;
-  lru_map<T, RGWQuotaCacheStats> stats_map;
+  /* the entries are spread over several maps, each with its own lock, so
+   * that the quota checks and updates of unrelated buckets and users don't
+   * serialize */
+  static constexpr size_t num_shards = 16;
+  std::array<std::unique_ptr<lru_map<T, RGWQuotaCacheStats>>, num_shards> stats_maps;
   RefCountedWaitObject *async_refcount;
+  RGWQuotaRefreshLimit pending_refreshes;
+
+  lru_map<T, RGWQuotaCacheStats>& stats_map(const T& key) {
+    return *stats_maps[shard_hash(key) % num_shards];
+  }
+  static size_t shard_hash(const rgw_bucket& bucket) {
+    return std::hash<std::string>{}(bucket.bucket_id) ^
+           std::hash<std::string>{}(bucket.name);
+  }
+  static size_t shard_hash(const rgw_user& user) {
+    return std::hash<std::string>{}(user.id) ^
+           std::hash<std::string>{}(user.tenant);
+  }
 
   class StatsAsyncTestSet : public lru_map<T, RGWQuotaCacheStats>::UpdateContext {
-    int objs_delta;
-    uint64_t added_bytes;
-    uint64_t removed_bytes;
   public:
-    StatsAsyncTestSet() : objs_delta(0), added_bytes(0), removed_bytes(0) {}
     bool update(RGWQuotaCacheStats *entry) override {
       if (entry->async_refresh_time.sec() == 0)
         return false;
 
       entry->async_refresh_time = utime_t(0, 0);
+      entry->start_refresh();
 
       return true;
     }
   };
 
+  /* replace the authoritative stats of an entry. the local changes made
+   * after the read was started are kept if keep_delta is set */
+  class StatsSet : public lru_map<T, RGWQuotaCacheStats>::UpdateContext {
+    RGWQuotaCacheStats& qs;
+    const bool keep_delta;
+  public:
+    StatsSet(RGWQuotaCacheStats& qs, bool keep_delta)
+      : qs(qs), keep_delta(keep_delta) {}
+    bool update(RGWQuotaCacheStats *entry) override {
+      if (keep_delta) {
+        entry->refreshed(qs);
+      } else {
+        *entry = qs;
+      }
+      return true;
+    }
+  };
+
+  class StatsRefreshFailed : public lru_map<T, RGWQuotaCacheStats>::UpdateContext {
+  public:
+    bool update(RGWQuotaCacheStats *entry) override {
+      entry->refresh_failed();
+      return true;
+    }
+  };
+
   virtual int fetch_stats_from_storage(const rgw_user& user, const rgw_bucket& bucket, RGWStorageStats& stats) = 0;
 
   virtual bool map_find(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs) = 0;
@@ -73,7 +117,11 @@ protected:
 
   virtual void data_modified(const rgw_user& user, rgw_bucket& bucket) {}
 public:
-  RGWQuotaCache(RGWRados *_store, int size) : store(_store), stats_map(size) {
+  RGWQuotaCache(RGWRados *_store, int size) : store(_store) {
+    for (auto& m : stats_maps) {
+      m = std::make_unique<lru_map<T, RGWQuotaCacheStats>>(
+          std::max<int>(size / num_shards, 1));
+    }
     async_refcount = new RefCountedWaitObject;
   }
   virtual ~RGWQuotaCache() {
@@ -85,7 +133,7 @@ public:
 
   virtual bool can_use_cached_stats(RGWQuotaInfo& quota, RGWStorageStats& stats);
 
-  void set_stats(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs, RGWStorageStats& stats);
+  void set_stats(const rgw_user& user, const rgw_bucket& bucket, RGWStorageStats& stats, bool keep_delta);
   int async_refresh(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs);
   void async_refresh_response(const rgw_user& user, rgw_bucket& bucket, RGWStorageStats& stats);
   void async_refresh_fail(const rgw_user& user, rgw_bucket& bucket);
@@ -138,10 +186,19 @@ bool RGWQuotaCache<T>::can_use_cached_stats(RGWQuotaInfo& quota, RGWStorageStats
 template<class T>
 int RGWQuotaCache<T>::async_refresh(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs)
 {
+  /* don't let many entries due at the same time flood the osds, the others
+   * will be refreshed by later requests */
+  const uint64_t max_pending =
+    store->ctx()->_conf.get_val<uint64_t>("rgw_quota_max_async_refreshes");
+  if (!pending_refreshes.get(max_pending)) {
+    return 0;
+  }
+
   /* protect against multiple updates */
   StatsAsyncTestSet test_update;
   if (!map_find_and_update(user, bucket, &test_update)) {
     /* most likely we just raced with another update */
+    pending_refreshes.put();
     return 0;
   }
 
@@ -152,6 +209,9 @@ int RGWQuotaCache<T>::async_refresh(const rgw_user& user, const rgw_bucket& buck
 
   int ret = handler->init_fetch();
   if (ret < 0) {
+    StatsRefreshFailed update;
+    map_find_and_update(user, bucket, &update);
+    pending_refreshes.put();
     async_refcount->put();
     handler->drop_reference();
     return ret;
@@ -165,6 +225,10 @@ void RGWQuotaCache<T>::async_refresh_fail(const rgw_user& user, rgw_bucket& buck
 {
   ldout(store->ctx(), 20) << "async stats refresh response for bucket=" << bucket << dendl;
 
+  StatsRefreshFailed update;
+  map_find_and_update(user, bucket, &update);
+
+  pending_refreshes.put();
   async_refcount->put();
 }
 
@@ -173,25 +237,26 @@ void RGWQuotaCache<T>::async_refresh_response(const rgw_user& user, rgw_bucket&
 {
   ldout(store->ctx(), 20) << "async stats refresh response for bucket=" << bucket << dendl;
 
-  RGWQuotaCacheStats qs;
-
-  map_find(user, bucket, qs);
-
-  set_stats(user, bucket, qs, stats);
+  set_stats(user, bucket, stats, true);
 
+  pending_refreshes.put();
   async_refcount->put();
 }
 
 template<class T>
-void RGWQuotaCache<T>::set_stats(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs, RGWStorageStats& stats)
+void RGWQuotaCache<T>::set_stats(const rgw_user& user, const rgw_bucket& bucket, RGWStorageStats& stats, bool keep_delta)
 {
+  RGWQuotaCacheStats qs;
   qs.stats = stats;
   qs.expiration = ceph_clock_now();
-  qs.async_refresh_time = qs.expiration;
-  qs.expiration += store->ctx()->_conf->rgw_bucket_quota_ttl;
-  qs.async_refresh_time += store->ctx()->_conf->rgw_bucket_quota_ttl / 2;
+  const double ttl = store->ctx()->_conf->rgw_bucket_quota_ttl;
+  qs.async_refresh_time = rgw_quota_async_refresh_time(qs.expiration, ttl);
+  qs.expiration += ttl;
 
-  map_add(user, bucket, qs);
+  StatsSet update(qs, keep_delta);
+  if (!map_find_and_update(user, bucket, &update)) {
+    map_add(user, bucket, qs);
+  }
 }
 
 template<class T>
@@ -208,9 +273,9 @@ int RGWQuotaCache<T>::get_stats(const rgw_user& user, const rgw_bucket& bucket,
       }
     }
 
-    if (can_use_cached_stats(quota, qs.stats) && qs.expiration >
-	ceph_clock_now()) {
-      stats = qs.stats;
+    RGWStorageStats current = qs.current();
+    if (can_use_cached_stats(quota, current) && qs.expiration > now) {
+      stats = current;
       return 0;
     }
   }
@@ -219,7 +284,7 @@ int RGWQuotaCache<T>::get_stats(const rgw_user& user, const rgw_bucket& bucket,
   if (ret < 0 && ret != -ENOENT)
     return ret;
 
-  set_stats(user, bucket, qs, stats);
+  set_stats(user, bucket, stats, false);
 
   return 0;
 }
@@ -240,27 +305,7 @@ public:
   }
 
   bool update(RGWQuotaCacheStats * const entry) override {
-    const uint64_t rounded_added = rgw_rounded_objsize(added_bytes);
-    const uint64_t rounded_removed = rgw_rounded_objsize(removed_bytes);
-
-    if (((int64_t)(entry->stats.size + added_bytes - removed_bytes)) >= 0) {
-      entry->stats.size += added_bytes - removed_bytes;
-    } else {
-      entry->stats.size = 0;
-    }
-
-    if (((int64_t)(entry->stats.size_rounded + rounded_added - rounded_removed)) >= 0) {
-      entry->stats.size_rounded += rounded_added - rounded_removed;
-    } else {
-      entry->stats.size_rounded = 0;
-    }
-
-    if (((int64_t)(entry->stats.num_objects + objs_delta)) >= 0) {
-      entry->stats.num_objects += objs_delta;
-    } else {
-      entry->stats.num_objects = 0;
-    }
-
+    entry->delta.add(objs_delta, added_bytes, removed_bytes);
     return true;
   }
 };
@@ -339,15 +384,15 @@ void BucketAsyncRefreshHandler::handle_response(const int r)
 class RGWBucketStatsCache : public RGWQuotaCache<rgw_bucket> {
 protected:
   bool map_find(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs) override {
-    return stats_map.find(bucket, qs);
+    return stats_map(bucket).find(bucket, qs);
   }
 
   bool map_find_and_update(const rgw_user& user, const rgw_bucket& bucket, lru_map<rgw_bucket, RGWQuotaCacheStats>::UpdateContext *ctx) override {
-    return stats_map.find_and_update(bucket, NULL, ctx);
+    return stats_map(bucket).find_and_update(bucket, NULL, ctx);
   }
 
   void map_add(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs) override {
-    stats_map.add(bucket, qs);
+    stats_map(bucket).add(bucket, qs);
   }
 
   int fetch_stats_from_storage(const rgw_user& user, const rgw_bucket& bucket, RGWStorageStats& stats) override;
@@ -536,15 +581,15 @@ class RGWUserStatsCache : public RGWQuotaCache<rgw_user> {
   UserSyncThread *user_sync_thread;
 protected:
   bool map_find(const rgw_user& user,const rgw_bucket& bucket, RGWQuotaCacheStats& qs) override {
-    return stats_map.find(user, qs);
+    return stats_map(user).find(user, qs);
   }
 
   bool map_find_and_update(const rgw_user& user, const rgw_bucket& bucket, lru_map<rgw_user, RGWQuotaCacheStats>::UpdateContext *ctx) override {
-    return stats_map.find_and_update(user, NULL, ctx);
+    return stats_map(user).find_and_update(user, NULL, ctx);
   }
 
   void map_add(const rgw_user& user, const rgw_bucket& bucket, RGWQuotaCacheStats& qs) override {
-    stats_map.add(user, qs);
+    stats_map(user).add(user, qs);
   }
 
   int fetch_stats_from_storage(const rgw_user& user, const rgw_bucket& bucket, RGWStorageStats& stats) override;
@@ -0,0 +1,116 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_RGW_QUOTA_CACHE_H
+#define CEPH_RGW_QUOTA_CACHE_H
+
+#include <atomic>
+
+#include "include/utime.h"
+#include "rgw_common.h"
+
+/* changes to the stats made through this gateway, that the stats read from
+ * rados may not reflect yet */
+struct RGWQuotaStatsDelta {
+  int64_t num_objects = 0;
+  int64_t size = 0;
+  int64_t size_rounded = 0;
+
+  void add(int objs_delta, uint64_t added_bytes, uint64_t removed_bytes) {
+    num_objects += objs_delta;
+    size += (int64_t)added_bytes - (int64_t)removed_bytes;
+    size_rounded += (int64_t)rgw_rounded_objsize(added_bytes) -
+                    (int64_t)rgw_rounded_objsize(removed_bytes);
+  }
+
+  void add(const RGWQuotaStatsDelta& other) {
+    num_objects += other.num_objects;
+    size += other.size;
+    size_rounded += other.size_rounded;
+  }
+
+  static uint64_t apply(uint64_t value, int64_t delta) {
+    if (delta < 0 && (uint64_t)-delta > value) {
+      return 0;
+    }
+    return value + delta;
+  }
+
+  void apply(RGWStorageStats& stats) const {
+    stats.num_objects = apply(stats.num_objects, num_objects);
+    stats.size = apply(stats.size, size);
+    stats.size_rounded = apply(stats.size_rounded, size_rounded);
+  }
+};
+
+struct RGWQuotaCacheStats {
+  RGWStorageStats stats; /* as last read from rados */
+  RGWQuotaStatsDelta delta; /* local changes since that read was started */
+  RGWQuotaStatsDelta refreshing; /* local changes before the read in flight */
+  utime_t expiration;
+  utime_t async_refresh_time;
+
+  /* the last authoritative stats, with the local changes on top */
+  RGWStorageStats current() const {
+    RGWStorageStats s = stats;
+    refreshing.apply(s);
+    delta.apply(s);
+    return s;
+  }
+
+  /* whatever was changed so far will be part of the stats we read */
+  void start_refresh() {
+    refreshing.add(delta);
+    delta = RGWQuotaStatsDelta();
+  }
+
+  /* the read failed, so the changes set aside are still pending */
+  void refresh_failed() {
+    delta.add(refreshing);
+    refreshing = RGWQuotaStatsDelta();
+  }
+
+  /* take the stats of a refresh, keeping the changes made after its read
+   * was started */
+  void refreshed(const RGWQuotaCacheStats& qs) {
+    RGWQuotaStatsDelta pending = delta;
+    *this = qs;
+    delta = pending;
+  }
+};
+
+/* when the stats loaded at the given time are due for a background
+ * refresh: somewhere between a quarter and three quarters of the ttl, so
+ * that the entries loaded together don't all come due together */
+utime_t rgw_quota_async_refresh_time(const utime_t& loaded, double ttl);
+
+/* caps the background refreshes in flight */
+class RGWQuotaRefreshLimit {
+  std::atomic<uint64_t> pending = { 0 };
+public:
+  bool get(uint64_t max_pending) {
+    if (++pending > max_pending) {
+      --pending;
+      return false;
+    }
+    return true;
+  }
+  void put() {
+    --pending;
+  }
+  uint64_t get_pending() const {
+    return pending;
+  }
+};
+
+#endif
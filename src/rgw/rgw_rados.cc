@@ -20,6 +20,8 @@
 #include "common/Throttle.h"
 
 #include "rgw_rados.h"
+#include "rgw_bucket_list.h"
+#include "rgw_index_completion.h"
 #include "rgw_zone.h"
 #include "rgw_cache.h"
 #include "rgw_acl.h"
@@ -474,6 +476,96 @@ void RGWObjManifest::append_rules(RGWObjManifest& m, map<uint64_t, RGWObjManifes
   }
 }
 
+/*
+ * the compact rules encoding: a table of the override prefixes in use,
+ * then each rule in order, with its offset and part number as deltas from
+ * the previous rule.  all the numbers are varints, so a rule for a part of
+ * a multipart upload usually takes less than a dozen bytes.
+ */
+void RGWObjManifest::encode_compact_rules(bufferlist& bl) const
+{
+  using ceph::encode;
+  vector<string> prefixes;
+  map<string, uint32_t> prefix_index;
+  for (auto& r : rules) {
+    const string& p = r.second.override_prefix;
+    if (!p.empty() && prefix_index.emplace(p, prefixes.size() + 1).second) {
+      prefixes.push_back(p);
+    }
+  }
+
+  bufferlist rules_bl;
+  if (!rules.empty()) {
+    /* up to 10 bytes for each of the 6 varints */
+    auto app = rules_bl.get_contiguous_appender(rules.size() * 60);
+    uint64_t last_ofs = 0;
+    uint32_t last_part_num = 0;
+    for (auto& r : rules) {
+      const RGWObjManifestRule& rule = r.second;
+      denc_varint(r.first - last_ofs, app);
+      denc_signed_varint((int64_t)(rule.start_ofs - r.first), app);
+      denc_signed_varint((int64_t)rule.start_part_num - last_part_num, app);
+      denc_varint(rule.part_size, app);
+      denc_varint(rule.stripe_max_size, app);
+      uint32_t index = 0;
+      if (!rule.override_prefix.empty()) {
+        index = prefix_index[rule.override_prefix];
+      }
+      denc_varint(index, app);
+      last_ofs = r.first;
+      last_part_num = rule.start_part_num;
+    }
+  }
+
+  encode(prefixes, bl);
+  encode((uint32_t)rules.size(), bl);
+  encode(rules_bl, bl);
+}
+
+void RGWObjManifest::decode_compact_rules(bufferlist::const_iterator& bl)
+{
+  using ceph::decode;
+  vector<string> prefixes;
+  uint32_t count;
+  bufferlist rules_bl;
+  decode(prefixes, bl);
+  decode(count, bl);
+  decode(rules_bl, bl);
+
+  rules.clear();
+  if (!count) {
+    return;
+  }
+  rules_bl.c_str(); /* make it contiguous */
+  auto p = rules_bl.front().begin();
+  uint64_t ofs = 0;
+  uint32_t part_num = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    RGWObjManifestRule rule;
+    uint64_t ofs_delta;
+    int64_t start_ofs_delta;
+    int64_t part_num_delta;
+    uint32_t index;
+    denc_varint(ofs_delta, p);
+    denc_signed_varint(start_ofs_delta, p);
+    denc_signed_varint(part_num_delta, p);
+    denc_varint(rule.part_size, p);
+    denc_varint(rule.stripe_max_size, p);
+    denc_varint(index, p);
+    if (index > prefixes.size()) {
+      throw buffer::malformed_input("bad override prefix index in manifest rule");
+    }
+    ofs += ofs_delta;
+    part_num += part_num_delta;
+    rule.start_ofs = ofs + start_ofs_delta;
+    rule.start_part_num = part_num;
+    if (index) {
+      rule.override_prefix = prefixes[index - 1];
+    }
+    rules.emplace_hint(rules.end(), ofs, std::move(rule));
+  }
+}
+
 void RGWObjManifest::convert_to_explicit(const RGWZoneGroup& zonegroup, const RGWZoneParams& zone_params)
 {
   if (explicit_objs) {
@@ -1020,32 +1112,6 @@ int RGWRados::get_max_chunk_size(const rgw_placement_rule& placement_rule, const
   return get_max_chunk_size(pool, max_chunk_size, palignment);
 }
 
-class RGWIndexCompletionManager;
-
-struct complete_op_data {
-  Mutex lock{"complete_op_data"};
-  AioCompletion *rados_completion{nullptr};
-  int manager_shard_id{-1};
-  RGWIndexCompletionManager *manager{nullptr};
-  rgw_obj obj;
-  RGWModifyOp op;
-  string tag;
-  rgw_bucket_entry_ver ver;
-  cls_rgw_obj_key key;
-  rgw_bucket_dir_entry_meta dir_meta;
-  list<cls_rgw_obj_key> remove_objs;
-  bool log_op;
-  uint16_t bilog_op;
-  rgw_zone_set zones_trace;
-
-  bool stopped{false};
-
-  void stop() {
-    Mutex::Locker l(lock);
-    stopped = true;
-  }
-};
-
 class RGWIndexCompletionThread : public RGWRadosThread {
   RGWRados *store;
 
@@ -1121,12 +1187,13 @@ int RGWIndexCompletionThread::process()
   return 0;
 }
 
-class RGWIndexCompletionManager {
+class RGWIndexCompletionManager : public RGWIndexCompletionBatcher::Backend {
   RGWRados *store{nullptr};
   vector<Mutex *> locks;
   vector<set<complete_op_data *> > completions;
 
   RGWIndexCompletionThread *completion_thread{nullptr};
+  std::shared_ptr<RGWIndexCompletionBatcher> batcher;
 
   int num_shards;
 
@@ -1145,7 +1212,7 @@ public:
 
     completions.resize(num_shards);
   }
-  ~RGWIndexCompletionManager() {
+  ~RGWIndexCompletionManager() override {
     stop();
 
     for (auto l : locks) {
@@ -1159,6 +1226,14 @@ public:
     return result;
   }
 
+  complete_op_data *new_completion(const rgw_obj& obj,
+                                   RGWModifyOp op, string& tag,
+                                   rgw_bucket_entry_ver& ver,
+                                   const cls_rgw_obj_key& key,
+                                   rgw_bucket_dir_entry_meta& dir_meta,
+                                   list<cls_rgw_obj_key> *remove_objs, bool log_op,
+                                   uint16_t bilog_op,
+                                   rgw_zone_set *zones_trace);
   void create_completion(const rgw_obj& obj,
                          RGWModifyOp op, string& tag,
                          rgw_bucket_entry_ver& ver,
@@ -1170,6 +1245,23 @@ public:
                          complete_op_data **result);
   bool handle_completion(completion_t cb, complete_op_data *arg);
 
+  /// queue a completion to be sent with others to the same shard, or return
+  /// false if batching is off
+  bool batch_completion(RGWRados::BucketShard& bs, const rgw_obj& obj,
+                        RGWModifyOp op, string& tag,
+                        rgw_bucket_entry_ver& ver,
+                        const cls_rgw_obj_key& key,
+                        rgw_bucket_dir_entry_meta& dir_meta,
+                        list<cls_rgw_obj_key> *remove_objs, bool log_op,
+                        uint16_t bilog_op,
+                        rgw_zone_set *zones_trace);
+
+  int send_batch(std::unique_ptr<RGWIndexCompletionBatcher::Batch>& batch,
+                 vector<rgw_cls_obj_complete_op>& ops) override;
+  void retry_completion(std::unique_ptr<complete_op_data> c) override {
+    completion_thread->add_completion(c.release());
+  }
+
   int start() {
     completion_thread = new RGWIndexCompletionThread(store);
     int ret = completion_thread->init();
@@ -1177,9 +1269,19 @@ public:
       return ret;
     }
     completion_thread->start();
+
+    auto cct = store->ctx();
+    if (cct->_conf.get_val<uint64_t>("rgw_bucket_index_complete_batch_window_ms") > 0) {
+      batcher = std::make_shared<RGWIndexCompletionBatcher>(cct, this);
+      batcher->create("index-batch");
+    }
     return 0;
   }
   void stop() {
+    if (batcher) {
+      batcher->stop();
+      batcher.reset();
+    }
     if (completion_thread) {
       completion_thread->stop();
       delete completion_thread;
@@ -1212,21 +1314,17 @@ static void obj_complete_cb(completion_t cb, void *arg)
 }
 
 
-void RGWIndexCompletionManager::create_completion(const rgw_obj& obj,
-                                                  RGWModifyOp op, string& tag,
-                                                  rgw_bucket_entry_ver& ver,
-                                                  const cls_rgw_obj_key& key,
-                                                  rgw_bucket_dir_entry_meta& dir_meta,
-                                                  list<cls_rgw_obj_key> *remove_objs, bool log_op,
-                                                  uint16_t bilog_op,
-                                                  rgw_zone_set *zones_trace,
-                                                  complete_op_data **result)
+complete_op_data *RGWIndexCompletionManager::new_completion(const rgw_obj& obj,
+                                                            RGWModifyOp op, string& tag,
+                                                            rgw_bucket_entry_ver& ver,
+                                                            const cls_rgw_obj_key& key,
+                                                            rgw_bucket_dir_entry_meta& dir_meta,
+                                                            list<cls_rgw_obj_key> *remove_objs, bool log_op,
+                                                            uint16_t bilog_op,
+                                                            rgw_zone_set *zones_trace)
 {
   complete_op_data *entry = new complete_op_data;
 
-  int shard_id = next_shard();
-
-  entry->manager_shard_id = shard_id;
   entry->manager = this;
   entry->obj = obj;
   entry->op = op;
@@ -1249,6 +1347,25 @@ void RGWIndexCompletionManager::create_completion(const rgw_obj& obj,
     entry->zones_trace.insert(store->svc.zone->get_zone().id);
   }
 
+  return entry;
+}
+
+void RGWIndexCompletionManager::create_completion(const rgw_obj& obj,
+                                                  RGWModifyOp op, string& tag,
+                                                  rgw_bucket_entry_ver& ver,
+                                                  const cls_rgw_obj_key& key,
+                                                  rgw_bucket_dir_entry_meta& dir_meta,
+                                                  list<cls_rgw_obj_key> *remove_objs, bool log_op,
+                                                  uint16_t bilog_op,
+                                                  rgw_zone_set *zones_trace,
+                                                  complete_op_data **result)
+{
+  complete_op_data *entry = new_completion(obj, op, tag, ver, key, dir_meta,
+                                           remove_objs, log_op, bilog_op,
+                                           zones_trace);
+  int shard_id = next_shard();
+  entry->manager_shard_id = shard_id;
+
   *result = entry;
 
   entry->rados_completion = librados::Rados::aio_create_completion(entry, NULL, obj_complete_cb);
@@ -1257,6 +1374,52 @@ void RGWIndexCompletionManager::create_completion(const rgw_obj& obj,
   completions[shard_id].insert(entry);
 }
 
+bool RGWIndexCompletionManager::batch_completion(RGWRados::BucketShard& bs,
+                                                 const rgw_obj& obj,
+                                                 RGWModifyOp op, string& tag,
+                                                 rgw_bucket_entry_ver& ver,
+                                                 const cls_rgw_obj_key& key,
+                                                 rgw_bucket_dir_entry_meta& dir_meta,
+                                                 list<cls_rgw_obj_key> *remove_objs, bool log_op,
+                                                 uint16_t bilog_op,
+                                                 rgw_zone_set *zones_trace)
+{
+  if (!batcher) {
+    return false;
+  }
+  std::unique_ptr<complete_op_data> entry{
+    new_completion(obj, op, tag, ver, key, dir_meta, remove_objs, log_op,
+                   bilog_op, zones_trace)};
+  return batcher->add(bs.index_ctx.get_id(), bs.index_ctx, bs.bucket_obj, entry);
+}
+
+static void batch_complete_cb(completion_t cb, void *arg)
+{
+  std::unique_ptr<RGWIndexCompletionBatcher::Batch> batch{
+    static_cast<RGWIndexCompletionBatcher::Batch *>(arg)};
+  int r = rados_aio_get_return_value(cb);
+  auto batcher = batch->batcher;
+  batcher->handle_completion(std::move(batch), r);
+}
+
+int RGWIndexCompletionManager::send_batch(std::unique_ptr<RGWIndexCompletionBatcher::Batch>& batch,
+                                          vector<rgw_cls_obj_complete_op>& ops)
+{
+  librados::ObjectWriteOperation o;
+  cls_rgw_guard_bucket_resharding(o, -ERR_BUSY_RESHARDING);
+  cls_rgw_bucket_complete_ops(o, ops);
+
+  auto b = batch.get();
+  auto completion = librados::Rados::aio_create_completion(b, nullptr, batch_complete_cb);
+  int r = b->index_ctx.aio_operate(b->oid, completion, &o);
+  completion->release();
+  if (r < 0) {
+    return r;
+  }
+  batch.release(); /* owned by the completion */
+  return 0;
+}
+
 bool RGWIndexCompletionManager::handle_completion(completion_t cb, complete_op_data *arg)
 {
   int shard_id = arg->manager_shard_id;
@@ -1296,6 +1459,9 @@ void RGWRados::finalize()
     if (sync_log_trimmer) {
       sync_log_trimmer->stop();
     }
+    if (sync_module) {
+      sync_module->shutdown();
+    }
   }
   if (async_rados) {
     async_rados->stop();
@@ -1605,7 +1771,7 @@ int RGWRados::init_complete()
   ldout(cct, 20) << __func__ << " bucket index max shards: " << bucket_index_max_shards << dendl;
 
   binfo_cache = new RGWChainedCacheImpl<bucket_info_entry>;
-  binfo_cache->init(svc.cache);
+  binfo_cache->init(svc.cache, "bucket_info");
 
   bool need_tombstone_cache = !svc.zone->get_zone_data_notify_to_map().empty(); /* have zones syncing from us */
 
@@ -1931,7 +2097,7 @@ int RGWRados::log_usage(map<rgw_user_bucket, RGWUsageBatch>& usage_info)
 
 int RGWRados::read_usage(const rgw_user& user, const string& bucket_name, uint64_t start_epoch, uint64_t end_epoch,
                          uint32_t max_entries, bool *is_truncated, RGWUsageIter& usage_iter, map<rgw_user_bucket,
-			 rgw_usage_log_entry>& usage)
+			 rgw_usage_log_entry>& usage, bool daily)
 {
   uint32_t num = max_entries;
   string hash, first_hash;
@@ -1951,7 +2117,7 @@ int RGWRados::read_usage(const rgw_user& user, const string& bucket_name, uint64
     map<rgw_user_bucket, rgw_usage_log_entry>::iterator iter;
 
     int ret =  cls_obj_usage_log_read(hash, user_str, bucket_name, start_epoch, end_epoch, num,
-                                    usage_iter.read_iter, ret_usage, is_truncated);
+                                    usage_iter.read_iter, ret_usage, is_truncated, daily);
     if (ret == -ENOENT)
       goto next;
 
@@ -2094,7 +2260,8 @@ int RGWRados::time_log_list(const string& oid, const real_time& start_time, cons
                             int max_entries, list<cls_log_entry>& entries,
 			    const string& marker,
 			    string *out_marker,
-			    bool *truncated)
+			    bool *truncated,
+                            librados::AioCompletion *completion)
 {
   librados::IoCtx io_ctx;
 
@@ -2109,6 +2276,10 @@ int RGWRados::time_log_list(const string& oid, const real_time& start_time, cons
   cls_log_list(op, st, et, marker, max_entries, entries,
 	       out_marker, truncated);
 
+  if (completion) {
+    return io_ctx.aio_operate(oid, completion, &op, NULL);
+  }
+
   bufferlist obl;
 
   int ret = io_ctx.operate(oid, &op, &obl);
@@ -2441,6 +2612,17 @@ int RGWRados::Bucket::List::list_objects_ordered(
   string cur_prefix = prefix_obj.get_index_key_name();
   string after_delim_s; /* needed in !params.delim.empty() AND later */
 
+  /* let the osds collapse common prefixes, unless the delimiter could
+   * match in the '_' escaping of a raw index key that the prefix doesn't
+   * cover. osds that don't know about it return every entry, which the
+   * loop below handles as well */
+  string cls_delim;
+  if (cct->_conf->rgw_list_bucket_cls_delimiter &&
+      (params.delim.find('_') == string::npos ||
+       (!cur_prefix.empty() && cur_prefix[0] != '_'))) {
+    cls_delim = params.delim;
+  }
+
   if (!params.delim.empty()) {
     /* if marker points at a common prefix, fast forward it into its
      * upper bound string */
@@ -2468,6 +2650,7 @@ int RGWRados::Bucket::List::list_objects_ordered(
 					   shard_id,
 					   cur_marker,
 					   cur_prefix,
+					   cls_delim,
 					   read_ahead + 1 - count,
 					   params.list_versions,
 					   ent_map,
@@ -2821,6 +3004,10 @@ int RGWRados::create_bucket(const RGWUserInfo& owner, rgw_bucket& bucket,
     info.index_type = rule_info.index_type;
     info.swift_ver_location = swift_ver_location;
     info.swift_versioning = (!swift_ver_location.empty());
+    if (cct->_conf.get_val<Option::size_t>("rgw_inline_data_max_size") > 0 &&
+        info.index_type == RGWBIType_Normal) {
+      info.flags |= BUCKET_INLINE_DATA;
+    }
     if (pmaster_num_shards) {
       info.num_shards = *pmaster_num_shards;
     } else {
@@ -3807,6 +3994,135 @@ done_cancel:
   return r;
 }
 
+/*
+ * store the object data and attrs in its bucket index entry, with no head
+ * object. returns -EEXIST if a (non inline) head object already exists, and
+ * -EOPNOTSUPP if the osds don't know about inline entries. in both cases
+ * the caller should fall back to write the head object.
+ */
+int RGWRados::Object::Write::write_meta_inline(uint64_t size, uint64_t accounted_size,
+                                               map<string, bufferlist>& attrs,
+                                               void *_index_op)
+{
+  RGWRados::Bucket::UpdateIndex *index_op = static_cast<RGWRados::Bucket::UpdateIndex *>(_index_op);
+  RGWRados *store = target->get_store();
+  rgw_obj& obj = target->get_obj();
+
+  if (!meta.data || meta.data->length() != size) {
+    return -EOPNOTSUPP;
+  }
+
+  if (real_clock::is_zero(meta.set_mtime)) {
+    meta.set_mtime = real_clock::now();
+  }
+
+  rgw_bucket_inline_data inline_data;
+  inline_data.data = *meta.data;
+
+  string etag;
+  string content_type;
+  bufferlist acl_bl;
+  string storage_class;
+
+  for (auto& [name, bl] : attrs) {
+    if (name == RGW_ATTR_MANIFEST || !bl.length()) {
+      continue;
+    }
+    inline_data.attrs[name] = bl;
+    if (name == RGW_ATTR_ETAG) {
+      etag = rgw_bl_str(bl);
+    } else if (name == RGW_ATTR_CONTENT_TYPE) {
+      content_type = rgw_bl_str(bl);
+    } else if (name == RGW_ATTR_ACL) {
+      acl_bl = bl;
+    }
+  }
+
+  string tag;
+  if (meta.ptag) {
+    tag = *meta.ptag;
+  } else {
+    append_rand_alpha(store->ctx(), tag, tag, 32);
+  }
+  bufferlist tag_bl;
+  tag_bl.append(tag.c_str(), tag.size() + 1);
+  inline_data.attrs[RGW_ATTR_ID_TAG] = std::move(tag_bl);
+
+  if (attrs.find(RGW_ATTR_SOURCE_ZONE) == attrs.end()) {
+    bufferlist bl;
+    encode(store->svc.zone->get_zone_short_id(), bl);
+    inline_data.attrs[RGW_ATTR_SOURCE_ZONE] = std::move(bl);
+  }
+
+  if (meta.manifest) {
+    storage_class = meta.manifest->get_tail_placement().placement_rule.storage_class;
+  }
+  if (!storage_class.empty()) {
+    bufferlist bl;
+    bl.append(storage_class);
+    inline_data.attrs[RGW_ATTR_STORAGE_CLASS] = std::move(bl);
+  }
+
+  bool orig_exists = false;
+  uint64_t orig_size = 0;
+
+  /* most writes create a new object, try that first so they take a single
+   * round trip to the index */
+  int r = index_op->complete_inline(size, accounted_size, meta.set_mtime,
+                                    etag, content_type, storage_class,
+                                    &acl_bl, meta.category, meta.user_data,
+                                    inline_data, CLS_RGW_PUT_INLINE_EXCLUSIVE);
+  if (r == -EEXIST) {
+    /* the state is only read for the quota stats. whether the object may be
+     * replaced is checked by the index along with the write, and a head
+     * object written meanwhile fails it with EEXIST */
+    target->invalidate_state();
+    RGWObjState *state;
+    r = target->get_state(&state, false);
+    if (r < 0) {
+      return r;
+    }
+    if (state->exists && !state->is_inline) {
+      return -EEXIST;
+    }
+    orig_exists = state->exists;
+    orig_size = state->accounted_size;
+    r = index_op->complete_inline(size, accounted_size, meta.set_mtime,
+                                  etag, content_type, storage_class,
+                                  &acl_bl, meta.category, meta.user_data,
+                                  inline_data, CLS_RGW_PUT_INLINE_REPLACE_INLINE);
+  }
+  if (r < 0) {
+    if (r != -EOPNOTSUPP) {
+      ldout(store->ctx(), 0) << "ERROR: " << __func__ << "(): failed to write inline entry for "
+                             << obj << " r=" << r << dendl;
+    }
+    return r;
+  }
+
+  if (meta.mtime) {
+    *meta.mtime = meta.set_mtime;
+  }
+  target->invalidate_state();
+
+  if (!real_clock::is_zero(meta.delete_at)) {
+    rgw_obj_index_key obj_key;
+    obj.key.get_index_key(&obj_key);
+
+    r = store->objexp_hint_add(meta.delete_at,
+            obj.bucket.tenant, obj.bucket.name, obj.bucket.bucket_id, obj_key);
+    if (r < 0) {
+      ldout(store->ctx(), 0) << "ERROR: objexp_hint_add() returned r=" << r << ", object will not get removed" << dendl;
+      /* ignoring error, nothing we can do at this point */
+    }
+  }
+  meta.canceled = false;
+
+  store->quota_handler->update_stats(meta.owner, obj.bucket, (orig_exists ? 0 : 1),
+                                     accounted_size, orig_size);
+  return 0;
+}
+
 int RGWRados::Object::Write::write_meta(uint64_t size, uint64_t accounted_size,
                                            map<string, bufferlist>& attrs)
 {
@@ -3818,6 +4134,17 @@ int RGWRados::Object::Write::write_meta(uint64_t size, uint64_t accounted_size,
   
   bool assume_noent = (meta.if_match == NULL && meta.if_nomatch == NULL);
   int r;
+  if (meta.inline_data) {
+    r = write_meta_inline(size, accounted_size, attrs, (void *)&index_op);
+    if (r != -EEXIST && r != -EOPNOTSUPP) {
+      return r;
+    }
+    if (r == -EEXIST) {
+      /* replacing a head object */
+      assume_noent = false;
+      target->invalidate_state();
+    }
+  }
   if (assume_noent) {
     r = _do_write_meta(size, accounted_size, attrs, assume_noent, meta.modify_tail, (void *)&index_op);
     if (r == -EEXIST) {
@@ -5548,20 +5875,31 @@ int RGWRados::Object::Delete::delete_obj()
   if (r < 0)
     return r;
 
-  store->remove_rgw_head_obj(op);
-  r = ref.ioctx.operate(ref.obj.oid, &op);
+  int64_t poolid = ref.ioctx.get_id();
+  uint64_t epoch = 0;
+  if (state->is_inline) {
+    /* there's no head object, completing the index op removes the data. it
+     * fails with -ECANCELED if a put replaced the entry since it was read */
+    r = index_op.complete_del_inline(poolid, state->mtime, params.remove_objs,
+                                     state->obj_tag);
+  } else {
+    store->remove_rgw_head_obj(op);
+    r = ref.ioctx.operate(ref.obj.oid, &op);
+    epoch = ref.ioctx.get_last_version();
+  }
 
   /* raced with another operation, object state is indeterminate */
-  const bool need_invalidate = (r == -ECANCELED);
+  const bool need_invalidate = (r == -ECANCELED || state->is_inline);
 
-  int64_t poolid = ref.ioctx.get_id();
   if (r >= 0) {
     tombstone_cache_t *obj_tombstone_cache = store->get_tombstone_cache();
     if (obj_tombstone_cache) {
       tombstone_entry entry{*state};
       obj_tombstone_cache->add(obj, entry);
     }
-    r = index_op.complete_del(poolid, ref.ioctx.get_last_version(), state->mtime, params.remove_objs);
+    if (!state->is_inline) {
+      r = index_op.complete_del(poolid, epoch, state->mtime, params.remove_objs);
+    }
     
     int ret = target->complete_atomic_modification();
     if (ret < 0) {
@@ -5708,6 +6046,64 @@ int RGWRados::get_olh_target_state(RGWObjectCtx& obj_ctx, const RGWBucketInfo& b
   return 0;
 }
 
+/*
+ * fill the state of an object stored in its bucket index entry. returns
+ * -ENOENT if there's no entry, or if the entry refers to a head object
+ */
+int RGWRados::get_inline_obj_state(const RGWBucketInfo& bucket_info, const rgw_obj& obj,
+                                   RGWObjState *s)
+{
+  rgw_cls_bi_entry bi_entry;
+  int r = bi_get(bucket_info, obj, BIIndexType::Plain, &bi_entry);
+  if (r < 0) {
+    return r;
+  }
+
+  rgw_bucket_dir_entry entry;
+  try {
+    auto iter = bi_entry.data.cbegin();
+    decode(entry, iter);
+  } catch (buffer::error& err) {
+    ldout(cct, 0) << "ERROR: " << __func__ << "(): failed to decode index entry for " << obj << dendl;
+    return -EIO;
+  }
+  if (!entry.exists || !entry.inline_data) {
+    return -ENOENT;
+  }
+
+  s->exists = true;
+  s->has_attrs = true;
+  s->is_inline = true;
+  s->size = entry.meta.size;
+  s->accounted_size = entry.meta.accounted_size;
+  s->mtime = entry.meta.mtime;
+  s->attrset = std::move(entry.inline_data->attrs);
+  s->data = std::move(entry.inline_data->data);
+
+  auto iter = s->attrset.find(RGW_ATTR_ETAG);
+  if (iter != s->attrset.end()) {
+    bufferlist& bletag = iter->second;
+    if (bletag.length() > 0 && bletag[bletag.length() - 1] == '\0') {
+      bufferlist newbl;
+      bletag.splice(0, bletag.length() - 1, &newbl);
+      bletag.claim(newbl);
+    }
+  }
+  s->obj_tag = s->attrset[RGW_ATTR_ID_TAG];
+
+  iter = s->attrset.find(RGW_ATTR_SOURCE_ZONE);
+  if (iter != s->attrset.end() && iter->second.length()) {
+    auto zbl = iter->second.cbegin();
+    try {
+      decode(s->zone_short_id, zbl);
+    } catch (buffer::error& err) {
+      ldout(cct, 0) << "ERROR: couldn't decode zone short id attr for object " << obj << ", non-critical error, ignoring" << dendl;
+    }
+  }
+  ldout(cct, 20) << "get_obj_state: found inline obj=" << obj << " size=" << s->size << dendl;
+  return 0;
+}
+
 int RGWRados::get_obj_state_impl(RGWObjectCtx *rctx, const RGWBucketInfo& bucket_info, const rgw_obj& obj,
                                  RGWObjState **state, bool follow_olh, bool assume_noent)
 {
@@ -5734,6 +6130,15 @@ int RGWRados::get_obj_state_impl(RGWObjectCtx *rctx, const RGWBucketInfo& bucket
 
   int r = -ENOENT;
 
+  if (!assume_noent && bucket_info.inline_data_enabled() &&
+      obj.key.ns.empty() && obj.key.instance.empty()) {
+    /* objects in these buckets are usually stored in the index */
+    r = get_inline_obj_state(bucket_info, obj, s);
+    if (r != -ENOENT) {
+      return r;
+    }
+  }
+
   if (!assume_noent) {
     r = RGWRados::raw_obj_stat(raw_obj, &s->size, &s->mtime, &s->epoch, &s->attrset, (s->prefetch_data ? &s->data : NULL), NULL);
   }
@@ -6070,8 +6475,10 @@ int RGWRados::Object::prepare_atomic_modification(ObjectWriteOperation& op, bool
   }
 
   if (need_guard) {
-    /* first verify that the object wasn't replaced under */
-    if (if_nomatch == NULL || strcmp(if_nomatch, "*") != 0) {
+    /* first verify that the object wasn't replaced under. an inline object
+     * has no head to compare against */
+    if ((if_nomatch == NULL || strcmp(if_nomatch, "*") != 0) &&
+        !state->is_inline) {
       op.cmpxattr(RGW_ATTR_ID_TAG, LIBRADOS_CMPXATTR_OP_EQ, state->obj_tag); 
       // FIXME: need to add FAIL_NOTEXIST_OK for racing deletion
     }
@@ -6108,7 +6515,7 @@ int RGWRados::Object::prepare_atomic_modification(ObjectWriteOperation& op, bool
   }
 
   if (reset_obj) {
-    if (state->exists) {
+    if (state->exists && !state->is_inline) {
       op.create(false);
       store->remove_rgw_head_obj(op);
     } else {
@@ -6225,6 +6632,49 @@ int RGWRados::set_attrs(void *ctx, const RGWBucketInfo& bucket_info, rgw_obj& sr
   RGWRados::Bucket bop(this, bucket_info);
   RGWRados::Bucket::UpdateIndex index_op(&bop, obj);
 
+  if (state && state->is_inline) {
+    /* rewrite the index entry with the updated attrs */
+    rgw_bucket_inline_data inline_data;
+    inline_data.data = state->data;
+    inline_data.attrs = state->attrset;
+    if (rmattrs) {
+      for (auto& i : *rmattrs) {
+        inline_data.attrs.erase(i.first);
+      }
+    }
+    for (auto& [name, bl] : attrs) {
+      if (bl.length()) {
+        inline_data.attrs[name] = bl;
+      }
+    }
+    string etag;
+    string content_type;
+    string storage_class;
+    bufferlist acl_bl;
+    for (auto& [name, bl] : inline_data.attrs) {
+      if (name == RGW_ATTR_ETAG) {
+        etag = rgw_bl_str(bl);
+      } else if (name == RGW_ATTR_CONTENT_TYPE) {
+        content_type = rgw_bl_str(bl);
+      } else if (name == RGW_ATTR_STORAGE_CLASS) {
+        storage_class = rgw_bl_str(bl);
+      } else if (name == RGW_ATTR_ACL) {
+        acl_bl = bl;
+      }
+    }
+    real_time mtime = real_clock::now();
+    r = index_op.complete_inline(state->size, state->accounted_size, mtime,
+                                 etag, content_type, storage_class, &acl_bl,
+                                 RGWObjCategory::Main, nullptr,
+                                 inline_data, CLS_RGW_PUT_INLINE_REPLACE_INLINE);
+    if (r < 0) {
+      return r;
+    }
+    state->attrset = std::move(inline_data.attrs);
+    state->mtime = mtime;
+    return 0;
+  }
+
   if (state) {
     string tag;
     append_rand_alpha(cct, tag, tag, 32);
@@ -6521,7 +6971,10 @@ int RGWRados::Bucket::UpdateIndex::complete(int64_t poolid, uint64_t epoch,
   ent.meta.content_type = content_type;
   ent.meta.appendable = appendable;
 
-  ret = store->cls_obj_complete_add(*bs, obj, optag, poolid, epoch, ent, category, remove_objs, bilog_flags, zones_trace);
+  /* the olh of a versioned object is linked right after this, which a
+   * batched completion could land behind */
+  const bool batch = RGWIndexCompletionBatcher::batchable(target->bucket_info, obj.key);
+  ret = store->cls_obj_complete_add(*bs, obj, optag, poolid, epoch, ent, category, remove_objs, bilog_flags, zones_trace, batch);
 
   if (target->bucket_info.datasync_flag_enabled()) {
     int r = store->data_log->add_entry(bs->bucket, bs->shard_id);
@@ -6533,6 +6986,61 @@ int RGWRados::Bucket::UpdateIndex::complete(int64_t poolid, uint64_t epoch,
   return ret;
 }
 
+int RGWRados::Bucket::UpdateIndex::complete_inline(uint64_t size, uint64_t accounted_size,
+                                                   ceph::real_time& ut, const string& etag,
+                                                   const string& content_type,
+                                                   const string& storage_class,
+                                                   bufferlist *acl_bl,
+                                                   RGWObjCategory category,
+                                                   const string *user_data,
+                                                   rgw_bucket_inline_data& inline_data,
+                                                   RGWPutInlineMode mode)
+{
+  if (blind) {
+    return -EOPNOTSUPP;
+  }
+  RGWRados *store = target->get_store();
+
+  rgw_bucket_dir_entry ent;
+  obj.key.get_index_key(&ent.key);
+  ent.meta.size = size;
+  ent.meta.accounted_size = accounted_size;
+  ent.meta.mtime = ut;
+  ent.meta.etag = etag;
+  ent.meta.storage_class = storage_class;
+  if (user_data)
+    ent.meta.user_data = *user_data;
+
+  ACLOwner owner;
+  if (acl_bl && acl_bl->length()) {
+    int ret = store->decode_policy(*acl_bl, &owner);
+    if (ret < 0) {
+      ldout(store->ctx(), 0) << "WARNING: could not decode policy ret=" << ret << dendl;
+    }
+  }
+  ent.meta.owner = owner.get_id().to_str();
+  ent.meta.owner_display_name = owner.get_display_name();
+  ent.meta.content_type = content_type;
+
+  BucketShard *bs;
+  int ret = guard_reshard(&bs, [&](BucketShard *bs) -> int {
+    return store->cls_obj_put_inline(*bs, ent, category, inline_data,
+                                     mode, bilog_flags, zones_trace);
+  });
+  if (ret < 0) {
+    return ret;
+  }
+
+  if (target->bucket_info.datasync_flag_enabled()) {
+    int r = store->data_log->add_entry(bs->bucket, bs->shard_id);
+    if (r < 0) {
+      lderr(store->ctx()) << "ERROR: failed writing data log" << dendl;
+    }
+  }
+
+  return 0;
+}
+
 int RGWRados::Bucket::UpdateIndex::complete_del(int64_t poolid, uint64_t epoch,
                                                 real_time& removed_mtime,
                                                 list<rgw_obj_index_key> *remove_objs)
@@ -6549,7 +7057,8 @@ int RGWRados::Bucket::UpdateIndex::complete_del(int64_t poolid, uint64_t epoch,
     return ret;
   }
 
-  ret = store->cls_obj_complete_del(*bs, optag, poolid, epoch, obj, removed_mtime, remove_objs, bilog_flags, zones_trace);
+  const bool batch = RGWIndexCompletionBatcher::batchable(target->bucket_info, obj.key);
+  ret = store->cls_obj_complete_del(*bs, optag, poolid, epoch, obj, removed_mtime, remove_objs, bilog_flags, zones_trace, batch);
 
   if (target->bucket_info.datasync_flag_enabled()) {
     int r = store->data_log->add_entry(bs->bucket, bs->shard_id);
@@ -6561,6 +7070,36 @@ int RGWRados::Bucket::UpdateIndex::complete_del(int64_t poolid, uint64_t epoch,
   return ret;
 }
 
+int RGWRados::Bucket::UpdateIndex::complete_del_inline(int64_t poolid,
+                                                       real_time& removed_mtime,
+                                                       list<rgw_obj_index_key> *remove_objs,
+                                                       const bufferlist& id_tag)
+{
+  if (blind) {
+    return 0;
+  }
+  RGWRados *store = target->get_store();
+  BucketShard *bs;
+
+  int ret = guard_reshard(&bs, [&](BucketShard *bs) -> int {
+    return store->cls_obj_complete_inline_del(*bs, optag, poolid, obj,
+                                              removed_mtime, remove_objs,
+                                              id_tag, bilog_flags, zones_trace);
+  });
+  if (ret < 0) {
+    return ret;
+  }
+
+  if (target->bucket_info.datasync_flag_enabled()) {
+    int r = store->data_log->add_entry(bs->bucket, bs->shard_id);
+    if (r < 0) {
+      lderr(store->ctx()) << "ERROR: failed writing data log" << dendl;
+    }
+  }
+
+  return 0;
+}
+
 
 int RGWRados::Bucket::UpdateIndex::cancel()
 {
@@ -6652,7 +7191,7 @@ int RGWRados::Object::Read::read(int64_t ofs, int64_t end, bufferlist& bl)
     if (r < 0)
       return r;
 
-    if (astate && astate->prefetch_data) {
+    if (astate && (astate->prefetch_data || astate->is_inline)) {
       if (!ofs && astate->data.length() >= len) {
         bl = astate->data;
         return bl.length();
@@ -6712,11 +7251,43 @@ struct get_obj_data {
   rgw::Aio* aio;
   uint64_t offset; // next offset to write to client
   rgw::AioResultList completed; // completed read results, sorted by offset
+  uint64_t buffered = 0; // bytes in completed
   optional_yield yield;
 
+  // the read-ahead window doubles as long as each window's worth of data
+  // gets to the client faster than the one before
+  uint64_t window;
+  const uint64_t max_window;
+  uint64_t window_bytes = 0; // bytes sent to the client in this window
+  ceph::mono_time window_start = ceph::mono_clock::now();
+  double last_rate = 0;
+
   get_obj_data(RGWRados* store, RGWGetDataCB* cb, rgw::Aio* aio,
-               uint64_t offset, optional_yield yield)
-    : store(store), client_cb(cb), aio(aio), offset(offset), yield(yield) {}
+               uint64_t offset, uint64_t window, uint64_t max_window,
+               optional_yield yield)
+    : store(store), client_cb(cb), aio(aio), offset(offset), yield(yield),
+      window(window), max_window(std::max(window, max_window)) {}
+
+  void update_window(uint64_t len) {
+    window_bytes += len;
+    if (window_bytes < window) {
+      return;
+    }
+    const auto now = ceph::mono_clock::now();
+    const double secs = std::chrono::duration<double>(now - window_start).count();
+    const double rate = secs > 0 ? window_bytes / secs : 0;
+    // a window that isn't at least 20% faster than the previous one
+    // isn't worth the memory
+    if (window < max_window && rate > last_rate * 1.2) {
+      window = std::min(window * 2, max_window);
+      aio->set_window(window);
+      ldout(store->ctx(), 20) << "get_obj_data: read window grows to "
+          << window << " at " << rate << " bytes/s" << dendl;
+    }
+    last_rate = rate;
+    window_bytes = 0;
+    window_start = now;
+  }
 
   int flush(rgw::AioResultList&& results) {
     int r = rgw::check_for_errors(results);
@@ -6724,6 +7295,9 @@ struct get_obj_data {
       return r;
     }
 
+    for (auto& e : results) {
+      buffered += e.data.length();
+    }
     auto cmp = [](const auto& lhs, const auto& rhs) { return lhs.id < rhs.id; };
     results.sort(cmp); // merge() requires results to be sorted first
     completed.merge(results, cmp); // merge results in sorted order
@@ -6733,10 +7307,28 @@ struct get_obj_data {
       completed.pop_front_and_dispose(std::default_delete<rgw::AioResultEntry>{});
 
       offset += bl.length();
+      buffered -= bl.length();
       int r = client_cb->handle_data(bl, 0, bl.length());
       if (r < 0) {
         return r;
       }
+      update_window(bl.length());
+    }
+    return 0;
+  }
+
+  // the reads that complete out of order are held until the ones before
+  // them complete. wait for those before reading more than a window ahead
+  int reserve(uint64_t len) {
+    while (!completed.empty() && buffered + len > window) {
+      auto c = aio->wait();
+      if (c.empty()) {
+        break;
+      }
+      int r = flush(std::move(c));
+      if (r < 0) {
+        return r;
+      }
     }
     return 0;
   }
@@ -6811,6 +7403,11 @@ int RGWRados::get_obj_iterate_cb(const rgw_raw_obj& read_obj, off_t obj_ofs,
   ldout(cct, 20) << "rados->get_obj_iterate_cb oid=" << read_obj.oid << " obj-ofs=" << obj_ofs << " read_ofs=" << read_ofs << " len=" << len << dendl;
   op.read(read_ofs, len, nullptr, nullptr);
 
+  r = d->reserve(len);
+  if (r < 0) {
+    return r;
+  }
+
   const uint64_t cost = len;
   const uint64_t id = obj_ofs; // use logical object offset for sorting replies
 
@@ -6827,9 +7424,11 @@ int RGWRados::Object::Read::iterate(int64_t ofs, int64_t end, RGWGetDataCB *cb,
   RGWObjectCtx& obj_ctx = source->get_ctx();
   const uint64_t chunk_size = cct->_conf->rgw_get_obj_max_req_size;
   const uint64_t window_size = cct->_conf->rgw_get_obj_window_size;
+  const uint64_t max_window_size =
+    cct->_conf.get_val<Option::size_t>("rgw_get_obj_max_window_size");
 
   auto aio = rgw::make_throttle(window_size, y);
-  get_obj_data data(store, cb, &*aio, ofs, y);
+  get_obj_data data(store, cb, &*aio, ofs, window_size, max_window_size, y);
 
   int r = store->iterate_obj(obj_ctx, source->get_bucket_info(), state.obj,
                              ofs, end, chunk_size, _get_obj_iterate_cb, &data);
@@ -7124,7 +7723,9 @@ int RGWRados::block_while_resharding(RGWRados::BucketShard *bs,
       return ret;
     }
 
-    if (!entry.resharding_in_progress()) {
+    // an OSD that doesn't know about online resharding blocks the writes
+    // all the same, so wait for that one to complete too
+    if (!entry.resharding_in_progress() && !entry.resharding_online()) {
       return fetch_new_bucket_id("get_bucket_resharding_succeeded",
 				 new_bucket_id);
     }
@@ -8993,7 +9594,8 @@ int RGWRados::cls_obj_prepare_op(BucketShard& bs, RGWModifyOp op, string& tag,
 int RGWRados::cls_obj_complete_op(BucketShard& bs, const rgw_obj& obj, RGWModifyOp op, string& tag,
                                   int64_t pool, uint64_t epoch,
                                   rgw_bucket_dir_entry& ent, RGWObjCategory category,
-				  list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *_zones_trace)
+				  list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *_zones_trace,
+                                  bool batch)
 {
   ObjectWriteOperation o;
   rgw_bucket_dir_entry_meta dir_meta;
@@ -9010,6 +9612,11 @@ int RGWRados::cls_obj_complete_op(BucketShard& bs, const rgw_obj& obj, RGWModify
   ver.pool = pool;
   ver.epoch = epoch;
   cls_rgw_obj_key key(ent.key.name, ent.key.instance);
+  if (batch &&
+      index_completion_manager->batch_completion(bs, obj, op, tag, ver, key, dir_meta, remove_objs,
+                                                 svc.zone->get_zone().log_data, bilog_flags, &zones_trace)) {
+    return 0;
+  }
   cls_rgw_guard_bucket_resharding(o, -ERR_BUSY_RESHARDING);
   cls_rgw_bucket_complete_op(o, op, tag, ver, key, dir_meta, remove_objs,
                              svc.zone->get_zone().log_data, bilog_flags, &zones_trace);
@@ -9025,9 +9632,10 @@ int RGWRados::cls_obj_complete_op(BucketShard& bs, const rgw_obj& obj, RGWModify
 int RGWRados::cls_obj_complete_add(BucketShard& bs, const rgw_obj& obj, string& tag,
                                    int64_t pool, uint64_t epoch,
                                    rgw_bucket_dir_entry& ent, RGWObjCategory category,
-                                   list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *zones_trace)
+                                   list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *zones_trace,
+                                   bool batch)
 {
-  return cls_obj_complete_op(bs, obj, CLS_RGW_OP_ADD, tag, pool, epoch, ent, category, remove_objs, bilog_flags, zones_trace);
+  return cls_obj_complete_op(bs, obj, CLS_RGW_OP_ADD, tag, pool, epoch, ent, category, remove_objs, bilog_flags, zones_trace, batch);
 }
 
 int RGWRados::cls_obj_complete_del(BucketShard& bs, string& tag,
@@ -9036,14 +9644,15 @@ int RGWRados::cls_obj_complete_del(BucketShard& bs, string& tag,
                                    real_time& removed_mtime,
                                    list<rgw_obj_index_key> *remove_objs,
                                    uint16_t bilog_flags,
-                                   rgw_zone_set *zones_trace)
+                                   rgw_zone_set *zones_trace,
+                                   bool batch)
 {
   rgw_bucket_dir_entry ent;
   ent.meta.mtime = removed_mtime;
   obj.key.get_index_key(&ent.key);
   return cls_obj_complete_op(bs, obj, CLS_RGW_OP_DEL, tag, pool, epoch,
 			     ent, RGWObjCategory::None, remove_objs,
-			     bilog_flags, zones_trace);
+			     bilog_flags, zones_trace, batch);
 }
 
 int RGWRados::cls_obj_complete_cancel(BucketShard& bs, string& tag, rgw_obj& obj, uint16_t bilog_flags, rgw_zone_set *zones_trace)
@@ -9056,6 +9665,65 @@ int RGWRados::cls_obj_complete_cancel(BucketShard& bs, string& tag, rgw_obj& obj
 			     zones_trace);
 }
 
+int RGWRados::cls_obj_complete_inline_del(BucketShard& bs, string& tag,
+                                          int64_t pool, rgw_obj& obj,
+                                          real_time& removed_mtime,
+                                          list<rgw_obj_index_key> *remove_objs,
+                                          const bufferlist& id_tag,
+                                          uint16_t bilog_flags,
+                                          rgw_zone_set *_zones_trace)
+{
+  ObjectWriteOperation o;
+  rgw_bucket_dir_entry_meta dir_meta;
+  dir_meta.mtime = removed_mtime;
+
+  rgw_zone_set zones_trace;
+  if (_zones_trace) {
+    zones_trace = *_zones_trace;
+  }
+  zones_trace.insert(svc.zone->get_zone().id);
+
+  /* there's no head object version to check the entry against, so check in
+   * the same op that the entry is still the inline object that was read; a
+   * put that replaced it must keep its entry */
+  rgw_bucket_entry_ver ver;
+  ver.pool = pool;
+  ver.epoch = 0;
+  rgw_obj_index_key index_key;
+  obj.key.get_index_key(&index_key);
+  cls_rgw_obj_key key(index_key.name, index_key.instance);
+  cls_rgw_guard_bucket_resharding(o, -ERR_BUSY_RESHARDING);
+  cls_rgw_guard_inline_entry(o, key, id_tag, -ECANCELED);
+  cls_rgw_bucket_complete_op(o, CLS_RGW_OP_DEL, tag, ver, key, dir_meta,
+                             remove_objs, svc.zone->get_zone().log_data,
+                             bilog_flags, &zones_trace);
+  return bs.index_ctx.operate(bs.bucket_obj, &o);
+}
+
+int RGWRados::cls_obj_put_inline(BucketShard& bs, rgw_bucket_dir_entry& ent,
+                                 RGWObjCategory category,
+                                 rgw_bucket_inline_data& inline_data,
+                                 RGWPutInlineMode mode, uint16_t bilog_flags,
+                                 rgw_zone_set *_zones_trace)
+{
+  ObjectWriteOperation o;
+  rgw_bucket_dir_entry_meta dir_meta = ent.meta;
+  dir_meta.category = category;
+
+  rgw_zone_set zones_trace;
+  if (_zones_trace) {
+    zones_trace = *_zones_trace;
+  }
+  zones_trace.insert(svc.zone->get_zone().id);
+
+  cls_rgw_obj_key key(ent.key.name, ent.key.instance);
+  cls_rgw_guard_bucket_resharding(o, -ERR_BUSY_RESHARDING);
+  cls_rgw_bucket_put_inline(o, key, dir_meta, inline_data, mode,
+                            svc.zone->get_zone().log_data, bilog_flags,
+                            &zones_trace);
+  return bs.index_ctx.operate(bs.bucket_obj, &o);
+}
+
 int RGWRados::cls_obj_set_bucket_tag_timeout(RGWBucketInfo& bucket_info, uint64_t timeout)
 {
   librados::IoCtx index_ctx;
@@ -9072,6 +9740,7 @@ int RGWRados::cls_bucket_list_ordered(RGWBucketInfo& bucket_info,
 				      int shard_id,
 				      const rgw_obj_index_key& start,
 				      const string& prefix,
+				      const string& delimiter,
 				      uint32_t num_entries,
 				      bool list_versions,
 				      map<string, rgw_bucket_dir_entry>& m,
@@ -9085,55 +9754,48 @@ int RGWRados::cls_bucket_list_ordered(RGWBucketInfo& bucket_info,
 
   librados::IoCtx index_ctx;
   // key   - oid (for different shards if there is any)
-  // value - list result for the corresponding oid (shard), it is filled by
-  //         the AIO callback
   map<int, string> oids;
-  map<int, struct rgw_cls_list_ret> list_results;
   int r = open_bucket_index(bucket_info, index_ctx, oids, shard_id);
   if (r < 0)
     return r;
 
   cls_rgw_obj_key start_key(start.name, start.instance);
-  r = CLSRGWIssueBucketList(index_ctx, start_key, prefix, num_entries,
-			    list_versions, oids, list_results,
-			    cct->_conf->rgw_bucket_index_max_aio)();
+  rgw::BucketListMerge merge(
+    oids, num_entries, cct->_conf->rgw_list_bucket_min_shard_entries,
+    [&](const cls_rgw_obj_key& marker, uint32_t n,
+	map<int, string>& shard_oids,
+	map<int, rgw_cls_list_ret>& results) {
+      return CLSRGWIssueBucketList(index_ctx, marker, prefix, delimiter, n,
+				   list_versions, shard_oids, results,
+				   cct->_conf->rgw_bucket_index_max_aio)();
+    });
+  r = merge.init(start_key);
   if (r < 0)
     return r;
 
-  // Create a list of iterators that are used to iterate each shard
-  vector<map<string, struct rgw_bucket_dir_entry>::iterator> vcurrents;
-  vector<map<string, struct rgw_bucket_dir_entry>::iterator> vends;
-  vector<string> vnames;
-  vcurrents.reserve(list_results.size());
-  vends.reserve(list_results.size());
-  vnames.reserve(list_results.size());
-  map<int, struct rgw_cls_list_ret>::iterator iter = list_results.begin();
-  *is_truncated = false;
-  for (; iter != list_results.end(); ++iter) {
-    vcurrents.push_back(iter->second.dir.m.begin());
-    vends.push_back(iter->second.dir.m.end());
-    vnames.push_back(oids[iter->first]);
-    *is_truncated = (*is_truncated || iter->second.is_truncated);
-  }
-
-  // Create a map to track the next candidate entry from each shard, if the entry
-  // from a specified shard is selected/erased, the next entry from that shard will
-  // be inserted for next round selection
-  map<string, size_t> candidates;
-  for (size_t i = 0; i < vcurrents.size(); ++i) {
-    if (vcurrents[i] != vends[i]) {
-      candidates[vcurrents[i]->first] = i;
-    }
-  }
-
   map<string, bufferlist> updates;
   uint32_t count = 0;
-  while (count < num_entries && !candidates.empty()) {
-    r = 0;
+  while (count < num_entries) {
     // Select the next one
-    int pos = candidates.begin()->second;
-    const string& name = vcurrents[pos]->first;
-    struct rgw_bucket_dir_entry& dirent = vcurrents[pos]->second;
+    const string *name;
+    rgw_bucket_dir_entry *entry;
+    const string *oid;
+    r = merge.peek(&name, &entry, &oid);
+    if (r == -ENOENT)
+      break;
+    if (r < 0)
+      return r;
+    struct rgw_bucket_dir_entry& dirent = *entry;
+
+    if (dirent.is_common_prefix()) {
+      // every shard with entries under the prefix returns it
+      if (m.find(*name) == m.end()) {
+	m[*name] = std::move(dirent);
+	++count;
+      }
+      merge.pop();
+      continue;
+    }
 
     bool force_check = force_check_filter &&
         force_check_filter(dirent.key.name);
@@ -9145,25 +9807,24 @@ int RGWRados::cls_bucket_list_ordered(RGWBucketInfo& bucket_info,
       librados::IoCtx sub_ctx;
       sub_ctx.dup(index_ctx);
       r = check_disk_state(sub_ctx, bucket_info, dirent, dirent,
-			   updates[vnames[pos]]);
+			   updates[*oid]);
       if (r < 0 && r != -ENOENT) {
           return r;
       }
+    } else {
+      r = 0;
     }
     if (r >= 0) {
       ldout(cct, 10) << "RGWRados::cls_bucket_list_ordered: got " <<
 	dirent.key.name << "[" << dirent.key.instance << "]" << dendl;
-      m[name] = std::move(dirent);
+      m[*name] = std::move(dirent);
       ++count;
     }
-
-    // Refresh the candidates map
-    candidates.erase(candidates.begin());
-    ++vcurrents[pos];
-    if (vcurrents[pos] != vends[pos]) {
-      candidates[vcurrents[pos]->first] = pos;
-    }
+    merge.pop();
   }
+  ldout(cct, 20) << "cls_bucket_list_ordered: " << merge.get_num_fetches()
+		 << " shard requests returned " << merge.get_num_fetched()
+		 << " entries" << dendl;
 
   // Suggest updates if there is any
   map<string, bufferlist>::iterator miter = updates.begin();
@@ -9179,12 +9840,7 @@ int RGWRados::cls_bucket_list_ordered(RGWBucketInfo& bucket_info,
   }
 
   // Check if all the returned entries are consumed or not
-  for (size_t i = 0; i < vcurrents.size(); ++i) {
-    if (vcurrents[i] != vends[i]) {
-      *is_truncated = true;
-      break;
-    }
-  }
+  *is_truncated = merge.is_truncated();
   if (!m.empty())
     *last_entry = m.rbegin()->first;
 
@@ -9267,7 +9923,7 @@ int RGWRados::cls_bucket_list_unordered(RGWBucketInfo& bucket_info,
     rgw_cls_list_ret result;
 
     librados::ObjectReadOperation op;
-    cls_rgw_bucket_list_op(op, marker, prefix, num_entries,
+    cls_rgw_bucket_list_op(op, marker, prefix, string(), num_entries,
                            list_versions, &result);
     r = index_ctx.operate(oid, &op, nullptr);
     if (r < 0)
@@ -9362,7 +10018,7 @@ int RGWRados::cls_obj_usage_log_add(const string& oid,
 int RGWRados::cls_obj_usage_log_read(const string& oid, const string& user, const string& bucket,
                                      uint64_t start_epoch, uint64_t end_epoch, uint32_t max_entries,
                                      string& read_iter, map<rgw_user_bucket, rgw_usage_log_entry>& usage,
-				     bool *is_truncated)
+				     bool *is_truncated, bool daily)
 {
   rgw_raw_obj obj(svc.zone->get_zone_params().usage_log_pool, oid);
 
@@ -9375,7 +10031,7 @@ int RGWRados::cls_obj_usage_log_read(const string& oid, const string& user, cons
   *is_truncated = false;
 
   r = cls_rgw_usage_log_read(ref.ioctx, ref.obj.oid, user, bucket, start_epoch, end_epoch,
-			     max_entries, read_iter, usage, is_truncated);
+			     max_entries, read_iter, usage, is_truncated, daily);
 
   return r;
 }
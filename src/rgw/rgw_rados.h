@@ -414,6 +414,11 @@ protected:
 
   string tail_instance; /* tail object's instance */
 
+  bool compact_rules{false}; /* encode rules with encode_compact_rules() */
+
+  void encode_compact_rules(bufferlist& bl) const;
+  void decode_compact_rules(bufferlist::const_iterator& bl);
+
   void convert_to_explicit(const RGWZoneGroup& zonegroup, const RGWZoneParams& zone_params);
   int append_explicit(RGWObjManifest& m, const RGWZoneGroup& zonegroup, const RGWZoneParams& zone_params);
   void append_rules(RGWObjManifest& m, map<uint64_t, RGWObjManifestRule>::iterator& iter, string *override_prefix);
@@ -440,6 +445,7 @@ public:
     tail_placement = rhs.tail_placement;
     rules = rhs.rules;
     tail_instance = rhs.tail_instance;
+    compact_rules = rhs.compact_rules;
 
     begin_iter.set_manifest(this);
     end_iter.set_manifest(this);
@@ -476,8 +482,17 @@ public:
     max_head_size = 0;
   }
 
+  /*
+   * a manifest built from many parts of different sizes has a rule per
+   * part.  the compact encoding stores these as deltas in varints, but
+   * can't be decoded by older gateways, so it's only used when asked for
+   */
+  void set_compact_rules(bool compact) {
+    compact_rules = compact;
+  }
+
   void encode(bufferlist& bl) const {
-    ENCODE_START(7, 6, bl);
+    ENCODE_START(compact_rules ? 8 : 7, compact_rules ? 8 : 6, bl);
     encode(obj_size, bl);
     encode(objs, bl);
     encode(explicit_objs, bl);
@@ -485,7 +500,11 @@ public:
     encode(head_size, bl);
     encode(max_head_size, bl);
     encode(prefix, bl);
-    encode(rules, bl);
+    if (compact_rules) {
+      encode_compact_rules(bl);
+    } else {
+      encode(rules, bl);
+    }
     bool encode_tail_bucket = !(tail_placement.bucket == obj.bucket);
     encode(encode_tail_bucket, bl);
     if (encode_tail_bucket) {
@@ -502,16 +521,21 @@ public:
   }
 
   void decode(bufferlist::const_iterator& bl) {
-    DECODE_START_LEGACY_COMPAT_LEN_32(7, 2, 2, bl);
+    DECODE_START_LEGACY_COMPAT_LEN_32(8, 2, 2, bl);
     decode(obj_size, bl);
     decode(objs, bl);
+    compact_rules = (struct_v >= 8);
     if (struct_v >= 3) {
       decode(explicit_objs, bl);
       decode(obj, bl);
       decode(head_size, bl);
       decode(max_head_size, bl);
       decode(prefix, bl);
-      decode(rules, bl);
+      if (compact_rules) {
+        decode_compact_rules(bl);
+      } else {
+        decode(rules, bl);
+      }
     } else {
       explicit_objs = true;
       if (!objs.empty()) {
@@ -890,6 +914,7 @@ struct RGWObjState {
   bufferlist olh_tag;
   uint64_t pg_ver;
   uint32_t zone_short_id;
+  bool is_inline{false}; //< data and attrs are in the bucket index entry
 
   /* important! don't forget to update copy constructor */
 
@@ -930,6 +955,7 @@ struct RGWObjState {
     is_olh = rhs.is_olh;
     objv_tracker = rhs.objv_tracker;
     pg_ver = rhs.pg_ver;
+    is_inline = rhs.is_inline;
   }
 
   bool get_attr(string name, bufferlist& dest) {
@@ -1256,6 +1282,7 @@ class RGWRados : public AdminSocketHook
                            RGWObjState *olh_state, RGWObjState **target_state);
   int get_obj_state_impl(RGWObjectCtx *rctx, const RGWBucketInfo& bucket_info, const rgw_obj& obj, RGWObjState **state,
                          bool follow_olh, bool assume_noent = false);
+  int get_inline_obj_state(const RGWBucketInfo& bucket_info, const rgw_obj& obj, RGWObjState *s);
   int append_atomic_test(RGWObjectCtx *rctx, const RGWBucketInfo& bucket_info, const rgw_obj& obj,
                          librados::ObjectOperation& op, RGWObjState **state);
   int append_atomic_test(const RGWObjState* astate, librados::ObjectOperation& op);
@@ -1440,7 +1467,7 @@ public:
   int log_usage(map<rgw_user_bucket, RGWUsageBatch>& usage_info);
   int read_usage(const rgw_user& user, const string& bucket_name, uint64_t start_epoch, uint64_t end_epoch,
                  uint32_t max_entries, bool *is_truncated, RGWUsageIter& read_iter, map<rgw_user_bucket,
-		 rgw_usage_log_entry>& usage);
+		 rgw_usage_log_entry>& usage, bool daily = false);
   int trim_usage(const rgw_user& user, const string& bucket_name, uint64_t start_epoch, uint64_t end_epoch);
   int clear_usage();
 
@@ -1604,6 +1631,7 @@ public:
         bool modify_tail;
         bool completeMultipart;
         bool appendable;
+        bool inline_data{false}; //< store data and attrs in the index entry
 
         MetaParams() : mtime(NULL), rmattrs(NULL), data(NULL), manifest(NULL), ptag(NULL),
                  remove_objs(NULL), category(RGWObjCategory::Main), flags(0),
@@ -1617,6 +1645,9 @@ public:
                      map<std::string, bufferlist>& attrs,
                      bool modify_tail, bool assume_noent,
                      void *index_op);
+      int write_meta_inline(uint64_t size, uint64_t accounted_size,
+                            map<std::string, bufferlist>& attrs,
+                            void *index_op);
       int write_meta(uint64_t size, uint64_t accounted_size,
                      map<std::string, bufferlist>& attrs);
       int write_data(const char *data, uint64_t ofs, uint64_t len, bool exclusive);
@@ -1772,6 +1803,21 @@ public:
       int complete_del(int64_t poolid, uint64_t epoch,
                        ceph::real_time& removed_mtime, /* mtime of removed object */
                        list<rgw_obj_index_key> *remove_objs);
+      /* remove an inline entry, failing with -ECANCELED if it no longer
+       * holds the object written with id_tag */
+      int complete_del_inline(int64_t poolid,
+                              ceph::real_time& removed_mtime,
+                              list<rgw_obj_index_key> *remove_objs,
+                              const bufferlist& id_tag);
+      /* write an entry holding the object, without prepare() */
+      int complete_inline(uint64_t size, uint64_t accounted_size,
+                          ceph::real_time& ut, const string& etag,
+                          const string& content_type,
+                          const string& storage_class,
+                          bufferlist *acl_bl, RGWObjCategory category,
+                          const string *user_data,
+                          rgw_bucket_inline_data& inline_data,
+                          RGWPutInlineMode mode);
       int cancel();
 
       const string *get_optag() { return &optag; }
@@ -2197,16 +2243,27 @@ public:
 
   int cls_obj_prepare_op(BucketShard& bs, RGWModifyOp op, string& tag, rgw_obj& obj, uint16_t bilog_flags, rgw_zone_set *zones_trace = nullptr);
   int cls_obj_complete_op(BucketShard& bs, const rgw_obj& obj, RGWModifyOp op, string& tag, int64_t pool, uint64_t epoch,
-                          rgw_bucket_dir_entry& ent, RGWObjCategory category, list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *zones_trace = nullptr);
+                          rgw_bucket_dir_entry& ent, RGWObjCategory category, list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *zones_trace = nullptr,
+                          bool batch = false);
   int cls_obj_complete_add(BucketShard& bs, const rgw_obj& obj, string& tag, int64_t pool, uint64_t epoch, rgw_bucket_dir_entry& ent,
-                           RGWObjCategory category, list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *zones_trace = nullptr);
+                           RGWObjCategory category, list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *zones_trace = nullptr,
+                           bool batch = false);
   int cls_obj_complete_del(BucketShard& bs, string& tag, int64_t pool, uint64_t epoch, rgw_obj& obj,
-                           ceph::real_time& removed_mtime, list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *zones_trace = nullptr);
+                           ceph::real_time& removed_mtime, list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags, rgw_zone_set *zones_trace = nullptr,
+                           bool batch = false);
   int cls_obj_complete_cancel(BucketShard& bs, string& tag, rgw_obj& obj, uint16_t bilog_flags, rgw_zone_set *zones_trace = nullptr);
+  int cls_obj_complete_inline_del(BucketShard& bs, string& tag, int64_t pool, rgw_obj& obj,
+                                  ceph::real_time& removed_mtime, list<rgw_obj_index_key> *remove_objs,
+                                  const bufferlist& id_tag, uint16_t bilog_flags,
+                                  rgw_zone_set *zones_trace = nullptr);
+  int cls_obj_put_inline(BucketShard& bs, rgw_bucket_dir_entry& ent, RGWObjCategory category,
+                         rgw_bucket_inline_data& inline_data, RGWPutInlineMode mode,
+                         uint16_t bilog_flags, rgw_zone_set *zones_trace = nullptr);
   int cls_obj_set_bucket_tag_timeout(RGWBucketInfo& bucket_info, uint64_t timeout);
   int cls_bucket_list_ordered(RGWBucketInfo& bucket_info, int shard_id,
 			      const rgw_obj_index_key& start,
 			      const string& prefix,
+			      const string& delimiter,
 			      uint32_t num_entries, bool list_versions,
 			      map<string, rgw_bucket_dir_entry>& m,
 			      bool *is_truncated,
@@ -2242,7 +2299,7 @@ public:
   int cls_obj_usage_log_add(const string& oid, rgw_usage_log_info& info);
   int cls_obj_usage_log_read(const string& oid, const string& user, const string& bucket, uint64_t start_epoch,
                              uint64_t end_epoch, uint32_t max_entries, string& read_iter, map<rgw_user_bucket,
-			     rgw_usage_log_entry>& usage, bool *is_truncated);
+			     rgw_usage_log_entry>& usage, bool *is_truncated, bool daily = false);
   int cls_obj_usage_log_trim(const string& oid, const string& user, const string& bucket, uint64_t start_epoch,
                              uint64_t end_epoch);
   int cls_obj_usage_log_clear(string& oid);
@@ -2259,7 +2316,8 @@ public:
   int time_log_add(const string& oid, const ceph::real_time& ut, const string& section, const string& key, bufferlist& bl);
   int time_log_list(const string& oid, const ceph::real_time& start_time, const ceph::real_time& end_time,
                     int max_entries, list<cls_log_entry>& entries,
-		    const string& marker, string *out_marker, bool *truncated);
+		    const string& marker, string *out_marker, bool *truncated,
+                    librados::AioCompletion *completion = nullptr);
   int time_log_info(const string& oid, cls_log_header *header);
   int time_log_info_async(librados::IoCtx& io_ctx, const string& oid, cls_log_header *header, librados::AioCompletion *completion);
   int time_log_trim(const string& oid, const ceph::real_time& start_time, const ceph::real_time& end_time,
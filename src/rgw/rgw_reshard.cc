@@ -24,6 +24,9 @@
 const string reshard_oid_prefix = "reshard.";
 const string reshard_lock_name = "reshard_process";
 const string bucket_instance_lock_name = "bucket_instance_lock";
+// the passes over the index log of an online reshard before the writes
+// are blocked anyway, in case they outpace the replay
+static constexpr int max_online_replay_passes = 10;
 
 
 class BucketReshardShard {
@@ -33,6 +36,9 @@ class BucketReshardShard {
   RGWRados::BucketShard bs;
   vector<rgw_cls_bi_entry> entries;
   map<RGWObjCategory, rgw_bucket_category_stats> stats;
+  // the stats of all the entries written, for an online reshard to set
+  // them once the index log has been replayed
+  map<RGWObjCategory, rgw_bucket_category_stats> totals;
   deque<librados::AioCompletion *>& aio_completions;
   uint64_t max_aio_completions;
   uint64_t reshard_shard_batch_size;
@@ -68,6 +74,27 @@ class BucketReshardShard {
     return 0;
   }
 
+  void account_total(rgw_cls_bi_entry& entry, bool add) {
+    cls_rgw_obj_key key;
+    RGWObjCategory category;
+    rgw_bucket_category_stats entry_stats;
+    if (!entry.get_info(&key, &category, &entry_stats)) {
+      return;
+    }
+    rgw_bucket_category_stats& target = totals[category];
+    if (add) {
+      target.num_entries += entry_stats.num_entries;
+      target.total_size += entry_stats.total_size;
+      target.total_size_rounded += entry_stats.total_size_rounded;
+      target.actual_size += entry_stats.actual_size;
+    } else {
+      target.num_entries -= entry_stats.num_entries;
+      target.total_size -= entry_stats.total_size;
+      target.total_size_rounded -= entry_stats.total_size_rounded;
+      target.actual_size -= entry_stats.actual_size;
+    }
+  }
+
 public:
   BucketReshardShard(RGWRados *_store, const RGWBucketInfo& _bucket_info,
                      int _num_shard,
@@ -97,6 +124,7 @@ public:
       target.total_size += entry_stats.total_size;
       target.total_size_rounded += entry_stats.total_size_rounded;
       target.actual_size += entry_stats.actual_size;
+      account_total(entry, true);
     }
     if (entries.size() >= reshard_shard_batch_size) {
       int ret = flush();
@@ -134,6 +162,68 @@ public:
     return 0;
   }
 
+  // replace the index entries of an object with those of its source shard
+  int sync_entries(const string& name, list<rgw_cls_bi_entry>& source) {
+    list<rgw_cls_bi_entry> current;
+    string marker;
+    bool is_truncated = true;
+    while (is_truncated) {
+      list<rgw_cls_bi_entry> l;
+      int ret = store->bi_list(bs, name, marker, reshard_shard_batch_size,
+			       &l, &is_truncated);
+      if (ret < 0 && ret != -ENOENT) {
+	return ret;
+      }
+      if (l.empty()) {
+	break;
+      }
+      marker = l.back().idx;
+      current.splice(current.end(), l);
+    }
+
+    set<string> keep;
+    for (auto& entry : source) {
+      keep.insert(entry.idx);
+    }
+    librados::ObjectWriteOperation op;
+    set<string> remove;
+    for (auto& entry : current) {
+      account_total(entry, false);
+      if (keep.find(entry.idx) == keep.end()) {
+	remove.insert(entry.idx);
+      }
+    }
+    if (!remove.empty()) {
+      op.omap_rm_keys(remove);
+    }
+    for (auto& entry : source) {
+      store->bi_put(op, bs, entry);
+      account_total(entry, true);
+    }
+    if (op.size() == 0) {
+      return 0;
+    }
+
+    librados::AioCompletion *c;
+    int ret = get_completion(&c);
+    if (ret < 0) {
+      return ret;
+    }
+    return bs.index_ctx.aio_operate(bs.bucket_obj, c, &op);
+  }
+
+  // overwrite the stats of the shard with those of the entries written
+  int set_stats() {
+    librados::ObjectWriteOperation op;
+    cls_rgw_bucket_update_stats(op, true, totals);
+    librados::AioCompletion *c;
+    int ret = get_completion(&c);
+    if (ret < 0) {
+      return ret;
+    }
+    return bs.index_ctx.aio_operate(bs.bucket_obj, c, &op);
+  }
+
   int wait_all_aio() {
     int ret = 0;
     while (!aio_completions.empty()) {
@@ -174,6 +264,7 @@ public:
         ldout(store->ctx(), 20) << __func__ <<
 	  ": shard->wait_all_aio() returned ret=" << ret << dendl;
       }
+      delete shard;
     }
   }
 
@@ -191,24 +282,54 @@ public:
     return 0;
   }
 
-  int finish() {
+  int sync_entries(int shard_index, const string& name,
+		   list<rgw_cls_bi_entry>& source) {
+    int ret = target_shards[shard_index]->sync_entries(name, source);
+    if (ret < 0) {
+      derr << "ERROR: target_shards.sync_entries(" << name <<
+	") returned error: " << cpp_strerror(-ret) << dendl;
+      return ret;
+    }
+
+    return 0;
+  }
+
+  int wait_all_aio() {
     int ret = 0;
     for (auto& shard : target_shards) {
-      int r = shard->flush();
+      int r = shard->wait_all_aio();
       if (r < 0) {
-        derr << "ERROR: target_shards[" << shard->get_num_shard() << "].flush() returned error: " << cpp_strerror(-r) << dendl;
+        derr << "ERROR: target_shards[" << shard->get_num_shard() << "].wait_all_aio() returned error: " << cpp_strerror(-r) << dendl;
         ret = r;
       }
     }
+    return ret;
+  }
+
+  int set_stats() {
     for (auto& shard : target_shards) {
-      int r = shard->wait_all_aio();
+      int ret = shard->set_stats();
+      if (ret < 0) {
+        derr << "ERROR: target_shards[" << shard->get_num_shard() << "].set_stats() returned error: " << cpp_strerror(-ret) << dendl;
+        return ret;
+      }
+    }
+    return wait_all_aio();
+  }
+
+  int finish() {
+    int ret = 0;
+    for (auto& shard : target_shards) {
+      int r = shard->flush();
       if (r < 0) {
-        derr << "ERROR: target_shards[" << shard->get_num_shard() << "].wait_all_aio() returned error: " << cpp_strerror(-r) << dendl;
+        derr << "ERROR: target_shards[" << shard->get_num_shard() << "].flush() returned error: " << cpp_strerror(-r) << dendl;
         ret = r;
       }
-      delete shard;
     }
-    target_shards.clear();
+    int r = wait_all_aio();
+    if (r < 0) {
+      ret = r;
+    }
     return ret;
   }
 }; // class BucketReshardManager
@@ -484,9 +605,170 @@ int RGWBucketReshardLock::renew(const Clock::time_point& now) {
 }
 
 
+// the reshard status of each source shard, along with the progress of
+// the reshard, written back to the shards every now and then
+class ReshardProgress {
+  RGWRados *store;
+  librados::IoCtx& index_ctx;
+  map<int, string>& oids;
+  map<int, cls_rgw_bucket_instance_entry> entries;
+  set<int> dirty;
+  ceph::coarse_mono_time last_write;
+
+  static constexpr auto write_interval = std::chrono::seconds(10);
+
+public:
+  ReshardProgress(RGWRados *_store, librados::IoCtx& _index_ctx,
+		  map<int, string>& _oids, const string& new_instance_id,
+		  int32_t num_shards, cls_rgw_reshard_status status) :
+    store(_store), index_ctx(_index_ctx), oids(_oids)
+  {
+    for (auto& i : oids) {
+      entries[i.first].set_status(new_instance_id, num_shards, status);
+    }
+  }
+
+  cls_rgw_bucket_instance_entry& get(int shard) {
+    dirty.insert(shard);
+    return entries[shard];
+  }
+
+  void set_status(cls_rgw_reshard_status status) {
+    for (auto& i : entries) {
+      i.second.reshard_status = status;
+      dirty.insert(i.first);
+    }
+  }
+
+  int write(bool force) {
+    const auto now = ceph::coarse_mono_clock::now();
+    if (dirty.empty() || (!force && now - last_write < write_interval)) {
+      return 0;
+    }
+    last_write = now;
+
+    map<int, string> dirty_oids;
+    const auto update_time = ceph::real_clock::now();
+    for (int shard : dirty) {
+      entries[shard].update_time = update_time;
+      dirty_oids[shard] = oids[shard];
+    }
+    int ret = CLSRGWIssueSetBucketResharding(index_ctx, dirty_oids, entries,
+			store->ctx()->_conf->rgw_bucket_index_max_aio)();
+    if (ret < 0) {
+      lderr(store->ctx()) << "ERROR: failed to write reshard progress: " <<
+	cpp_strerror(-ret) << dendl;
+      return ret;
+    }
+    dirty.clear();
+    return 0;
+  }
+};
+
+static int get_target_shard_index(RGWRados *store,
+				  const RGWBucketInfo& new_bucket_info,
+				  const cls_rgw_obj_key& cls_key,
+				  int *shard_index)
+{
+  int target_shard_id;
+  rgw_obj obj(new_bucket_info.bucket, rgw_obj_key(cls_key));
+  int ret = store->get_target_shard_id(new_bucket_info, obj.get_hash_object(),
+				       &target_shard_id);
+  if (ret < 0) {
+    lderr(store->ctx()) << "ERROR: get_target_shard_id() returned ret=" << ret << dendl;
+    return ret;
+  }
+  *shard_index = (target_shard_id > 0 ? target_shard_id : 0);
+  return 0;
+}
+
+// copy the index changes that the source shards logged after @p markers
+// to the target shards.  the log only tells which objects changed, so
+// all the entries of each of them are copied again
+static int replay_index_log(RGWRados *store, RGWBucketInfo& bucket_info,
+			    const RGWBucketInfo& new_bucket_info,
+			    librados::IoCtx& index_ctx, map<int, string>& oids,
+			    BucketIndexShardsManager& markers,
+			    BucketReshardManager& target_shards_mgr,
+			    ReshardProgress& progress, uint64_t *num_replayed)
+{
+  const uint32_t max_aio = store->ctx()->_conf->rgw_bucket_index_max_aio;
+  const uint32_t max_entries =
+    store->ctx()->_conf.get_val<uint64_t>("rgw_reshard_batch_size");
+
+  *num_replayed = 0;
+  map<int, string> pending = oids;
+  while (!pending.empty()) {
+    map<int, cls_rgw_bi_log_list_ret> logs;
+    int ret = CLSRGWIssueBILogList(index_ctx, markers, max_entries, pending,
+				   logs, max_aio)();
+    if (ret < 0) {
+      lderr(store->ctx()) << "ERROR: failed to list bucket index log: " <<
+	cpp_strerror(-ret) << dendl;
+      return ret;
+    }
+
+    for (auto& [shard, log] : logs) {
+      set<string> names;
+      for (auto& entry : log.entries) {
+	names.insert(entry.object);
+	markers.add(shard, entry.id);
+      }
+      for (auto& name : names) {
+	list<rgw_cls_bi_entry> source;
+	string marker;
+	bool is_truncated = true;
+	while (is_truncated) {
+	  list<rgw_cls_bi_entry> l;
+	  ret = store->bi_list(bucket_info.bucket, shard, name, marker,
+			       max_entries, &l, &is_truncated);
+	  if (ret < 0 && ret != -ENOENT) {
+	    derr << "ERROR: bi_list(): " << cpp_strerror(-ret) << dendl;
+	    return ret;
+	  }
+	  if (l.empty()) {
+	    break;
+	  }
+	  marker = l.back().idx;
+	  source.splice(source.end(), l);
+	}
+
+	int shard_index;
+	ret = get_target_shard_index(store, new_bucket_info,
+				     cls_rgw_obj_key(name), &shard_index);
+	if (ret < 0) {
+	  return ret;
+	}
+	ret = target_shards_mgr.sync_entries(shard_index, name, source);
+	if (ret < 0) {
+	  return ret;
+	}
+      }
+
+      progress.get(shard).num_entries_replayed += log.entries.size();
+      *num_replayed += log.entries.size();
+      if (!log.truncated) {
+	pending.erase(shard);
+      }
+    }
+
+    ret = target_shards_mgr.wait_all_aio();
+    if (ret < 0) {
+      return ret;
+    }
+    ret = progress.write(false);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+
+  return 0;
+}
+
 int RGWBucketReshard::do_reshard(int num_shards,
 				 RGWBucketInfo& new_bucket_info,
 				 int max_entries,
+				 bool online,
 				 bool verbose,
 				 ostream *out,
 				 Formatter *formatter)
@@ -527,6 +809,55 @@ int RGWBucketReshard::do_reshard(int num_shards,
 
   BucketReshardManager target_shards_mgr(store, new_bucket_info, num_target_shards);
 
+  librados::IoCtx index_ctx;
+  map<int, string> source_oids;
+  ret = store->open_bucket_index(bucket_info, index_ctx, source_oids);
+  if (ret < 0) {
+    return ret;
+  }
+
+  // in online mode, changes made to the index while it is being copied
+  // are logged after the markers of the index headers
+  BucketIndexShardsManager markers;
+  if (online) {
+    map<int, rgw_cls_list_ret> headers;
+    ret = CLSRGWIssueGetDirHeader(index_ctx, source_oids, headers,
+				  store->ctx()->_conf->rgw_bucket_index_max_aio)();
+    if (ret < 0) {
+      lderr(store->ctx()) << "ERROR: failed to read bucket index headers: " <<
+	cpp_strerror(-ret) << dendl;
+      return ret;
+    }
+    for (auto& [shard, header] : headers) {
+      markers.add(shard, header.dir.header.max_marker);
+    }
+  }
+
+  ReshardProgress progress(store, index_ctx, source_oids,
+			   new_bucket_info.bucket.bucket_id, num_shards,
+			   (online ? CLS_RGW_RESHARD_ONLINE :
+			    CLS_RGW_RESHARD_IN_PROGRESS));
+
+  auto renew_locks = [this] {
+    Clock::time_point now = Clock::now();
+    if (reshard_lock.should_renew(now)) {
+      // assume outer locks have timespans at least the size of ours, so
+      // can call inside conditional
+      if (outer_reshard_lock) {
+	int ret = outer_reshard_lock->renew(now);
+	if (ret < 0) {
+	  return ret;
+	}
+      }
+      int ret = reshard_lock.renew(now);
+      if (ret < 0) {
+	lderr(store->ctx()) << "Error renewing bucket lock: " << ret << dendl;
+	return ret;
+      }
+    }
+    return 0;
+  };
+
   verbose = verbose && (formatter != nullptr);
 
   if (verbose) {
@@ -545,6 +876,8 @@ int RGWBucketReshard::do_reshard(int num_shards,
   for (int i = 0; i < num_source_shards; ++i) {
     bool is_truncated = true;
     marker.clear();
+    cls_rgw_bucket_instance_entry& shard_progress = progress.get(i);
+    shard_progress.start_time = ceph::real_clock::now();
     while (is_truncated) {
       entries.clear();
       ret = store->bi_list(bucket, i, string(), marker, max_entries, &entries, &is_truncated);
@@ -566,42 +899,31 @@ int RGWBucketReshard::do_reshard(int num_shards,
 
 	marker = entry.idx;
 
-	int target_shard_id;
 	cls_rgw_obj_key cls_key;
 	RGWObjCategory category;
 	rgw_bucket_category_stats stats;
 	bool account = entry.get_info(&cls_key, &category, &stats);
-	rgw_obj_key key(cls_key);
-	rgw_obj obj(new_bucket_info.bucket, key);
-	int ret = store->get_target_shard_id(new_bucket_info, obj.get_hash_object(), &target_shard_id);
+	int shard_index;
+	int ret = get_target_shard_index(store, new_bucket_info, cls_key,
+					 &shard_index);
 	if (ret < 0) {
-	  lderr(store->ctx()) << "ERROR: get_target_shard_id() returned ret=" << ret << dendl;
 	  return ret;
 	}
 
-	int shard_index = (target_shard_id > 0 ? target_shard_id : 0);
-
 	ret = target_shards_mgr.add_entry(shard_index, entry, account,
 					  category, stats);
 	if (ret < 0) {
 	  return ret;
 	}
+	shard_progress.num_entries_copied++;
 
-	Clock::time_point now = Clock::now();
-	if (reshard_lock.should_renew(now)) {
-	  // assume outer locks have timespans at least the size of ours, so
-	  // can call inside conditional
-	  if (outer_reshard_lock) {
-	    ret = outer_reshard_lock->renew(now);
-	    if (ret < 0) {
-	      return ret;
-	    }
-	  }
-	  ret = reshard_lock.renew(now);
-	  if (ret < 0) {
-	    lderr(store->ctx()) << "Error renewing bucket lock: " << ret << dendl;
-	    return ret;
-	  }
+	ret = renew_locks();
+	if (ret < 0) {
+	  return ret;
+	}
+	ret = progress.write(false);
+	if (ret < 0) {
+	  return ret;
 	}
 
 	if (verbose) {
@@ -614,6 +936,10 @@ int RGWBucketReshard::do_reshard(int num_shards,
 	}
       } // entries loop
     }
+    ret = progress.write(true);
+    if (ret < 0) {
+      return ret;
+    }
   }
 
   if (verbose) {
@@ -631,6 +957,55 @@ int RGWBucketReshard::do_reshard(int num_shards,
     return -EIO;
   }
 
+  if (online) {
+    // catch up with the changes logged during the copy, until few enough
+    // are left for the writes to be blocked while the rest is replayed
+    const uint64_t cutover_entries = store->ctx()->_conf.get_val<uint64_t>(
+      "rgw_reshard_online_cutover_entries");
+    uint64_t num_replayed;
+    for (int pass = 0; pass < max_online_replay_passes; ++pass) {
+      ret = replay_index_log(store, bucket_info, new_bucket_info, index_ctx,
+			     source_oids, markers, target_shards_mgr, progress,
+			     &num_replayed);
+      if (ret < 0) {
+	lderr(store->ctx()) << "ERROR: failed to replay index log" << dendl;
+	return ret;
+      }
+      ldout(store->ctx(), 10) << __func__ << ": replayed " << num_replayed <<
+	" index log entries" << dendl;
+      ret = renew_locks();
+      if (ret < 0) {
+	return ret;
+      }
+      if (num_replayed <= cutover_entries) {
+	break;
+      }
+    }
+
+    // block the writes, replay what's left and set the final stats
+    progress.set_status(CLS_RGW_RESHARD_IN_PROGRESS);
+    ret = progress.write(true);
+    if (ret < 0) {
+      return ret;
+    }
+    ret = replay_index_log(store, bucket_info, new_bucket_info, index_ctx,
+			   source_oids, markers, target_shards_mgr, progress,
+			   &num_replayed);
+    if (ret < 0) {
+      lderr(store->ctx()) << "ERROR: failed to replay index log" << dendl;
+      return ret;
+    }
+    ret = target_shards_mgr.set_stats();
+    if (ret < 0) {
+      lderr(store->ctx()) << "ERROR: failed to set the stats of the new index" << dendl;
+      return -EIO;
+    }
+    ret = progress.write(true);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+
   ret = rgw_link_bucket(store, new_bucket_info.owner, new_bucket_info.bucket, bucket_info.creation_time);
   if (ret < 0) {
     lderr(store->ctx()) << "failed to link new bucket instance (bucket_id=" << new_bucket_info.bucket.bucket_id << ": " << cpp_strerror(-ret) << ")" << dendl;
@@ -677,6 +1052,8 @@ int RGWBucketReshard::execute(int num_shards, int max_op_entries,
                               bool verbose, ostream *out, Formatter *formatter,
 			      RGWReshard* reshard_log)
 {
+  const bool online = store->ctx()->_conf.get_val<bool>("rgw_reshard_online");
+
   int ret = reshard_lock.lock();
   if (ret < 0) {
     return ret;
@@ -699,7 +1076,8 @@ int RGWBucketReshard::execute(int num_shards, int max_op_entries,
   // set resharding status of current bucket_info & shards with
   // information about planned resharding
   ret = set_resharding_status(new_bucket_info.bucket.bucket_id,
-			      num_shards, CLS_RGW_RESHARD_IN_PROGRESS);
+			      num_shards, (online ? CLS_RGW_RESHARD_ONLINE :
+					   CLS_RGW_RESHARD_IN_PROGRESS));
   if (ret < 0) {
     reshard_lock.unlock();
     return ret;
@@ -708,6 +1086,7 @@ int RGWBucketReshard::execute(int num_shards, int max_op_entries,
   ret = do_reshard(num_shards,
 		   new_bucket_info,
 		   max_op_entries,
+		   online,
                    verbose, out, formatter);
   if (ret < 0) {
     goto error_out;
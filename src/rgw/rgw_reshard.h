@@ -76,6 +76,7 @@ private:
   int do_reshard(int num_shards,
 		 RGWBucketInfo& new_bucket_info,
 		 int max_entries,
+		 bool online,
                  bool verbose,
                  ostream *os,
 		 Formatter *formatter);
@@ -354,7 +354,10 @@ done:
 
 send_data:
   if (get_data && !op_ret) {
-    int r = dump_body(s, bl.c_str() + bl_ofs, bl_len);
+    // send the data as read from rados, rather than flattening it first
+    bufferlist data;
+    data.substr_of(bl, bl_ofs, bl_len);
+    int r = dump_body(s, data);
     if (r < 0)
       return r;
   }
@@ -385,6 +388,289 @@ int RGWGetObj_ObjStore_S3::get_decrypt_filter(std::unique_ptr<RGWGetObj_Filter>
   return res;
 }
 
+// read a single character setting of a serialization, if it's given
+static int get_select_char(XMLObj *obj, const char *name, char *c,
+                           std::string& error)
+{
+  std::string val;
+  if (!RGWXMLDecoder::decode_xml(name, val, obj)) {
+    return 0;
+  }
+  if (val.size() != 1) {
+    error = std::string(name) + " must be a single character";
+    return -EINVAL;
+  }
+  *c = val[0];
+  return 0;
+}
+
+static int parse_select_request(XMLObj *root, rgw::s3select::Params& params,
+                                std::string& error)
+{
+  using namespace rgw::s3select;
+
+  XMLObj *req = root->find_first("SelectObjectContentRequest");
+  if (!req) {
+    error = "missing SelectObjectContentRequest";
+    return -ERR_MALFORMED_XML;
+  }
+  RGWXMLDecoder::decode_xml("Expression", params.expression, req, true);
+  std::string type;
+  RGWXMLDecoder::decode_xml("ExpressionType", type, req, true);
+  if (type != "SQL") {
+    error = "ExpressionType must be SQL";
+    return -EINVAL;
+  }
+
+  XMLObj *in = req->find_first("InputSerialization");
+  XMLObj *out = req->find_first("OutputSerialization");
+  if (!in || !out) {
+    error = "missing InputSerialization or OutputSerialization";
+    return -ERR_MALFORMED_XML;
+  }
+
+  std::string compression;
+  RGWXMLDecoder::decode_xml("CompressionType", compression, in);
+  if (!compression.empty() && compression != "NONE") {
+    error = "CompressionType " + compression + " is not supported";
+    return -ERR_NOT_IMPLEMENTED;
+  }
+
+  int r = 0;
+  if (XMLObj *csv = in->find_first("CSV"); csv) {
+    params.input = Format::CSV;
+    auto& c = params.csv_input;
+    std::string header;
+    RGWXMLDecoder::decode_xml("FileHeaderInfo", header, csv);
+    if (header.empty() || header == "NONE") {
+      c.header = CSVInput::Header::None;
+    } else if (header == "USE") {
+      c.header = CSVInput::Header::Use;
+    } else if (header == "IGNORE") {
+      c.header = CSVInput::Header::Ignore;
+    } else {
+      error = "invalid FileHeaderInfo " + header;
+      return -EINVAL;
+    }
+    r = get_select_char(csv, "FieldDelimiter", &c.field_delimiter, error);
+    if (r == 0)
+      r = get_select_char(csv, "RecordDelimiter", &c.record_delimiter, error);
+    if (r == 0)
+      r = get_select_char(csv, "QuoteCharacter", &c.quote, error);
+    c.quote_escape = c.quote;
+    if (r == 0)
+      r = get_select_char(csv, "QuoteEscapeCharacter", &c.quote_escape, error);
+    if (r == 0)
+      r = get_select_char(csv, "Comments", &c.comment, error);
+  } else if (XMLObj *json = in->find_first("JSON"); json) {
+    params.input = Format::JSON;
+    std::string json_type;
+    RGWXMLDecoder::decode_xml("Type", json_type, json);
+    if (json_type == "LINES") {
+      params.json_input.lines = true;
+    } else if (!json_type.empty() && json_type != "DOCUMENT") {
+      error = "invalid JSON Type " + json_type;
+      return -EINVAL;
+    }
+  } else {
+    error = "only CSV and JSON input are supported";
+    return -ERR_NOT_IMPLEMENTED;
+  }
+  if (r < 0) {
+    return r;
+  }
+
+  if (XMLObj *csv = out->find_first("CSV"); csv) {
+    params.output = Format::CSV;
+    auto& c = params.csv_output;
+    std::string quote_fields;
+    RGWXMLDecoder::decode_xml("QuoteFields", quote_fields, csv);
+    if (quote_fields == "ALWAYS") {
+      c.quote_always = true;
+    } else if (!quote_fields.empty() && quote_fields != "ASNEEDED") {
+      error = "invalid QuoteFields " + quote_fields;
+      return -EINVAL;
+    }
+    r = get_select_char(csv, "FieldDelimiter", &c.field_delimiter, error);
+    if (r == 0)
+      r = get_select_char(csv, "RecordDelimiter", &c.record_delimiter, error);
+    if (r == 0)
+      r = get_select_char(csv, "QuoteCharacter", &c.quote, error);
+    c.quote_escape = c.quote;
+    if (r == 0)
+      r = get_select_char(csv, "QuoteEscapeCharacter", &c.quote_escape, error);
+  } else if (XMLObj *json = out->find_first("JSON"); json) {
+    params.output = Format::JSON;
+    r = get_select_char(json, "RecordDelimiter",
+                        &params.json_output.record_delimiter, error);
+  } else {
+    error = "OutputSerialization must be CSV or JSON";
+    return -EINVAL;
+  }
+  return r;
+}
+
+int RGWSelectObj_ObjStore_S3::get_params()
+{
+  int r = RGWGetObj_ObjStore_S3::get_params();
+  if (r < 0) {
+    return r;
+  }
+  // the query reads the whole object
+  range_str = nullptr;
+
+  RGWXMLParser parser;
+  if (!parser.init()) {
+    return -EINVAL;
+  }
+  bufferlist data;
+  std::tie(r, data) = rgw_rest_read_all_input(
+      s, s->cct->_conf->rgw_max_put_param_size, false);
+  if (r < 0) {
+    return r;
+  }
+  if (!parser.parse(data.c_str(), data.length(), 1)) {
+    return -ERR_MALFORMED_XML;
+  }
+
+  std::string error;
+  try {
+    r = parse_select_request(&parser, params, error);
+  } catch (RGWXMLDecoder::err& err) {
+    ldpp_dout(this, 5) << "Malformed select request: " << err << dendl;
+    return -ERR_MALFORMED_XML;
+  }
+  if (r < 0) {
+    s->err.message = error;
+    return r;
+  }
+
+  rgw::s3select::Error err;
+  scanner = std::make_unique<rgw::s3select::Scanner>(params);
+  r = scanner->init(&err);
+  if (r < 0) {
+    ldpp_dout(this, 5) << "invalid select expression: " << err.code
+        << ": " << err.message << dendl;
+    s->err.message = err.code + ": " + err.message;
+    return r;
+  }
+  return 0;
+}
+
+int RGWSelectObj_ObjStore_S3::send_records()
+{
+  if (records.empty()) {
+    return 0;
+  }
+  bufferlist bl;
+  rgw::s3select::encode_records_event(records, bl);
+  bytes_returned += records.size();
+  records.clear();
+  return dump_body(s, bl);
+}
+
+void RGWSelectObj_ObjStore_S3::send_error(const rgw::s3select::Error& err)
+{
+  ldpp_dout(this, 5) << "select failed with " << err.code << ": "
+      << err.message << dendl;
+  failed = true;
+  bufferlist bl;
+  rgw::s3select::encode_error_event(err, bl);
+  dump_body(s, bl);
+}
+
+int RGWSelectObj_ObjStore_S3::send_response_data(bufferlist& bl, off_t bl_ofs,
+                                                 off_t bl_len)
+{
+  if (!sent_header) {
+    if (op_ret < 0) {
+      return RGWGetObj_ObjStore_S3::send_response_data(bl, bl_ofs, bl_len);
+    }
+    // the status can't change once the event stream starts, so later errors
+    // are sent as error events
+    set_req_state_err(s, 0);
+    dump_errno(s);
+    end_header(s, this, "application/octet-stream", CHUNKED_TRANSFER_ENCODING);
+    sent_header = true;
+  }
+  if (failed) {
+    return -EIO;
+  }
+
+  // scan each rados buffer where it is, rather than flattening them
+  constexpr size_t max_event_size = 64 * 1024;
+  bufferlist data;
+  data.substr_of(bl, bl_ofs, bl_len);
+  rgw::s3select::Error err;
+  for (const auto& p : data.buffers()) {
+    int r = scanner->process(p.c_str(), p.length(), records, &err);
+    if (r < 0) {
+      send_error(err);
+      return r;
+    }
+    if (records.size() >= max_event_size) {
+      r = send_records();
+      if (r < 0) {
+        return r;
+      }
+    }
+    if (scanner->done()) {
+      break;
+    }
+  }
+  int r = send_records();
+  if (r < 0) {
+    return r;
+  }
+  if (scanner->done()) {
+    return -ECANCELED; // LIMIT was reached, stop reading the object
+  }
+  return 0;
+}
+
+int RGWSelectObj_ObjStore_S3::send_response_data_error()
+{
+  if (sent_header) {
+    return 0; // execute() ends the event stream
+  }
+  return RGWGetObj_ObjStore_S3::send_response_data_error();
+}
+
+void RGWSelectObj_ObjStore_S3::execute()
+{
+  RGWGetObj::execute();
+
+  if (!sent_header || failed) {
+    return;
+  }
+  if (op_ret == -ECANCELED && scanner->done()) {
+    op_ret = 0;
+  }
+  if (op_ret < 0) {
+    send_error({"InternalError", "failed to read the object"});
+    return;
+  }
+
+  rgw::s3select::Error err;
+  op_ret = scanner->finish(records, &err);
+  if (op_ret < 0) {
+    send_error(err);
+    return;
+  }
+  op_ret = send_records();
+  if (op_ret < 0) {
+    return;
+  }
+  bufferlist bl;
+  const auto processed = scanner->get_bytes_processed();
+  rgw::s3select::encode_stats_event(processed, processed, bytes_returned, bl);
+  rgw::s3select::encode_end_event(bl);
+  op_ret = dump_body(s, bl);
+  if (op_ret > 0) {
+    op_ret = 0;
+  }
+}
+
 void RGWGetObjTags_ObjStore_S3::send_response_data(bufferlist& bl)
 {
   dump_errno(s);
@@ -1614,7 +1900,11 @@ int RGWPutObj_ObjStore_S3::get_encrypt_filter(
        * We use crypto mode that configured as if we were decrypting. */
       res = rgw_s3_prepare_decrypt(s, xattrs, &block_crypt, crypt_http_responses);
       if (res == 0 && block_crypt != nullptr)
-        filter->reset(new RGWPutObj_BlockEncrypt(s->cct, cb, std::move(block_crypt)));
+        filter->reset(new RGWPutObj_BlockEncrypt(
+          s->cct, cb, std::move(block_crypt),
+          rgw::putobj::TransformPool::get(s->cct),
+          rgw::putobj::TransformPool::get_max_pending(s->cct),
+          s->yield));
     }
     /* it is ok, to not have encryption at all */
   }
@@ -1623,7 +1913,11 @@ int RGWPutObj_ObjStore_S3::get_encrypt_filter(
     std::unique_ptr<BlockCrypt> block_crypt;
     res = rgw_s3_prepare_encrypt(s, attrs, nullptr, &block_crypt, crypt_http_responses);
     if (res == 0 && block_crypt != nullptr) {
-      filter->reset(new RGWPutObj_BlockEncrypt(s->cct, cb, std::move(block_crypt)));
+      filter->reset(new RGWPutObj_BlockEncrypt(
+        s->cct, cb, std::move(block_crypt),
+        rgw::putobj::TransformPool::get(s->cct),
+        rgw::putobj::TransformPool::get_max_pending(s->cct),
+        s->yield));
     }
   }
   return res;
@@ -2139,7 +2433,11 @@ int RGWPostObj_ObjStore_S3::get_encrypt_filter(
   int res = rgw_s3_prepare_encrypt(s, attrs, &parts, &block_crypt,
                                    crypt_http_responses);
   if (res == 0 && block_crypt != nullptr) {
-    filter->reset(new RGWPutObj_BlockEncrypt(s->cct, cb, std::move(block_crypt)));
+    filter->reset(new RGWPutObj_BlockEncrypt(
+      s->cct, cb, std::move(block_crypt),
+      rgw::putobj::TransformPool::get(s->cct),
+      rgw::putobj::TransformPool::get_max_pending(s->cct),
+      s->yield));
   }
   return res;
 }
@@ -3295,6 +3593,9 @@ RGWOp *RGWHandler_REST_Obj_S3::op_delete()
 
 RGWOp *RGWHandler_REST_Obj_S3::op_post()
 {
+  if (s->info.args.exists("select"))
+    return new RGWSelectObj_ObjStore_S3;
+
   if (s->info.args.exists("uploadId"))
     return new RGWCompleteMultipart_ObjStore_S3;
 
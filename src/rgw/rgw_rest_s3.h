@@ -28,6 +28,7 @@
 #include "rgw_auth.h"
 #include "rgw_auth_filters.h"
 #include "rgw_sts.h"
+#include "rgw_s3select.h"
 
 struct rgw_http_error {
   int http_ret;
@@ -56,6 +57,30 @@ public:
                          bufferlist* manifest_bl) override;
 };
 
+// SelectObjectContent: a GET that filters the object's data through an
+// S3 Select query, and returns the result as an event stream
+class RGWSelectObj_ObjStore_S3 : public RGWGetObj_ObjStore_S3
+{
+  rgw::s3select::Params params;
+  std::unique_ptr<rgw::s3select::Scanner> scanner;
+  std::string records; //< output not yet sent
+  uint64_t bytes_returned = 0;
+  bool failed = false; //< an error event was sent
+
+  int send_records();
+  void send_error(const rgw::s3select::Error& err);
+public:
+  RGWSelectObj_ObjStore_S3() { get_data = true; }
+
+  int get_params() override;
+  void execute() override;
+  int send_response_data_error() override;
+  int send_response_data(bufferlist& bl, off_t ofs, off_t len) override;
+
+  const char* name() const override { return "select_obj_content"; }
+  RGWOpType get_type() override { return RGW_OP_SELECT_OBJ_CONTENT; }
+};
+
 class RGWGetObjTags_ObjStore_S3 : public RGWGetObjTags_ObjStore
 {
 public:
@@ -0,0 +1,1585 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <boost/crc.hpp>
+
+#include "rgw_s3select.h"
+
+namespace rgw::s3select {
+
+// S3 refuses records larger than this
+static constexpr size_t max_record_size = 1024 * 1024;
+
+struct ColumnRef {
+  std::string qualifier;      //< the alias prefix, if any
+  std::string name;           //< empty for positional columns
+  bool case_sensitive = false; //< quoted names match exactly
+  int index = -1;             //< the csv field, once known
+};
+
+enum class Cast { None, Number, String };
+
+struct Operand {
+  enum class Kind { Column, String, Number, Null };
+  Kind kind = Kind::Null;
+  ColumnRef column;
+  std::string str; //< the literal, as written for numbers
+  double num = 0;
+  Cast cast = Cast::None;
+};
+
+enum class CmpOp { Eq, Ne, Lt, Le, Gt, Ge };
+
+struct Expr {
+  enum class Kind { And, Or, Not, Compare, Like, IsNull };
+  Kind kind;
+  std::unique_ptr<Expr> left, right; //< And and Or use both, Not the left
+  Operand lhs, rhs;                  //< Compare uses both, Like and IsNull lhs
+  CmpOp op = CmpOp::Eq;
+  std::string pattern;               //< for Like
+  bool negate = false;               //< NOT LIKE and IS NOT NULL
+
+  explicit Expr(Kind kind) : kind(kind) {}
+};
+
+struct Projection {
+  enum class Kind { All, Value, Count, Sum, Min, Max, Avg };
+  Kind kind = Kind::Value;
+  Operand value;
+  std::string name; //< the AS name, or the column name
+};
+
+struct Query {
+  std::vector<Projection> projections;
+  std::unique_ptr<Expr> where;
+  std::string alias;
+  bool aggregate = false;
+  bool has_limit = false;
+  uint64_t limit = 0;
+  std::vector<ColumnRef*> columns; //< every column the query reads
+};
+
+static bool iequals(std::string_view a, std::string_view b)
+{
+  return a.size() == b.size() &&
+      std::equal(a.begin(), a.end(), b.begin(), [] (char x, char y) {
+          return std::tolower((unsigned char)x) == std::tolower((unsigned char)y);
+        });
+}
+
+// _1, _2, ...
+static int positional_index(std::string_view name)
+{
+  if (name.size() < 2 || name[0] != '_' || name.size() > 8) {
+    return -1;
+  }
+  int n = 0;
+  for (auto c : name.substr(1)) {
+    if (!std::isdigit((unsigned char)c)) {
+      return -1;
+    }
+    n = n * 10 + (c - '0');
+  }
+  return n > 0 ? n - 1 : -1;
+}
+
+static bool to_number(std::string_view s, double *v)
+{
+  while (!s.empty() && std::isspace((unsigned char)s.front())) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && std::isspace((unsigned char)s.back())) {
+    s.remove_suffix(1);
+  }
+  char buf[64];
+  if (s.empty() || s.size() >= sizeof(buf)) {
+    return false;
+  }
+  memcpy(buf, s.data(), s.size());
+  buf[s.size()] = '\0';
+  char *end = nullptr;
+  *v = std::strtod(buf, &end);
+  return end == buf + s.size();
+}
+
+static void append_number(double v, std::string& out)
+{
+  char buf[32];
+  int n;
+  if (std::isfinite(v) && v == std::floor(v) && std::fabs(v) < 1e15) {
+    n = snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+  } else {
+    n = snprintf(buf, sizeof(buf), "%.15g", v);
+  }
+  out.append(buf, n);
+}
+
+static void append_json_string(std::string_view s, std::string& out)
+{
+  out.push_back('"');
+  for (auto c : s) {
+    switch (c) {
+    case '"': out.append("\\\""); break;
+    case '\\': out.append("\\\\"); break;
+    case '\n': out.append("\\n"); break;
+    case '\r': out.append("\\r"); break;
+    case '\t': out.append("\\t"); break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+        out.append(buf);
+      } else {
+        out.push_back(c);
+      }
+    }
+  }
+  out.push_back('"');
+}
+
+// SQL LIKE, where % matches any run of characters and _ any one
+static bool like(std::string_view s, std::string_view p)
+{
+  size_t si = 0, pi = 0;
+  size_t star = std::string_view::npos, mark = 0;
+  while (si < s.size()) {
+    if (pi < p.size() && (p[pi] == '_' || p[pi] == s[si])) {
+      ++si;
+      ++pi;
+    } else if (pi < p.size() && p[pi] == '%') {
+      star = pi++;
+      mark = si;
+    } else if (star != std::string_view::npos) {
+      pi = star + 1;
+      si = ++mark;
+    } else {
+      return false;
+    }
+  }
+  while (pi < p.size() && p[pi] == '%') {
+    ++pi;
+  }
+  return pi == p.size();
+}
+
+
+// parser
+
+namespace {
+
+struct Token {
+  enum class Type { End, Ident, QuotedIdent, String, Number, Symbol };
+  Type type = Type::End;
+  std::string text;
+};
+
+bool tokenize(std::string_view sql, std::vector<Token>& toks, Error *err)
+{
+  size_t i = 0;
+  while (i < sql.size()) {
+    const char c = sql[i];
+    if (std::isspace((unsigned char)c)) {
+      ++i;
+      continue;
+    }
+    Token t;
+    if (std::isalpha((unsigned char)c) || c == '_') {
+      size_t j = i;
+      while (j < sql.size() &&
+             (std::isalnum((unsigned char)sql[j]) || sql[j] == '_')) {
+        ++j;
+      }
+      t.type = Token::Type::Ident;
+      t.text = sql.substr(i, j - i);
+      i = j;
+    } else if (c == '"' || c == '\'') {
+      // quoted identifier or string, with a doubled quote for a quote
+      t.type = c == '"' ? Token::Type::QuotedIdent : Token::Type::String;
+      size_t j = i + 1;
+      for (;;) {
+        if (j >= sql.size()) {
+          err->code = "ParseExpectedTokenType";
+          err->message = "unterminated quote in expression";
+          return false;
+        }
+        if (sql[j] == c) {
+          if (j + 1 < sql.size() && sql[j + 1] == c) {
+            t.text.push_back(c);
+            j += 2;
+            continue;
+          }
+          break;
+        }
+        t.text.push_back(sql[j++]);
+      }
+      i = j + 1;
+    } else if (std::isdigit((unsigned char)c) ||
+               ((c == '-' || c == '.') && i + 1 < sql.size() &&
+                (std::isdigit((unsigned char)sql[i + 1]) || sql[i + 1] == '.'))) {
+      size_t j = i + 1;
+      while (j < sql.size() &&
+             (std::isalnum((unsigned char)sql[j]) || sql[j] == '.' ||
+              ((sql[j] == '-' || sql[j] == '+') &&
+               (sql[j - 1] == 'e' || sql[j - 1] == 'E')))) {
+        ++j;
+      }
+      t.type = Token::Type::Number;
+      t.text = sql.substr(i, j - i);
+      i = j;
+    } else {
+      static const char* symbols[] = {
+        "<=", ">=", "<>", "!=", "=", "<", ">", "(", ")", ",", "*", ".", "[", "]"
+      };
+      for (auto s : symbols) {
+        if (sql.substr(i, strlen(s)) == s) {
+          t.type = Token::Type::Symbol;
+          t.text = s;
+          break;
+        }
+      }
+      if (t.type != Token::Type::Symbol) {
+        err->code = "ParseInvalidTypeParam";
+        err->message = std::string("unexpected character '") + c +
+            "' in expression";
+        return false;
+      }
+      i += t.text.size();
+    }
+    toks.push_back(std::move(t));
+  }
+  toks.emplace_back(); // End
+  return true;
+}
+
+bool is_reserved(std::string_view word)
+{
+  static const char* reserved[] = {
+    "select", "from", "where", "and", "or", "not", "like", "is", "null",
+    "limit", "as", "cast"
+  };
+  return std::any_of(std::begin(reserved), std::end(reserved),
+                     [word] (const char* r) { return iequals(word, r); });
+}
+
+class Parser {
+  std::vector<Token> toks;
+  size_t pos = 0;
+  Error *err;
+
+  const Token& peek() const { return toks[pos]; }
+
+  bool keyword(const char* kw) {
+    if (peek().type == Token::Type::Ident && iequals(peek().text, kw)) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+  bool symbol(const char* s) {
+    if (peek().type == Token::Type::Symbol && peek().text == s) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+  bool fail(const std::string& expected) {
+    err->code = "ParseUnexpectedToken";
+    if (peek().type == Token::Type::End) {
+      err->message = "expected " + expected + " at end of expression";
+    } else {
+      err->message = "expected " + expected + " before '" + peek().text + "'";
+    }
+    return false;
+  }
+
+  bool parse_column(ColumnRef& col) {
+    auto ident = [this] (std::string& name, bool& quoted) {
+      const auto& t = peek();
+      if (t.type == Token::Type::QuotedIdent ||
+          (t.type == Token::Type::Ident && !is_reserved(t.text))) {
+        name = t.text;
+        quoted = t.type == Token::Type::QuotedIdent;
+        ++pos;
+        return true;
+      }
+      return fail("a column");
+    };
+    if (!ident(col.name, col.case_sensitive)) {
+      return false;
+    }
+    if (symbol(".")) {
+      col.qualifier = std::move(col.name);
+      if (!ident(col.name, col.case_sensitive)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool parse_operand(Operand& o) {
+    const auto& t = peek();
+    if (t.type == Token::Type::String) {
+      o.kind = Operand::Kind::String;
+      o.str = t.text;
+      ++pos;
+      return true;
+    }
+    if (t.type == Token::Type::Number) {
+      o.kind = Operand::Kind::Number;
+      o.str = t.text;
+      if (!to_number(o.str, &o.num)) {
+        return fail("a number");
+      }
+      ++pos;
+      return true;
+    }
+    if (keyword("null")) {
+      o.kind = Operand::Kind::Null;
+      return true;
+    }
+    if (keyword("cast")) {
+      if (!symbol("(")) {
+        return fail("'('");
+      }
+      if (!parse_operand(o)) {
+        return false;
+      }
+      if (!keyword("as")) {
+        return fail("AS");
+      }
+      if (keyword("int") || keyword("integer") || keyword("float") ||
+          keyword("decimal") || keyword("numeric")) {
+        o.cast = Cast::Number;
+      } else if (keyword("string") || keyword("varchar") || keyword("char")) {
+        o.cast = Cast::String;
+      } else {
+        return fail("INT, FLOAT, DECIMAL or STRING");
+      }
+      if (!symbol(")")) {
+        return fail("')'");
+      }
+      if (o.kind == Operand::Kind::Number && o.cast == Cast::String) {
+        o.kind = Operand::Kind::String;
+      } else if (o.kind == Operand::Kind::String && o.cast == Cast::Number) {
+        if (!to_number(o.str, &o.num)) {
+          err->code = "CastFailed";
+          err->message = "cannot cast '" + o.str + "' to a number";
+          return false;
+        }
+        o.kind = Operand::Kind::Number;
+      }
+      return true;
+    }
+    o.kind = Operand::Kind::Column;
+    return parse_column(o.column);
+  }
+
+  std::unique_ptr<Expr> parse_or() {
+    auto e = parse_and();
+    while (e && keyword("or")) {
+      auto o = std::make_unique<Expr>(Expr::Kind::Or);
+      o->left = std::move(e);
+      o->right = parse_and();
+      if (!o->right) {
+        return nullptr;
+      }
+      e = std::move(o);
+    }
+    return e;
+  }
+  std::unique_ptr<Expr> parse_and() {
+    auto e = parse_not();
+    while (e && keyword("and")) {
+      auto a = std::make_unique<Expr>(Expr::Kind::And);
+      a->left = std::move(e);
+      a->right = parse_not();
+      if (!a->right) {
+        return nullptr;
+      }
+      e = std::move(a);
+    }
+    return e;
+  }
+  std::unique_ptr<Expr> parse_not() {
+    if (keyword("not")) {
+      auto n = std::make_unique<Expr>(Expr::Kind::Not);
+      n->left = parse_not();
+      if (!n->left) {
+        return nullptr;
+      }
+      return n;
+    }
+    return parse_predicate();
+  }
+  std::unique_ptr<Expr> parse_predicate() {
+    if (symbol("(")) {
+      auto e = parse_or();
+      if (e && !symbol(")")) {
+        fail("')'");
+        return nullptr;
+      }
+      return e;
+    }
+    Operand lhs;
+    if (!parse_operand(lhs)) {
+      return nullptr;
+    }
+    static const std::pair<const char*, CmpOp> ops[] = {
+      {"=", CmpOp::Eq}, {"!=", CmpOp::Ne}, {"<>", CmpOp::Ne},
+      {"<", CmpOp::Lt}, {"<=", CmpOp::Le}, {">", CmpOp::Gt}, {">=", CmpOp::Ge},
+    };
+    for (const auto& [s, op] : ops) {
+      if (symbol(s)) {
+        auto e = std::make_unique<Expr>(Expr::Kind::Compare);
+        e->lhs = std::move(lhs);
+        e->op = op;
+        if (!parse_operand(e->rhs)) {
+          return nullptr;
+        }
+        return e;
+      }
+    }
+    const bool negate = keyword("not");
+    if (keyword("like")) {
+      if (peek().type != Token::Type::String) {
+        fail("a LIKE pattern");
+        return nullptr;
+      }
+      auto e = std::make_unique<Expr>(Expr::Kind::Like);
+      e->lhs = std::move(lhs);
+      e->pattern = toks[pos++].text;
+      e->negate = negate;
+      return e;
+    }
+    if (negate) {
+      fail("LIKE");
+      return nullptr;
+    }
+    if (keyword("is")) {
+      auto e = std::make_unique<Expr>(Expr::Kind::IsNull);
+      e->lhs = std::move(lhs);
+      e->negate = keyword("not");
+      if (!keyword("null")) {
+        fail("NULL");
+        return nullptr;
+      }
+      return e;
+    }
+    fail("a comparison");
+    return nullptr;
+  }
+
+  bool parse_projection(Projection& p) {
+    static const std::pair<const char*, Projection::Kind> aggregates[] = {
+      {"count", Projection::Kind::Count}, {"sum", Projection::Kind::Sum},
+      {"min", Projection::Kind::Min}, {"max", Projection::Kind::Max},
+      {"avg", Projection::Kind::Avg},
+    };
+    const auto& t = peek();
+    if (t.type == Token::Type::Ident &&
+        toks[pos + 1].type == Token::Type::Symbol && toks[pos + 1].text == "(") {
+      for (const auto& [name, kind] : aggregates) {
+        if (iequals(t.text, name)) {
+          pos += 2;
+          p.kind = kind;
+          if (kind == Projection::Kind::Count && symbol("*")) {
+            // COUNT(*)
+          } else if (!parse_operand(p.value)) {
+            return false;
+          }
+          if (!symbol(")")) {
+            return fail("')'");
+          }
+          break;
+        }
+      }
+    }
+    if (p.kind == Projection::Kind::Value) {
+      if (!parse_operand(p.value)) {
+        return false;
+      }
+      if (p.value.kind == Operand::Kind::Column) {
+        p.name = p.value.column.name;
+      }
+    }
+    if (keyword("as")) {
+      const auto& n = peek();
+      if (n.type != Token::Type::Ident && n.type != Token::Type::QuotedIdent) {
+        return fail("a name");
+      }
+      p.name = n.text;
+      ++pos;
+    }
+    return true;
+  }
+
+  void collect(Operand& o, std::vector<ColumnRef*>& columns) {
+    if (o.kind == Operand::Kind::Column) {
+      columns.push_back(&o.column);
+    }
+  }
+  void collect(Expr& e, std::vector<ColumnRef*>& columns) {
+    if (e.left) {
+      collect(*e.left, columns);
+    }
+    if (e.right) {
+      collect(*e.right, columns);
+    }
+    collect(e.lhs, columns);
+    collect(e.rhs, columns);
+  }
+
+ public:
+  Parser(std::vector<Token>&& toks, Error *err)
+    : toks(std::move(toks)), err(err) {}
+
+  std::unique_ptr<Query> parse() {
+    auto q = std::make_unique<Query>();
+    if (!keyword("select")) {
+      fail("SELECT");
+      return nullptr;
+    }
+    if (symbol("*")) {
+      q->projections.emplace_back().kind = Projection::Kind::All;
+    } else {
+      do {
+        if (!parse_projection(q->projections.emplace_back())) {
+          return nullptr;
+        }
+      } while (symbol(","));
+    }
+    if (!keyword("from")) {
+      fail("FROM");
+      return nullptr;
+    }
+    if (!keyword("s3object")) {
+      fail("S3Object");
+      return nullptr;
+    }
+    if (symbol("[")) {
+      if (!symbol("*") || !symbol("]")) {
+        fail("S3Object[*]");
+        return nullptr;
+      }
+    }
+    const bool as = keyword("as");
+    if (peek().type == Token::Type::Ident && !is_reserved(peek().text)) {
+      q->alias = toks[pos++].text;
+    } else if (as) {
+      fail("an alias");
+      return nullptr;
+    }
+    if (keyword("where")) {
+      q->where = parse_or();
+      if (!q->where) {
+        return nullptr;
+      }
+    }
+    if (keyword("limit")) {
+      const auto& t = peek();
+      char *end = nullptr;
+      const auto n = t.type == Token::Type::Number ?
+          std::strtoull(t.text.c_str(), &end, 10) : 0;
+      if (t.type != Token::Type::Number || *end != '\0') {
+        fail("a LIMIT count");
+        return nullptr;
+      }
+      q->has_limit = true;
+      q->limit = n;
+      ++pos;
+    }
+    if (peek().type != Token::Type::End) {
+      fail("end of expression");
+      return nullptr;
+    }
+
+    size_t aggregates = 0;
+    for (auto& p : q->projections) {
+      if (p.kind != Projection::Kind::All && p.kind != Projection::Kind::Value) {
+        ++aggregates;
+      }
+      collect(p.value, q->columns);
+    }
+    if (aggregates && aggregates != q->projections.size()) {
+      err->code = "UnsupportedSyntax";
+      err->message = "aggregates can't be selected with other columns";
+      return nullptr;
+    }
+    q->aggregate = aggregates > 0;
+    if (q->where) {
+      collect(*q->where, q->columns);
+    }
+
+    // strip the alias prefix, and number positional columns
+    for (auto col : q->columns) {
+      if (!col->qualifier.empty() &&
+          !iequals(col->qualifier, q->alias) &&
+          !iequals(col->qualifier, "s3object")) {
+        err->code = "ParseInvalidPathComponent";
+        err->message = "unknown table " + col->qualifier;
+        return nullptr;
+      }
+      if (!col->case_sensitive) {
+        col->index = positional_index(col->name);
+        if (col->index >= 0) {
+          col->name.clear();
+        }
+      }
+    }
+    return q;
+  }
+};
+
+} // anonymous namespace
+
+static std::unique_ptr<Query> parse_query(std::string_view sql, Error *err)
+{
+  std::vector<Token> toks;
+  if (!tokenize(sql, toks, err)) {
+    return nullptr;
+  }
+  return Parser{std::move(toks), err}.parse();
+}
+
+
+// scanner
+
+Scanner::Scanner(const Params& params)
+  : params(params)
+{}
+
+Scanner::~Scanner() = default;
+
+int Scanner::init(Error *err)
+{
+  query = parse_query(params.expression, err);
+  if (!query) {
+    return -EINVAL;
+  }
+
+  const bool csv = params.input == Format::CSV;
+  const auto header = params.csv_input.header;
+  header_pending = csv && header != CSVInput::Header::None;
+
+  max_fields = 0;
+  for (auto col : query->columns) {
+    if (col->name.empty()) {
+      if (!csv) {
+        err->code = "InvalidColumnIndex";
+        err->message = "positional columns are only valid for CSV input";
+        return -EINVAL;
+      }
+      max_fields = std::max(max_fields, static_cast<size_t>(col->index) + 1);
+    } else if (csv && header != CSVInput::Header::Use) {
+      err->code = "MissingHeaders";
+      err->message = "column " + col->name + " needs FileHeaderInfo USE";
+      return -EINVAL;
+    }
+  }
+
+  const auto& p = query->projections;
+  const bool select_all = p.size() == 1 && p[0].kind == Projection::Kind::All;
+  if (select_all) {
+    max_fields = std::numeric_limits<size_t>::max();
+  }
+  if (select_all && params.input == params.output) {
+    // records are written as they were read
+    const auto& in = params.csv_input;
+    const auto& out = params.csv_output;
+    passthrough = !csv || (!out.quote_always &&
+                           in.field_delimiter == out.field_delimiter &&
+                           in.quote == out.quote &&
+                           in.quote_escape == out.quote_escape);
+  }
+
+  acc.assign(p.size(), 0);
+  acc_count.assign(p.size(), 0);
+  limit_reached = query->has_limit && query->limit == 0;
+  return 0;
+}
+
+size_t Scanner::next_piece(std::string_view buf) const
+{
+  char delim;
+  if (params.input == Format::CSV) {
+    delim = params.csv_input.record_delimiter;
+  } else if (params.json_input.lines) {
+    delim = '\n';
+  } else {
+    delim = '}';
+  }
+  auto p = static_cast<const char*>(memchr(buf.data(), delim, buf.size()));
+  return p ? p - buf.data() + 1 : buf.size();
+}
+
+bool Scanner::find_record(std::string_view buf, size_t *len,
+                          size_t *consumed) const
+{
+  const char *begin = buf.data();
+  const char *end = begin + buf.size();
+
+  if (params.input == Format::CSV) {
+    const auto& in = params.csv_input;
+    const char rd = in.record_delimiter;
+    const char q = in.quote;
+    if (q && in.quote_escape != q) {
+      // a backslash style escape may hide a quote, so scan every character
+      bool quoted = false;
+      for (const char *p = begin; p < end; ++p) {
+        if (quoted && *p == in.quote_escape) {
+          ++p;
+        } else if (*p == q) {
+          quoted = !quoted;
+        } else if (*p == rd && !quoted) {
+          *len = p - begin;
+          *consumed = *len + 1;
+          return true;
+        }
+      }
+      return false;
+    }
+    // a delimiter ends the record unless it's inside quotes, which it is if
+    // an odd number of quotes precede it
+    bool quoted = false;
+    const char *scan = begin;
+    for (;;) {
+      auto d = static_cast<const char*>(memchr(scan, rd, end - scan));
+      if (!d) {
+        return false;
+      }
+      if (q) {
+        for (const char *p = scan;
+             (p = static_cast<const char*>(memchr(p, q, d - p))); ++p) {
+          quoted = !quoted;
+        }
+      }
+      if (!quoted) {
+        *len = d - begin;
+        *consumed = *len + 1;
+        return true;
+      }
+      scan = d + 1;
+    }
+  }
+
+  if (params.json_input.lines) {
+    auto d = static_cast<const char*>(memchr(begin, '\n', end - begin));
+    if (!d) {
+      return false;
+    }
+    *len = d - begin;
+    *consumed = *len + 1;
+    return true;
+  }
+
+  // a json document is a series of objects, possibly in an array. skip to
+  // the end of the next one
+  int depth = 0;
+  bool in_string = false;
+  for (const char *p = begin; p < end; ++p) {
+    const char c = *p;
+    if (depth == 0) {
+      if (c == '{') {
+        depth = 1;
+      }
+    } else if (in_string) {
+      if (c == '\\') {
+        ++p;
+      } else if (c == '"') {
+        in_string = false;
+      }
+    } else if (c == '"') {
+      in_string = true;
+    } else if (c == '{' || c == '[') {
+      ++depth;
+    } else if ((c == '}' || c == ']') && --depth == 0) {
+      *len = p + 1 - begin;
+      *consumed = *len;
+      return true;
+    }
+  }
+  return false;
+}
+
+int Scanner::process(const char *data, size_t len, std::string& out,
+                     Error *err)
+{
+  bytes_processed += len;
+  std::string_view in{data, len};
+
+  // finish the record that started in an earlier part, adding to it up to
+  // each place it could end
+  while (!carry.empty() && !in.empty() && !limit_reached) {
+    const size_t n = next_piece(in);
+    carry.append(in.data(), n);
+    in.remove_prefix(n);
+
+    size_t rec_len, consumed;
+    if (find_record(carry, &rec_len, &consumed)) {
+      std::string rec;
+      rec.swap(carry);
+      int r = handle_record(std::string_view{rec}.substr(0, rec_len), out, err);
+      if (r < 0) {
+        return r;
+      }
+    } else if (carry.size() > max_record_size) {
+      err->code = "OverMaxRecordSize";
+      err->message = "a record exceeds the maximum record size of 1 MiB";
+      return -EINVAL;
+    }
+  }
+
+  while (!in.empty() && !limit_reached) {
+    size_t rec_len, consumed;
+    if (!find_record(in, &rec_len, &consumed)) {
+      if (in.size() > max_record_size) {
+        err->code = "OverMaxRecordSize";
+        err->message = "a record exceeds the maximum record size of 1 MiB";
+        return -EINVAL;
+      }
+      carry.assign(in);
+      break;
+    }
+    int r = handle_record(in.substr(0, rec_len), out, err);
+    if (r < 0) {
+      return r;
+    }
+    in.remove_prefix(consumed);
+  }
+  return 0;
+}
+
+int Scanner::finish(std::string& out, Error *err)
+{
+  if (!carry.empty() && !limit_reached) {
+    // the last record need not end with a delimiter
+    std::string rec;
+    rec.swap(carry);
+    if (params.input == Format::JSON && !params.json_input.lines) {
+      auto junk = rec.find_first_not_of(" \t\r\n,]");
+      if (junk != std::string::npos) {
+        err->code = "JSONParsingError";
+        err->message = "the object ends within a JSON record";
+        return -EINVAL;
+      }
+    } else {
+      int r = handle_record(rec, out, err);
+      if (r < 0) {
+        return r;
+      }
+    }
+  }
+
+  if (!query->aggregate) {
+    return 0;
+  }
+
+  // write the aggregates as one record, named _1, _2, ...
+  std::string value;
+  for (size_t i = 0; i < query->projections.size(); i++) {
+    const auto& p = query->projections[i];
+    value.clear();
+    if (p.kind == Projection::Kind::Count) {
+      append_number(acc[i], value);
+    } else if (acc_count[i] > 0) {
+      append_number(p.kind == Projection::Kind::Avg ?
+                    acc[i] / acc_count[i] : acc[i], value);
+    }
+    if (params.output == Format::CSV) {
+      emit_csv_value(value, i == 0, out);
+    } else {
+      out.push_back(i == 0 ? '{' : ',');
+      append_json_string(p.name.empty() ? "_" + std::to_string(i + 1) : p.name,
+                         out);
+      out.push_back(':');
+      out.append(value.empty() ? "null" : value);
+    }
+  }
+  if (params.output == Format::CSV) {
+    out.push_back(params.csv_output.record_delimiter);
+  } else {
+    out.push_back('}');
+    out.push_back(params.json_output.record_delimiter);
+  }
+  return 0;
+}
+
+int Scanner::handle_record(std::string_view rec, std::string& out, Error *err)
+{
+  record = rec;
+  fields.clear();
+  keys.clear();
+  scratch.clear();
+  csv_pos = 0;
+  fields_complete = false;
+
+  if (params.input == Format::CSV) {
+    const auto& in = params.csv_input;
+    if (in.record_delimiter == '\n' && !rec.empty() && rec.back() == '\r') {
+      rec.remove_suffix(1);
+      record = rec;
+    }
+    if (rec.empty() || (in.comment && rec.front() == in.comment)) {
+      return 0;
+    }
+    if (header_pending) {
+      header_pending = false;
+      return in.header == CSVInput::Header::Use ? bind_header(err) : 0;
+    }
+  } else {
+    // skip whitespace, and the array and commas around document records
+    const auto start = params.json_input.lines ?
+        rec.find_first_not_of(" \t\r\n") : rec.find('{');
+    if (start == std::string_view::npos) {
+      return 0;
+    }
+    rec.remove_prefix(start);
+    while (std::isspace((unsigned char)rec.back())) {
+      rec.remove_suffix(1);
+    }
+    record = rec;
+    int r = parse_json_fields(err);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  ++records;
+  if (query->where && !eval(*query->where)) {
+    return 0;
+  }
+  if (query->aggregate) {
+    accumulate();
+    return 0;
+  }
+  emit(out);
+  if (query->has_limit && ++emitted >= query->limit) {
+    limit_reached = true;
+  }
+  return 0;
+}
+
+void Scanner::parse_csv_fields(size_t count)
+{
+  const auto& in = params.csv_input;
+  const char delim = in.field_delimiter;
+
+  while (fields.size() < count && !fields_complete) {
+    const size_t pos = csv_pos;
+    Field f;
+    f.present = true;
+    size_t next; // position of the delimiter after the field
+
+    if (in.quote && pos < record.size() && record[pos] == in.quote) {
+      std::string *buf = nullptr; // only if the field has escaped quotes
+      size_t seg = pos + 1;
+      size_t i = seg;
+      while (i < record.size()) {
+        const char c = record[i];
+        const bool escape = c == in.quote_escape && i + 1 < record.size() &&
+            (in.quote_escape != in.quote || record[i + 1] == in.quote);
+        if (escape) {
+          if (!buf) {
+            buf = &scratch.emplace_back();
+          }
+          buf->append(record.substr(seg, i - seg));
+          buf->push_back(record[i + 1]);
+          i += 2;
+          seg = i;
+        } else if (c == in.quote) {
+          break;
+        } else {
+          ++i;
+        }
+      }
+      auto tail = record.substr(seg, i - seg);
+      if (buf) {
+        buf->append(tail);
+        f.text = *buf;
+      } else {
+        f.text = tail;
+      }
+      // anything between the closing quote and the delimiter is dropped
+      next = record.find(delim, std::min(i + 1, record.size()));
+    } else {
+      auto d = static_cast<const char*>(
+          memchr(record.data() + pos, delim, record.size() - pos));
+      next = d ? d - record.data() : std::string_view::npos;
+      f.text = record.substr(pos, (d ? next : record.size()) - pos);
+    }
+
+    fields.push_back(f);
+    if (next == std::string_view::npos) {
+      fields_complete = true;
+    } else {
+      csv_pos = next + 1;
+    }
+  }
+}
+
+// decode the backslash escapes of a json string
+static void json_unescape(std::string_view s, std::string& out)
+{
+  auto append_utf8 = [&out] (uint32_t cp) {
+    if (cp < 0x80) {
+      out.push_back(cp);
+    } else if (cp < 0x800) {
+      out.push_back(0xc0 | (cp >> 6));
+      out.push_back(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+      out.push_back(0xe0 | (cp >> 12));
+      out.push_back(0x80 | ((cp >> 6) & 0x3f));
+      out.push_back(0x80 | (cp & 0x3f));
+    } else {
+      out.push_back(0xf0 | (cp >> 18));
+      out.push_back(0x80 | ((cp >> 12) & 0x3f));
+      out.push_back(0x80 | ((cp >> 6) & 0x3f));
+      out.push_back(0x80 | (cp & 0x3f));
+    }
+  };
+  auto hex4 = [&s] (size_t i, uint32_t *v) {
+    if (i + 4 > s.size()) {
+      return false;
+    }
+    char buf[5] = {s[i], s[i + 1], s[i + 2], s[i + 3], '\0'};
+    char *end = nullptr;
+    *v = std::strtoul(buf, &end, 16);
+    return end == buf + 4;
+  };
+
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] != '\\' || i + 1 == s.size()) {
+      out.push_back(s[i]);
+      continue;
+    }
+    const char c = s[++i];
+    switch (c) {
+    case 'b': out.push_back('\b'); break;
+    case 'f': out.push_back('\f'); break;
+    case 'n': out.push_back('\n'); break;
+    case 'r': out.push_back('\r'); break;
+    case 't': out.push_back('\t'); break;
+    case 'u': {
+      uint32_t cp;
+      if (!hex4(i + 1, &cp)) {
+        out.push_back(c);
+        break;
+      }
+      i += 4;
+      uint32_t lo;
+      if (cp >= 0xd800 && cp < 0xdc00 && i + 2 < s.size() &&
+          s[i + 1] == '\\' && s[i + 2] == 'u' && hex4(i + 3, &lo) &&
+          lo >= 0xdc00 && lo < 0xe000) {
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+        i += 6;
+      }
+      append_utf8(cp);
+      break;
+    }
+    default: out.push_back(c); break; // \" \\ \/
+    }
+  }
+}
+
+// return the end of the json string starting at i, or npos
+static size_t scan_json_string(std::string_view s, size_t i, bool *escaped)
+{
+  for (++i; i < s.size(); i++) {
+    if (s[i] == '\\') {
+      *escaped = true;
+      ++i;
+    } else if (s[i] == '"') {
+      return i + 1;
+    }
+  }
+  return std::string_view::npos;
+}
+
+// return the end of the json value starting at i, or npos
+static size_t scan_json_value(std::string_view s, size_t i)
+{
+  if (i >= s.size()) {
+    return std::string_view::npos;
+  }
+  bool escaped = false;
+  if (s[i] == '"') {
+    return scan_json_string(s, i, &escaped);
+  }
+  if (s[i] == '{' || s[i] == '[') {
+    int depth = 0;
+    for (; i < s.size(); i++) {
+      const char c = s[i];
+      if (c == '"') {
+        i = scan_json_string(s, i, &escaped);
+        if (i == std::string_view::npos) {
+          return i;
+        }
+        --i;
+      } else if (c == '{' || c == '[') {
+        ++depth;
+      } else if ((c == '}' || c == ']') && --depth == 0) {
+        return i + 1;
+      }
+    }
+    return std::string_view::npos;
+  }
+  const size_t end = s.find_first_of(",}] \t\r\n", i);
+  return end == std::string_view::npos ? s.size() : end;
+}
+
+int Scanner::parse_json_fields(Error *err)
+{
+  auto fail = [err] {
+    err->code = "JSONParsingError";
+    err->message = "invalid JSON record";
+    return -EINVAL;
+  };
+  auto skip_ws = [this] (size_t& i) {
+    while (i < record.size() && std::isspace((unsigned char)record[i])) {
+      ++i;
+    }
+  };
+
+  size_t i = 0;
+  if (record.empty() || record[0] != '{') {
+    return fail();
+  }
+  ++i;
+  skip_ws(i);
+  if (i < record.size() && record[i] == '}') {
+    return 0;
+  }
+  for (;;) {
+    if (i >= record.size() || record[i] != '"') {
+      return fail();
+    }
+    bool escaped = false;
+    const size_t key_end = scan_json_string(record, i, &escaped);
+    if (key_end == std::string_view::npos) {
+      return fail();
+    }
+    std::string_view key = record.substr(i + 1, key_end - i - 2);
+    if (escaped) {
+      auto& buf = scratch.emplace_back();
+      json_unescape(key, buf);
+      key = buf;
+    }
+    i = key_end;
+    skip_ws(i);
+    if (i >= record.size() || record[i] != ':') {
+      return fail();
+    }
+    ++i;
+    skip_ws(i);
+
+    const size_t value_end = scan_json_value(record, i);
+    if (value_end == std::string_view::npos || value_end == i) {
+      return fail();
+    }
+    Field f;
+    f.raw = record.substr(i, value_end - i);
+    if (record[i] == '"') {
+      auto text = f.raw.substr(1, f.raw.size() - 2);
+      if (text.find('\\') != std::string_view::npos) {
+        auto& buf = scratch.emplace_back();
+        json_unescape(text, buf);
+        text = buf;
+      }
+      f.text = text;
+      f.present = true;
+    } else {
+      f.text = f.raw;
+      f.is_string = false;
+      f.present = f.raw != "null";
+    }
+    keys.push_back(key);
+    fields.push_back(f);
+
+    i = value_end;
+    skip_ws(i);
+    if (i < record.size() && record[i] == ',') {
+      ++i;
+      skip_ws(i);
+      continue;
+    }
+    if (i < record.size() && record[i] == '}') {
+      return 0;
+    }
+    return fail();
+  }
+}
+
+int Scanner::bind_header(Error *err)
+{
+  parse_csv_fields(std::numeric_limits<size_t>::max());
+  header_names.clear();
+  for (const auto& f : fields) {
+    header_names.emplace_back(f.text);
+  }
+  for (auto col : query->columns) {
+    if (col->name.empty()) {
+      continue;
+    }
+    auto match = [col] (const std::string& h) {
+      return col->case_sensitive ? h == col->name : iequals(h, col->name);
+    };
+    auto h = std::find_if(header_names.begin(), header_names.end(), match);
+    if (h == header_names.end()) {
+      err->code = "InvalidColumnIndex";
+      err->message = "column " + col->name + " is not in the header";
+      return -EINVAL;
+    }
+    col->index = h - header_names.begin();
+    if (max_fields != std::numeric_limits<size_t>::max()) {
+      max_fields = std::max(max_fields, static_cast<size_t>(col->index) + 1);
+    }
+  }
+  fields.clear();
+  return 0;
+}
+
+auto Scanner::get(const ColumnRef& col) -> Field
+{
+  if (params.input == Format::CSV) {
+    if (col.index < 0) {
+      return Field{};
+    }
+    const size_t n = col.index;
+    if (n >= fields.size()) {
+      // parse as far as any column the query uses, at most once per record
+      parse_csv_fields(std::max(n + 1, max_fields));
+    }
+    return n < fields.size() ? fields[n] : Field{};
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (col.case_sensitive ? keys[i] == col.name : iequals(keys[i], col.name)) {
+      return fields[i];
+    }
+  }
+  return Field{};
+}
+
+auto Scanner::eval(const Operand& o) -> Field
+{
+  Field f;
+  switch (o.kind) {
+  case Operand::Kind::Column:
+    return get(o.column);
+  case Operand::Kind::String:
+    f.text = o.str;
+    f.present = true;
+    break;
+  case Operand::Kind::Number:
+    f.text = f.raw = o.str;
+    f.present = true;
+    f.is_string = false;
+    break;
+  case Operand::Kind::Null:
+    break;
+  }
+  return f;
+}
+
+bool Scanner::compare(const Expr& e)
+{
+  const Field a = eval(e.lhs);
+  const Field b = eval(e.rhs);
+  if (!a.present || !b.present) {
+    return false; // comparisons with null are never true
+  }
+  auto numeric = [] (const Operand& o, const Field& f) {
+    if (o.cast != Cast::None) {
+      return o.cast == Cast::Number;
+    }
+    return o.kind == Operand::Kind::Number ||
+        (o.kind == Operand::Kind::Column && !f.is_string);
+  };
+  int c;
+  if ((numeric(e.lhs, a) || numeric(e.rhs, b)) &&
+      e.lhs.cast != Cast::String && e.rhs.cast != Cast::String) {
+    double x, y;
+    if (e.lhs.kind == Operand::Kind::Number) {
+      x = e.lhs.num;
+    } else if (!to_number(a.text, &x)) {
+      return false;
+    }
+    if (e.rhs.kind == Operand::Kind::Number) {
+      y = e.rhs.num;
+    } else if (!to_number(b.text, &y)) {
+      return false;
+    }
+    c = x < y ? -1 : (x > y ? 1 : 0);
+  } else {
+    c = a.text.compare(b.text);
+  }
+  switch (e.op) {
+  case CmpOp::Eq: return c == 0;
+  case CmpOp::Ne: return c != 0;
+  case CmpOp::Lt: return c < 0;
+  case CmpOp::Le: return c <= 0;
+  case CmpOp::Gt: return c > 0;
+  case CmpOp::Ge: return c >= 0;
+  }
+  return false;
+}
+
+bool Scanner::eval(const Expr& e)
+{
+  switch (e.kind) {
+  case Expr::Kind::And:
+    return eval(*e.left) && eval(*e.right);
+  case Expr::Kind::Or:
+    return eval(*e.left) || eval(*e.right);
+  case Expr::Kind::Not:
+    return !eval(*e.left);
+  case Expr::Kind::Compare:
+    return compare(e);
+  case Expr::Kind::Like: {
+    const Field f = eval(e.lhs);
+    return f.present && like(f.text, e.pattern) != e.negate;
+  }
+  case Expr::Kind::IsNull:
+    return !eval(e.lhs).present != e.negate;
+  }
+  return false;
+}
+
+void Scanner::accumulate()
+{
+  for (size_t i = 0; i < query->projections.size(); i++) {
+    const auto& p = query->projections[i];
+    if (p.kind == Projection::Kind::Count &&
+        p.value.kind == Operand::Kind::Null) {
+      acc[i] += 1; // COUNT(*)
+      continue;
+    }
+    const Field f = eval(p.value);
+    double v;
+    if (!f.present) {
+      continue;
+    }
+    if (p.kind == Projection::Kind::Count) {
+      acc[i] += 1;
+      continue;
+    }
+    if (!to_number(f.text, &v)) {
+      continue;
+    }
+    switch (p.kind) {
+    case Projection::Kind::Min:
+      acc[i] = acc_count[i] ? std::min(acc[i], v) : v;
+      break;
+    case Projection::Kind::Max:
+      acc[i] = acc_count[i] ? std::max(acc[i], v) : v;
+      break;
+    default:
+      acc[i] += v;
+      break;
+    }
+    ++acc_count[i];
+  }
+}
+
+void Scanner::emit(std::string& out)
+{
+  if (passthrough) {
+    out.append(record);
+    out.push_back(params.output == Format::CSV ?
+                  params.csv_output.record_delimiter :
+                  params.json_output.record_delimiter);
+    return;
+  }
+
+  const bool csv_in = params.input == Format::CSV;
+  if (params.output == Format::CSV) {
+    bool first = true;
+    for (const auto& p : query->projections) {
+      if (p.kind == Projection::Kind::All) {
+        if (csv_in) {
+          parse_csv_fields(std::numeric_limits<size_t>::max());
+        }
+        for (const auto& f : fields) {
+          emit_csv_value(f.present ? f.text : std::string_view{}, first, out);
+          first = false;
+        }
+        continue;
+      }
+      const Field f = eval(p.value);
+      emit_csv_value(f.present ? f.text : std::string_view{}, first, out);
+      first = false;
+    }
+    out.push_back(params.csv_output.record_delimiter);
+    return;
+  }
+
+  out.push_back('{');
+  bool first = true;
+  auto key = [&out, &first] (std::string_view name) {
+    if (!first) {
+      out.push_back(',');
+    }
+    first = false;
+    append_json_string(name, out);
+    out.push_back(':');
+  };
+  size_t n = 0;
+  for (const auto& p : query->projections) {
+    ++n;
+    if (p.kind == Projection::Kind::All) {
+      if (csv_in) {
+        parse_csv_fields(std::numeric_limits<size_t>::max());
+      }
+      for (size_t i = 0; i < fields.size(); i++) {
+        if (!csv_in) {
+          key(keys[i]);
+        } else if (i < header_names.size()) {
+          key(header_names[i]);
+        } else {
+          key("_" + std::to_string(i + 1));
+        }
+        emit_json_value(fields[i], out);
+      }
+      continue;
+    }
+    if (!p.name.empty()) {
+      key(p.name);
+    } else {
+      key("_" + std::to_string(n));
+    }
+    emit_json_value(eval(p.value), out);
+  }
+  out.push_back('}');
+  out.push_back(params.json_output.record_delimiter);
+}
+
+void Scanner::emit_csv_value(std::string_view v, bool first,
+                             std::string& out) const
+{
+  const auto& o = params.csv_output;
+  if (!first) {
+    out.push_back(o.field_delimiter);
+  }
+  const char special[] = {o.field_delimiter, o.record_delimiter, o.quote,
+                          o.quote_escape, '\r', '\n'};
+  const bool quote = o.quote_always ||
+      v.find_first_of(std::string_view{special, sizeof(special)}) !=
+      std::string_view::npos;
+  if (!quote) {
+    out.append(v);
+    return;
+  }
+  out.push_back(o.quote);
+  for (auto c : v) {
+    if (c == o.quote || (c == o.quote_escape && o.quote_escape != o.quote)) {
+      out.push_back(o.quote_escape);
+    }
+    out.push_back(c);
+  }
+  out.push_back(o.quote);
+}
+
+void Scanner::emit_json_value(const Field& f, std::string& out) const
+{
+  if (!f.present) {
+    out.append("null");
+  } else if (!f.raw.empty()) {
+    out.append(f.raw); // json input, already encoded
+  } else {
+    append_json_string(f.text, out);
+  }
+}
+
+
+// event stream
+
+static void append_be(std::string& s, uint32_t v, int bytes)
+{
+  for (int i = bytes - 1; i >= 0; i--) {
+    s.push_back(static_cast<char>((v >> (i * 8)) & 0xff));
+  }
+}
+
+using Header = std::pair<std::string_view, std::string_view>;
+
+// prelude: total length, headers length, prelude crc; then the headers, the
+// payload and a crc of the whole message
+static void encode_message(std::initializer_list<Header> headers,
+                           std::string_view payload, ceph::bufferlist& out)
+{
+  std::string h;
+  for (const auto& [name, value] : headers) {
+    h.push_back(static_cast<char>(name.size()));
+    h.append(name);
+    h.push_back(7); // string
+    append_be(h, value.size(), 2);
+    h.append(value);
+  }
+  const uint32_t total = 12 + h.size() + payload.size() + 4;
+
+  std::string msg;
+  msg.reserve(total);
+  append_be(msg, total, 4);
+  append_be(msg, h.size(), 4);
+  boost::crc_32_type prelude_crc;
+  prelude_crc.process_bytes(msg.data(), msg.size());
+  append_be(msg, prelude_crc.checksum(), 4);
+  msg.append(h);
+  msg.append(payload);
+  boost::crc_32_type message_crc;
+  message_crc.process_bytes(msg.data(), msg.size());
+  append_be(msg, message_crc.checksum(), 4);
+  out.append(msg);
+}
+
+void encode_records_event(std::string_view payload, ceph::bufferlist& out)
+{
+  encode_message({{":event-type", "Records"},
+                  {":content-type", "application/octet-stream"},
+                  {":message-type", "event"}}, payload, out);
+}
+
+void encode_stats_event(uint64_t scanned, uint64_t processed,
+                        uint64_t returned, ceph::bufferlist& out)
+{
+  const std::string payload =
+      "<Stats><BytesScanned>" + std::to_string(scanned) + "</BytesScanned>"
+      "<BytesProcessed>" + std::to_string(processed) + "</BytesProcessed>"
+      "<BytesReturned>" + std::to_string(returned) + "</BytesReturned></Stats>";
+  encode_message({{":event-type", "Stats"},
+                  {":content-type", "text/xml"},
+                  {":message-type", "event"}}, payload, out);
+}
+
+void encode_end_event(ceph::bufferlist& out)
+{
+  encode_message({{":message-type", "event"},
+                  {":event-type", "End"}}, {}, out);
+}
+
+void encode_error_event(const Error& err, ceph::bufferlist& out)
+{
+  encode_message({{":error-code", err.code},
+                  {":error-message", err.message},
+                  {":message-type", "error"}}, {}, out);
+}
+
+} // namespace rgw::s3select
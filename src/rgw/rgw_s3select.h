@@ -0,0 +1,173 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "include/buffer.h"
+
+// S3 Select: run a SQL SELECT statement over a CSV or JSON object as its data
+// is read, returning only the matching records and the selected columns
+namespace rgw::s3select {
+
+enum class Format { CSV, JSON };
+
+struct CSVInput {
+  enum class Header {
+    None,   //< the first record is data, columns are named _1, _2, ...
+    Use,    //< the first record names the columns
+    Ignore, //< the first record is skipped
+  };
+  Header header = Header::None;
+  char field_delimiter = ',';
+  char record_delimiter = '\n';
+  char quote = '"';
+  char quote_escape = '"';
+  char comment = '\0'; //< records starting with this are skipped, if set
+};
+
+struct JSONInput {
+  bool lines = false; //< one object per line, rather than a document
+};
+
+struct CSVOutput {
+  bool quote_always = false; //< or only fields that need it
+  char field_delimiter = ',';
+  char record_delimiter = '\n';
+  char quote = '"';
+  char quote_escape = '"';
+};
+
+struct JSONOutput {
+  char record_delimiter = '\n';
+};
+
+struct Params {
+  std::string expression;
+  Format input = Format::CSV;
+  CSVInput csv_input;
+  JSONInput json_input;
+  Format output = Format::CSV;
+  CSVOutput csv_output;
+  JSONOutput json_output;
+};
+
+/// an error, with the code and message S3 returns for it
+struct Error {
+  std::string code;
+  std::string message;
+};
+
+struct Query;
+struct ColumnRef;
+struct Operand;
+struct Expr;
+
+/// evaluates a query over a stream of object data, without holding more than
+/// one record of it. only the columns the query uses are parsed, and
+/// records it selects entirely are copied as they are when possible.
+///
+/// queries are of the form
+///   SELECT <*|column [AS name], ...|aggregate, ...> FROM S3Object [[AS] alias]
+///     [WHERE <condition>] [LIMIT <n>]
+/// columns are _1, _2, ... or names, optionally prefixed by the alias.
+/// conditions combine comparisons, LIKE and IS [NOT] NULL with AND, OR and
+/// NOT. aggregates are COUNT(*), SUM, MIN, MAX and AVG
+class Scanner {
+ public:
+  explicit Scanner(const Params& params);
+  ~Scanner();
+
+  /// parse the expression, and check it against the input format
+  int init(Error *err);
+
+  /// scan the next part of the object, appending the output records
+  int process(const char *data, size_t len, std::string& out, Error *err);
+
+  /// scan the end of the object, appending any aggregate output
+  int finish(std::string& out, Error *err);
+
+  /// true once LIMIT is reached, and no more input is needed
+  bool done() const { return limit_reached; }
+
+  uint64_t get_bytes_processed() const { return bytes_processed; }
+  uint64_t get_records() const { return records; }
+
+ private:
+  /// a value read from a record
+  struct Field {
+    std::string_view text; //< unescaped
+    std::string_view raw;  //< json text of the value, for json output
+    bool present = false;  //< false for missing columns and json nulls
+    bool is_string = true; //< false for json numbers, booleans and objects
+  };
+
+  const Params params;
+  std::unique_ptr<Query> query;
+
+  std::string carry; //< the start of a record that spans parts
+  uint64_t bytes_processed = 0;
+  uint64_t records = 0;
+  uint64_t emitted = 0;
+  bool limit_reached = false;
+  bool header_pending = false;
+  bool passthrough = false; //< copy selected records as they are
+  size_t max_fields = 0;    //< the number of csv fields to parse
+
+  // the fields of the current record
+  std::string_view record;
+  std::vector<Field> fields;
+  std::vector<std::string_view> keys; //< json keys of fields
+  size_t csv_pos = 0; //< where the next csv field starts
+  bool fields_complete = false;
+  std::deque<std::string> scratch; //< unescaped values
+  std::vector<std::string> header_names;
+
+  // aggregates
+  std::vector<double> acc;
+  std::vector<uint64_t> acc_count;
+
+  size_t next_piece(std::string_view buf) const;
+  bool find_record(std::string_view buf, size_t *len, size_t *consumed) const;
+  int handle_record(std::string_view rec, std::string& out, Error *err);
+
+  void parse_csv_fields(size_t count);
+  int parse_json_fields(Error *err);
+  int bind_header(Error *err);
+
+  Field get(const ColumnRef& col);
+  Field eval(const Operand& o);
+  bool eval(const Expr& e);
+  bool compare(const Expr& e);
+
+  void accumulate();
+  void emit(std::string& out);
+  void emit_csv_value(std::string_view v, bool first, std::string& out) const;
+  void emit_json_value(const Field& f, std::string& out) const;
+};
+
+/// encode an event of the AWS event stream format SelectObjectContent
+/// responds with
+void encode_records_event(std::string_view payload, ceph::bufferlist& out);
+void encode_stats_event(uint64_t scanned, uint64_t processed,
+                        uint64_t returned, ceph::bufferlist& out);
+void encode_end_event(ceph::bufferlist& out);
+void encode_error_event(const Error& err, ceph::bufferlist& out);
+
+} // namespace rgw::s3select
@@ -20,6 +20,13 @@ PerfCountersRef build(CephContext *cct, const std::string& name)
   b.add_time_avg(l_poll, "poll_latency", "Average latency of replication log requests");
   b.add_u64_counter(l_poll_err, "poll_errors", "Number of replication log request errors");
 
+  b.add_u64_counter(l_bucket_sync_objects, "bucket_sync_objects", "Number of objects synced by bucket sync");
+  b.add_u64(l_bucket_full_sync_shards, "bucket_full_sync_shards", "Number of bucket shards in full sync");
+  b.add_u64(l_bucket_full_sync_window, "bucket_full_sync_window", "Concurrent object fetches allowed over the bucket shards in full sync");
+  b.add_time_avg(l_bucket_full_sync_latency, "bucket_full_sync_latency", "Average latency of object syncs in bucket full sync");
+  b.add_u64_avg(l_bucket_full_sync_rate, "bucket_full_sync_rate", "Objects per second synced by each bucket shard over its full sync");
+  b.add_time_avg(l_bucket_inc_sync_lag, "bucket_inc_sync_lag", "Average age of bucket index log entries when their sync starts");
+
   auto logger = PerfCountersRef{ b.create_perf_counters(), cct };
   cct->get_perfcounters_collection()->add(logger.get());
   return logger;
@@ -17,6 +17,13 @@ enum {
   l_poll,
   l_poll_err,
 
+  l_bucket_sync_objects,
+  l_bucket_full_sync_shards,
+  l_bucket_full_sync_window,
+  l_bucket_full_sync_latency,
+  l_bucket_full_sync_rate,
+  l_bucket_inc_sync_lag,
+
   l_last,
 };
 
@@ -43,6 +43,8 @@ public:
   RGWSyncModuleInstance() {}
   virtual ~RGWSyncModuleInstance() {}
   virtual RGWDataSyncModule *get_data_handler() = 0;
+  /* stop any background work of the instance, before the store goes down */
+  virtual void shutdown() {}
   virtual RGWRESTMgr *get_rest_filter(int dialect, RGWRESTMgr *orig) {
     return orig;
   }
@@ -15,6 +15,7 @@
 #include "rgw_pubsub.h"
 #include "rgw_pubsub_push.h"
 #include "rgw_perf_counters.h"
+#include "common/ceph_mutex.h"
 #ifdef WITH_RADOSGW_AMQP_ENDPOINT
 #include "rgw_amqp.h"
 #endif
@@ -26,6 +27,9 @@
 
 
 #define PUBSUB_EVENTS_RETENTION_DEFAULT 7
+#define PUBSUB_PUSH_BATCH_SIZE_DEFAULT 64
+#define PUBSUB_PUSH_RETRY_MIN_MS_DEFAULT 500
+#define PUBSUB_PUSH_RETRY_MAX_MS_DEFAULT 60000
 
 /*
 
@@ -36,6 +40,10 @@ config:
    "uid": <uid>,                   # default: "pubsub"
    "data_bucket_prefix": <prefix>  # default: "pubsub-"
    "data_oid_prefix": <prefix>     #
+   "push_queue": <true|false>      # default: false, queue pushes in rados and deliver them in batches
+   "push_batch_size": <num>        # default: 64, max events per queued push
+   "push_retry_min_ms": <ms>       # default: 500, first retry delay of a failed queued push
+   "push_retry_max_ms": <ms>       # default: 60000, max retry delay of a failed queued push
 
     # non-dynamic config
     "notifications": [
@@ -100,6 +108,17 @@ struct PSSubConfig {
     }
   }
 
+  void to_user_conf(const rgw_user& owner, rgw_pubsub_sub_config *uc) const {
+    uc->user = owner;
+    uc->name = name;
+    uc->topic = topic;
+    uc->dest.bucket_name = data_bucket_name;
+    uc->dest.oid_prefix = data_oid_prefix;
+    uc->dest.push_endpoint = push_endpoint_name;
+    uc->dest.push_endpoint_args = push_endpoint_args;
+    uc->s3_id = s3_id;
+  }
+
   void dump(Formatter *f) const {
     encode_json("name", name, f);
     encode_json("topic", topic, f);
@@ -192,6 +211,11 @@ struct PSConfig {
 
   int events_retention_days{0};
 
+  bool push_queue{false};
+  uint32_t push_batch_size{PUBSUB_PUSH_BATCH_SIZE_DEFAULT};
+  uint32_t push_retry_min_ms{PUBSUB_PUSH_RETRY_MIN_MS_DEFAULT};
+  uint32_t push_retry_max_ms{PUBSUB_PUSH_RETRY_MAX_MS_DEFAULT};
+
   uint64_t sync_instance{0};
   uint64_t max_id{0};
 
@@ -206,6 +230,10 @@ struct PSConfig {
     encode_json("data_bucket_prefix", data_bucket_prefix, f);
     encode_json("data_oid_prefix", data_oid_prefix, f);
     encode_json("events_retention_days", events_retention_days, f);
+    encode_json("push_queue", push_queue, f);
+    encode_json("push_batch_size", push_batch_size, f);
+    encode_json("push_retry_min_ms", push_retry_min_ms, f);
+    encode_json("push_retry_max_ms", push_retry_max_ms, f);
     encode_json("sync_instance", sync_instance, f);
     encode_json("max_id", max_id, f);
     {
@@ -246,6 +274,11 @@ struct PSConfig {
     data_bucket_prefix = config["data_bucket_prefix"]("pubsub-");
     data_oid_prefix = config["data_oid_prefix"];
     events_retention_days = config["events_retention_days"](PUBSUB_EVENTS_RETENTION_DEFAULT);
+    push_queue = config["push_queue"](false);
+    push_batch_size = std::max(config["push_batch_size"](PUBSUB_PUSH_BATCH_SIZE_DEFAULT), 1);
+    push_retry_min_ms = std::max(config["push_retry_min_ms"](PUBSUB_PUSH_RETRY_MIN_MS_DEFAULT), 1);
+    push_retry_max_ms = std::max<uint32_t>(config["push_retry_max_ms"](PUBSUB_PUSH_RETRY_MAX_MS_DEFAULT),
+                                           push_retry_min_ms);
 
     for (auto& c : config["notifications"].array()) {
       PSNotificationConfig nc;
@@ -467,13 +500,25 @@ static void make_s3_record_ref(CephContext *cct, const rgw_bucket& bucket,
   set_event_id(r->id, r->object_etag, ts);
 }
 
+static string get_sub_id(const rgw_user& owner, const string& sub_name) {
+  string owner_prefix;
+  if (!owner.empty()) {
+    owner_prefix = owner.to_str() + "/";
+  }
+
+  return owner_prefix + sub_name;
+}
+
 class PSManager;
 using PSManagerRef = std::shared_ptr<PSManager>;
+class PSDeliveryThread;
+using PSDeliveryThreadRef = std::shared_ptr<PSDeliveryThread>;
 
 struct PSEnv {
   PSConfigRef conf;
   shared_ptr<RGWUserInfo> data_user_info;
   PSManagerRef manager;
+  PSDeliveryThreadRef delivery;
 
   PSEnv() : conf(make_shared<PSConfig>()),
             data_user_info(make_shared<RGWUserInfo>()) {}
@@ -487,6 +532,440 @@ struct PSEnv {
 
 using PSEnvRef = std::shared_ptr<PSEnv>;
 
+// when push_queue is configured, events are not pushed from the sync path.
+// they are appended to a persistent queue per subscription, a cls_log object
+// in the log pool, and this thread delivers them to the push endpoints in
+// batches, with its own coroutine and http managers. a slow or unavailable
+// endpoint only delays its own queue, and is retried with a backoff. the
+// queues are listed in a registry object, so that events queued before a
+// restart are delivered after it. events of a subscription may be queued by
+// any gateway of the zone, so a worker delivers a queue only while it holds a
+// lease on the queue object
+class PSDeliveryThread : public RGWRadosThread, public DoutPrefixProvider {
+  class DeliveryCR;
+  class WorkerCR;
+
+  struct Queue {
+    rgw_pubsub_sub_config conf;
+    PSSubConfigRef sub_conf; // holds the push endpoint
+    bool active{false}; // a worker is delivering the queue
+    bool dirty{false}; // events were queued since the worker last listed it
+  };
+
+  const PSConfigRef conf;
+  RGWCoroutinesManager crs;
+  RGWHTTPManager http;
+  RGWDataSyncEnv sync_env;
+
+  ceph::mutex lock = ceph::make_mutex("PSDeliveryThread::lock");
+  std::map<std::string, Queue> queues; // by subscription id
+  RGWCoroutinesStack *delivery_stack{nullptr};
+  bool loaded{false};
+
+  uint64_t interval_msec() override { return 1000; }
+  void stop_process() override { crs.stop(); }
+
+  static bool same_endpoint(const rgw_pubsub_sub_config& a, const rgw_pubsub_sub_config& b) {
+    return a.dest.push_endpoint == b.dest.push_endpoint &&
+      a.dest.push_endpoint_args == b.dest.push_endpoint_args;
+  }
+
+  void update_queue(const std::string& sub_id, const rgw_pubsub_sub_config& uc, bool replace);
+  int load_queues();
+
+  // queues with new events and no worker, marked as active
+  std::vector<std::string> get_ready();
+  // the endpoint to deliver the next batch of a queue with
+  PSSubConfigRef begin_pass(const std::string& sub_id);
+  // returns false if events were queued since the last pass. a drained
+  // queue is forgotten until its next event, which registers it again
+  bool end_worker(const std::string& sub_id, bool force);
+
+public:
+  PSDeliveryThread(RGWRados *_store, const PSConfigRef& _conf)
+    : RGWRadosThread(_store, "pubsub-delivery"), conf(_conf),
+      crs(_store->ctx(), _store->get_cr_registry()),
+      http(_store->ctx(), crs.get_completion_mgr()) {
+    sync_env.dpp = this;
+    sync_env.cct = _store->ctx();
+    sync_env.store = _store;
+    sync_env.async_rados = _store->get_async_rados();
+    sync_env.http_manager = &http;
+  }
+
+  ~PSDeliveryThread() override {
+    stop();
+  }
+
+  int init() override {
+    return http.start();
+  }
+  int process() override;
+
+  static rgw_raw_obj registry_obj(RGWRados *store) {
+    return rgw_raw_obj(store->svc.zone->get_zone_params().log_pool, pubsub_push_queue_registry_oid);
+  }
+  static std::string queue_oid(const std::string& sub_id) {
+    return pubsub_push_queue_oid_prefix + sub_id;
+  }
+
+  // true if the queue is registered with this endpoint configuration
+  bool is_registered(const std::string& sub_id, const rgw_pubsub_sub_config& uc);
+  // events were appended to the queue of the subscription
+  void notify(const std::string& sub_id, const rgw_pubsub_sub_config& uc);
+
+  // implements DoutPrefixProvider
+  CephContext *get_cct() const override { return cct; }
+  unsigned get_subsys() const override { return dout_subsys; }
+  std::ostream& gen_prefix(std::ostream& out) const override {
+    return out << "pubsub delivery: ";
+  }
+};
+
+// delivers a single queue, a batch at a time, until it is empty
+class PSDeliveryThread::WorkerCR : public RGWCoroutine {
+  PSDeliveryThread* const thread;
+  const std::string sub_id;
+  const std::string oid;
+  PSSubConfigRef sub_conf;
+  std::list<cls_log_entry> entries;
+  std::string marker;
+  bool truncated{false};
+  std::vector<rgw_pubsub_event> events;
+  std::vector<rgw_pubsub_s3_record> records;
+  uint32_t backoff_ms{0};
+  int ret{0};
+  boost::intrusive_ptr<RGWContinuousLeaseCR> lease_cr;
+  boost::intrusive_ptr<RGWCoroutinesStack> lease_stack;
+
+  void init_lease_cr() {
+    lease_cr.reset(new RGWContinuousLeaseCR(thread->sync_env.async_rados, thread->store,
+                                            rgw_raw_obj(thread->store->svc.zone->get_zone_params().log_pool, oid),
+                                            "pubsub_delivery", cct->_conf->rgw_sync_lease_period, this));
+    lease_stack.reset(spawn(lease_cr.get(), false));
+  }
+
+  void decode_entries() {
+    events.clear();
+    records.clear();
+    for (auto& entry : entries) {
+      auto iter = entry.data.cbegin();
+      try {
+        if (entry.section == rgw_pubsub_s3_record::json_type_single) {
+          records.emplace_back();
+          decode(records.back(), iter);
+        } else {
+          events.emplace_back();
+          decode(events.back(), iter);
+        }
+      } catch (const buffer::error& e) {
+        ldpp_dout(thread, 1) << "ERROR: failed to decode queued event: queue=" << oid
+          << " id=" << entry.id << ", dropping it" << dendl;
+        if (entry.section == rgw_pubsub_s3_record::json_type_single) {
+          records.pop_back();
+        } else {
+          events.pop_back();
+        }
+      }
+    }
+  }
+
+  utime_t next_backoff() {
+    if (backoff_ms == 0) {
+      backoff_ms = thread->conf->push_retry_min_ms;
+    } else {
+      backoff_ms = std::min(backoff_ms * 2, thread->conf->push_retry_max_ms);
+    }
+    return utime_t(backoff_ms / 1000, (backoff_ms % 1000) * 1000000);
+  }
+
+public:
+  WorkerCR(PSDeliveryThread* _thread, const std::string& _sub_id)
+    : RGWCoroutine(_thread->cct), thread(_thread), sub_id(_sub_id),
+      oid(queue_oid(sub_id)) {}
+
+  ~WorkerCR() override {
+    if (lease_cr) {
+      lease_cr->abort();
+    }
+  }
+
+  int operate() override {
+    reenter(this) {
+      while (!thread->going_down()) {
+        if (!lease_cr || !lease_cr->is_locked()) {
+          // the lease was lost, or not taken yet
+          drain_all();
+          yield init_lease_cr();
+          while (!lease_cr->is_locked()) {
+            if (lease_cr->is_done()) {
+              break;
+            }
+            set_sleeping(true);
+            yield;
+          }
+          if (!lease_cr->is_locked()) {
+            // another gateway delivers the queue, take over if it stops
+            yield {
+              const auto interval = next_backoff();
+              ldpp_dout(thread, 20) << "failed to lock queue=" << oid << " ret="
+                << lease_cr->get_ret_status() << ", retrying in " << interval << dendl;
+              wait(interval);
+            }
+            continue;
+          }
+        }
+        sub_conf = thread->begin_pass(sub_id);
+        if (!sub_conf || !sub_conf->push_endpoint) {
+          // events remain queued until the endpoint is configured again
+          ldpp_dout(thread, 1) << "ERROR: no push endpoint for queue=" << oid << dendl;
+          thread->end_worker(sub_id, true);
+          break;
+        }
+        yield call(new RGWRadosTimelogListCR(thread->store, oid, "",
+                                             thread->conf->push_batch_size,
+                                             &entries, &marker, &truncated));
+        if (retcode == -ENOENT) {
+          entries.clear();
+        } else if (retcode < 0) {
+          ldpp_dout(thread, 1) << "ERROR: failed to list queue=" << oid << " ret=" << retcode << dendl;
+          yield wait(next_backoff());
+          continue;
+        }
+        if (entries.empty()) {
+          if (thread->end_worker(sub_id, false)) {
+            break;
+          }
+          continue;
+        }
+
+        decode_entries();
+        ret = 0;
+        if (!events.empty()) {
+          yield call(sub_conf->push_endpoint->send_batch_to_completion_async(events, &thread->sync_env));
+          ret = retcode;
+        }
+        if (ret == 0 && !records.empty()) {
+          yield call(sub_conf->push_endpoint->send_batch_to_completion_async(records, &thread->sync_env));
+          ret = retcode;
+        }
+        if (ret < 0) {
+          if (perfcounter) perfcounter->inc(l_rgw_pubsub_push_failed, events.size() + records.size());
+          yield {
+            const auto interval = next_backoff();
+            ldpp_dout(thread, 1) << "ERROR: failed to push " << events.size() + records.size()
+              << " events from queue=" << oid << " to endpoint: " << sub_conf->push_endpoint_name
+              << " ret=" << ret << ", retrying in " << interval << dendl;
+            wait(interval);
+          }
+          continue;
+        }
+        if (perfcounter) perfcounter->inc(l_rgw_pubsub_push_ok, events.size() + records.size());
+        ldpp_dout(thread, 20) << "pushed " << events.size() + records.size() << " events from queue="
+          << oid << " to endpoint: " << sub_conf->push_endpoint_name << dendl;
+        backoff_ms = 0;
+
+        if (!lease_cr->is_locked()) {
+          // the gateway that took the lease trims the batch after pushing it
+          ldpp_dout(thread, 1) << "lost lock on queue=" << oid << ", not trimming it" << dendl;
+          continue;
+        }
+        yield call(new RGWRadosTimelogTrimCR(thread->store, oid, real_time{}, real_time{},
+                                             "", marker));
+        if (retcode < 0 && retcode != -ENODATA) {
+          // the batch is pushed again once the trim succeeds
+          ldpp_dout(thread, 1) << "ERROR: failed to trim queue=" << oid << " ret=" << retcode << dendl;
+          yield wait(next_backoff());
+        }
+      }
+      if (lease_cr) {
+        lease_cr->go_down();
+      }
+      drain_all();
+      return set_cr_done();
+    }
+    return 0;
+  }
+};
+
+// starts a worker for every queue with new events, and waits for more
+class PSDeliveryThread::DeliveryCR : public RGWCoroutine {
+  PSDeliveryThread* const thread;
+  std::vector<std::string> ready;
+  std::vector<std::string>::iterator iter;
+  int child_ret{0};
+
+public:
+  explicit DeliveryCR(PSDeliveryThread* _thread)
+    : RGWCoroutine(_thread->cct), thread(_thread) {}
+
+  int operate() override {
+    reenter(this) {
+      while (!thread->going_down()) {
+        ready = thread->get_ready();
+        for (iter = ready.begin(); iter != ready.end(); ++iter) {
+          spawn(new WorkerCR(thread, *iter), false);
+        }
+        while (collect_next(&child_ret)) {
+          // workers report their own errors
+        }
+        // woken up early by notify()
+        yield wait(utime_t(1, 0));
+      }
+      drain_all();
+      return set_cr_done();
+    }
+    return 0;
+  }
+};
+
+void PSDeliveryThread::update_queue(const std::string& sub_id,
+                                    const rgw_pubsub_sub_config& uc,
+                                    bool replace)
+{
+  {
+    std::lock_guard l{lock};
+    auto& q = queues[sub_id];
+    q.dirty = true;
+    if (q.sub_conf && (!replace || same_endpoint(q.conf, uc))) {
+      return;
+    }
+  }
+  // creating the endpoint may connect to it, do it unlocked
+  auto sub_conf = std::make_shared<PSSubConfig>();
+  sub_conf->from_user_conf(cct, uc);
+
+  std::lock_guard l{lock};
+  auto& q = queues[sub_id];
+  if (q.sub_conf && !replace) {
+    return;
+  }
+  q.conf = uc;
+  q.sub_conf = std::move(sub_conf);
+}
+
+int PSDeliveryThread::load_queues()
+{
+  rgw_rados_ref ref;
+  int r = store->get_raw_obj_ref(registry_obj(store), &ref);
+  if (r < 0) {
+    return r;
+  }
+
+  std::string marker;
+  bool more = true;
+  while (more) {
+    std::map<std::string, bufferlist> vals;
+    r = ref.ioctx.omap_get_vals2(ref.obj.oid, marker, 1000, &vals, &more);
+    if (r == -ENOENT) {
+      return 0;
+    }
+    if (r < 0) {
+      return r;
+    }
+    for (auto& [sub_id, bl] : vals) {
+      marker = sub_id;
+      rgw_pubsub_sub_config uc;
+      try {
+        auto iter = bl.cbegin();
+        decode(uc, iter);
+      } catch (const buffer::error& e) {
+        ldpp_dout(this, 1) << "ERROR: failed to decode registry entry of queue="
+          << queue_oid(sub_id) << dendl;
+        continue;
+      }
+      ldpp_dout(this, 20) << "resuming queue=" << queue_oid(sub_id) << dendl;
+      // configuration from events queued since is newer
+      update_queue(sub_id, uc, false);
+    }
+  }
+  return 0;
+}
+
+std::vector<std::string> PSDeliveryThread::get_ready()
+{
+  std::vector<std::string> ready;
+  std::lock_guard l{lock};
+  for (auto& [sub_id, q] : queues) {
+    if (q.dirty && !q.active && q.sub_conf && q.sub_conf->push_endpoint) {
+      q.active = true;
+      ready.push_back(sub_id);
+    }
+  }
+  return ready;
+}
+
+PSSubConfigRef PSDeliveryThread::begin_pass(const std::string& sub_id)
+{
+  std::lock_guard l{lock};
+  auto& q = queues[sub_id];
+  q.dirty = false;
+  return q.sub_conf;
+}
+
+bool PSDeliveryThread::end_worker(const std::string& sub_id, bool force)
+{
+  std::lock_guard l{lock};
+  auto& q = queues[sub_id];
+  if (q.dirty && !force) {
+    return false;
+  }
+  if (force) {
+    q.active = false;
+  } else {
+    // the subscription may have been removed along with its registry entry
+    queues.erase(sub_id);
+  }
+  return true;
+}
+
+int PSDeliveryThread::process()
+{
+  if (!loaded) {
+    int r = load_queues();
+    if (r < 0) {
+      ldpp_dout(this, 1) << "ERROR: failed to read queue registry: ret=" << r << dendl;
+      return r;
+    }
+    loaded = true;
+  }
+
+  auto stack = new RGWCoroutinesStack(cct, &crs);
+  stack->call(new DeliveryCR(this));
+  {
+    std::lock_guard l{lock};
+    delivery_stack = stack;
+  }
+  std::list<RGWCoroutinesStack*> stacks{stack};
+  int r = crs.run(stacks);
+
+  std::lock_guard l{lock};
+  delivery_stack = nullptr;
+  for (auto& [sub_id, q] : queues) {
+    q.active = false;
+  }
+  return r;
+}
+
+bool PSDeliveryThread::is_registered(const std::string& sub_id,
+                                     const rgw_pubsub_sub_config& uc)
+{
+  std::lock_guard l{lock};
+  auto iter = queues.find(sub_id);
+  return iter != queues.end() && iter->second.sub_conf &&
+    same_endpoint(iter->second.conf, uc);
+}
+
+void PSDeliveryThread::notify(const std::string& sub_id,
+                              const rgw_pubsub_sub_config& uc)
+{
+  update_queue(sub_id, uc, true);
+  std::lock_guard l{lock};
+  if (delivery_stack) {
+    crs.get_completion_mgr()->wakeup(delivery_stack);
+  }
+}
+
 template<typename EventType>
 class PSEvent {
   const EventRef<EventType> event;
@@ -850,6 +1329,71 @@ class PSSubscription {
     }
   };
 
+  // append the event to the push queue of the subscription, registering the
+  // queue first if the delivery thread does not know it yet
+  template<typename EventType>
+  class QueueEventCR : public RGWCoroutine {
+    RGWDataSyncEnv* const sync_env;
+    const PSSubscriptionRef sub;
+    const EventRef<EventType> event;
+    const std::string sub_id;
+    rgw_pubsub_sub_config user_conf;
+    cls_log_entry entry;
+
+  public:
+    QueueEventCR(RGWDataSyncEnv* const _sync_env,
+                 const PSSubscriptionRef& _sub,
+                 const rgw_user& owner,
+                 const EventRef<EventType>& _event) : RGWCoroutine(_sync_env->cct),
+                                     sync_env(_sync_env),
+                                     sub(_sub),
+                                     event(_event),
+                                     sub_id(RGWUserPubSub::get_push_queue_id(owner, sub->sub_conf->name)) {
+      sub->sub_conf->to_user_conf(owner, &user_conf);
+    }
+
+    int operate() override {
+      reenter(this) {
+        if (!sub->env->delivery->is_registered(sub_id, user_conf)) {
+          yield {
+            std::map<std::string, bufferlist> keys;
+            encode(user_conf, keys[sub_id]);
+            call(new RGWRadosSetOmapKeysCR(sync_env->store,
+                                           PSDeliveryThread::registry_obj(sync_env->store),
+                                           keys));
+          }
+          if (retcode < 0) {
+            ldout(sync_env->cct, 1) << "ERROR: failed to register push queue for subscription="
+              << sub_id << " ret=" << retcode << dendl;
+            return set_cr_error(retcode);
+          }
+        }
+
+        {
+          bufferlist bl;
+          encode(*event, bl);
+          sync_env->store->time_log_prepare_entry(entry, real_clock::now(),
+                                                  EventType::json_type_single,
+                                                  event->id, bl);
+        }
+        yield call(new RGWRadosTimelogAddCR(sync_env->store,
+                                            PSDeliveryThread::queue_oid(sub_id),
+                                            entry));
+        if (retcode < 0) {
+          ldout(sync_env->cct, 1) << "ERROR: failed to queue event: " << event->id
+            << " for subscription=" << sub_id << " ret=" << retcode << dendl;
+          return set_cr_error(retcode);
+        }
+
+        ldout(sync_env->cct, 20) << "event: " << event->id << " queued for subscription="
+          << sub_id << dendl;
+        sub->env->delivery->notify(sub_id, user_conf);
+        return set_cr_done();
+      }
+      return 0;
+    }
+  };
+
 public:
   PSSubscription(RGWDataSyncEnv *_sync_env,
                  PSEnvRef _env,
@@ -895,6 +1439,15 @@ public:
   static RGWCoroutine *push_event_cr(RGWDataSyncEnv* const sync_env, const PSSubscriptionRef& sub, const EventRef<EventType>& event) {
     return new PushEventCR<EventType>(sync_env, sub, event);
   }
+
+  template<typename EventType>
+  static RGWCoroutine *queue_event_cr(RGWDataSyncEnv* const sync_env, const PSSubscriptionRef& sub, const rgw_user& owner, const EventRef<EventType>& event) {
+    return new QueueEventCR<EventType>(sync_env, sub, owner, event);
+  }
+
+  bool push_queued() const {
+    return env->delivery != nullptr;
+  }
   friend class InitCR;
 };
 
@@ -988,12 +1541,7 @@ class PSManager
   };
 
   string sub_id(const rgw_user& owner, const string& sub_name) {
-    string owner_prefix;
-    if (!owner.empty()) {
-      owner_prefix = owner.to_str() + "/";
-    }
-
-    return owner_prefix + sub_name;
+    return get_sub_id(owner, sub_name);
   }
 
   std::map<std::string, GetSubCR *> get_subs;
@@ -1255,7 +1803,17 @@ public:
                 if (perfcounter) perfcounter->inc(l_rgw_pubsub_store_ok);
                 event_handled = true;
               }
-              if (sub->sub_conf->push_endpoint) {
+              if (sub->sub_conf->push_endpoint && sub->push_queued()) {
+                ldout(sync_env->cct, 20) << "queue event for subscription=" << *siter << " owner=" << *oiter << dendl;
+                yield call(PSSubscription::queue_event_cr(sync_env, sub, *oiter, event));
+                if (retcode < 0) {
+                  if (perfcounter) perfcounter->inc(l_rgw_pubsub_push_failed);
+                  ldout(sync_env->cct, 1) << "ERROR: failed to queue event for subscription=" << *siter << " ret=" << retcode << dendl;
+                } else {
+                  if (perfcounter) perfcounter->inc(l_rgw_pubsub_push_queued);
+                  event_handled = true;
+                }
+              } else if (sub->sub_conf->push_endpoint) {
                 ldout(sync_env->cct, 20) << "push event for subscription=" << *siter << " owner=" << *oiter << " ret=" << retcode << dendl;
                 yield call(PSSubscription::push_event_cr(sync_env, sub, event));
                 if (retcode < 0) {
@@ -1278,7 +1836,17 @@ public:
                 if (perfcounter) perfcounter->inc(l_rgw_pubsub_store_ok);
                 event_handled = true;
               }
-              if (sub->sub_conf->push_endpoint) {
+              if (sub->sub_conf->push_endpoint && sub->push_queued()) {
+                ldout(sync_env->cct, 20) << "queue record for subscription=" << *siter << " owner=" << *oiter << dendl;
+                yield call(PSSubscription::queue_event_cr(sync_env, sub, *oiter, record));
+                if (retcode < 0) {
+                  if (perfcounter) perfcounter->inc(l_rgw_pubsub_push_failed);
+                  ldout(sync_env->cct, 1) << "ERROR: failed to queue record for subscription=" << *siter << " ret=" << retcode << dendl;
+                } else {
+                  if (perfcounter) perfcounter->inc(l_rgw_pubsub_push_queued);
+                  event_handled = true;
+                }
+              } else if (sub->sub_conf->push_endpoint) {
                   ldout(sync_env->cct, 20) << "push record for subscription=" << *siter << " owner=" << *oiter << " ret=" << retcode << dendl;
                 yield call(PSSubscription::push_event_cr(sync_env, sub, record));
                 if (retcode < 0) {
@@ -1510,6 +2078,22 @@ public:
   void init(RGWDataSyncEnv *sync_env, uint64_t instance_id) override {
     PSManagerRef mgr = PSManager::get_shared(sync_env, env);
     env->init_instance(sync_env->store->svc.zone->get_realm(), instance_id, mgr);
+    if (conf->push_queue && !env->delivery) {
+      auto delivery = std::make_shared<PSDeliveryThread>(sync_env->store, conf);
+      int ret = delivery->init();
+      if (ret < 0) {
+        ldout(sync_env->cct, 1) << "ERROR: failed to init push delivery, pushing synchronously: ret=" << ret << dendl;
+      } else {
+        delivery->start();
+        env->delivery = std::move(delivery);
+      }
+    }
+  }
+
+  void shutdown() {
+    if (env->delivery) {
+      env->delivery->stop();
+    }
   }
 
   RGWCoroutine *start_sync(RGWDataSyncEnv *sync_env) override {
@@ -1559,6 +2143,10 @@ RGWPSSyncModuleInstance::RGWPSSyncModuleInstance(CephContext *cct, const JSONFor
 #endif
 }
 
+void RGWPSSyncModuleInstance::shutdown() {
+  data_handler->shutdown();
+}
+
 RGWPSSyncModuleInstance::~RGWPSSyncModuleInstance() {
 #ifdef WITH_RADOSGW_AMQP_ENDPOINT
   rgw::amqp::shutdown();
@@ -25,6 +25,7 @@ public:
   RGWPSSyncModuleInstance(CephContext *cct, const JSONFormattable& config);
   ~RGWPSSyncModuleInstance();
   RGWDataSyncModule *get_data_handler() override;
+  void shutdown() override;
   RGWRESTMgr *get_rest_filter(int dialect, RGWRESTMgr *orig) override;
   bool supports_user_writes() override {
     return true;
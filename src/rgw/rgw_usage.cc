@@ -52,8 +52,10 @@ int RGWUsage::show(RGWRados *store, const rgw_user& uid, const string& bucket_na
   bool user_section_open = false;
   map<string, rgw_usage_log_entry> summary_map;
   while (is_truncated) {
+    /* the summary doesn't need the hourly records, the osds can read their
+     * daily rollups instead where those cover the range */
     int ret = store->read_usage(uid, bucket_name, start_epoch, end_epoch, max_entries,
-                                &is_truncated, usage_iter, usage);
+                                &is_truncated, usage_iter, usage, !show_log_entries);
 
     if (ret == -ENOENT) {
       ret = 0;
@@ -2940,7 +2940,7 @@ public:
 
 void rgw_user_init(RGWRados *store)
 {
-  uinfo_cache.init(store->svc.cache);
+  uinfo_cache.init(store->svc.cache, "user_info");
 
   user_meta_handler = new RGWUserMetadataHandler;
   store->meta_mgr->register_handler(user_meta_handler);
@@ -3,8 +3,10 @@
 
 #pragma once
 
+#include "common/perf_counters.h"
 #include "rgw/rgw_service.h"
 #include "rgw/rgw_cache.h"
+#include "rgw/rgw_perf_counters.h"
 
 #include "svc_sys_obj_core.h"
 
@@ -110,6 +112,8 @@ class RGWChainedCacheImpl : public RGWChainedCache {
   RGWSI_SysObj_Cache *svc{nullptr};
   ceph::timespan expiry;
   RWLock lock;
+  CephContext *cct{nullptr};
+  PerfCounters *counters{nullptr};
 
   std::unordered_map<std::string, std::pair<T, ceph::coarse_mono_time>> entries;
 
@@ -124,13 +128,20 @@ public:
 
   void unregistered() override {
     svc = nullptr;
+    if (counters) {
+      rgw_chained_cache_perf_stop(cct, counters);
+      counters = nullptr;
+    }
   }
 
-  void init(RGWSI_SysObj_Cache *_svc) {
+  // @p name tells the cache apart in the perf counters
+  void init(RGWSI_SysObj_Cache *_svc, const std::string& name) {
     if (!_svc) {
       return;
     }
     svc = _svc;
+    cct = svc->ctx();
+    counters = rgw_chained_cache_perf_start(cct, name);
     svc->register_chained_cache(this);
     expiry = std::chrono::seconds(svc->ctx()->_conf.get_val<uint64_t>(
 				    "rgw_cache_expiry_interval"));
@@ -139,14 +150,18 @@ public:
   boost::optional<T> find(const string& key) {
     RWLock::RLocker rl(lock);
     auto iter = entries.find(key);
-    if (iter == entries.end()) {
-      return boost::none;
-    }
-    if (expiry.count() &&
-	(ceph::coarse_mono_clock::now() - iter->second.second) > expiry) {
+    if (iter == entries.end() ||
+	(expiry.count() &&
+	 (ceph::coarse_mono_clock::now() - iter->second.second) > expiry)) {
+      if (counters) {
+	counters->inc(l_rgw_chained_cache_miss);
+      }
       return boost::none;
     }
 
+    if (counters) {
+      counters->inc(l_rgw_chained_cache_hit);
+    }
     return iter->second.first;
   }
 
@@ -173,7 +188,9 @@ public:
 
   void invalidate(const string& key) override {
     RWLock::WLocker wl(lock);
-    entries.erase(key);
+    if (entries.erase(key) && counters) {
+      counters->inc(l_rgw_chained_cache_invalidate);
+    }
   }
 
   void invalidate_all() override {
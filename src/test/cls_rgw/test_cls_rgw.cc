@@ -431,7 +431,7 @@ TEST(cls_rgw, index_list)
   map<int, string> oids = { {0, bucket_oid} };
   map<int, struct rgw_cls_list_ret> list_results;
   cls_rgw_obj_key start_key("", "");
-  int r = CLSRGWIssueBucketList(ioctx, start_key, "", 1000, true, oids, list_results, 1)();
+  int r = CLSRGWIssueBucketList(ioctx, start_key, "", "", 1000, true, oids, list_results, 1)();
 
   ASSERT_EQ(r, 0);
   ASSERT_EQ(1u, list_results.size());
@@ -445,6 +445,345 @@ TEST(cls_rgw, index_list)
     ASSERT_EQ(it2->first.compare(keys[i]), 0);
 }
 
+TEST(cls_rgw, index_list_delimiter)
+{
+  string bucket_oid = str_int("bucket", 7);
+
+  OpMgr mgr;
+
+  ObjectWriteOperation *op = mgr.write_op();
+  cls_rgw_bucket_init_index(*op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  vector<string> names = {
+    "a", "dir/a", "dir/b", "dir/sub/c", "dir0", "e/f", "e/g", "z"
+  };
+  uint64_t epoch = 1;
+  for (size_t i = 0; i < names.size(); i++) {
+    string tag = str_int("tag", i);
+    string loc = str_int("loc", i);
+
+    index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, names[i], loc);
+
+    rgw_bucket_dir_entry_meta meta;
+    meta.category = RGWObjCategory::None;
+    meta.size = 1024;
+    index_complete(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, epoch, names[i], meta);
+  }
+
+  auto list = [&](const string& start, const string& prefix, uint32_t num,
+                  bool *truncated) {
+    map<int, string> oids = { {0, bucket_oid} };
+    map<int, rgw_cls_list_ret> list_results;
+    cls_rgw_obj_key start_key(start, "");
+    int r = CLSRGWIssueBucketList(ioctx, start_key, prefix, "/", num, false,
+                                  oids, list_results, 1)();
+    EXPECT_EQ(0, r);
+    vector<string> listed;
+    for (auto& [key, entry] : list_results[0].dir.m) {
+      EXPECT_EQ(key, entry.key.name);
+      EXPECT_EQ(key.back() == '/', entry.is_common_prefix());
+      listed.push_back(key);
+    }
+    *truncated = list_results[0].is_truncated;
+    return listed;
+  };
+
+  bool truncated;
+  ASSERT_EQ(vector<string>({"a", "dir/", "dir0", "e/", "z"}),
+            list("", "", 1000, &truncated));
+  ASSERT_FALSE(truncated);
+
+  ASSERT_EQ(vector<string>({"dir/a", "dir/b", "dir/sub/"}),
+            list("", "dir/", 1000, &truncated));
+  ASSERT_FALSE(truncated);
+
+  // a marker at, or inside, a common prefix continues after it
+  ASSERT_EQ(vector<string>({"a", "dir/"}), list("", "", 2, &truncated));
+  ASSERT_TRUE(truncated);
+  ASSERT_EQ(vector<string>({"dir0", "e/"}), list("dir/", "", 2, &truncated));
+  ASSERT_EQ(vector<string>({"dir0", "e/"}), list("dir/b", "", 2, &truncated));
+  ASSERT_EQ(vector<string>({"z"}), list("e/", "", 2, &truncated));
+  ASSERT_FALSE(truncated);
+}
+
+TEST(cls_rgw, index_reshard_online)
+{
+  string bucket_oid = str_int("bucket", 8);
+
+  OpMgr mgr;
+
+  ObjectWriteOperation *op = mgr.write_op();
+  cls_rgw_bucket_init_index(*op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  cls_rgw_bucket_instance_entry entry;
+  entry.set_status("new_instance", 4, CLS_RGW_RESHARD_ONLINE);
+  entry.start_time = ceph::real_clock::now();
+  entry.num_entries_copied = 10;
+  ASSERT_EQ(0, cls_rgw_set_bucket_resharding(ioctx, bucket_oid, entry));
+
+  cls_rgw_bucket_instance_entry status;
+  ASSERT_EQ(0, cls_rgw_get_bucket_resharding(ioctx, bucket_oid, &status));
+  ASSERT_TRUE(status.resharding_online());
+  ASSERT_EQ(entry.start_time, status.start_time);
+  ASSERT_EQ(10u, status.num_entries_copied);
+
+  // the writes go on, and are logged even without log_op
+  auto prepare = [&](const string& obj, string tag) {
+    ObjectWriteOperation *op = mgr.write_op();
+    cls_rgw_guard_bucket_resharding(*op, -EBUSY);
+    cls_rgw_obj_key key(obj, string());
+    string loc;
+    rgw_zone_set zones_trace;
+    cls_rgw_bucket_prepare_op(*op, CLS_RGW_OP_ADD, tag, key, loc, false,
+                              0, zones_trace);
+    return ioctx.operate(bucket_oid, op);
+  };
+  ASSERT_EQ(0, prepare("obj", "tag0"));
+
+  map<int, string> oids = { {0, bucket_oid} };
+  BucketIndexShardsManager markers;
+  map<int, cls_rgw_bi_log_list_ret> logs;
+  ASSERT_EQ(0, CLSRGWIssueBILogList(ioctx, markers, 100, oids, logs, 1)());
+  ASSERT_EQ(1u, logs[0].entries.size());
+  ASSERT_EQ("obj", logs[0].entries.front().object);
+
+  // and are blocked once the reshard cuts over
+  entry.reshard_status = CLS_RGW_RESHARD_IN_PROGRESS;
+  ASSERT_EQ(0, cls_rgw_set_bucket_resharding(ioctx, bucket_oid, entry));
+  ASSERT_EQ(-EBUSY, prepare("obj", "tag1"));
+}
+
+TEST(cls_rgw, index_complete_batch)
+{
+  string bucket_oid = str_int("bucket", 9);
+
+  OpMgr mgr;
+
+  ObjectWriteOperation *op = mgr.write_op();
+  cls_rgw_bucket_init_index(*op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  const int num_objs = 3;
+  const uint64_t obj_size = 1024;
+  vector<rgw_cls_obj_complete_op> ops;
+  for (int i = 0; i < num_objs; i++) {
+    string obj = str_int("obj", i);
+    string tag = str_int("tag", i);
+    string loc = str_int("loc", i);
+    index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+
+    rgw_cls_obj_complete_op& c = ops.emplace_back();
+    c.op = CLS_RGW_OP_ADD;
+    c.key = cls_rgw_obj_key(obj, string());
+    c.tag = tag;
+    c.ver.pool = ioctx.get_id();
+    c.ver.epoch = 1;
+    c.meta.category = RGWObjCategory::None;
+    c.meta.size = obj_size;
+    c.meta.accounted_size = obj_size;
+    c.log_op = true;
+  }
+  // ops that fail their checks, before writing anything, are skipped
+  // without failing the others
+  ops[1].tag = "unknown-tag";
+  rgw_cls_obj_complete_op& del = ops.emplace_back();
+  del.op = CLS_RGW_OP_DEL;
+  del.key = cls_rgw_obj_key("missing", string());
+  del.ver.pool = ioctx.get_id();
+  del.ver.epoch = 1;
+  del.log_op = true;
+
+  op = mgr.write_op();
+  cls_rgw_bucket_complete_ops(*op, ops);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, 2, obj_size * 2);
+
+  // each applied op has its own bilog entry, after the prepares
+  map<int, string> oids = { {0, bucket_oid} };
+  BucketIndexShardsManager markers;
+  map<int, cls_rgw_bi_log_list_ret> logs;
+  ASSERT_EQ(0, CLSRGWIssueBILogList(ioctx, markers, 100, oids, logs, 1)());
+  auto& entries = logs[0].entries;
+  ASSERT_EQ(num_objs + 2u, entries.size());
+  auto complete = std::next(entries.begin(), num_objs);
+  ASSERT_EQ("obj-0", complete->object);
+  ASSERT_EQ(CLS_RGW_STATE_COMPLETE, complete->state);
+  ++complete;
+  ASSERT_EQ("obj-2", complete->object);
+  ASSERT_EQ(CLS_RGW_STATE_COMPLETE, complete->state);
+
+  // two ops on the same entry are rejected
+  vector<rgw_cls_obj_complete_op> dup_ops = { ops[0], ops[0] };
+  op = mgr.write_op();
+  cls_rgw_bucket_complete_ops(*op, dup_ops);
+  ASSERT_EQ(-EINVAL, ioctx.operate(bucket_oid, op));
+}
+
+static int put_inline(librados::IoCtx& ioctx, const string& oid, const string& obj,
+                      const string& data, RGWPutInlineMode mode,
+                      const string& id_tag = string())
+{
+  ObjectWriteOperation op;
+  cls_rgw_obj_key key(obj, string());
+  rgw_bucket_dir_entry_meta meta;
+  meta.category = RGWObjCategory::None;
+  meta.size = data.size();
+  meta.accounted_size = data.size();
+  rgw_bucket_inline_data inline_data;
+  inline_data.data.append(data);
+  if (!id_tag.empty()) {
+    inline_data.attrs[RGW_BUCKET_INLINE_ID_TAG_ATTR].append(id_tag);
+  }
+  cls_rgw_bucket_put_inline(op, key, meta, inline_data, mode, true, 0, nullptr);
+  return ioctx.operate(oid, &op);
+}
+
+static void get_entry(librados::IoCtx& ioctx, const string& oid, const string& obj,
+                      rgw_bucket_dir_entry *entry)
+{
+  cls_rgw_obj_key key(obj, string());
+  rgw_cls_bi_entry bi_entry;
+  ASSERT_EQ(0, cls_rgw_bi_get(ioctx, oid, BIIndexType::Plain, key, &bi_entry));
+  auto iter = bi_entry.data.cbegin();
+  decode(*entry, iter);
+}
+
+TEST(cls_rgw, index_put_inline)
+{
+  string bucket_oid = str_int("bucket", 10);
+
+  OpMgr mgr;
+
+  ObjectWriteOperation *op = mgr.write_op();
+  cls_rgw_bucket_init_index(*op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  // exclusive creates an entry, and fails on an existing one
+  ASSERT_EQ(0, put_inline(ioctx, bucket_oid, "obj", "abc", CLS_RGW_PUT_INLINE_EXCLUSIVE));
+  rgw_bucket_dir_entry entry;
+  get_entry(ioctx, bucket_oid, "obj", &entry);
+  ASSERT_TRUE(entry.exists);
+  ASSERT_TRUE(entry.inline_data);
+  ASSERT_EQ("abc", entry.inline_data->data.to_str());
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, 1, 3);
+
+  ASSERT_EQ(-EEXIST, put_inline(ioctx, bucket_oid, "obj", "defg", CLS_RGW_PUT_INLINE_EXCLUSIVE));
+  get_entry(ioctx, bucket_oid, "obj", &entry);
+  ASSERT_EQ("abc", entry.inline_data->data.to_str());
+
+  // replace-inline replaces an inline entry
+  ASSERT_EQ(0, put_inline(ioctx, bucket_oid, "obj", "defg", CLS_RGW_PUT_INLINE_REPLACE_INLINE));
+  get_entry(ioctx, bucket_oid, "obj", &entry);
+  ASSERT_EQ("defg", entry.inline_data->data.to_str());
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, 1, 4);
+
+  // and creates a missing one
+  ASSERT_EQ(0, put_inline(ioctx, bucket_oid, "obj2", "hi", CLS_RGW_PUT_INLINE_REPLACE_INLINE));
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, 2, 6);
+
+  // but fails on an entry with a head object, which it would orphan
+  string obj = "obj3";
+  string tag = "tag";
+  string loc = "loc";
+  index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+  rgw_bucket_dir_entry_meta meta;
+  meta.category = RGWObjCategory::None;
+  meta.size = 1024;
+  index_complete(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, 1, obj, meta);
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, 3, 1030);
+
+  ASSERT_EQ(-EEXIST, put_inline(ioctx, bucket_oid, obj, "xyz", CLS_RGW_PUT_INLINE_REPLACE_INLINE));
+  get_entry(ioctx, bucket_oid, obj, &entry);
+  ASSERT_FALSE(entry.inline_data);
+  ASSERT_EQ(1024u, entry.meta.size);
+
+  // overwrite replaces any entry
+  ASSERT_EQ(0, put_inline(ioctx, bucket_oid, obj, "xyz", CLS_RGW_PUT_INLINE_OVERWRITE));
+  get_entry(ioctx, bucket_oid, obj, &entry);
+  ASSERT_TRUE(entry.inline_data);
+  ASSERT_EQ("xyz", entry.inline_data->data.to_str());
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, 3, 9);
+
+  // a regular write replaces the inline data
+  tag = "tag2";
+  index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+  index_complete(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, 2, obj, meta);
+  get_entry(ioctx, bucket_oid, obj, &entry);
+  ASSERT_FALSE(entry.inline_data);
+
+  // unknown modes are rejected
+  ASSERT_EQ(-EINVAL, put_inline(ioctx, bucket_oid, "obj4", "x", (RGWPutInlineMode)3));
+}
+
+static int del_inline(OpMgr& mgr, librados::IoCtx& ioctx, string& oid, string& obj,
+                      const string& id_tag)
+{
+  string tag = "del-" + id_tag;
+  string loc = "loc";
+  index_prepare(mgr, ioctx, oid, CLS_RGW_OP_DEL, tag, obj, loc);
+
+  ObjectWriteOperation *op = mgr.write_op();
+  cls_rgw_obj_key key(obj, string());
+  bufferlist id_tag_bl;
+  id_tag_bl.append(id_tag);
+  cls_rgw_guard_inline_entry(*op, key, id_tag_bl, -ECANCELED);
+  rgw_bucket_entry_ver ver;
+  ver.pool = ioctx.get_id();
+  rgw_bucket_dir_entry_meta meta;
+  cls_rgw_bucket_complete_op(*op, CLS_RGW_OP_DEL, tag, ver, key, meta, nullptr, true, 0, nullptr);
+  return ioctx.operate(oid, op);
+}
+
+TEST(cls_rgw, index_guard_inline_entry)
+{
+  string bucket_oid = str_int("bucket", 11);
+
+  OpMgr mgr;
+
+  ObjectWriteOperation *op = mgr.write_op();
+  cls_rgw_bucket_init_index(*op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  string obj = "obj";
+  ASSERT_EQ(0, put_inline(ioctx, bucket_oid, obj, "abc", CLS_RGW_PUT_INLINE_EXCLUSIVE, "put1"));
+
+  // a regular put replaces the inline entry after the delete read it
+  string tag = "tag";
+  string loc = "loc";
+  index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+  rgw_bucket_dir_entry_meta meta;
+  meta.category = RGWObjCategory::None;
+  meta.size = 1024;
+  index_complete(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, 1, obj, meta);
+
+  // so the delete of the inline object must leave the new entry alone
+  ASSERT_EQ(-ECANCELED, del_inline(mgr, ioctx, bucket_oid, obj, "put1"));
+  rgw_bucket_dir_entry entry;
+  get_entry(ioctx, bucket_oid, obj, &entry);
+  ASSERT_TRUE(entry.exists);
+  ASSERT_FALSE(entry.inline_data);
+  ASSERT_EQ(1024u, entry.meta.size);
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, 1, 1024);
+
+  // as must the delete of an inline object replaced by another inline put
+  string obj2 = "obj2";
+  ASSERT_EQ(0, put_inline(ioctx, bucket_oid, obj2, "de", CLS_RGW_PUT_INLINE_EXCLUSIVE, "put2"));
+  ASSERT_EQ(0, put_inline(ioctx, bucket_oid, obj2, "fgh", CLS_RGW_PUT_INLINE_REPLACE_INLINE, "put3"));
+  ASSERT_EQ(-ECANCELED, del_inline(mgr, ioctx, bucket_oid, obj2, "put2"));
+  get_entry(ioctx, bucket_oid, obj2, &entry);
+  ASSERT_EQ("fgh", entry.inline_data->data.to_str());
+
+  // a delete of the object that was read removes it
+  ASSERT_EQ(0, del_inline(mgr, ioctx, bucket_oid, obj2, "put3"));
+  test_stats(ioctx, bucket_oid, RGWObjCategory::None, 1, 1024);
+
+  // and a missing entry fails the guard too
+  ASSERT_EQ(-ECANCELED, del_inline(mgr, ioctx, bucket_oid, obj2, "put3"));
+}
+
 
 TEST(cls_rgw, bi_list)
 {
@@ -880,6 +1219,93 @@ TEST(cls_rgw, usage_basic)
   ASSERT_EQ(0, cls_rgw_usage_log_trim(ioctx, oid, "", bucket2, start_epoch, end_epoch));
 }
 
+TEST(cls_rgw, usage_daily)
+{
+  string oid = "usage.daily";
+  string user = "user1";
+  string payer;
+  const uint64_t day = 24 * 60 * 60;
+  const uint64_t start_epoch = 100 * day;
+  const uint64_t end_epoch = 102 * day;
+
+  // an entry per hour over two days, across two buckets
+  for (uint64_t hour = 0; hour < 48; hour++) {
+    rgw_usage_log_info info;
+    for (string bucket : {"bucket1", "bucket2"}) {
+      rgw_usage_log_entry entry(user, payer, bucket);
+      entry.epoch = start_epoch + hour * 3600;
+      rgw_usage_data data(hour, 2 * hour);
+      data.ops = 1;
+      data.successful_ops = 1;
+      entry.add("get_obj", data);
+      info.entries.push_back(entry);
+    }
+    ObjectWriteOperation op;
+    cls_rgw_usage_log_add(op, info);
+    ASSERT_EQ(0, ioctx.operate(oid, &op));
+  }
+
+  auto read = [&] (const string& user, uint64_t start, uint64_t end, bool daily) {
+    map<rgw_user_bucket, rgw_usage_log_entry> usage;
+    string read_iter;
+    bool truncated = true;
+    while (truncated) {
+      map<rgw_user_bucket, rgw_usage_log_entry> result;
+      EXPECT_EQ(0, cls_rgw_usage_log_read(ioctx, oid, user, "", start, end,
+                                          1000, read_iter, result, &truncated,
+                                          daily));
+      for (auto& [ub, entry] : result) {
+        usage[ub].aggregate(entry);
+      }
+    }
+    return usage;
+  };
+  auto ops = [] (const map<rgw_user_bucket, rgw_usage_log_entry>& usage) {
+    uint64_t ops = 0;
+    for (auto& [ub, entry] : usage) {
+      ops += entry.total_usage.ops;
+    }
+    return ops;
+  };
+  auto bytes_sent = [] (const map<rgw_user_bucket, rgw_usage_log_entry>& usage) {
+    uint64_t sent = 0;
+    for (auto& [ub, entry] : usage) {
+      sent += entry.total_usage.bytes_sent;
+    }
+    return sent;
+  };
+
+  for (const string& u : {user, string()}) {
+    auto hourly = read(u, start_epoch, end_epoch, false);
+    auto daily = read(u, start_epoch, end_epoch, true);
+    ASSERT_EQ(2u, daily.size());
+    ASSERT_EQ(96u, ops(hourly));
+    ASSERT_EQ(ops(hourly), ops(daily));
+    ASSERT_EQ(bytes_sent(hourly), bytes_sent(daily));
+
+    // the second day alone
+    hourly = read(u, start_epoch + day, end_epoch, false);
+    daily = read(u, start_epoch + day, end_epoch, true);
+    ASSERT_EQ(48u, ops(daily));
+    ASSERT_EQ(bytes_sent(hourly), bytes_sent(daily));
+  }
+
+  // a range that isn't made of whole days is read from the hourly records
+  ASSERT_EQ(2u, ops(read(user, start_epoch, start_epoch + 3600, true)));
+
+  // trimming hourly records takes them out of the rollups too
+  ASSERT_EQ(0, cls_rgw_usage_log_trim(ioctx, oid, user, "", start_epoch,
+                                      start_epoch + 6 * 3600));
+  auto hourly = read(user, start_epoch, end_epoch, false);
+  auto daily = read(user, start_epoch, end_epoch, true);
+  ASSERT_EQ(84u, ops(hourly));
+  ASSERT_EQ(ops(hourly), ops(daily));
+  ASSERT_EQ(bytes_sent(hourly), bytes_sent(daily));
+
+  ASSERT_EQ(0, cls_rgw_usage_log_trim(ioctx, oid, user, "", 0, (uint64_t)-1));
+  ASSERT_EQ(0u, read(user, start_epoch, end_epoch, true).size());
+}
+
 TEST(cls_rgw, usage_clear_no_obj)
 {
   string user="user1";
@@ -0,0 +1,172 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// a crimson counterpart of ceph_objectstore_bench: write an object (or
+// one object per job) in fixed size blocks, then read it back
+
+#include <boost/iterator/counting_iterator.hpp>
+#include <boost/program_options.hpp>
+
+#include <seastar/core/app-template.hh>
+#include <seastar/core/do_with.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/core/reactor.hh>
+#include <seastar/core/semaphore.hh>
+#include <seastar/core/thread.hh>
+
+#include "common/ceph_time.h"
+#include "crimson/common/config_proxy.h"
+#include "crimson/common/log.h"
+#include "crimson/os/cyan_collection.h"
+#include "crimson/os/futurized_store.h"
+#include "os/Transaction.h"
+
+namespace bpo = boost::program_options;
+
+namespace {
+
+seastar::logger& logger() {
+  return ceph::get_logger(ceph_subsys_filestore);
+}
+
+using ceph::os::FuturizedStore;
+using ceph::os::Transaction;
+
+struct bench_config {
+  std::string type;
+  std::string path;
+  uint64_t size;
+  uint64_t block_size;
+  unsigned repeats;
+  unsigned jobs;
+  unsigned depth;
+
+  static bench_config load(bpo::variables_map& options) {
+    bench_config conf;
+    conf.type = options["type"].as<std::string>();
+    conf.path = options["path"].as<std::string>();
+    conf.size = options["size"].as<uint64_t>();
+    conf.block_size = options["block-size"].as<uint64_t>();
+    conf.repeats = options["repeats"].as<unsigned>();
+    conf.jobs = options["jobs"].as<unsigned>();
+    conf.depth = options["depth"].as<unsigned>();
+    return conf;
+  }
+};
+
+// run @p op on every block of every job's object, keeping at most
+// conf.depth ops in flight
+template <typename Op>
+seastar::future<> for_each_block(const bench_config& conf, Op&& op)
+{
+  return seastar::do_with(seastar::semaphore{conf.depth}, std::move(op),
+    [&conf](auto& sem, auto& op) {
+    const uint64_t blocks = conf.size / conf.block_size;
+    return seastar::do_for_each(
+      boost::counting_iterator<uint64_t>(0),
+      boost::counting_iterator<uint64_t>(blocks * conf.jobs),
+      [&sem, &op, &conf, blocks](uint64_t i) {
+	return sem.wait(1).then([&sem, &op, &conf, blocks, i] {
+	  const unsigned job = i % conf.jobs;
+	  const uint64_t off = (i / conf.jobs) * conf.block_size;
+	  ceph_assert(off < blocks * conf.block_size);
+	  // not waited for here, the semaphore bounds the queue depth
+	  (void)op(job, off).finally([&sem] {
+	    sem.signal(1);
+	  });
+	});
+      }).then([&sem, &conf] {
+	return sem.wait(conf.depth);
+      });
+  });
+}
+
+void report(const char* what, const bench_config& conf,
+	    ceph::mono_clock::duration elapsed)
+{
+  const double secs = std::chrono::duration<double>(elapsed).count();
+  const uint64_t bytes = conf.size * conf.jobs;
+  const uint64_t ops = bytes / conf.block_size;
+  logger().info("{}: {} bytes in {} ops, {:.3f}s, {:.2f} MB/s, {:.0f} IOPS",
+		what, bytes, ops, secs, bytes / secs / (1 << 20), ops / secs);
+}
+
+seastar::future<> run(const bench_config& conf)
+{
+  return seastar::async([&conf] {
+    auto store = FuturizedStore::create(conf.type, conf.path);
+    store->mkfs().get();
+    store->mount().get();
+    const coll_t cid;
+    auto ch = store->create_new_collection(cid);
+    {
+      Transaction t;
+      t.create_collection(cid, 0);
+      store->do_transaction(ch, std::move(t)).get();
+    }
+    std::vector<ghobject_t> oids;
+    for (unsigned j = 0; j < conf.jobs; ++j) {
+      oids.emplace_back(hobject_t{sobject_t{fmt::format("job{}", j),
+					    CEPH_NOSNAP}});
+    }
+    bufferlist data;
+    data.append_zero(conf.block_size);
+    for (unsigned r = 0; r < conf.repeats; ++r) {
+      auto start = ceph::mono_clock::now();
+      for_each_block(conf, [&](unsigned job, uint64_t off) {
+	Transaction t;
+	t.write(cid, oids[job], off, data.length(), data);
+	return store->do_transaction(ch, std::move(t));
+      }).get();
+      report("write", conf, ceph::mono_clock::now() - start);
+    }
+    for (unsigned r = 0; r < conf.repeats; ++r) {
+      auto start = ceph::mono_clock::now();
+      for_each_block(conf, [&](unsigned job, uint64_t off) {
+	return store->read(ch, oids[job], off, conf.block_size).then(
+	  [&conf](bufferlist&& bl) {
+	  ceph_assert(bl.length() == conf.block_size);
+	});
+      }).get();
+      report("read", conf, ceph::mono_clock::now() - start);
+    }
+    store->umount().get();
+  });
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  seastar::app_template app;
+  app.add_options()
+    ("type", bpo::value<std::string>()->default_value("blockstore"),
+     "objectstore type: cyanstore or blockstore")
+    ("path", bpo::value<std::string>()->default_value("."),
+     "data directory, blockstore uses the file or device at $path/block")
+    ("size", bpo::value<uint64_t>()->default_value(1 << 30),
+     "total size in bytes written by each job")
+    ("block-size", bpo::value<uint64_t>()->default_value(4 << 10),
+     "block size in bytes for each write")
+    ("repeats", bpo::value<unsigned>()->default_value(1),
+     "number of times to repeat the write and read cycles")
+    ("jobs", bpo::value<unsigned>()->default_value(1),
+     "number of objects written concurrently")
+    ("depth", bpo::value<unsigned>()->default_value(64),
+     "number of ops in flight");
+  return app.run(argc, argv, [&app] {
+    auto&& config = app.configuration();
+    auto conf = bench_config::load(config);
+    return seastar::do_with(std::move(conf), [](auto& conf) {
+      return ceph::common::sharded_conf().start(
+	EntityName{}, string_view{"ceph"}).then([&conf] {
+	return run(conf);
+      }).finally([] {
+	return ceph::common::sharded_conf().stop();
+      });
+    }).handle_exception([] (auto eptr) {
+      logger().info("\nfailed!\n");
+      return seastar::make_exception_future<>(eptr);
+    });
+  });
+}
@@ -0,0 +1,426 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <stdlib.h>
+#include <iostream>
+#include <fmt/format.h>
+
+#include <seastar/core/app-template.hh>
+#include <seastar/core/sharded.hh>
+#include <seastar/core/thread.hh>
+
+#include "common/ceph_argparse.h"
+#include "crimson/common/config_proxy.h"
+#include "crimson/os/block_store.h"
+#include "crimson/os/cyan_collection.h"
+#include "crimson/os/sharded_block_store.h"
+#include "os/Transaction.h"
+
+using ceph::os::BlockStore;
+using ceph::os::ShardedBlockStore;
+using ceph::os::Transaction;
+using Config = ceph::common::ConfigProxy;
+
+namespace {
+
+void expect(bool cond, const std::string& what)
+{
+  if (!cond) {
+    throw std::runtime_error(what);
+  }
+}
+
+bufferlist make_data(uint64_t len, char seed)
+{
+  bufferlist bl;
+  for (uint64_t i = 0; i < len; ++i) {
+    bl.append(static_cast<char>(seed + i % 251));
+  }
+  return bl;
+}
+
+void do_txn(BlockStore& store, const coll_t& cid, Transaction&& t)
+{
+  store.do_transaction(store.open_collection(cid), std::move(t)).get();
+}
+
+// keep a copy of the expected contents and compare them with the store
+void verify(BlockStore& store, const coll_t& cid, const ghobject_t& oid,
+	    const bufferlist& expected)
+{
+  auto c = store.open_collection(cid);
+  expect(bool(c), "missing collection");
+  auto bl = store.read(c, oid, 0, 0).get0();
+  expect(bl.contents_equal(expected),
+	 fmt::format("{} contents mismatch, got {} bytes, expected {}",
+		     oid, bl.length(), expected.length()));
+}
+
+void test_block_store(const std::string& path)
+{
+  BlockStore store{path};
+  store.mkfs().get();
+  store.mount().get();
+  {
+    store.write_meta("key", "value").get();
+    auto [r, value] = store.read_meta("key").get();
+    expect(r == 0 && value == "value", "bad meta");
+    std::tie(r, value) = store.read_meta("nokey").get();
+    expect(r == -ENOENT, "unexpected meta");
+  }
+  const coll_t cid;
+  const ghobject_t oid{hobject_t{sobject_t{"obj", CEPH_NOSNAP}}};
+  bufferlist expected;
+  {
+    auto c = store.create_new_collection(cid);
+    Transaction t;
+    t.create_collection(cid, 0);
+    expected = make_data(10000, 'a');
+    t.write(cid, oid, 0, expected.length(), expected);
+    store.do_transaction(c, std::move(t)).get();
+  }
+  verify(store, cid, oid, expected);
+
+  // partial overwrite within a block, and across a block boundary
+  {
+    Transaction t;
+    auto bl = make_data(100, 'x');
+    t.write(cid, oid, 5000, bl.length(), bl);
+    auto bl2 = make_data(300, 'y');
+    t.write(cid, oid, 8100, bl2.length(), bl2);
+    do_txn(store, cid, std::move(t));
+    bufferlist e;
+    e.substr_of(expected, 0, 5000);
+    e.append(bl);
+    bufferlist rest;
+    rest.substr_of(expected, 5100, 3000);
+    e.append(rest);
+    e.append(bl2);
+    rest.substr_of(expected, 8400, expected.length() - 8400);
+    e.append(rest);
+    expected.swap(e);
+  }
+  verify(store, cid, oid, expected);
+
+  // shrink to the middle of a block, then grow again: the gap reads as zeros
+  {
+    Transaction t;
+    t.truncate(cid, oid, 6000);
+    auto bl = make_data(10, 'z');
+    t.write(cid, oid, 9000, bl.length(), bl);
+    do_txn(store, cid, std::move(t));
+    bufferlist e;
+    e.substr_of(expected, 0, 6000);
+    e.append_zero(3000);
+    e.append(bl);
+    expected.swap(e);
+  }
+  verify(store, cid, oid, expected);
+
+  {
+    Transaction t;
+    bufferlist v;
+    v.append("value");
+    t.setattr(cid, oid, "attr", v);
+    std::map<std::string, bufferlist> kv;
+    kv["key"] = v;
+    t.omap_setkeys(cid, oid, kv);
+    do_txn(store, cid, std::move(t));
+  }
+
+  // enough metadata updates to wrap the journal a few times
+  std::vector<ghobject_t> oids;
+  for (unsigned i = 0; i < 200; ++i) {
+    Transaction t;
+    ghobject_t o{hobject_t{sobject_t{fmt::format("obj{}", i), CEPH_NOSNAP}}};
+    auto bl = make_data(4096 * (i % 3 + 1), 'a' + i % 26);
+    t.write(cid, o, 0, bl.length(), bl);
+    if (i % 2) {
+      t.remove(cid, o);
+    } else {
+      oids.push_back(o);
+    }
+    do_txn(store, cid, std::move(t));
+  }
+
+  // omap changes are journaled as deltas, replayed on top of the checkpoint
+  const ghobject_t oid2{hobject_t{sobject_t{"omap", CEPH_NOSNAP}}};
+  const ghobject_t oid3{hobject_t{sobject_t{"recreated", CEPH_NOSNAP}}};
+  {
+    Transaction t;
+    bufferlist v;
+    v.append("value");
+    std::map<std::string, bufferlist> kv;
+    kv["k1"] = v;
+    kv["k2"] = v;
+    t.touch(cid, oid2);
+    t.omap_setkeys(cid, oid2, kv);
+    t.touch(cid, oid3);
+    t.omap_setkeys(cid, oid3, kv);
+    do_txn(store, cid, std::move(t));
+  }
+  {
+    Transaction t;
+    bufferlist v;
+    v.append("value2");
+    std::map<std::string, bufferlist> kv;
+    kv["k2"] = v;
+    kv["k3"] = v;
+    t.omap_setkeys(cid, oid2, kv);
+    t.omap_rmkeys(cid, oid2, std::set<std::string>{"k1", "k3"});
+    t.remove(cid, oid3);
+    t.touch(cid, oid3);
+    do_txn(store, cid, std::move(t));
+  }
+  oids.push_back(oid2);
+  oids.push_back(oid3);
+  const uint64_t used = store.get_used_bytes();
+  store.umount().get();
+
+  BlockStore store2{path};
+  store2.mount().get();
+  verify(store2, cid, oid, expected);
+  expect(store2.get_used_bytes() == used, "used bytes mismatch after remount");
+  auto c = store2.open_collection(cid);
+  auto attr = store2.get_attr(c, oid, "attr").get0();
+  expect(std::string(attr.c_str(), attr.length()) == "value", "bad xattr");
+  auto omap = store2.omap_get_values(c, oid, {"key", "nokey"}).get0();
+  expect(omap.size() == 1 && omap["key"].to_str() == "value", "bad omap");
+  omap = store2.omap_get_values(c, oid2, {"k1", "k2", "k3"}).get0();
+  expect(omap.size() == 1 && omap["k2"].to_str() == "value2",
+	 "bad omap after delta replay");
+  omap = store2.omap_get_values(c, oid3, {"k1", "k2"}).get0();
+  expect(omap.empty(), "omap of a removed object survived");
+  auto [objects, next] = store2.list_objects(c, ghobject_t{},
+					     ghobject_t::get_max(),
+					     1000).get();
+  expect(objects.size() == oids.size() + 1, "bad object listing");
+  expect(next == ghobject_t::get_max(), "bad listing end");
+  for (unsigned i = 0; i < oids.size() - 2; ++i) {
+    auto bl = store2.read(c, oids[i], 0, 0).get0();
+    expect(bl.length() == 4096 * (i * 2 % 3 + 1), "bad object size");
+  }
+  {
+    Transaction t;
+    t.remove(cid, oid);
+    for (auto& o : oids) {
+      t.remove(cid, o);
+    }
+    t.remove_collection(cid);
+    store2.do_transaction(c, std::move(t)).get();
+  }
+  expect(store2.get_used_bytes() == 0, "blocks leaked");
+  store2.umount().get();
+}
+
+// a transaction running out of space changes nothing, in memory or on disk
+void test_failed_transaction(const std::string& path)
+{
+  // the block map of an object filling the device takes a few hundred KiB
+  ceph::common::sharded_conf().invoke_on_all([](Config& config) {
+    return config.set_val("crimson_blockstore_journal_size", "1M");
+  }).get();
+  BlockStore store{path};
+  store.mkfs().get();
+  store.mount().get();
+  const coll_t cid;
+  const ghobject_t big{hobject_t{sobject_t{"big", CEPH_NOSNAP}}};
+  const ghobject_t oid{hobject_t{sobject_t{"obj", CEPH_NOSNAP}}};
+  const ghobject_t gone{hobject_t{sobject_t{"gone", CEPH_NOSNAP}}};
+  const ghobject_t added{hobject_t{sobject_t{"added", CEPH_NOSNAP}}};
+  const coll_t cid2{spg_t{pg_t{1, 0}}};
+  bufferlist v;
+  v.append("value");
+  auto data = make_data(3 * 4096 + 100, 'a');
+  {
+    auto c = store.create_new_collection(cid);
+    Transaction t;
+    t.create_collection(cid, 0);
+    // most of the device
+    bufferlist bl;
+    bl.append_zero(60 << 20);
+    t.write(cid, big, 0, bl.length(), bl);
+    t.write(cid, oid, 0, data.length(), data);
+    t.setattr(cid, oid, "attr", v);
+    std::map<std::string, bufferlist> kv;
+    kv["k1"] = v;
+    kv["k2"] = v;
+    t.omap_setkeys(cid, oid, kv);
+    t.omap_setheader(cid, oid, v);
+    t.touch(cid, gone);
+    t.omap_setkeys(cid, gone, kv);
+    store.do_transaction(c, std::move(t)).get();
+  }
+  const uint64_t used = store.get_used_bytes();
+
+  auto check = [&](BlockStore& store, const std::string& when) {
+    expect(store.get_used_bytes() == used, "used bytes changed " + when);
+    verify(store, cid, oid, data);
+    auto c = store.open_collection(cid);
+    auto attrs = store.get_attrs(c, oid).get0();
+    expect(attrs.size() == 1 && attrs.count("attr"), "bad xattrs " + when);
+    auto omap = store.omap_get_values(c, oid, {"k1", "k2", "k3"}).get0();
+    expect(omap.size() == 2 && omap["k1"].to_str() == "value" &&
+	   omap["k2"].to_str() == "value", "bad omap " + when);
+    omap = store.omap_get_values(c, gone, {"k1", "k2"}).get0();
+    expect(omap.size() == 2, "bad omap of a removed object " + when);
+    auto [objects, next] = store.list_objects(c, ghobject_t{},
+					      ghobject_t::get_max(),
+					      1000).get();
+    expect(objects.size() == 3, "bad object listing " + when);
+    expect(!store.open_collection(cid2), "collection created " + when);
+  };
+
+  {
+    store.create_new_collection(cid2);
+    Transaction t;
+    t.create_collection(cid2, 0);
+    t.touch(cid2, added);
+    // overwrites some blocks, releasing the old ones
+    auto bl = make_data(5000, 'x');
+    t.write(cid, oid, 1000, bl.length(), bl);
+    t.truncate(cid, oid, 2000);
+    t.rmattr(cid, oid, "attr");
+    std::map<std::string, bufferlist> kv;
+    kv["k2"] = bl;
+    kv["k3"] = bl;
+    t.omap_setkeys(cid, oid, kv);
+    t.omap_rmkeys(cid, oid, std::set<std::string>{"k1"});
+    t.omap_clear(cid, oid);
+    t.omap_setkeys(cid, oid, kv);
+    t.remove(cid, gone);
+    t.touch(cid, added);
+    // and does not fit
+    bufferlist huge;
+    huge.append_zero(8 << 20);
+    t.write(cid, added, 0, huge.length(), huge);
+    bool failed = false;
+    try {
+      do_txn(store, cid, std::move(t));
+    } catch (std::exception&) {
+      failed = true;
+    }
+    expect(failed, "transaction did not run out of space");
+  }
+  check(store, "after rollback");
+
+  // the store is still usable, and nothing of the failed transaction is
+  // journaled along with the next one
+  {
+    Transaction t;
+    t.setattr(cid, big, "attr", v);
+    do_txn(store, cid, std::move(t));
+  }
+  store.umount().get();
+
+  BlockStore store2{path};
+  store2.mount().get();
+  check(store2, "after remount");
+  store2.umount().get();
+}
+
+// collections spread over the shards, each in its own slice of the device
+void test_sharded_block_store(const std::string& path)
+{
+  const unsigned nshards = seastar::smp::count;
+  ceph::common::sharded_conf().invoke_on_all([nshards](Config& config) {
+    return config.set_val("crimson_blockstore_journal_size",
+			  fmt::format("{}", nshards * 128 * 1024));
+  }).get();
+  std::vector<coll_t> cids{coll_t::meta()};
+  for (unsigned ps = 0; ps < 2 * nshards + 1; ++ps) {
+    cids.emplace_back(spg_t{pg_t{ps, 1}});
+  }
+  const ghobject_t oid{hobject_t{sobject_t{"obj", CEPH_NOSNAP}}};
+  auto data_of = [](unsigned i) {
+    return make_data(4096 + i * 100, 'a' + i % 26);
+  };
+  {
+    ShardedBlockStore store{path};
+    store.mkfs().get();
+    store.mount().get();
+    for (unsigned i = 0; i < cids.size(); ++i) {
+      auto c = store.create_new_collection(cids[i]);
+      Transaction t;
+      t.create_collection(cids[i], i % 8);
+      auto bl = data_of(i);
+      t.write(cids[i], oid, 0, bl.length(), bl);
+      std::map<std::string, bufferlist> kv;
+      kv["key"].append(fmt::format("{}", i));
+      t.omap_setkeys(cids[i], oid, kv);
+      store.do_transaction(c, std::move(t)).get();
+      expect(store.open_collection(cids[i]) == c, "collection not opened");
+    }
+    // a pg removed along with its objects
+    {
+      auto c = store.open_collection(cids.back());
+      Transaction t;
+      t.remove(cids.back(), oid);
+      t.remove_collection(cids.back());
+      store.do_transaction(c, std::move(t)).get();
+      expect(!c->exists && !store.open_collection(cids.back()),
+	     "collection not removed");
+      cids.pop_back();
+    }
+    expect(store.list_collections().size() == cids.size(),
+	   "bad collection listing");
+    store.umount().get();
+  }
+  ShardedBlockStore store{path};
+  store.mount().get();
+  expect(store.list_collections().size() == cids.size(),
+	 "bad collection listing after remount");
+  for (unsigned i = 0; i < cids.size(); ++i) {
+    auto c = store.open_collection(cids[i]);
+    expect(bool(c), fmt::format("missing collection {}", cids[i]));
+    expect(c->bits == int(i % 8), "bad collection bits");
+    auto bl = store.read(c, oid, 0, 0).get0();
+    expect(bl.contents_equal(data_of(i)),
+	   fmt::format("bad contents in {}", cids[i]));
+    auto omap = store.omap_get_values(c, oid, {"key"}).get0();
+    expect(omap.size() == 1 && omap["key"].to_str() == fmt::format("{}", i),
+	   fmt::format("bad omap in {}", cids[i]));
+  }
+  store.umount().get();
+}
+
+seastar::future<> test(const std::string& path)
+{
+  return ceph::common::sharded_conf().start(EntityName{},
+					    string_view{"ceph"}).then([] {
+    return ceph::common::sharded_conf().invoke_on_all([](Config& config) {
+      return config.set_val("crimson_blockstore_size", "64M").then([&config] {
+	// small enough for the test to switch journal halves
+	return config.set_val("crimson_blockstore_journal_size", "256K");
+      });
+    });
+  }).then([path] {
+    return seastar::async([path] {
+      test_block_store(path);
+      test_failed_transaction(path);
+      test_sharded_block_store(path);
+    });
+  }).finally([] {
+    return ceph::common::sharded_conf().stop();
+  });
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  char tmpl[] = "/tmp/test_block_store.XXXXXX";
+  std::string path = mkdtemp(tmpl);
+  seastar::app_template app;
+  int r = app.run(argc, argv, [&] {
+    return test(path).then([] {
+      std::cout << "All tests succeeded" << std::endl;
+    }).handle_exception([] (auto eptr) {
+      std::cout << "Test failure" << std::endl;
+      return seastar::make_exception_future<>(eptr);
+    });
+  });
+  std::string cmd = "rm -rf " + path;
+  std::ignore = system(cmd.c_str());
+  return r;
+}
@@ -0,0 +1,252 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+// measure how fast FileStore replays its journal at mount, for a range
+// of journal_replay_threads values
+//
+// for each thread count, a fresh store is created with a number of
+// collections, and a journal is filled with entries writing to their
+// objects as if the OSD had crashed before applying any of them.  the
+// time spent in the following mount is what we report.
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+#include "common/Cond.h"
+#include "common/Finisher.h"
+#include "common/ceph_argparse.h"
+#include "common/errno.h"
+#include "global/global_init.h"
+#include "include/str_list.h"
+#include "os/ObjectStore.h"
+#include "os/filestore/FileJournal.h"
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_filestore
+
+static void usage()
+{
+  cout << "usage: ceph_bench_filestore_replay [flags] <data dir> <journal>\n"
+      "	 --collections\n"
+      "	       number of collections written to (default 16)\n"
+      "	 --objects\n"
+      "	       number of objects per collection (default 16)\n"
+      "	 --entries\n"
+      "	       number of journal entries to replay (default 10000)\n"
+      "	 --block-size\n"
+      "	       bytes written by each entry (default 4096)\n"
+      "	 --threads\n"
+      "	       comma separated journal_replay_threads values (default 1,4)\n"
+       << std::endl;
+  generic_server_usage();
+}
+
+struct Config {
+  string data;
+  string journal;
+  unsigned collections = 16;
+  unsigned objects = 16;
+  uint64_t entries = 10000;
+  uint64_t block_size = 4096;
+  vector<int> threads = {1, 4};
+};
+
+static coll_t make_cid(unsigned i)
+{
+  return coll_t(spg_t(pg_t(i, 1), shard_id_t::NO_SHARD));
+}
+
+static ghobject_t make_oid(unsigned coll, unsigned i)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "replay_bench_%u", i);
+  return ghobject_t(hobject_t(name, "", CEPH_NOSNAP, coll, 1, ""));
+}
+
+static uint64_t read_committed_seq(const string& data)
+{
+  std::ifstream f(data + "/current/commit_op_seq");
+  uint64_t seq = 0;
+  f >> seq;
+  return seq;
+}
+
+// create a store with the configured collections, and return its fsid
+// and last committed op seq
+static int prepare_store(const Config& cfg, uuid_d *fsid, uint64_t *seq)
+{
+  string cmd = "rm -rf " + cfg.data + " && mkdir -p " + cfg.data;
+  int r = ::system(cmd.c_str());
+  if (r != 0) {
+    derr << "failed to reset " << cfg.data << dendl;
+    return -EIO;
+  }
+  std::unique_ptr<ObjectStore> store(
+    ObjectStore::create(g_ceph_context, "filestore", cfg.data, cfg.journal));
+  r = store->mkfs();
+  if (r < 0) {
+    derr << "mkfs failed: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  r = store->mount();
+  if (r < 0) {
+    derr << "mount failed: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  for (unsigned i = 0; i < cfg.collections; ++i) {
+    const coll_t cid = make_cid(i);
+    auto ch = store->create_new_collection(cid);
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    for (unsigned j = 0; j < cfg.objects; ++j) {
+      t.touch(cid, make_oid(i, j));
+    }
+    store->queue_transaction(ch, std::move(t));
+  }
+  *fsid = store->get_fsid();
+  store->umount();
+  *seq = read_committed_seq(cfg.data);
+  return 0;
+}
+
+// append cfg.entries entries after @p seq to the journal
+static int fill_journal(const Config& cfg, const uuid_d& fsid, uint64_t seq)
+{
+  Finisher finisher(g_ceph_context);
+  Cond sync_cond;
+  FileJournal journal(g_ceph_context, fsid, &finisher, &sync_cond,
+		      cfg.journal.c_str(), g_conf()->journal_dio,
+		      g_conf()->journal_aio, g_conf()->journal_force_aio);
+  int r = journal.open(seq);
+  if (r < 0) {
+    derr << "failed to open journal: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  {
+    bufferlist bl;
+    uint64_t last = seq;
+    while (journal.read_entry(bl, last)) {
+      bl.clear();
+    }
+  }
+  r = journal.make_writeable();
+  if (r < 0) {
+    derr << "failed to make journal writeable: " << cpp_strerror(r) << dendl;
+    journal.close();
+    return r;
+  }
+  finisher.start();
+
+  bufferlist data;
+  data.append_zero(cfg.block_size);
+  bufferlist attr;
+  attr.append_zero(256);
+  C_SaferCond committed;
+  C_GatherBuilder gather(g_ceph_context, &committed);
+  for (uint64_t i = 0; i < cfg.entries; ++i) {
+    // like an OSD write: the data and an object info update
+    const unsigned coll = i % cfg.collections;
+    const coll_t cid = make_cid(coll);
+    const ghobject_t oid = make_oid(coll, (i / cfg.collections) % cfg.objects);
+    vector<ObjectStore::Transaction> tls(1);
+    tls[0].write(cid, oid, (i * cfg.block_size) % (4 << 20),
+		 data.length(), data);
+    tls[0].setattr(cid, oid, "_", attr);
+    bufferlist tbl;
+    int orig_len = journal.prepare_entry(tls, &tbl);
+    journal.reserve_throttle_and_backoff(tbl.length());
+    journal.submit_entry(seq + 1 + i, tbl, orig_len, gather.new_sub());
+  }
+  gather.activate();
+  committed.wait();
+  journal.close();
+  finisher.stop();
+  return 0;
+}
+
+static int run(const Config& cfg, int threads)
+{
+  uuid_d fsid;
+  uint64_t seq;
+  int r = prepare_store(cfg, &fsid, &seq);
+  if (r < 0)
+    return r;
+  r = fill_journal(cfg, fsid, seq);
+  if (r < 0)
+    return r;
+
+  g_conf().set_val_or_die("journal_replay_threads", std::to_string(threads));
+  g_conf().apply_changes(nullptr);
+  std::unique_ptr<ObjectStore> store(
+    ObjectStore::create(g_ceph_context, "filestore", cfg.data, cfg.journal));
+  using namespace std::chrono;
+  auto start = steady_clock::now();
+  r = store->mount();
+  auto elapsed = duration<double>(steady_clock::now() - start).count();
+  if (r < 0) {
+    derr << "mount failed: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  store->umount();
+  std::cout << "threads " << threads << ": replayed " << cfg.entries
+	    << " entries in " << elapsed << "s, "
+	    << cfg.entries / elapsed << " entries/s" << std::endl;
+  return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_witharg(args, i, &val, "--collections", (char*)nullptr)) {
+      cfg.collections = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)nullptr)) {
+      cfg.objects = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--entries", (char*)nullptr)) {
+      cfg.entries = atoll(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--block-size", (char*)nullptr)) {
+      cfg.block_size = atoll(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)nullptr)) {
+      vector<string> v;
+      get_str_vec(val, ",", v);
+      cfg.threads.clear();
+      for (auto& s : v) {
+	cfg.threads.push_back(atoi(s.c_str()));
+      }
+    } else {
+      ++i;
+    }
+  }
+  if (args.size() != 2 || cfg.collections == 0 || cfg.objects == 0 ||
+      cfg.threads.empty()) {
+    usage();
+    exit(1);
+  }
+  cfg.data = args[0];
+  cfg.journal = args[1];
+
+  common_init_finish(g_ceph_context);
+
+  for (int threads : cfg.threads) {
+    if (run(cfg, threads) < 0)
+      return 1;
+  }
+  return 0;
+}
@@ -620,6 +620,74 @@ TEST(BlueFS, test_replay) {
   rm_temp_bdev(fn);
 }
 
+TEST(BlueFS, test_migrate_hot_files) {
+  uint64_t size = 1048576 * 128;
+  string fn_db = get_temp_bdev(size);
+  string fn_slow = get_temp_bdev(size);
+  g_ceph_context->_conf.set_val(
+    "bluefs_alloc_size",
+    "65536");
+  g_ceph_context->_conf.set_val(
+    "bluefs_migrate_min_heat",
+    "1048576");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, fn_db, false));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_SLOW, fn_slow, false));
+  fs.add_block_extent(BlueFS::BDEV_SLOW, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid));
+  ASSERT_EQ(0, fs.mount());
+
+  uint64_t len = 4 * 1048576;
+  auto buf = gen_buffer(len);
+  {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.mkdir("db.slow"));
+    ASSERT_EQ(0, fs.open_for_write("db.slow", "000001.sst", &h, false));
+    h->append(buf.get(), len);
+    fs.fsync(h);
+    fs.close_writer(h);
+  }
+  uint64_t slow_free = fs.get_free(BlueFS::BDEV_SLOW);
+  uint64_t db_free = fs.get_free(BlueFS::BDEV_DB);
+
+  // a file nobody reads stays where it is
+  ASSERT_EQ(0u, fs.migrate_hot_files());
+
+  BlueFS::FileReader *h;
+  ASSERT_EQ(0, fs.open_for_read("db.slow", "000001.sst", &h, true));
+  std::unique_ptr<char[]> out = std::make_unique<char[]>(len);
+  ASSERT_EQ((int)len, fs.read_random(h, 0, len, out.get()));
+
+  uint64_t moved = fs.migrate_hot_files();
+  ASSERT_GE(moved, len);
+  ASSERT_EQ(slow_free + moved, fs.get_free(BlueFS::BDEV_SLOW));
+  ASSERT_GE(db_free - moved, fs.get_free(BlueFS::BDEV_DB));
+
+  // data is intact and is now served from the db device
+  memset(out.get(), 0, len);
+  ASSERT_EQ((int)len, fs.read_random(h, 0, len, out.get()));
+  ASSERT_EQ(0, memcmp(buf.get(), out.get(), len));
+  delete h;
+
+  // the new placement survives a remount
+  fs.umount();
+  ASSERT_EQ(0, fs.mount());
+  ASSERT_EQ(0, fs.open_for_read("db.slow", "000001.sst", &h, true));
+  memset(out.get(), 0, len);
+  ASSERT_EQ((int)len, fs.read_random(h, 0, len, out.get()));
+  ASSERT_EQ(0, memcmp(buf.get(), out.get(), len));
+  delete h;
+  fs.umount();
+
+  g_ceph_context->_conf.rm_val("bluefs_migrate_min_heat");
+  rm_temp_bdev(fn_db);
+  rm_temp_bdev(fn_slow);
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
@@ -7,6 +7,7 @@
 #include "include/stringify.h"
 #include "common/ceph_time.h"
 #include "os/bluestore/BlueStore.h"
+#include "os/bluestore/CompressedCache.h"
 #include "common/ceph_argparse.h"
 #include "global/global_init.h"
 #include "global/global_context.h"
@@ -1542,6 +1543,73 @@ TEST(BlueStoreRepairer, StoreSpaceTracker)
   ASSERT_TRUE(bmap2.is_used(hoid, 0x3223b19ffff));
 }
 
+TEST(CompressedCache, basic)
+{
+  CompressedCache cache(g_ceph_context, 4);
+
+  bluestore_blob_t b1;
+  b1.allocated_test(bluestore_pextent_t(0x10000, 0x2000));
+  b1.set_compressed(0x10000, 0x1800);
+  bluestore_blob_t b2;
+  b2.allocated_test(bluestore_pextent_t(0x40000, 0x1000));
+  b2.allocated_test(bluestore_pextent_t(0x80000, 0x1000));
+  b2.set_compressed(0x8000, 0x2000);
+
+  bufferlist bl1, bl2, out;
+  bl1.append(string(0x1800, 'a'));
+  bl2.append(string(0x2000, 'b'));
+
+  // disabled until it is given a size
+  ASSERT_FALSE(cache.enabled());
+  cache.insert(b1, bl1);
+  ASSERT_EQ(0u, cache.get_num_entries());
+
+  cache.trim(0x100000);
+  ASSERT_TRUE(cache.enabled());
+  cache.insert(b1, bl1);
+  cache.insert(b2, bl2);
+  ASSERT_EQ(2u, cache.get_num_entries());
+  ASSERT_EQ(0x3800u, cache.get_bytes());
+  ASSERT_TRUE(cache.lookup(b1, &out));
+  ASSERT_TRUE(out.contents_equal(bl1));
+  ASSERT_TRUE(cache.lookup(b2, &out));
+  ASSERT_TRUE(out.contents_equal(bl2));
+
+  // uncompressed blobs are never cached
+  bluestore_blob_t b3;
+  b3.allocated_test(bluestore_pextent_t(0x20000, 0x1000));
+  ASSERT_FALSE(cache.lookup(b3, &out));
+
+  // a different blob at the same location is a miss
+  bluestore_blob_t b4;
+  b4.allocated_test(bluestore_pextent_t(0x10000, 0x1000));
+  b4.set_compressed(0x10000, 0x800);
+  ASSERT_FALSE(cache.lookup(b4, &out));
+  ASSERT_EQ(1u, cache.get_num_entries());
+  ASSERT_EQ(0x2000u, cache.get_bytes());
+
+  // releasing the space of a blob drops it
+  cache.insert(b1, bl1);
+  interval_set<uint64_t> released;
+  released.insert(0x40000, 0x1000);
+  cache.invalidate(released);
+  ASSERT_FALSE(cache.lookup(b2, &out));
+  ASSERT_TRUE(cache.lookup(b1, &out));
+  ASSERT_EQ(0x1800u, cache.get_bytes());
+
+  // shrinking evicts
+  cache.insert(b2, bl2);
+  cache.trim(0x1000);
+  ASSERT_EQ(0u, cache.get_num_entries());
+  ASSERT_EQ(0u, cache.get_bytes());
+
+  cache.trim(0x100000);
+  cache.insert(b1, bl1);
+  cache.clear();
+  ASSERT_EQ(0u, cache.get_num_entries());
+  ASSERT_FALSE(cache.lookup(b1, &out));
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
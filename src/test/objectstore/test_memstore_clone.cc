@@ -180,6 +180,105 @@ TEST_F(MemStoreClone, CloneRangeHoleEnd)
   ASSERT_EQ(expected, result);
 }
 
+// the same with memstore_page_set, where whole pages are shared with the
+// clone until either side writes to them
+class MemStorePageSetClone : public MemStoreClone {
+public:
+  void SetUp() override {
+    SetVal(g_conf(), "memstore_page_set", "true");
+    MemStoreClone::SetUp();
+  }
+};
+
+// src 11 22 33
+// dst 11 22 33, then src 11 xx 33 and dst 11 22 3_
+TEST_F(MemStorePageSetClone, CloneCopyOnWrite)
+{
+  ASSERT_TRUE(store);
+
+  const auto src = make_ghobject("src1");
+  const auto dst = make_ghobject("dst1");
+
+  bufferlist srcbl, xbl, result, expected;
+  srcbl.append("111122223333");
+  xbl.append("xxxx");
+
+  ObjectStore::Transaction t;
+  t.write(cid, src, 0, 12, srcbl);
+  t.clone(cid, src, dst);
+  ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  ASSERT_EQ(12, store->read(ch, dst, 0, 12, result));
+  ASSERT_EQ(srcbl, result);
+
+  ObjectStore::Transaction t2;
+  t2.write(cid, src, 4, 4, xbl);
+  t2.truncate(cid, dst, 9);
+  ASSERT_EQ(0, store->queue_transaction(ch, std::move(t2)));
+  result.clear();
+  expected.append("1111xxxx3333");
+  ASSERT_EQ(12, store->read(ch, src, 0, 12, result));
+  ASSERT_EQ(expected, result);
+  result.clear();
+  expected.clear();
+  expected.append("111122223");
+  ASSERT_EQ(9, store->read(ch, dst, 0, 12, result));
+  ASSERT_EQ(expected, result);
+}
+
+// src 11[11 11 11 11]11
+// dst 22 22 22 22 22 22
+// res 22 11 11 11 11 22
+TEST_F(MemStorePageSetClone, CloneRangePartialPages)
+{
+  ASSERT_TRUE(store);
+
+  const auto src = make_ghobject("src1");
+  const auto dst = make_ghobject("dst1");
+
+  bufferlist srcbl, dstbl, result, expected;
+  srcbl.append("111111111111");
+  dstbl.append("222222222222");
+  expected.append("221111111122");
+
+  ObjectStore::Transaction t;
+  t.write(cid, src, 0, 12, srcbl);
+  t.write(cid, dst, 0, 12, dstbl);
+  t.clone_range(cid, src, dst, 2, 8, 2);
+  ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  ASSERT_EQ(12, store->read(ch, dst, 0, 12, result));
+  ASSERT_EQ(expected, result);
+}
+
+// src 11 22 3_
+// dst 11 22 3_, then dst 11 22 34 4_ with src unchanged
+TEST_F(MemStorePageSetClone, ClonePartialLastPage)
+{
+  ASSERT_TRUE(store);
+
+  const auto src = make_ghobject("src1");
+  const auto dst = make_ghobject("dst1");
+
+  bufferlist srcbl, abl, result, expected;
+  srcbl.append("111122223");
+  abl.append("44");
+
+  ObjectStore::Transaction t;
+  t.write(cid, src, 0, 9, srcbl);
+  t.clone(cid, src, dst);
+  t.write(cid, dst, 9, 2, abl);
+  t.truncate(cid, src, 12);
+  ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  expected.append("11112222344");
+  ASSERT_EQ(11, store->read(ch, dst, 0, 12, result));
+  ASSERT_EQ(expected, result);
+  result.clear();
+  expected.clear();
+  expected.append("111122223");
+  expected.append_zero(3);
+  ASSERT_EQ(12, store->read(ch, src, 0, 12, result));
+  ASSERT_EQ(expected, result);
+}
+
 int main(int argc, char** argv)
 {
   // default to memstore
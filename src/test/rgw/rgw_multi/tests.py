@@ -670,6 +670,58 @@ def test_object_delete():
             zone_bucket_checkpoint(target_conn.zone, source_conn.zone, bucket.name)
             check_bucket_eq(source_conn, target_conn, bucket)
 
+def test_inline_object():
+    zonegroup = realm.master_zonegroup()
+    zonegroup_conns = ZonegroupConns(zonegroup)
+    zone_conn = zonegroup_conns.master_zone
+
+    # buckets created while rgw_inline_data_max_size is set store their small
+    # objects in the index entries
+    zone_conn.zone.stop()
+    zone_conn.zone.start(['--rgw-inline-data-max-size=4096'])
+    try:
+        bucket_name = gen_bucket_name()
+        bucket = zone_conn.create_bucket(bucket_name)
+        objname = 'myobj'
+        small = 'a' * 100
+        large = 'b' * 8192
+
+        def check_contents(content):
+            k = get_key(zone_conn, bucket_name, objname)
+            eq(k.get_contents_as_string(encoding='ascii'), content)
+            keys = list(bucket.list())
+            eq(len(keys), 1)
+            eq(keys[0].size, len(content))
+
+        k = new_key(zone_conn, bucket_name, objname)
+        k.set_contents_from_string(small)
+        check_contents(small)
+
+        # an inline object is replaced by another
+        k.set_contents_from_string(small[::-1] + 'c')
+        check_contents(small[::-1] + 'c')
+
+        # or by a larger object with a head object, which a small object
+        # then replaces as usual
+        k.set_contents_from_string(large)
+        check_contents(large)
+        k.set_contents_from_string(small)
+        check_contents(small)
+
+        zonegroup_meta_checkpoint(zonegroup)
+        for target_conn in zonegroup_conns.zones:
+            if target_conn.zone == zone_conn.zone:
+                continue
+            zone_bucket_checkpoint(target_conn.zone, zone_conn.zone, bucket_name)
+            check_bucket_eq(zone_conn, target_conn, bucket)
+
+        k.delete()
+        eq(get_key(zone_conn, bucket_name, objname), None)
+        eq(len(list(bucket.list())), 0)
+    finally:
+        zone_conn.zone.stop()
+        zone_conn.zone.start()
+
 def get_latest_object_version(key):
     for k in key.bucket.list_versions(key.name):
         if k.is_latest:
@@ -13,11 +13,91 @@
  */
 #include "rgw/rgw_rados.h"
 #include "rgw/rgw_http_client.h"
+#include "rgw/rgw_perf_counters.h"
 #include "global/global_init.h"
 #include "common/ceph_argparse.h"
+#include <atomic>
+#include <thread>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
 #include <curl/curl.h>
 #include <gtest/gtest.h>
 
+namespace {
+
+using tcp = boost::asio::ip::tcp;
+
+// http server on a local port that answers every request with an empty 200,
+// keeping the connection open. counts the connections it accepts. it runs
+// on a single thread, which its destructor stops and joins
+class KeepAliveServer {
+  boost::asio::io_context context;
+  tcp::acceptor acceptor;
+  std::thread thread;
+  std::atomic<size_t> connections{0};
+
+  struct Connection : std::enable_shared_from_this<Connection> {
+    static constexpr std::string_view response =
+        "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+    tcp::socket socket;
+    boost::asio::streambuf buf;
+
+    explicit Connection(tcp::socket&& socket) : socket(std::move(socket)) {}
+
+    void read() {
+      boost::asio::async_read_until(socket, buf, "\r\n\r\n",
+          [self = shared_from_this()] (boost::system::error_code ec, size_t n) {
+            if (ec) {
+              return;
+            }
+            self->buf.consume(n);
+            self->write();
+          });
+    }
+    void write() {
+      boost::asio::async_write(socket, boost::asio::buffer(response),
+          [self = shared_from_this()] (boost::system::error_code ec, size_t) {
+            if (ec) {
+              return;
+            }
+            self->read();
+          });
+    }
+  };
+
+  void accept() {
+    acceptor.async_accept([this] (boost::system::error_code ec, tcp::socket socket) {
+        if (ec) {
+          return;
+        }
+        ++connections;
+        std::make_shared<Connection>(std::move(socket))->read();
+        accept();
+      });
+  }
+ public:
+  KeepAliveServer()
+    : acceptor(context, tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0))
+  {
+    accept();
+    thread = std::thread([this] { context.run(); });
+  }
+  ~KeepAliveServer() {
+    // the connections are dropped with the handlers that hold them
+    context.stop();
+    thread.join();
+  }
+
+  std::string url() const {
+    return "http://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port());
+  }
+  size_t num_connections() const { return connections; }
+};
+
+} // anonymous namespace
+
 TEST(HTTPManager, SignalThread)
 {
   auto cct = g_ceph_context;
@@ -43,6 +123,29 @@ TEST(HTTPManager, SignalThread)
   }
 }
 
+TEST(HTTPManager, ConnectionReuse)
+{
+  auto cct = g_ceph_context;
+  KeepAliveServer server;
+
+  const uint64_t reqs_before = perfcounter->get(l_rgw_http_req);
+  const uint64_t reused_before = perfcounter->get(l_rgw_http_conn_reused);
+
+  constexpr size_t num_requests = 32;
+  for (size_t i = 0; i < num_requests; i++) {
+    RGWHTTPClient client{cct, "GET", server.url()};
+    ASSERT_EQ(0, RGWHTTP::process(&client, null_yield));
+    EXPECT_EQ(200, client.get_http_status());
+  }
+
+  // each manager thread opens at most one connection for sequential requests
+  const auto threads = cct->_conf.get_val<uint64_t>("rgw_http_client_threads");
+  EXPECT_LE(server.num_connections(), threads);
+  EXPECT_EQ(num_requests, perfcounter->get(l_rgw_http_req) - reqs_before);
+  EXPECT_EQ(num_requests - server.num_connections(),
+            perfcounter->get(l_rgw_http_conn_reused) - reused_before);
+}
+
 int main(int argc, char** argv)
 {
   vector<const char*> args;
@@ -53,11 +156,13 @@ int main(int argc, char** argv)
 			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
   common_init_finish(g_ceph_context);
 
+  rgw_perf_start(g_ceph_context);
   rgw_http_client_init(cct->get());
   rgw_setup_saved_curl_handles();
   ::testing::InitGoogleTest(&argc, argv);
   int r = RUN_ALL_TESTS();
   rgw_release_all_curl_handles();
   rgw_http_client_cleanup();
+  rgw_perf_stop(g_ceph_context);
   return r;
 }
@@ -0,0 +1,210 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "rgw/rgw_bucket_list.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <gtest/gtest.h>
+
+namespace {
+
+// a synthetic bucket index, with names hashed to shards
+struct FakeIndex {
+  // only the names are kept, entries are built when listed
+  std::vector<std::vector<std::string>> shards;
+  std::map<int, std::string> oids;
+  uint64_t requests = 0;
+
+  FakeIndex(unsigned num_shards, unsigned num_objects,
+	    std::function<unsigned(unsigned)> shard_of = nullptr)
+    : shards(num_shards)
+  {
+    for (unsigned i = 0; i < num_shards; ++i) {
+      oids[i] = "shard." + std::to_string(i);
+    }
+    for (unsigned i = 0; i < num_objects; ++i) {
+      char name[32];
+      snprintf(name, sizeof(name), "obj%08u", i);
+      const unsigned shard = shard_of ? shard_of(i) :
+	std::hash<std::string>{}(name) % num_shards;
+      shards[shard].push_back(name);
+    }
+    for (auto& shard : shards) {
+      std::sort(shard.begin(), shard.end());
+    }
+  }
+
+  // list up to num_entries entries after start, like rgw_bucket_list
+  int list(const cls_rgw_obj_key& start, uint32_t num_entries,
+	   std::map<int, std::string>& shard_oids,
+	   std::map<int, rgw_cls_list_ret>& results) {
+    for (auto& [id, oid] : shard_oids) {
+      ++requests;
+      auto& shard = shards[id];
+      auto& ret = results[id];
+      auto i = std::upper_bound(shard.begin(), shard.end(), start.name);
+      for (; i != shard.end() && ret.dir.m.size() < num_entries; ++i) {
+	auto& entry = ret.dir.m[*i];
+	entry.key.name = *i;
+	entry.exists = true;
+      }
+      ret.is_truncated = (i != shard.end());
+    }
+    return 0;
+  }
+
+  rgw::BucketListMerge make_merge(uint32_t num_entries,
+				  uint32_t min_shard_entries) {
+    return rgw::BucketListMerge(
+      oids, num_entries, min_shard_entries,
+      [this](const cls_rgw_obj_key& start, uint32_t num_entries,
+	     std::map<int, std::string>& shard_oids,
+	     std::map<int, rgw_cls_list_ret>& results) {
+	return list(start, num_entries, shard_oids, results);
+      });
+  }
+};
+
+// list a page of up to max entries after marker
+std::vector<std::string> list_page(rgw::BucketListMerge& merge,
+				   const std::string& marker, uint32_t max,
+				   bool *truncated)
+{
+  std::vector<std::string> names;
+  EXPECT_EQ(0, merge.init(cls_rgw_obj_key(marker)));
+  while (names.size() < max) {
+    const std::string *key;
+    rgw_bucket_dir_entry *entry;
+    const std::string *oid;
+    int r = merge.peek(&key, &entry, &oid);
+    if (r == -ENOENT) {
+      break;
+    }
+    EXPECT_EQ(0, r);
+    EXPECT_EQ(*key, entry->key.name);
+    names.push_back(entry->key.name);
+    merge.pop();
+  }
+  *truncated = merge.is_truncated();
+  return names;
+}
+
+std::vector<std::string> list_all(FakeIndex& index, uint32_t max,
+				  uint32_t min_shard_entries)
+{
+  std::vector<std::string> names;
+  bool truncated = true;
+  while (truncated) {
+    auto merge = index.make_merge(max, min_shard_entries);
+    auto page = list_page(merge, names.empty() ? "" : names.back(), max,
+			  &truncated);
+    EXPECT_TRUE(page.size() == max || !truncated);
+    names.insert(names.end(), page.begin(), page.end());
+  }
+  return names;
+}
+
+std::vector<std::string> expected_names(const FakeIndex& index)
+{
+  std::vector<std::string> names;
+  for (auto& shard : index.shards) {
+    names.insert(names.end(), shard.begin(), shard.end());
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+} // anonymous namespace
+
+TEST(BucketListMerge, Ordered)
+{
+  FakeIndex index(16, 10000);
+  ASSERT_EQ(expected_names(index), list_all(index, 1000, 8));
+  ASSERT_EQ(expected_names(index), list_all(index, 7, 1));
+}
+
+TEST(BucketListMerge, Empty)
+{
+  FakeIndex index(4, 0);
+  auto merge = index.make_merge(1000, 8);
+  bool truncated;
+  ASSERT_TRUE(list_page(merge, "", 1000, &truncated).empty());
+  ASSERT_FALSE(truncated);
+}
+
+TEST(BucketListMerge, Skewed)
+{
+  // all entries in a single shard: its page doubles until the listing is
+  // complete, and the other shards are only asked once
+  FakeIndex index(64, 5000, [](unsigned) { return 17; });
+  auto merge = index.make_merge(1000, 8);
+  bool truncated;
+  auto names = list_page(merge, "", 1000, &truncated);
+  ASSERT_EQ(1000u, names.size());
+  ASSERT_TRUE(truncated);
+  ASSERT_TRUE(std::is_sorted(names.begin(), names.end()));
+  ASSERT_EQ("obj00000000", names.front());
+  ASSERT_EQ("obj00000999", names.back());
+  ASSERT_GT(16u, merge.get_num_fetches());
+  ASSERT_GT(2 * 1000u + 8, merge.get_num_fetched());
+}
+
+TEST(BucketListMerge, StopsWhenFull)
+{
+  FakeIndex index(1, 100);
+  auto merge = index.make_merge(10, 1);
+  bool truncated;
+  auto names = list_page(merge, "", 10, &truncated);
+  ASSERT_EQ(10u, names.size());
+  ASSERT_TRUE(truncated);
+  // the shard ran out with the last entry, but isn't asked for more
+  // until another entry is wanted
+  ASSERT_EQ(1u, index.requests);
+  ASSERT_EQ(10u, merge.get_num_fetched());
+}
+
+TEST(BucketListMerge, SharedKeys)
+{
+  // with a delimiter, every shard returns the common prefixes it has
+  // entries under.  neither shard may lose its place in the merge
+  FakeIndex index(2, 0);
+  index.shards[0] = {"a", "dir/", "x"};
+  index.shards[1] = {"b", "dir/", "y"};
+  auto merge = index.make_merge(1000, 1);
+  bool truncated;
+  ASSERT_EQ(std::vector<std::string>({"a", "b", "dir/", "dir/", "x", "y"}),
+	    list_page(merge, "", 1000, &truncated));
+  ASSERT_FALSE(truncated);
+}
+
+// compare the entries pulled from a 1024 shard index to list one page,
+// with the small adaptive pages and with a full page from every shard
+TEST(BucketListMerge, Bench1024Shards)
+{
+  FakeIndex index(1024, 1 << 18);
+  const uint32_t max = 1000;
+  // what list_objects_ordered() asks for with the default readahead
+  const uint32_t num_entries = max + 1;
+
+  auto run = [&](const char *what, uint32_t min_shard_entries) {
+    const auto requests = index.requests;
+    const auto start = std::chrono::steady_clock::now();
+    auto merge = index.make_merge(num_entries, min_shard_entries);
+    bool truncated;
+    auto names = list_page(merge, "obj00100000", max, &truncated);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(max, names.size());
+    EXPECT_EQ("obj00100001", names.front());
+    std::cout << what << ": " << index.requests - requests
+	      << " shard requests, "
+	      << merge.get_num_fetched() << " entries fetched, "
+	      << std::chrono::duration<double, std::milli>(elapsed).count()
+	      << "ms" << std::endl;
+    return merge.get_num_fetched();
+  };
+  const auto full = run("full pages", num_entries);
+  const auto adaptive = run("adaptive pages", 8);
+  ASSERT_LT(adaptive * 10, full);
+}
@@ -0,0 +1,120 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "rgw/rgw_cache.h"
+#include "global/global_context.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+struct TestChainedCache : public RGWChainedCache {
+  std::set<std::string> keys;
+
+  void chain_cb(const std::string& key, void *data) override {
+    keys.insert(key);
+  }
+  void invalidate(const std::string& key) override {
+    keys.erase(key);
+  }
+  void invalidate_all() override {
+    keys.clear();
+  }
+};
+
+// a cache with a single shard, so that the limits apply to all entries
+struct CacheTest : public ::testing::Test {
+  ObjectCache cache;
+
+  void SetUp() override {
+    g_ceph_context->_conf.set_val("rgw_cache_shards", "1");
+    g_ceph_context->_conf.set_val("rgw_cache_lru_size", "4");
+    g_ceph_context->_conf.set_val("rgw_cache_max_bytes", "0");
+    g_ceph_context->_conf.set_val("rgw_cache_expiry_interval", "0");
+    cache.set_ctx(g_ceph_context);
+    cache.set_enabled(true);
+  }
+
+  void put(const std::string& name, size_t len = 1) {
+    ObjectCacheInfo info;
+    info.flags = CACHE_FLAG_DATA;
+    info.data.append(std::string(len, 'x'));
+    cache.put(name, info, nullptr);
+  }
+
+  bool has(const std::string& name) {
+    return bool(cache.get(name));
+  }
+};
+
+} // anonymous namespace
+
+TEST_F(CacheTest, PutGetRemove)
+{
+  put("a");
+  ASSERT_TRUE(has("a"));
+  ASSERT_FALSE(has("b"));
+  ASSERT_TRUE(cache.remove("a"));
+  ASSERT_FALSE(has("a"));
+  ASSERT_FALSE(cache.remove("a"));
+}
+
+TEST_F(CacheTest, ClockEviction)
+{
+  for (auto name : {"a", "b", "c", "d"}) {
+    put(name);
+  }
+  // a hit keeps "a" past the hand, "b" goes instead
+  ASSERT_TRUE(has("a"));
+  put("e");
+  ASSERT_TRUE(has("a"));
+  ASSERT_FALSE(has("b"));
+  for (auto name : {"c", "d", "e"}) {
+    ASSERT_TRUE(has(name));
+  }
+}
+
+TEST_F(CacheTest, ByteLimit)
+{
+  g_ceph_context->_conf.set_val("rgw_cache_lru_size", "1000");
+  g_ceph_context->_conf.set_val("rgw_cache_max_bytes", "64K");
+  cache.set_ctx(g_ceph_context);
+  cache.set_enabled(true);
+
+  for (int i = 0; i < 10; ++i) {
+    put(std::to_string(i), 16 << 10);
+  }
+  int cached = 0;
+  for (int i = 0; i < 10; ++i) {
+    cached += has(std::to_string(i));
+  }
+  ASSERT_EQ(3, cached);
+  // the last entry put is always kept
+  ASSERT_TRUE(has("9"));
+}
+
+TEST_F(CacheTest, ChainedInvalidate)
+{
+  TestChainedCache chained;
+  cache.chain_cache(&chained);
+
+  ObjectCacheInfo info;
+  info.flags = CACHE_FLAG_DATA;
+  rgw_cache_entry_info cache_info;
+  cache.put("a", info, &cache_info);
+  int data = 0;
+  RGWChainedCache::Entry entry(&chained, "key", &data);
+  ASSERT_TRUE(cache.chain_cache_entry({&cache_info}, &entry));
+  ASSERT_EQ(1u, chained.keys.count("key"));
+
+  // evicting the entry invalidates what was chained to it
+  for (auto name : {"b", "c", "d", "e"}) {
+    put(name);
+  }
+  ASSERT_FALSE(has("a"));
+  ASSERT_TRUE(chained.keys.empty());
+
+  // a stale entry can't be chained to
+  ASSERT_FALSE(cache.chain_cache_entry({&cache_info}, &entry));
+  cache.unchain_cache(&chained);
+}
@@ -4,6 +4,10 @@
 
 #include "rgw/rgw_compression.h"
 
+#include <chrono>
+#include <iostream>
+#include <random>
+
 class ut_get_sink : public RGWGetObj_Filter {
   bufferlist sink;
 public:
@@ -182,3 +186,89 @@ TEST(Compress, BillionZeros)
 
   ASSERT_EQ(d_sink.get_sink().length() , size*1000);
 }
+
+TEST(Compress, Pool)
+{
+  CompressorRef plugin;
+  plugin = Compressor::create(g_ceph_context, Compressor::COMP_ALG_ZLIB);
+  ASSERT_NE(plugin.get(), nullptr);
+
+  constexpr size_t size = 100000;
+  bufferlist bl;
+  for (size_t i = 0; i < size; i++) {
+    bl.append(static_cast<char>(i % 251));
+  }
+
+  // the same parts compressed inline and concurrently
+  std::vector<compression_block> expected;
+  bufferlist expected_data;
+  rgw::putobj::TransformPool pool(4);
+  for (auto tp : {(rgw::putobj::TransformPool*)nullptr, &pool}) {
+    ut_put_sink c_sink;
+    RGWPutObj_Compress compressor(g_ceph_context, plugin, &c_sink, tp, 3);
+    for (int i = 0; i < 20; i++) {
+      ASSERT_EQ(0, compressor.process(bufferlist{bl}, size*i));
+    }
+    ASSERT_EQ(0, compressor.process({}, size*20)); // flush
+    ASSERT_TRUE(compressor.is_compressed());
+    auto& blocks = compressor.get_compression_blocks();
+    ASSERT_EQ(20u, blocks.size());
+    if (!tp) {
+      expected = blocks;
+      expected_data = c_sink.get_sink();
+      continue;
+    }
+    for (size_t i = 0; i < blocks.size(); i++) {
+      EXPECT_EQ(expected[i].old_ofs, blocks[i].old_ofs);
+      EXPECT_EQ(expected[i].new_ofs, blocks[i].new_ofs);
+      EXPECT_EQ(expected[i].len, blocks[i].len);
+    }
+    ASSERT_TRUE(expected_data.contents_equal(c_sink.get_sink()));
+  }
+}
+
+struct ut_put_counter : public rgw::putobj::DataProcessor {
+  uint64_t bytes = 0;
+  int process(bufferlist&& bl, uint64_t ofs) override {
+    bytes += bl.length();
+    return 0;
+  }
+};
+
+// compare 1GB uploads compressed inline and on a pool, in chunks of
+// rgw_max_chunk_size. run with --gtest_also_run_disabled_tests
+TEST(Compress, DISABLED_Bench1GUpload)
+{
+  CompressorRef plugin = Compressor::create(g_ceph_context,
+                                            Compressor::COMP_ALG_ZLIB);
+  ASSERT_NE(plugin.get(), nullptr);
+
+  const size_t chunk_size = g_ceph_context->_conf->rgw_max_chunk_size;
+  const size_t total = 1ull << 30;
+  // 4 bits of entropy per byte, compresses to about half
+  bufferptr bp(chunk_size);
+  std::mt19937 rng(42);
+  for (size_t i = 0; i < chunk_size; i++) {
+    bp.c_str()[i] = 'a' + rng() % 16;
+  }
+  bufferlist chunk;
+  chunk.append(bp);
+
+  auto run = [&] (const char *what, rgw::putobj::TransformPool *pool) {
+    ut_put_counter sink;
+    RGWPutObj_Compress compressor(g_ceph_context, plugin, &sink, pool, 4);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t ofs = 0; ofs < total; ofs += chunk_size) {
+      ASSERT_EQ(0, compressor.process(bufferlist{chunk}, ofs));
+    }
+    ASSERT_EQ(0, compressor.process({}, total));
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    ASSERT_TRUE(compressor.is_compressed());
+    std::cout << what << ": " << total / elapsed.count() / (1 << 20)
+              << " MB/s, compressed to " << sink.bytes << " bytes" << std::endl;
+  };
+  run("inline", nullptr);
+  rgw::putobj::TransformPool pool(4);
+  run("4 threads", &pool);
+}
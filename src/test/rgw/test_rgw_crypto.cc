@@ -11,6 +11,7 @@
  * Foundation. See file COPYING.
  *
  */
+#include <chrono>
 #include <iostream>
 #include "global/global_init.h"
 #include "common/ceph_argparse.h"
@@ -796,6 +797,88 @@ TEST(TestRGWCrypto, verify_Encrypt_Decrypt)
 }
 
 
+struct ut_put_counter : public rgw::putobj::DataProcessor {
+  uint64_t bytes = 0;
+  int process(bufferlist&& bl, uint64_t ofs) override {
+    bytes += bl.length();
+    return 0;
+  }
+};
+
+// compare 1GB uploads encrypted inline and on a pool, in chunks of
+// rgw_max_chunk_size. run with --gtest_also_run_disabled_tests
+TEST(TestRGWCrypto, DISABLED_Bench1GUpload)
+{
+  uint8_t key[32];
+  for(size_t i=0;i<sizeof(key);i++)
+    key[i]=i;
+
+  const size_t chunk_size = g_ceph_context->_conf->rgw_max_chunk_size;
+  const size_t total = 1ull << 30;
+  bufferptr bp(chunk_size);
+  memset(bp.c_str(), 'a', chunk_size);
+  bufferlist chunk;
+  chunk.append(bp);
+
+  auto run = [&] (const char *what, rgw::putobj::TransformPool *pool) {
+    ut_put_counter sink;
+    RGWPutObj_BlockEncrypt encrypt(g_ceph_context, &sink,
+                                   AES_256_CBC_create(g_ceph_context, &key[0], 32),
+                                   pool, 4);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t ofs = 0; ofs < total; ofs += chunk_size) {
+      ASSERT_EQ(0, encrypt.process(bufferlist{chunk}, ofs));
+    }
+    ASSERT_EQ(0, encrypt.process({}, total));
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(total, sink.bytes);
+    std::cout << what << ": " << total / elapsed.count() / (1 << 20)
+              << " MB/s" << std::endl;
+  };
+  run("inline", nullptr);
+  rgw::putobj::TransformPool pool(4);
+  run("4 threads", &pool);
+}
+
+TEST(TestRGWCrypto, verify_RGWPutObj_BlockEncrypt_pool)
+{
+  const size_t test_size = 1024*1024 + 17;
+  bufferptr buf(test_size);
+  char* p = buf.c_str();
+  for(size_t i = 0; i < buf.length(); i++)
+    p[i] = i + i*i + (i >> 2);
+  bufferlist input;
+  input.append(buf);
+
+  uint8_t key[32];
+  for(size_t i=0;i<sizeof(key);i++)
+    key[i]=i;
+
+  // the same parts, encrypted inline and concurrently
+  bufferlist expected;
+  rgw::putobj::TransformPool pool(4);
+  for (auto tp : {(rgw::putobj::TransformPool*)nullptr, &pool}) {
+    ut_put_sink put_sink;
+    RGWPutObj_BlockEncrypt encrypt(g_ceph_context, &put_sink,
+                                   AES_256_CBC_create(g_ceph_context, &key[0], 32),
+                                   tp, 3);
+    for (size_t pos = 0; pos < test_size; pos += 65537) {
+      bufferlist bl;
+      bl.substr_of(input, pos, std::min<size_t>(65537, test_size - pos));
+      ASSERT_EQ(0, encrypt.process(std::move(bl), pos));
+    }
+    ASSERT_EQ(0, encrypt.process({}, test_size));
+    ASSERT_EQ(test_size, put_sink.get_sink().length());
+    if (!tp) {
+      expected = put_sink.get_sink();
+    } else {
+      ASSERT_TRUE(expected.contents_equal(put_sink.get_sink()));
+    }
+  }
+}
+
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
@@ -0,0 +1,83 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "rgw/rgw_data_sync.h"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// complete a full window of syncs with the same latency
+bool complete_window(RGWSyncSpawnWindow& window, ceph::timespan latency)
+{
+  bool changed = false;
+  for (unsigned n = window.get(); n > 0; n--) {
+    changed = window.update(latency);
+  }
+  return changed;
+}
+
+} // anonymous namespace
+
+TEST(SyncSpawnWindow, Bounds)
+{
+  RGWSyncSpawnWindow window(0, 0);
+  EXPECT_EQ(1u, window.get());
+
+  // the max is raised to the min
+  RGWSyncSpawnWindow window2(16, 8);
+  EXPECT_EQ(16u, window2.get());
+  EXPECT_FALSE(complete_window(window2, 10ms));
+  EXPECT_EQ(16u, window2.get());
+}
+
+TEST(SyncSpawnWindow, AdjustOncePerWindow)
+{
+  RGWSyncSpawnWindow window(8, 128);
+  for (unsigned i = 1; i < 8; i++) {
+    EXPECT_FALSE(window.update(10ms));
+  }
+  EXPECT_EQ(8u, window.get());
+  EXPECT_TRUE(window.update(10ms));
+  EXPECT_EQ(9u, window.get());
+}
+
+TEST(SyncSpawnWindow, Grow)
+{
+  RGWSyncSpawnWindow window(8, 32);
+  // grows by an eighth while the latency stays low
+  ASSERT_TRUE(complete_window(window, 10ms));
+  EXPECT_EQ(9u, window.get());
+  ASSERT_TRUE(complete_window(window, 12ms));
+  EXPECT_EQ(10u, window.get());
+
+  // up to the max
+  while (complete_window(window, 10ms)) {}
+  EXPECT_EQ(32u, window.get());
+  EXPECT_EQ(10ms, window.get_min_latency());
+}
+
+TEST(SyncSpawnWindow, Shrink)
+{
+  RGWSyncSpawnWindow window(4, 128);
+  for (int i = 0; i < 20; i++) {
+    complete_window(window, 10ms);
+  }
+  const unsigned grown = window.get();
+  ASSERT_LT(16u, grown);
+
+  // shrinks by a quarter once the smoothed latency doubles
+  ASSERT_TRUE(complete_window(window, 100ms));
+  EXPECT_EQ(grown * 3 / 4, window.get());
+
+  // down to the min
+  while (complete_window(window, 100ms)) {}
+  EXPECT_EQ(4u, window.get());
+
+  // and grows again once the latency recovers
+  while (!complete_window(window, 10ms)) {}
+  EXPECT_EQ(5u, window.get());
+  EXPECT_GT(20ms, window.get_avg_latency());
+}
@@ -16,7 +16,12 @@
 
 #include "rgw/rgw_dmclock_sync_scheduler.h"
 #include "rgw/rgw_dmclock_async_scheduler.h"
+#include "rgw/rgw_dmclock_tenant_scheduler.h"
+#include "rgw/rgw_request.h"
+#include "rgw/rgw_process.h"
 
+#include <chrono>
+#include <iostream>
 #include <optional>
 #include <boost/asio/spawn.hpp>
 #include <gtest/gtest.h>
@@ -25,6 +30,30 @@
 
 namespace rgw::dmclock {
 
+// an op with the default dmclock client and cost
+class ScheduleOp : public RGWOp {
+ public:
+  int verify_permission() override { return 0; }
+  void execute() override {}
+  const char* name() const override { return "schedule_op"; }
+};
+
+// an unauthenticated request for the bucket of the url, as the scheduler
+// sees it
+struct TestRequest {
+  RGWEnv env;
+  RGWUserInfo user;
+  req_state s;
+  ScheduleOp op;
+
+  explicit TestRequest(const std::string& url_bucket)
+    : s(g_ceph_context, &env, &user, 0) {
+    env.init(g_ceph_context);
+    s.init_state.url_bucket = url_bucket;
+    op.init(nullptr, &s, nullptr);
+  }
+};
+
 using boost::system::error_code;
 
 // return a lambda that can be used as a callback to capture its arguments
@@ -426,6 +455,263 @@ TEST(Queue, SpawnAsyncRequest)
   EXPECT_TRUE(context.stopped());
 }
 
+TEST(TenantQueue, RateLimit)
+{
+  g_ceph_context->_conf.set_val_or_die("rgw_dmclock_tenant_qos",
+                                       "limited=0:1:1, other/limited=0:1:1");
+  boost::asio::io_context context;
+  ClientCounters counters(g_ceph_context);
+  TenantScheduler queue(g_ceph_context, context, std::ref(counters));
+
+  std::optional<error_code> ec1, ec2, ec3, ec4, ec5, ec6;
+  std::optional<PhaseType> p1, p2, p3, p4, p5, p6;
+
+  auto now = get_time();
+  const qos_target limited{"limited", "bucket"};
+  const qos_target other{"other", "bucket"};
+  const qos_target other_limited{"other", "limited"};
+  queue.async_request(client_id::data, limited, {}, now, 1, capture(ec1, p1));
+  queue.async_request(client_id::data, limited, {}, now, 1, capture(ec2, p2));
+  queue.async_request(client_id::data, other, {}, now, 1, capture(ec3, p3));
+  queue.async_request(client_id::data, other, {}, now, 1, capture(ec4, p4));
+  queue.async_request(client_id::data, other_limited, {}, now, 1, capture(ec5, p5));
+  queue.async_request(client_id::data, other_limited, {}, now, 1, capture(ec6, p6));
+
+  context.poll();
+  EXPECT_TRUE(context.stopped());
+
+  ASSERT_TRUE(ec1);
+  EXPECT_EQ(boost::system::errc::success, *ec1);
+  ASSERT_TRUE(ec2);
+  EXPECT_EQ(boost::system::errc::resource_unavailable_try_again, *ec2);
+  ASSERT_TRUE(ec3);
+  EXPECT_EQ(boost::system::errc::success, *ec3);
+  ASSERT_TRUE(ec4);
+  EXPECT_EQ(boost::system::errc::success, *ec4);
+  // the bucket has its own limit, apart from its tenant
+  ASSERT_TRUE(ec5);
+  EXPECT_EQ(boost::system::errc::success, *ec5);
+  ASSERT_TRUE(ec6);
+  EXPECT_EQ(boost::system::errc::resource_unavailable_try_again, *ec6);
+
+  EXPECT_EQ(0u, counters(client_id::data)->get(queue_counters::l_qlen));
+  EXPECT_EQ(2u, counters(client_id::data)->get(queue_counters::l_limit));
+
+  g_ceph_context->_conf.set_val_or_die("rgw_dmclock_tenant_qos", "");
+}
+
+TEST(TenantQueue, UserQos)
+{
+  g_ceph_context->_conf.set_val_or_die("rgw_dmclock_tenant_qos",
+                                       "limited=0:1:1, other=0:1:1");
+  boost::asio::io_context context;
+  ClientCounters counters(g_ceph_context);
+  TenantScheduler queue(g_ceph_context, context, std::ref(counters));
+
+  std::optional<error_code> ec1, ec2, ec3, ec4, ec5, ec6;
+  std::optional<PhaseType> p1, p2, p3, p4, p5, p6;
+
+  auto now = get_time();
+  const qos_target user{"user", "bucket", true, ClientInfo(0, 1, 1)};
+  const qos_target unlimited{"limited", "bucket", true, ClientInfo(0, 1, 0)};
+  const qos_target other{"other", "bucket", true, std::nullopt};
+  queue.async_request(client_id::data, user, {}, now, 1, capture(ec1, p1));
+  queue.async_request(client_id::data, user, {}, now, 1, capture(ec2, p2));
+  queue.async_request(client_id::data, unlimited, {}, now, 1, capture(ec3, p3));
+  queue.async_request(client_id::data, unlimited, {}, now, 1, capture(ec4, p4));
+  queue.async_request(client_id::data, other, {}, now, 1, capture(ec5, p5));
+  queue.async_request(client_id::data, other, {}, now, 1, capture(ec6, p6));
+
+  context.poll();
+  EXPECT_TRUE(context.stopped());
+
+  // the user's qos applies to its tenant
+  ASSERT_TRUE(ec1);
+  EXPECT_EQ(boost::system::errc::success, *ec1);
+  ASSERT_TRUE(ec2);
+  EXPECT_EQ(boost::system::errc::resource_unavailable_try_again, *ec2);
+  // and takes precedence over the config
+  ASSERT_TRUE(ec3);
+  EXPECT_EQ(boost::system::errc::success, *ec3);
+  ASSERT_TRUE(ec4);
+  EXPECT_EQ(boost::system::errc::success, *ec4);
+  // users without one fall back to the config
+  ASSERT_TRUE(ec5);
+  EXPECT_EQ(boost::system::errc::success, *ec5);
+  ASSERT_TRUE(ec6);
+  EXPECT_EQ(boost::system::errc::resource_unavailable_try_again, *ec6);
+
+  EXPECT_EQ(0u, counters(client_id::data)->get(queue_counters::l_qlen));
+  EXPECT_EQ(2u, counters(client_id::data)->get(queue_counters::l_limit));
+
+  g_ceph_context->_conf.set_val_or_die("rgw_dmclock_tenant_qos", "");
+}
+
+TEST(TenantQueue, ClassWeights)
+{
+  g_ceph_context->_conf.set_val_or_die("rgw_dmclock_admin_wgt", "1");
+  g_ceph_context->_conf.set_val_or_die("rgw_dmclock_data_wgt", "3");
+  boost::asio::io_context context;
+  ClientCounters counters(g_ceph_context);
+  TenantScheduler queue(g_ceph_context, context, std::ref(counters));
+
+  // queue 4 requests of each class before any runs, data should get three
+  // turns for each admin turn
+  std::vector<client_id> order;
+  auto now = get_time();
+  for (int i = 0; i < 4; i++) {
+    for (auto client : {client_id::admin, client_id::data}) {
+      queue.async_request(client, qos_target{"tenant", "bucket"}, {}, now, 1,
+          [&order, client] (error_code ec, PhaseType) {
+            EXPECT_FALSE(ec);
+            order.push_back(client);
+          });
+    }
+  }
+  context.poll();
+  EXPECT_TRUE(context.stopped());
+
+  const std::vector<client_id> expected = {
+    client_id::data, client_id::data, client_id::admin, client_id::data,
+    client_id::data, client_id::admin, client_id::admin, client_id::admin,
+  };
+  EXPECT_EQ(expected, order);
+
+  g_ceph_context->_conf.rm_val("rgw_dmclock_admin_wgt");
+  g_ceph_context->_conf.rm_val("rgw_dmclock_data_wgt");
+}
+
+// measure the cost of scheduling 100k requests over 1000 tenants
+TEST(TenantQueue, Bench)
+{
+  boost::asio::io_context context;
+  ClientCounters counters(g_ceph_context);
+  TenantScheduler queue(g_ceph_context, context, std::ref(counters));
+
+  constexpr size_t num_requests = 100000;
+  constexpr size_t num_tenants = 1000;
+  std::vector<std::string> tenants;
+  for (size_t i = 0; i < num_tenants; i++) {
+    tenants.push_back("tenant" + std::to_string(i));
+  }
+
+  size_t completed = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < num_requests; i++) {
+    const auto client = static_cast<client_id>(i % client_count);
+    queue.async_request(client, qos_target{tenants[i % num_tenants], "bucket"},
+                        {}, get_time(), 1,
+        [&] (error_code ec, PhaseType) {
+          EXPECT_FALSE(ec);
+          ++completed;
+          queue.request_complete();
+        });
+  }
+  context.run();
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(num_requests, completed);
+  const double secs = std::chrono::duration<double>(elapsed).count();
+  std::cout << "scheduled " << num_requests << " requests over "
+            << num_tenants << " tenants in " << secs << "s, "
+            << num_requests / secs << " req/s" << std::endl;
+}
+
+TEST(TenantQueue, ScheduleRequestTarget)
+{
+  g_ceph_context->_conf.set_val_or_die("rgw_dmclock_tenant_qos",
+                                       "limited=0:1:1, other/limited=0:1:1");
+  boost::asio::io_context context;
+  ClientCounters counters(g_ceph_context);
+  TenantScheduler queue(g_ceph_context, context, std::ref(counters));
+
+  // the target is taken from the url, as bucket_tenant and bucket_name
+  // aren't set before auth
+  const std::vector<std::string> url_buckets = {
+    "limited:bucket", "limited:bucket",
+    "other:bucket", "other:bucket",
+    "other:limited", "other:limited",
+    "limited", "limited",
+  };
+  std::vector<int> results;
+  boost::asio::spawn(context, [&] (boost::asio::yield_context yield) {
+    for (const auto& url_bucket : url_buckets) {
+      TestRequest req(url_bucket);
+      req.s.yield = optional_yield{context, yield};
+      auto [r, completer] = schedule_request(&queue, nullptr, &req.s, &req.op);
+      results.push_back(r);
+    }
+  });
+  context.poll();
+  EXPECT_TRUE(context.stopped());
+
+  ASSERT_EQ(url_buckets.size(), results.size());
+  EXPECT_EQ(0, results[0]);
+  EXPECT_EQ(-EAGAIN, results[1]);
+  EXPECT_EQ(0, results[2]);
+  EXPECT_EQ(0, results[3]);
+  EXPECT_EQ(0, results[4]);
+  EXPECT_EQ(-EAGAIN, results[5]);
+  // a bucket without its tenant belongs to the requester's, which is the
+  // default tenant for anonymous requests
+  EXPECT_EQ(0, results[6]);
+  EXPECT_EQ(0, results[7]);
+
+  g_ceph_context->_conf.set_val_or_die("rgw_dmclock_tenant_qos", "");
+}
+
 #endif
 
+TEST(ScheduleRequest, AccessKey)
+{
+  {
+    TestRequest req("bucket");
+    EXPECT_EQ("", rgw_get_request_access_key(&req.s));
+  }
+  {
+    TestRequest req("bucket");
+    req.env.set("HTTP_AUTHORIZATION", "AWS AKIDV2:c2lnbmF0dXJl");
+    EXPECT_EQ("AKIDV2", rgw_get_request_access_key(&req.s));
+  }
+  {
+    TestRequest req("bucket");
+    req.env.set("HTTP_AUTHORIZATION", "AWS4-HMAC-SHA256 "
+                "Credential=AKIDV4/20190101/us-east-1/s3/aws4_request, "
+                "SignedHeaders=host;x-amz-date, Signature=abcdef");
+    EXPECT_EQ("AKIDV4", rgw_get_request_access_key(&req.s));
+  }
+  {
+    TestRequest req("bucket");
+    req.env.set("HTTP_AUTHORIZATION", "Bearer token");
+    EXPECT_EQ("", rgw_get_request_access_key(&req.s));
+  }
+  {
+    TestRequest req("bucket");
+    req.s.info.args.set("AWSAccessKeyId=AKIDV2&Signature=abc&Expires=1");
+    req.s.info.args.parse();
+    EXPECT_EQ("AKIDV2", rgw_get_request_access_key(&req.s));
+  }
+  {
+    TestRequest req("bucket");
+    req.s.info.args.set("X-Amz-Credential=AKIDV4%2F20190101%2Fus-east-1%2Fs3%2Faws4_request");
+    req.s.info.args.parse();
+    EXPECT_EQ("AKIDV4", rgw_get_request_access_key(&req.s));
+  }
+}
+
+TEST(TenantQueue, ParseQos)
+{
+  auto qos = parse_tenant_qos("1:2.5:0");
+  ASSERT_TRUE(qos);
+  EXPECT_EQ(1.0, qos->reservation);
+  EXPECT_EQ(2.5, qos->weight);
+  EXPECT_EQ(0.0, qos->limit);
+
+  EXPECT_FALSE(parse_tenant_qos(""));
+  EXPECT_FALSE(parse_tenant_qos("1:2"));
+  EXPECT_FALSE(parse_tenant_qos("1:2:3:4"));
+  EXPECT_FALSE(parse_tenant_qos("1:x:3"));
+  EXPECT_FALSE(parse_tenant_qos("1:-2:3"));
+}
+
 } // namespace rgw::dmclock
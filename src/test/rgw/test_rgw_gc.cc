@@ -0,0 +1,107 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "rgw/rgw_gc.h"
+#include "global/global_context.h"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct GCIOWindow : public ::testing::Test {
+  void SetUp() override {
+    g_ceph_context->_conf.set_val("rgw_gc_max_concurrent_io", "16");
+    g_ceph_context->_conf.set_val("rgw_gc_io_target_latency", "0.1");
+  }
+  void TearDown() override {
+    g_ceph_context->_conf.rm_val("rgw_gc_max_concurrent_io");
+    g_ceph_context->_conf.rm_val("rgw_gc_io_target_latency");
+  }
+};
+
+// complete a full window of removals with the same latency, returning
+// whether the window changed
+bool complete_window(RGWGCIOWindow& window, ceph::timespan latency)
+{
+  bool changed = false;
+  for (size_t n = window.get(); n > 0; n--) {
+    changed = window.update(latency);
+  }
+  return changed;
+}
+
+} // anonymous namespace
+
+TEST_F(GCIOWindow, Fixed)
+{
+  g_ceph_context->_conf.set_val("rgw_gc_io_target_latency", "0");
+  RGWGCIOWindow window(g_ceph_context);
+  EXPECT_FALSE(window.adaptive());
+  EXPECT_EQ(16u, window.get());
+}
+
+TEST_F(GCIOWindow, BelowTarget)
+{
+  RGWGCIOWindow window(g_ceph_context);
+  ASSERT_TRUE(window.adaptive());
+  EXPECT_EQ(10u, window.get());
+
+  // grows by one per window of removals within the target
+  EXPECT_TRUE(complete_window(window, 50ms));
+  EXPECT_EQ(11u, window.get());
+  EXPECT_TRUE(complete_window(window, 100ms));
+  EXPECT_EQ(12u, window.get());
+
+  // up to rgw_gc_max_concurrent_io
+  while (complete_window(window, 50ms)) {}
+  EXPECT_EQ(16u, window.get());
+  EXPECT_FALSE(complete_window(window, 50ms));
+}
+
+TEST_F(GCIOWindow, AboveTarget)
+{
+  RGWGCIOWindow window(g_ceph_context);
+  ASSERT_EQ(10u, window.get());
+
+  // halved per window of removals over the target
+  EXPECT_TRUE(complete_window(window, 200ms));
+  EXPECT_EQ(5u, window.get());
+  EXPECT_TRUE(complete_window(window, 150ms));
+  EXPECT_EQ(2u, window.get());
+
+  // down to one
+  EXPECT_TRUE(complete_window(window, 200ms));
+  EXPECT_EQ(1u, window.get());
+  EXPECT_FALSE(complete_window(window, 200ms));
+  EXPECT_EQ(1u, window.get());
+
+  // and grows back once the latency is within the target
+  EXPECT_TRUE(complete_window(window, 50ms));
+  EXPECT_EQ(2u, window.get());
+}
+
+TEST_F(GCIOWindow, AverageLatency)
+{
+  RGWGCIOWindow window(g_ceph_context);
+  ASSERT_EQ(10u, window.get());
+
+  // a single slow removal doesn't shrink a window that averages within
+  // the target
+  for (int i = 0; i < 9; i++) {
+    ASSERT_FALSE(window.update(50ms));
+  }
+  ASSERT_TRUE(window.update(300ms));
+  EXPECT_EQ(11u, window.get());
+
+  // but enough of them do
+  for (int i = 0; i < 5; i++) {
+    ASSERT_FALSE(window.update(50ms));
+  }
+  for (int i = 0; i < 5; i++) {
+    ASSERT_FALSE(window.update(300ms));
+  }
+  ASSERT_TRUE(window.update(300ms));
+  EXPECT_EQ(5u, window.get());
+}
@@ -0,0 +1,219 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#include "rgw/rgw_index_completion.h"
+#include "global/global_context.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using Batch = RGWIndexCompletionBatcher::Batch;
+
+// keeps the batches instead of sending them, and the completions retried on
+// their own
+struct TestBackend : public RGWIndexCompletionBatcher::Backend {
+  std::mutex mutex;
+  std::condition_variable cond;
+  int send_result = 0;
+  std::vector<std::unique_ptr<Batch>> batches;
+  std::vector<std::vector<rgw_cls_obj_complete_op>> sent_ops;
+  std::vector<std::unique_ptr<complete_op_data>> retried;
+
+  int send_batch(std::unique_ptr<Batch>& batch,
+                 std::vector<rgw_cls_obj_complete_op>& ops) override {
+    std::lock_guard l{mutex};
+    if (send_result < 0) {
+      return send_result;
+    }
+    batches.push_back(std::move(batch));
+    sent_ops.push_back(ops);
+    cond.notify_all();
+    return 0;
+  }
+  void retry_completion(std::unique_ptr<complete_op_data> c) override {
+    std::lock_guard l{mutex};
+    retried.push_back(std::move(c));
+  }
+
+  size_t num_batches() {
+    std::lock_guard l{mutex};
+    return batches.size();
+  }
+  std::unique_ptr<Batch> take_batch(size_t i) {
+    std::lock_guard l{mutex};
+    return std::move(batches.at(i));
+  }
+  bool wait_for_batches(size_t count, std::chrono::milliseconds timeout) {
+    std::unique_lock l{mutex};
+    return cond.wait_for(l, timeout, [&] { return batches.size() >= count; });
+  }
+};
+
+struct BatcherTest : public ::testing::Test {
+  TestBackend backend;
+  librados::IoCtx index_ctx;
+  std::shared_ptr<RGWIndexCompletionBatcher> batcher;
+
+  void start(const std::string& window_ms, const std::string& max_entries) {
+    g_ceph_context->_conf.set_val("rgw_bucket_index_complete_batch_window_ms", window_ms);
+    g_ceph_context->_conf.set_val("rgw_bucket_index_complete_batch_max_entries", max_entries);
+    batcher = std::make_shared<RGWIndexCompletionBatcher>(g_ceph_context, &backend);
+    batcher->create("index-batch");
+  }
+  void TearDown() override {
+    if (batcher) {
+      batcher->stop();
+    }
+  }
+
+  bool add(const std::string& oid, const std::string& name,
+           const std::list<cls_rgw_obj_key>& remove_objs = {}) {
+    auto c = std::make_unique<complete_op_data>();
+    c->op = CLS_RGW_OP_ADD;
+    c->key = cls_rgw_obj_key(name);
+    c->remove_objs = remove_objs;
+    return batcher->add(1, index_ctx, oid, c);
+  }
+};
+
+} // anonymous namespace
+
+TEST_F(BatcherTest, FlushOnSize)
+{
+  start("60000", "3");
+  ASSERT_TRUE(add("shard.0", "a"));
+  ASSERT_TRUE(add("shard.0", "b"));
+  EXPECT_EQ(0u, backend.num_batches());
+  ASSERT_TRUE(add("shard.0", "c"));
+
+  // a full batch is sent without waiting for the window
+  ASSERT_EQ(1u, backend.num_batches());
+  ASSERT_EQ(3u, backend.sent_ops[0].size());
+  EXPECT_EQ("a", backend.sent_ops[0][0].key.name);
+  EXPECT_EQ("b", backend.sent_ops[0][1].key.name);
+  EXPECT_EQ("c", backend.sent_ops[0][2].key.name);
+}
+
+TEST_F(BatcherTest, FlushOnWindow)
+{
+  start("10", "100");
+  ASSERT_TRUE(add("shard.0", "a"));
+  ASSERT_TRUE(add("shard.1", "b"));
+  ASSERT_TRUE(add("shard.0", "c"));
+
+  // one batch per shard object once the window ends
+  ASSERT_TRUE(backend.wait_for_batches(2, std::chrono::seconds(10)));
+  std::map<std::string, size_t> entries;
+  for (size_t i = 0; i < 2; i++) {
+    auto batch = backend.take_batch(i);
+    entries[batch->oid] = batch->entries.size();
+  }
+  EXPECT_EQ(2u, entries["shard.0"]);
+  EXPECT_EQ(1u, entries["shard.1"]);
+}
+
+TEST_F(BatcherTest, FlushOnConflict)
+{
+  start("60000", "100");
+  ASSERT_TRUE(add("shard.0", "a"));
+  ASSERT_TRUE(add("shard.0", "b"));
+  // a second op on an entry sends the batch holding the first
+  ASSERT_TRUE(add("shard.0", "a"));
+  ASSERT_EQ(1u, backend.num_batches());
+  EXPECT_EQ(2u, backend.sent_ops[0].size());
+
+  // and so does an op removing an entry of the batch
+  ASSERT_TRUE(add("shard.0", "c", {cls_rgw_obj_key("a")}));
+  ASSERT_EQ(2u, backend.num_batches());
+  ASSERT_EQ(1u, backend.sent_ops[1].size());
+  EXPECT_EQ("a", backend.sent_ops[1][0].key.name);
+
+  // ops on other shard objects don't conflict
+  ASSERT_TRUE(add("shard.1", "c"));
+  EXPECT_EQ(2u, backend.num_batches());
+
+  // the rest is sent on stop
+  batcher->stop();
+  EXPECT_EQ(4u, backend.num_batches());
+}
+
+TEST_F(BatcherTest, FallbackNotSupported)
+{
+  start("60000", "2");
+  ASSERT_TRUE(add("shard.0", "a"));
+  ASSERT_TRUE(add("shard.0", "b"));
+  ASSERT_EQ(1u, backend.num_batches());
+
+  batcher->handle_completion(backend.take_batch(0), -EOPNOTSUPP);
+  ASSERT_EQ(2u, backend.retried.size());
+  EXPECT_EQ("a", backend.retried[0]->key.name);
+  EXPECT_EQ("b", backend.retried[1]->key.name);
+
+  // the osds don't support batches, so later completions are sent alone
+  EXPECT_FALSE(add("shard.0", "c"));
+}
+
+TEST_F(BatcherTest, FallbackResharding)
+{
+  start("60000", "2");
+  ASSERT_TRUE(add("shard.0", "a"));
+  ASSERT_TRUE(add("shard.0", "b"));
+  ASSERT_EQ(1u, backend.num_batches());
+
+  // the ops are retried on the resharded bucket, and batching goes on
+  batcher->handle_completion(backend.take_batch(0), -ERR_BUSY_RESHARDING);
+  EXPECT_EQ(2u, backend.retried.size());
+  EXPECT_TRUE(add("shard.0", "c"));
+}
+
+TEST_F(BatcherTest, FallbackBatchFailed)
+{
+  start("60000", "2");
+  ASSERT_TRUE(add("shard.0", "a"));
+  ASSERT_TRUE(add("shard.0", "b"));
+  ASSERT_EQ(1u, backend.num_batches());
+
+  // none of a failed batch is applied, so its ops are sent alone
+  batcher->handle_completion(backend.take_batch(0), -EIO);
+  EXPECT_EQ(2u, backend.retried.size());
+  EXPECT_TRUE(add("shard.0", "c"));
+
+  // and so are the ops of a batch that couldn't be sent
+  backend.send_result = -EIO;
+  ASSERT_TRUE(add("shard.0", "d"));
+  EXPECT_EQ(4u, backend.retried.size());
+}
+
+TEST_F(BatcherTest, CompletedBatch)
+{
+  start("60000", "1");
+  ASSERT_TRUE(add("shard.0", "a"));
+  ASSERT_EQ(1u, backend.num_batches());
+  batcher->handle_completion(backend.take_batch(0), 0);
+  EXPECT_TRUE(backend.retried.empty());
+}
+
+TEST(IndexCompletion, BatchableVersioned)
+{
+  RGWBucketInfo info;
+  EXPECT_TRUE(RGWIndexCompletionBatcher::batchable(info, rgw_obj_key("obj")));
+  // an instance is linked to its olh after its completion
+  EXPECT_FALSE(RGWIndexCompletionBatcher::batchable(info, rgw_obj_key("obj", "inst")));
+
+  // so is every write to a versioned bucket, even if versioning is suspended
+  info.flags = BUCKET_VERSIONED;
+  EXPECT_FALSE(RGWIndexCompletionBatcher::batchable(info, rgw_obj_key("obj")));
+  info.flags = BUCKET_VERSIONED | BUCKET_VERSIONS_SUSPENDED;
+  EXPECT_FALSE(RGWIndexCompletionBatcher::batchable(info, rgw_obj_key("obj")));
+}
@@ -0,0 +1,75 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "rgw/rgw_lc.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::vector<size_t> match(const LCPrefixMatcher& matcher, std::string_view name)
+{
+  std::vector<size_t> rules;
+  matcher.match(name, [&rules] (size_t rule) { rules.push_back(rule); });
+  return rules;
+}
+
+} // anonymous namespace
+
+TEST(LCPrefixMatcher, Empty)
+{
+  LCPrefixMatcher matcher;
+  EXPECT_TRUE(matcher.empty());
+  EXPECT_TRUE(matcher.get_list_prefixes().empty());
+  EXPECT_TRUE(match(matcher, "obj").empty());
+}
+
+TEST(LCPrefixMatcher, ListPrefixes)
+{
+  LCPrefixMatcher matcher;
+  matcher.add("logs/", 0);
+  matcher.add("logs/2019/", 1);
+  matcher.add("tmp/", 2);
+  matcher.add("logs/", 3);
+  matcher.add("tmpfiles/", 4);
+  EXPECT_FALSE(matcher.empty());
+
+  // the prefixes under another rule's prefix are listed with it
+  const std::vector<std::string> expected{"logs/", "tmp/", "tmpfiles/"};
+  EXPECT_EQ(expected, matcher.get_list_prefixes());
+}
+
+TEST(LCPrefixMatcher, EmptyPrefix)
+{
+  LCPrefixMatcher matcher;
+  matcher.add("", 0);
+  matcher.add("logs/", 1);
+
+  // the whole bucket is listed once
+  const std::vector<std::string> expected{""};
+  EXPECT_EQ(expected, matcher.get_list_prefixes());
+
+  EXPECT_EQ(std::vector<size_t>({0}), match(matcher, "obj"));
+  EXPECT_EQ(std::vector<size_t>({0, 1}), match(matcher, "logs/obj"));
+}
+
+TEST(LCPrefixMatcher, Match)
+{
+  LCPrefixMatcher matcher;
+  matcher.add("logs/", 0);
+  matcher.add("logs/2019/", 1);
+  matcher.add("tmp/", 2);
+  matcher.add("logs/", 3);
+
+  // the shorter prefixes match first, and the rules of a prefix in the
+  // order they were added
+  EXPECT_EQ(std::vector<size_t>({0, 3, 1}), match(matcher, "logs/2019/obj"));
+  EXPECT_EQ(std::vector<size_t>({0, 3}), match(matcher, "logs/2018/obj"));
+  EXPECT_EQ(std::vector<size_t>({0, 3}), match(matcher, "logs/"));
+  EXPECT_EQ(std::vector<size_t>({2}), match(matcher, "tmp/obj"));
+
+  // names shorter than a prefix don't match it
+  EXPECT_TRUE(match(matcher, "logs").empty());
+  EXPECT_TRUE(match(matcher, "tmpobj").empty());
+  EXPECT_TRUE(match(matcher, "").empty());
+}
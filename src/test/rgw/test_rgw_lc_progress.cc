@@ -0,0 +1,130 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "rgw/rgw_lc.h"
+#include "global/global_context.h"
+
+#include <gtest/gtest.h>
+
+// test fixture for global setup/teardown
+class LCProgress : public ::testing::Test {
+  static constexpr auto poolname = "ceph_test_rgw_lc_progress";
+
+ protected:
+  static librados::Rados rados;
+  static librados::IoCtx io;
+
+ public:
+  static void SetUpTestCase() {
+    ASSERT_EQ(0, rados.init_with_context(g_ceph_context));
+    ASSERT_EQ(0, rados.connect());
+    int r = rados.ioctx_create(poolname, io);
+    if (r == -ENOENT) {
+      r = rados.pool_create(poolname);
+      if (r == -EEXIST) {
+        r = 0;
+      }
+      if (r == 0) {
+        r = rados.ioctx_create(poolname, io);
+      }
+    }
+    ASSERT_EQ(0, r);
+  }
+
+  static void TearDownTestCase() {
+    io.close();
+    rados.shutdown();
+  }
+
+  void TearDown() override {
+    io.remove(oid());
+  }
+
+  static std::string oid() {
+    auto info = ::testing::UnitTest::GetInstance()->current_test_info();
+    return lc_progress_oid_prefix + info->name();
+  }
+};
+librados::Rados LCProgress::rados;
+librados::IoCtx LCProgress::io;
+
+TEST_F(LCProgress, NoMarker)
+{
+  LCShardProgress progress(io, oid(), 4, 0, "");
+  rgw_obj_key marker;
+  EXPECT_EQ(-ENOENT, progress.read(&marker));
+  EXPECT_EQ(0, progress.finish());
+}
+
+TEST_F(LCProgress, Checkpoint)
+{
+  LCShardProgress progress(io, oid(), 4, 0, "", 3);
+  ASSERT_EQ(0, progress.processed(rgw_obj_key("a"), false));
+  ASSERT_EQ(0, progress.processed(rgw_obj_key("b"), false));
+  rgw_obj_key marker;
+  EXPECT_EQ(-ENOENT, progress.read(&marker));
+
+  // the marker is saved once the interval is reached
+  ASSERT_EQ(0, progress.processed(rgw_obj_key("c"), false));
+  ASSERT_EQ(0, progress.read(&marker));
+  EXPECT_EQ(rgw_obj_key("c"), marker);
+
+  // and left alone until the next interval
+  ASSERT_EQ(0, progress.processed(rgw_obj_key("d"), false));
+  ASSERT_EQ(0, progress.read(&marker));
+  EXPECT_EQ(rgw_obj_key("c"), marker);
+}
+
+TEST_F(LCProgress, CheckpointAtLastVersion)
+{
+  LCShardProgress progress(io, oid(), 4, 0, "", 2);
+  ASSERT_EQ(0, progress.processed(rgw_obj_key("a"), false));
+  ASSERT_EQ(0, progress.processed(rgw_obj_key("b", "v2"), true));
+  ASSERT_EQ(0, progress.processed(rgw_obj_key("b", "v1"), true));
+  rgw_obj_key marker;
+  EXPECT_EQ(-ENOENT, progress.read(&marker));
+
+  // saved past the interval, at the last version of the name
+  ASSERT_EQ(0, progress.processed(rgw_obj_key("b", "v0"), false));
+  ASSERT_EQ(0, progress.read(&marker));
+  EXPECT_EQ(rgw_obj_key("b", "v0"), marker);
+}
+
+TEST_F(LCProgress, Resume)
+{
+  {
+    LCShardProgress progress(io, oid(), 4, 1, "logs/", 1);
+    ASSERT_EQ(0, progress.processed(rgw_obj_key("logs/a"), false));
+    ASSERT_EQ(0, progress.processed(rgw_obj_key("logs/b"), false));
+  }
+  // a later run of the same shard and prefix resumes after the marker
+  LCShardProgress progress(io, oid(), 4, 1, "logs/", 1);
+  rgw_obj_key marker;
+  ASSERT_EQ(0, progress.read(&marker));
+  EXPECT_EQ(rgw_obj_key("logs/b"), marker);
+
+  // other shards and prefixes have their own markers
+  LCShardProgress other_shard(io, oid(), 4, 2, "logs/", 1);
+  EXPECT_EQ(-ENOENT, other_shard.read(&marker));
+  LCShardProgress other_prefix(io, oid(), 4, 1, "tmp/", 1);
+  EXPECT_EQ(-ENOENT, other_prefix.read(&marker));
+
+  // and the markers saved before a reshard are ignored
+  LCShardProgress resharded(io, oid(), 8, 1, "logs/", 1);
+  EXPECT_EQ(-ENOENT, resharded.read(&marker));
+}
+
+TEST_F(LCProgress, Finish)
+{
+  LCShardProgress progress(io, oid(), 4, 0, "", 1);
+  LCShardProgress other(io, oid(), 4, 1, "", 1);
+  ASSERT_EQ(0, progress.processed(rgw_obj_key("a"), false));
+  ASSERT_EQ(0, other.processed(rgw_obj_key("b"), false));
+
+  // a finished shard starts over, and leaves the other markers alone
+  ASSERT_EQ(0, progress.finish());
+  rgw_obj_key marker;
+  EXPECT_EQ(-ENOENT, progress.read(&marker));
+  ASSERT_EQ(0, other.read(&marker));
+  EXPECT_EQ(rgw_obj_key("b"), marker);
+}
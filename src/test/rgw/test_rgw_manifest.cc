@@ -11,6 +11,7 @@
  * Foundation. See file COPYING.
  *
  */
+#include <chrono>
 #include <iostream>
 #include "global/global_init.h"
 #include "common/ceph_argparse.h"
@@ -340,6 +341,131 @@ TEST(TestRGWManifest, multipart) {
   ASSERT_EQ(m.get_obj_size(), num_parts * part_size);
 }
 
+// the manifest a part upload writes
+static void gen_part(test_rgw_env& env, const string& prefix, int num,
+                     uint64_t part_size, uint64_t stripe_size,
+                     RGWObjManifest *manifest)
+{
+  RGWObjManifest::generator gen;
+  rgw_bucket bucket;
+  rgw_obj head;
+  manifest->set_prefix(prefix);
+  manifest->set_multipart_part_rule(stripe_size, num);
+  rgw_placement_rule rule(env.zonegroup.default_placement.name, RGW_STORAGE_CLASS_STANDARD);
+  int r = gen.create_begin(g_ceph_context, manifest, rule, nullptr, bucket, head);
+  ASSERT_EQ(r, 0);
+  for (uint64_t ofs = stripe_size; ofs < part_size; ofs += stripe_size) {
+    gen.create_next(ofs);
+  }
+  gen.create_next(part_size);
+}
+
+// parts of different sizes, as uploaded by a client streaming data of
+// unknown size, and a part uploaded twice.  each part takes a rule
+static void gen_upload_parts(test_rgw_env& env, int num_parts,
+                             vector<RGWObjManifest> *parts)
+{
+  const string upload_id = "abc123";
+  parts->resize(num_parts);
+  for (int i = 0; i < num_parts; ++i) {
+    uint64_t part_size = 5 * 1024 * 1024 + (i % 7) * 4096;
+    string prefix = upload_id;
+    if (i == num_parts / 2) {
+      prefix = upload_id + ".retried";
+    }
+    gen_part(env, prefix, i + 1, part_size, 4 * 1024 * 1024, &(*parts)[i]);
+  }
+}
+
+static void check_same_objs(test_rgw_env& env, RGWObjManifest& m1, RGWObjManifest& m2)
+{
+  ASSERT_EQ(m1.get_obj_size(), m2.get_obj_size());
+  auto i1 = m1.obj_begin();
+  auto i2 = m2.obj_begin();
+  for (; i1 != m1.obj_end() && i2 != m2.obj_end(); ++i1, ++i2) {
+    ASSERT_EQ(i1.get_ofs(), i2.get_ofs());
+    ASSERT_EQ(i1.get_stripe_size(), i2.get_stripe_size());
+    ASSERT_EQ(env.get_raw(i1.get_location()), env.get_raw(i2.get_location()));
+  }
+  ASSERT_TRUE(i1 == m1.obj_end());
+  ASSERT_TRUE(i2 == m2.obj_end());
+}
+
+TEST(TestRGWManifest, compact_rules) {
+  test_rgw_env env;
+  vector<RGWObjManifest> parts;
+  gen_upload_parts(env, 100, &parts);
+
+  RGWObjManifest m;
+  for (auto& part : parts) {
+    m.append(part, env.zonegroup, env.zone_params);
+  }
+
+  bufferlist bl;
+  encode(m, bl);
+  m.set_compact_rules(true);
+  bufferlist compact_bl;
+  encode(m, compact_bl);
+  cout << "100 parts: " << bl.length() << " bytes, compact "
+       << compact_bl.length() << " bytes" << std::endl;
+  ASSERT_LT(compact_bl.length() * 3, bl.length());
+
+  RGWObjManifest m2;
+  auto iter = compact_bl.cbegin();
+  decode(m2, iter);
+  check_same_objs(env, m, m2);
+
+  // objects stay compact when rewritten
+  bufferlist bl2;
+  encode(m2, bl2);
+  ASSERT_TRUE(bl2.contents_equal(compact_bl));
+
+  // seeks land on the same stripes
+  for (uint64_t ofs = 0; ofs < m.get_obj_size(); ofs += 3 * 1024 * 1024 + 17) {
+    auto f1 = m.obj_find(ofs);
+    auto f2 = m2.obj_find(ofs);
+    ASSERT_EQ(f1.get_stripe_ofs(), f2.get_stripe_ofs());
+    ASSERT_EQ(env.get_raw(f1.get_location()), env.get_raw(f2.get_location()));
+  }
+}
+
+// the manifest work done by CompleteMultipartUpload, for a large number
+// of parts: appending the manifest of every part, and encoding the result
+TEST(TestRGWManifest, complete_many_parts) {
+  test_rgw_env env;
+  using namespace std::chrono;
+  for (int num_parts : {1000, 10000}) {
+    vector<RGWObjManifest> parts;
+    gen_upload_parts(env, num_parts, &parts);
+
+    for (bool compact : {false, true}) {
+      auto start = steady_clock::now();
+      RGWObjManifest m;
+      for (auto& part : parts) {
+        m.append(part, env.zonegroup, env.zone_params);
+      }
+      m.set_compact_rules(compact);
+      bufferlist bl;
+      encode(m, bl);
+      auto complete = steady_clock::now();
+
+      RGWObjManifest m2;
+      auto iter = bl.cbegin();
+      decode(m2, iter);
+      auto decoded = steady_clock::now();
+
+      cout << num_parts << " parts" << (compact ? ", compact" : "")
+           << ": complete " << duration<double, std::milli>(complete - start).count()
+           << "ms, decode " << duration<double, std::milli>(decoded - complete).count()
+           << "ms, " << bl.length() << " bytes" << std::endl;
+      ASSERT_EQ(m.get_obj_size(), m2.get_obj_size());
+      if (compact) {
+        ASSERT_GT(16u * num_parts, bl.length());
+      }
+    }
+  }
+}
+
 TEST(TestRGWManifest, old_obj_manifest) {
   test_rgw_env env;
   OldObjManifest old_manifest;
@@ -0,0 +1,330 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+#include "rgw/rgw_common.h"
+#include "rgw/rgw_coroutine.h"
+#include "rgw/rgw_data_sync.h"
+#include "rgw/rgw_http_client.h"
+#include "rgw/rgw_perf_counters.h"
+#include "rgw/rgw_pubsub.h"
+#include "rgw/rgw_pubsub_push.h"
+#ifdef WITH_RADOSGW_AMQP_ENDPOINT
+#include "rgw/rgw_amqp.h"
+#endif
+#include "common/ceph_argparse.h"
+#include "common/ceph_json.h"
+#include "global/global_init.h"
+#include <mutex>
+#include <thread>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <gtest/gtest.h>
+
+namespace {
+
+using tcp = boost::asio::ip::tcp;
+
+// http server on a local port standing in for a push endpoint. it keeps the
+// body of every request, and answers all of them with the same status. it
+// runs on a single thread, which its destructor stops and joins
+class PushServer {
+  boost::asio::io_context context;
+  tcp::acceptor acceptor;
+  std::thread thread;
+  const std::string response;
+  std::mutex mutex;
+  std::vector<std::string> bodies;
+
+  static size_t content_length(const std::string& header) {
+    const auto lower = boost::algorithm::to_lower_copy(header);
+    const auto pos = lower.find("content-length:");
+    if (pos == std::string::npos) {
+      return 0;
+    }
+    return std::stoul(lower.substr(pos + strlen("content-length:")));
+  }
+
+  struct Connection : std::enable_shared_from_this<Connection> {
+    static constexpr std::string_view cont = "HTTP/1.1 100 Continue\r\n\r\n";
+    PushServer& server;
+    tcp::socket socket;
+    boost::asio::streambuf buf;
+    size_t length = 0;
+
+    Connection(PushServer& server, tcp::socket&& socket)
+      : server(server), socket(std::move(socket)) {}
+
+    void read_header() {
+      boost::asio::async_read_until(socket, buf, "\r\n\r\n",
+          [self = shared_from_this()] (boost::system::error_code ec, size_t n) {
+            if (ec) {
+              return;
+            }
+            const std::string header(boost::asio::buffers_begin(self->buf.data()),
+                                     boost::asio::buffers_begin(self->buf.data()) + n);
+            self->buf.consume(n);
+            self->length = content_length(header);
+            if (boost::algorithm::to_lower_copy(header).find("expect: 100-continue") != std::string::npos) {
+              boost::asio::async_write(self->socket, boost::asio::buffer(cont),
+                  [self] (boost::system::error_code ec, size_t) {
+                    if (!ec) {
+                      self->read_body();
+                    }
+                  });
+            } else {
+              self->read_body();
+            }
+          });
+    }
+    void read_body() {
+      const size_t needed = buf.size() < length ? length - buf.size() : 0;
+      boost::asio::async_read(socket, buf, boost::asio::transfer_exactly(needed),
+          [self = shared_from_this()] (boost::system::error_code ec, size_t) {
+            if (ec) {
+              return;
+            }
+            {
+              std::lock_guard l{self->server.mutex};
+              self->server.bodies.emplace_back(
+                  boost::asio::buffers_begin(self->buf.data()),
+                  boost::asio::buffers_begin(self->buf.data()) + self->length);
+            }
+            self->buf.consume(self->length);
+            boost::asio::async_write(self->socket, boost::asio::buffer(self->server.response),
+                [self] (boost::system::error_code ec, size_t) {
+                  if (!ec) {
+                    self->read_header();
+                  }
+                });
+          });
+    }
+  };
+
+  void accept() {
+    acceptor.async_accept([this] (boost::system::error_code ec, tcp::socket socket) {
+        if (ec) {
+          return;
+        }
+        std::make_shared<Connection>(*this, std::move(socket))->read_header();
+        accept();
+      });
+  }
+ public:
+  explicit PushServer(int status)
+    : acceptor(context, tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0)),
+      response("HTTP/1.1 " + std::to_string(status) + " Status\r\nContent-Length: 0\r\n\r\n")
+  {
+    accept();
+    thread = std::thread([this] { context.run(); });
+  }
+  ~PushServer() {
+    // the connections are dropped with the handlers that hold them
+    context.stop();
+    thread.join();
+  }
+
+  std::string url() const {
+    return "http://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port());
+  }
+  std::vector<std::string> get_bodies() {
+    std::lock_guard l{mutex};
+    return bodies;
+  }
+};
+
+// endpoint that fails the events without an id, and counts the sent ones
+class CountingEndpoint : public RGWPubSubEndpoint {
+  class SendCR : public RGWCoroutine {
+    const int r;
+   public:
+    SendCR(CephContext *cct, int r) : RGWCoroutine(cct), r(r) {}
+    int operate() override {
+      if (r < 0) {
+        return set_cr_error(r);
+      }
+      return set_cr_done();
+    }
+  };
+ public:
+  size_t sent = 0;
+
+  RGWCoroutine* send_to_completion_async(const rgw_pubsub_event& event, RGWDataSyncEnv* env) override {
+    ++sent;
+    return new SendCR(env->cct, event.id.empty() ? -EIO : 0);
+  }
+  RGWCoroutine* send_to_completion_async(const rgw_pubsub_s3_record& record, RGWDataSyncEnv* env) override {
+    ++sent;
+    return new SendCR(env->cct, record.id.empty() ? -EIO : 0);
+  }
+};
+
+// runs the coroutines endpoints return, with their own http manager
+class PushTest : public ::testing::Test {
+ protected:
+  RGWCoroutinesManager crs{g_ceph_context, nullptr};
+  RGWHTTPManager http{g_ceph_context, crs.get_completion_mgr()};
+  RGWDataSyncEnv env;
+
+  void SetUp() override {
+    ASSERT_EQ(0, http.start());
+    env.cct = g_ceph_context;
+    env.http_manager = &http;
+  }
+
+  int run(RGWCoroutine *cr) {
+    boost::intrusive_ptr<RGWCoroutine> ref{cr, false};
+    return crs.run(cr);
+  }
+
+  template <typename EventType>
+  static std::vector<EventType> make_events(size_t count) {
+    std::vector<EventType> events(count);
+    for (size_t i = 0; i < count; i++) {
+      events[i].id = "id" + std::to_string(i);
+    }
+    return events;
+  }
+};
+
+RGWPubSubEndpoint::Ptr make_endpoint(const std::string& url, const std::string& args = "")
+{
+  RGWHTTPArgs http_args;
+  http_args.set(args);
+  http_args.parse();
+  return RGWPubSubEndpoint::create(url, "topic", http_args, g_ceph_context);
+}
+
+size_t count_array(const std::string& body, const char *name)
+{
+  JSONParser p;
+  if (!p.parse(body.c_str(), body.size())) {
+    return 0;
+  }
+  auto iter = p.find_first(name);
+  if (iter.end() || !(*iter)->is_array()) {
+    return 0;
+  }
+  return (*iter)->get_array_elements().size();
+}
+
+} // anonymous namespace
+
+TEST_F(PushTest, HTTPBatchRecords)
+{
+  PushServer server(200);
+  auto endpoint = make_endpoint(server.url());
+
+  const auto records = make_events<rgw_pubsub_s3_record>(3);
+  ASSERT_EQ(0, run(endpoint->send_batch_to_completion_async(records, &env)));
+
+  // the batch is sent in a single request
+  const auto bodies = server.get_bodies();
+  ASSERT_EQ(1u, bodies.size());
+  EXPECT_EQ(3u, count_array(bodies[0], rgw_pubsub_s3_record::json_type_plural));
+}
+
+TEST_F(PushTest, HTTPBatchEvents)
+{
+  PushServer server(200);
+  auto endpoint = make_endpoint(server.url());
+
+  const auto events = make_events<rgw_pubsub_event>(5);
+  ASSERT_EQ(0, run(endpoint->send_batch_to_completion_async(events, &env)));
+
+  const auto bodies = server.get_bodies();
+  ASSERT_EQ(1u, bodies.size());
+  EXPECT_EQ(5u, count_array(bodies[0], rgw_pubsub_event::json_type_plural));
+}
+
+TEST_F(PushTest, HTTPBatchErrorStatus)
+{
+  PushServer server(500);
+  auto endpoint = make_endpoint(server.url(), "http-ack-level=non-error");
+
+  const auto records = make_events<rgw_pubsub_s3_record>(2);
+  EXPECT_GT(0, run(endpoint->send_batch_to_completion_async(records, &env)));
+  EXPECT_EQ(1u, server.get_bodies().size());
+}
+
+TEST_F(PushTest, HTTPBatchAckStatus)
+{
+  PushServer server(202);
+  auto endpoint = make_endpoint(server.url(), "http-ack-level=202");
+
+  const auto records = make_events<rgw_pubsub_s3_record>(2);
+  EXPECT_EQ(0, run(endpoint->send_batch_to_completion_async(records, &env)));
+}
+
+TEST_F(PushTest, HTTPBatchNoReply)
+{
+  std::string url;
+  {
+    // nothing listens on the port once the server is gone
+    PushServer server(200);
+    url = server.url();
+  }
+  auto endpoint = make_endpoint(url);
+
+  const auto records = make_events<rgw_pubsub_s3_record>(2);
+  EXPECT_GT(0, run(endpoint->send_batch_to_completion_async(records, &env)));
+}
+
+TEST_F(PushTest, DefaultBatch)
+{
+  CountingEndpoint endpoint;
+
+  auto events = make_events<rgw_pubsub_event>(4);
+  ASSERT_EQ(0, run(endpoint.send_batch_to_completion_async(events, &env)));
+  EXPECT_EQ(4u, endpoint.sent);
+
+  // all events are sent even if one of them failed
+  events[1].id.clear();
+  EXPECT_EQ(-EIO, run(endpoint.send_batch_to_completion_async(events, &env)));
+  EXPECT_EQ(8u, endpoint.sent);
+}
+
+#ifdef WITH_RADOSGW_AMQP_ENDPOINT
+TEST_F(PushTest, AMQPBatch)
+{
+  ASSERT_TRUE(rgw::amqp::init(g_ceph_context));
+  {
+    auto endpoint = make_endpoint("amqp://localhost", "amqp-exchange=ex1&amqp-ack-level=none");
+    const auto records = make_events<rgw_pubsub_s3_record>(3);
+    EXPECT_EQ(0, run(endpoint->send_batch_to_completion_async(records, &env)));
+  }
+  rgw::amqp::shutdown();
+}
+#endif
+
+int main(int argc, char** argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  rgw_perf_start(g_ceph_context);
+  rgw_http_client_init(cct->get());
+  rgw_setup_saved_curl_handles();
+  ::testing::InitGoogleTest(&argc, argv);
+  int r = RUN_ALL_TESTS();
+  rgw_release_all_curl_handles();
+  rgw_http_client_cleanup();
+  rgw_perf_stop(g_ceph_context);
+  return r;
+}
@@ -13,6 +13,13 @@
  */
 
 #include "rgw/rgw_putobj.h"
+#include "rgw/rgw_putobj_transform.h"
+#include <chrono>
+#include <thread>
+#ifdef HAVE_BOOST_CONTEXT
+#include <boost/asio/post.hpp>
+#include <boost/asio/spawn.hpp>
+#endif
 #include <gtest/gtest.h>
 
 inline bufferlist string_buf(const char* buf) {
@@ -194,3 +201,109 @@ TEST(PutObj_Stripe, SkipFirstChunk)
   ASSERT_EQ(4u, mock.ops.size());
   EXPECT_EQ(Op({"", 4}), mock.ops[3]); // flush
 }
+
+// uppercases each buffer, collecting the results in completion order
+struct MockTransform {
+  std::vector<Op> ops;
+  rgw::putobj::TransformQueue queue;
+
+  MockTransform(rgw::putobj::TransformPool* pool, size_t max_pending,
+                optional_yield y = null_yield)
+    : queue(pool, max_pending,
+            [this] (int r, bufferlist&& in, bufferlist&& out, uint64_t ofs) {
+              if (r < 0) {
+                return r;
+              }
+              ops.push_back({out.to_str(), ofs});
+              return 0;
+            }, y)
+  {}
+
+  int submit(const char* data, uint64_t offset, int result = 0) {
+    return queue.submit(string_buf(data), offset,
+        [result] (bufferlist& in, bufferlist& out) {
+          auto s = in.to_str();
+          // let later buffers finish first
+          std::this_thread::sleep_for(std::chrono::milliseconds(s.size()));
+          for (auto& c : s) {
+            c = toupper(c);
+          }
+          out.append(s);
+          return result;
+        });
+  }
+};
+
+TEST(PutObj_Transform, Inline)
+{
+  MockTransform mock(nullptr, 4);
+  ASSERT_EQ(0, mock.submit("aa", 0));
+  ASSERT_EQ(1u, mock.ops.size()); // completed immediately
+  EXPECT_EQ(Op({"AA", 0}), mock.ops[0]);
+  ASSERT_EQ(0, mock.queue.drain());
+}
+
+TEST(PutObj_Transform, Ordered)
+{
+  rgw::putobj::TransformPool pool(4);
+  MockTransform mock(&pool, 3);
+  ASSERT_EQ(0, mock.submit("aaaaaaaaaaaaaaaaaaaa", 0));
+  ASSERT_EQ(0, mock.submit("bbbbbbbbbb", 20));
+  ASSERT_EQ(0, mock.submit("c", 30));
+  ASSERT_EQ(0, mock.queue.submit(string_buf("d"), 31, nullptr));
+  ASSERT_EQ(0, mock.queue.drain());
+  ASSERT_EQ(4u, mock.ops.size());
+  EXPECT_EQ(Op({"AAAAAAAAAAAAAAAAAAAA", 0}), mock.ops[0]);
+  EXPECT_EQ(Op({"BBBBBBBBBB", 20}), mock.ops[1]);
+  EXPECT_EQ(Op({"C", 30}), mock.ops[2]);
+  EXPECT_EQ(Op({"", 31}), mock.ops[3]); // no transform, no output
+}
+
+TEST(PutObj_Transform, Bounded)
+{
+  rgw::putobj::TransformPool pool(4);
+  MockTransform mock(&pool, 2);
+  ASSERT_EQ(0, mock.submit("aaaaa", 0));
+  ASSERT_EQ(0, mock.submit("bbbbb", 5));
+  // waits for the first
+  ASSERT_EQ(0, mock.submit("ccccc", 10));
+  ASSERT_LE(1u, mock.ops.size());
+  ASSERT_EQ(0, mock.queue.drain());
+  ASSERT_EQ(3u, mock.ops.size());
+}
+
+TEST(PutObj_Transform, Error)
+{
+  rgw::putobj::TransformPool pool(2);
+  MockTransform mock(&pool, 4);
+  ASSERT_EQ(0, mock.submit("aa", 0));
+  ASSERT_EQ(0, mock.submit("bb", 2, -EIO));
+  ASSERT_EQ(0, mock.submit("cc", 4));
+  ASSERT_EQ(-EIO, mock.queue.drain());
+  ASSERT_EQ(1u, mock.ops.size());
+  ASSERT_EQ(-EIO, mock.submit("dd", 6));
+  // the destructor waits for "cc"
+}
+
+#ifdef HAVE_BOOST_CONTEXT
+TEST(PutObj_Transform, Yield)
+{
+  rgw::putobj::TransformPool pool(2);
+  boost::asio::io_context context;
+  bool other_ran = false;
+  boost::asio::spawn(context,
+    [&] (boost::asio::yield_context yield) {
+      MockTransform mock(&pool, 1, optional_yield{context, yield});
+      ASSERT_EQ(0, mock.submit("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 0));
+      // waits for the first, letting other handlers run meanwhile
+      ASSERT_EQ(0, mock.submit("b", 50));
+      EXPECT_TRUE(other_ran);
+      ASSERT_EQ(0, mock.queue.drain());
+      ASSERT_EQ(2u, mock.ops.size());
+      EXPECT_EQ(Op({"B", 50}), mock.ops[1]);
+    });
+  boost::asio::post(context, [&] { other_ran = true; });
+  context.run();
+  EXPECT_TRUE(other_ran);
+}
+#endif // HAVE_BOOST_CONTEXT
@@ -0,0 +1,139 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "rgw/rgw_quota_cache.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+RGWStorageStats make_stats(uint64_t num_objects, uint64_t size)
+{
+  RGWStorageStats stats;
+  stats.num_objects = num_objects;
+  stats.size = size;
+  stats.size_rounded = rgw_rounded_objsize(size);
+  return stats;
+}
+
+} // anonymous namespace
+
+TEST(QuotaStatsDelta, Apply)
+{
+  RGWQuotaStatsDelta delta;
+  delta.add(2, 8192, 0);
+  delta.add(-1, 0, 4096);
+  EXPECT_EQ(1, delta.num_objects);
+  EXPECT_EQ(4096, delta.size);
+
+  RGWStorageStats stats = make_stats(10, 40960);
+  delta.apply(stats);
+  EXPECT_EQ(11u, stats.num_objects);
+  EXPECT_EQ(45056u, stats.size);
+
+  // removals never take the stats below zero
+  RGWQuotaStatsDelta removed;
+  removed.add(-5, 0, 1 << 20);
+  RGWStorageStats small = make_stats(2, 4096);
+  removed.apply(small);
+  EXPECT_EQ(0u, small.num_objects);
+  EXPECT_EQ(0u, small.size);
+  EXPECT_EQ(0u, small.size_rounded);
+}
+
+TEST(QuotaCacheStats, RefreshKeepsLaterChanges)
+{
+  RGWQuotaCacheStats entry;
+  entry.stats = make_stats(10, 10000);
+  entry.delta.add(1, 1000, 0);
+  EXPECT_EQ(11u, entry.current().num_objects);
+
+  // the changes before the read are set aside, and still counted
+  entry.start_refresh();
+  EXPECT_EQ(0, entry.delta.num_objects);
+  EXPECT_EQ(11u, entry.current().num_objects);
+
+  // changes made while the read is in flight
+  entry.delta.add(2, 2000, 0);
+  EXPECT_EQ(13u, entry.current().num_objects);
+  EXPECT_EQ(13000u, entry.current().size);
+
+  // the read includes the changes set aside, but not the later ones
+  RGWQuotaCacheStats qs;
+  qs.stats = make_stats(11, 11000);
+  entry.refreshed(qs);
+  EXPECT_EQ(0, entry.refreshing.num_objects);
+  EXPECT_EQ(2, entry.delta.num_objects);
+  EXPECT_EQ(13u, entry.current().num_objects);
+  EXPECT_EQ(13000u, entry.current().size);
+}
+
+TEST(QuotaCacheStats, RefreshFailed)
+{
+  RGWQuotaCacheStats entry;
+  entry.stats = make_stats(10, 10000);
+  entry.delta.add(1, 1000, 0);
+  entry.start_refresh();
+  entry.delta.add(-3, 0, 3000);
+
+  // the changes set aside go back with the pending ones
+  entry.refresh_failed();
+  EXPECT_EQ(0, entry.refreshing.num_objects);
+  EXPECT_EQ(-2, entry.delta.num_objects);
+  EXPECT_EQ(-2000, entry.delta.size);
+  EXPECT_EQ(8u, entry.current().num_objects);
+  EXPECT_EQ(8000u, entry.current().size);
+
+  // and are set aside again by the next refresh
+  entry.start_refresh();
+  EXPECT_EQ(-2, entry.refreshing.num_objects);
+  EXPECT_EQ(0, entry.delta.num_objects);
+}
+
+TEST(QuotaCache, AsyncRefreshTime)
+{
+  const utime_t loaded(1000000, 0);
+  const double ttl = 600;
+  const utime_t earliest = loaded + utime_t(150, 0);
+  const utime_t latest = loaded + utime_t(450, 0);
+  utime_t first, last;
+  for (int i = 0; i < 1000; i++) {
+    const utime_t t = rgw_quota_async_refresh_time(loaded, ttl);
+    ASSERT_LE(earliest, t);
+    ASSERT_GE(latest, t);
+    if (i == 0 || t < first) {
+      first = t;
+    }
+    if (i == 0 || t > last) {
+      last = t;
+    }
+  }
+  // the refreshes are spread over the range
+  EXPECT_LT(first, loaded + utime_t(200, 0));
+  EXPECT_GT(last, loaded + utime_t(400, 0));
+}
+
+TEST(QuotaCache, RefreshLimit)
+{
+  RGWQuotaRefreshLimit limit;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(limit.get(4));
+  }
+  EXPECT_EQ(4u, limit.get_pending());
+
+  // the refreshes over the cap are left for later requests
+  EXPECT_FALSE(limit.get(4));
+  EXPECT_EQ(4u, limit.get_pending());
+
+  limit.put();
+  EXPECT_TRUE(limit.get(4));
+  EXPECT_FALSE(limit.get(4));
+
+  // a lower cap applies to the refreshes already in flight
+  EXPECT_FALSE(limit.get(2));
+  for (int i = 0; i < 4; i++) {
+    limit.put();
+  }
+  EXPECT_EQ(0u, limit.get_pending());
+  EXPECT_TRUE(limit.get(2));
+}
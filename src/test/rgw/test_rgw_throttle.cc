@@ -127,6 +127,23 @@ TEST_F(Aio_Throttle, CostOverWindow)
   EXPECT_EQ(-EDEADLK, c.front().result);
 }
 
+TEST_F(Aio_Throttle, SetWindow)
+{
+  BlockingAioThrottle throttle(4);
+  auto obj = make_obj(__PRETTY_FUNCTION__);
+
+  throttle.set_window(8);
+  {
+    // fits in the larger window, and doesn't have to wait
+    scoped_completion op1;
+    auto c1 = throttle.get(obj, wait_on(op1), 8, 0);
+    EXPECT_TRUE(c1.empty());
+  }
+  auto completions = throttle.drain();
+  ASSERT_EQ(1u, completions.size());
+  EXPECT_EQ(-ECANCELED, completions.front().result);
+}
+
 TEST_F(Aio_Throttle, ThrottleOverMax)
 {
   constexpr uint64_t window = 4;
@@ -687,3 +687,98 @@ TEST(TestFileJournal, ReplayDetectCorruptHeader) {
     ::close(fd);
   }
 }
+
+TEST(TestFileJournal, ReplayParallel) {
+  g_ceph_context->_conf.set_val("journal_ignore_corruption", "false");
+  g_ceph_context->_conf.set_val("journal_write_header_frequency", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  // entries 1..n each write to one of a few collections, every 10th
+  // entry also touches the next collection, and every 25th none at all
+  const unsigned num_colls = 4;
+  const uint64_t n = 200;
+  auto make_cid = [](unsigned i) {
+    return coll_t(spg_t(pg_t(i, 1), shard_id_t::NO_SHARD));
+  };
+  auto colls_of = [&](uint64_t seq) {
+    set<coll_t> colls;
+    if (seq % 25 == 0)
+      return colls;
+    colls.insert(make_cid(seq % num_colls));
+    if (seq % 10 == 0)
+      colls.insert(make_cid((seq + 1) % num_colls));
+    return colls;
+  };
+
+  fsid.generate_random();
+  FileJournal fj(g_ceph_context, fsid, finisher, &sync_cond, path,
+		 true, true, true);
+  ASSERT_EQ(0, fj.create());
+  ASSERT_EQ(0, fj.make_writeable());
+  {
+    C_SaferCond committed;
+    C_GatherBuilder gb(g_ceph_context, &committed);
+    for (uint64_t seq = 1; seq <= n; ++seq) {
+      vector<ObjectStore::Transaction> tls(1);
+      bufferlist data;
+      data.append("data");
+      for (auto& cid : colls_of(seq)) {
+	tls[0].write(cid, ghobject_t(hobject_t("obj", "", CEPH_NOSNAP, 0, 1, "")),
+		     0, data.length(), data);
+      }
+      if (tls[0].empty())
+	tls[0].nop();
+      bufferlist bl;
+      int orig_len = fj.prepare_entry(tls, &bl);
+      fj.reserve_throttle_and_backoff(bl.length());
+      fj.submit_entry(seq, bl, orig_len, gb.new_sub());
+    }
+    gb.activate();
+    committed.wait();
+  }
+  fj.close();
+
+  Mutex lock("ReplayParallel::lock");
+  map<coll_t, uint64_t> last_applied;
+  set<uint64_t> applied;
+  unsigned in_flight = 0, max_in_flight = 0;
+  bool out_of_order = false;
+  {
+    JournalReplayer replayer(
+      g_ceph_context, 4, 4096,
+      [&](vector<ObjectStore::Transaction>& tls, uint64_t seq) {
+	{
+	  Mutex::Locker l(lock);
+	  max_in_flight = std::max(max_in_flight, ++in_flight);
+	}
+	// give the other threads a chance to overlap
+	usleep(1000);
+	Mutex::Locker l(lock);
+	--in_flight;
+	auto colls = colls_of(seq);
+	if (colls.empty() && in_flight > 0)
+	  out_of_order = true;
+	for (auto& cid : colls) {
+	  if (last_applied[cid] >= seq)
+	    out_of_order = true;
+	  last_applied[cid] = seq;
+	}
+	applied.insert(seq);
+      });
+    ASSERT_EQ(0, fj.open(0));
+    bufferlist bl;
+    uint64_t seq = 0;
+    while (fj.read_entry(bl, seq)) {
+      replayer.queue(seq, bl);
+      bl.clear();
+    }
+    replayer.drain();
+    ASSERT_EQ(0, fj.make_writeable());
+    fj.close();
+  }
+  ASSERT_FALSE(out_of_order);
+  ASSERT_EQ(n, applied.size());
+  ASSERT_EQ(1u, *applied.begin());
+  ASSERT_EQ(n, *applied.rbegin());
+  ASSERT_GT(max_in_flight, 1u);
+}
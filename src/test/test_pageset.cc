@@ -1,5 +1,6 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
+#include <set>
 #include "gtest/gtest.h"
 
 #include "os/memstore/PageSet.h"
@@ -281,3 +282,125 @@ TEST(PageSet, FreeHoles)
   pages.get_range(0, 8, range);
   ASSERT_EQ(0u, range.size());
 }
+
+TEST(PageSet, CloneShares)
+{
+  PageSet src(4);
+  PageSet::page_vector range;
+  src.alloc_range(0, 16, range);
+  for (auto& p : range)
+    memset(p->data, 'a' + p->offset / 4, 4);
+  range.clear();
+
+  // clone pages 1 and 2 to offset 8
+  PageSet dst(4);
+  dst.clone_range(src, 4, 8, 8);
+  dst.get_range(0, 16, range);
+  ASSERT_EQ(2u, range.size());
+  ASSERT_EQ(8u, range[0]->offset);
+  ASSERT_EQ(12u, range[1]->offset);
+  ASSERT_TRUE(range[0]->is_shared());
+  ASSERT_EQ(0, memcmp(range[0]->data, "bbbb", 4));
+  ASSERT_EQ(0, memcmp(range[1]->data, "cccc", 4));
+  range.clear();
+
+  src.get_range(4, 4, range);
+  ASSERT_EQ(1u, range.size());
+  const char *shared = range[0]->data;
+  ASSERT_TRUE(range[0]->is_shared());
+  range.clear();
+
+  // writing to the clone copies the page, the source is unchanged
+  dst.alloc_range(9, 2, range);
+  ASSERT_EQ(1u, range.size());
+  ASSERT_NE(shared, range[0]->data);
+  ASSERT_FALSE(range[0]->is_shared());
+  // only the bytes outside of the allocated range are copied
+  ASSERT_EQ('b', range[0]->data[0]);
+  ASSERT_EQ('b', range[0]->data[3]);
+  memset(range[0]->data + 1, 'x', 2);
+  range.clear();
+
+  src.get_range(4, 4, range);
+  ASSERT_EQ(shared, range[0]->data);
+  ASSERT_FALSE(range[0]->is_shared());
+  ASSERT_EQ(0, memcmp(range[0]->data, "bbbb", 4));
+  range.clear();
+}
+
+TEST(PageSet, CloneHoles)
+{
+  // source pages at offsets 0 and 3, destination fully allocated
+  PageSet src(1);
+  PageSet::page_vector range;
+  for (uint64_t i : {0, 3})
+    src.alloc_range(i, 1, range);
+  range.clear();
+
+  PageSet dst(1);
+  dst.alloc_range(0, 4, range);
+  range.clear();
+
+  // holes in the source punch holes in the destination
+  dst.clone_range(src, 0, 4, 0);
+  dst.get_range(0, 4, range);
+  ASSERT_EQ(2u, range.size());
+  ASSERT_EQ(0u, range[0]->offset);
+  ASSERT_EQ(3u, range[1]->offset);
+  range.clear();
+}
+
+TEST(PageSet, CloneSelf)
+{
+  PageSet pages(1);
+  PageSet::page_vector range;
+  pages.alloc_range(0, 2, range);
+  range[0]->data[0] = 'a';
+  range[1]->data[0] = 'b';
+  range.clear();
+
+  pages.clone_range(pages, 0, 2, 4);
+  pages.get_range(0, 8, range);
+  ASSERT_EQ(4u, range.size());
+  ASSERT_EQ(range[0]->data, range[2]->data);
+  ASSERT_EQ(range[1]->data, range[3]->data);
+  ASSERT_EQ(4u, range[2]->offset);
+  range.clear();
+}
+
+TEST(PageAllocator, Arenas)
+{
+  // a page size no other test uses, to get a fresh allocator
+  const size_t page_size = 64 << 10;
+  auto& alloc = PageAllocator::get(page_size);
+  ASSERT_EQ(&alloc, &PageAllocator::get(page_size));
+  ASSERT_EQ(0u, alloc.get_num_arenas());
+
+  auto& pool = mempool::get_pool(mempool::mempool_memstore_data);
+  const size_t bytes = pool.allocated_bytes();
+  const size_t per_arena = PageAllocator::arena_size / page_size;
+  {
+    PageSet pages(page_size);
+    PageSet::page_vector range;
+    pages.alloc_range(0, page_size * (per_arena + 1), range);
+    ASSERT_EQ(per_arena + 1, range.size());
+    for (auto& p : range)
+      ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(p->data) % page_size);
+    ASSERT_EQ(2u, alloc.get_num_arenas());
+    ASSERT_EQ(bytes + 2 * PageAllocator::arena_size, pool.allocated_bytes());
+
+    // the arena emptied here is kept as a spare, while new pages fill up
+    // the partially used one
+    std::set<char*> freed;
+    for (size_t i = 1; i <= per_arena; i++)
+      freed.insert(range[i]->data);
+    range.clear();
+    pages.free_pages_after(page_size);
+    pages.alloc_range(page_size, page_size, range);
+    ASSERT_EQ(0u, freed.count(range[0]->data));
+    ASSERT_EQ(2u, alloc.get_num_arenas());
+  }
+  // one empty arena is kept around
+  ASSERT_EQ(1u, alloc.get_num_arenas());
+  ASSERT_EQ(bytes + PageAllocator::arena_size, pool.allocated_bytes());
+}
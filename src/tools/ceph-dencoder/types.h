@@ -381,6 +381,7 @@ TYPE(rgw_bucket_pending_info)
 TYPE(rgw_bucket_dir_entry_meta)
 TYPE(rgw_bucket_entry_ver)
 TYPE(rgw_bucket_dir_entry)
+TYPE(rgw_bucket_inline_data)
 TYPE(rgw_bucket_category_stats)
 TYPE(rgw_bucket_dir_header)
 TYPE(rgw_bucket_dir)
@@ -392,6 +393,9 @@ TYPE(rgw_usage_log_entry)
 #include "cls/rgw/cls_rgw_ops.h"
 TYPE(rgw_cls_obj_prepare_op)
 TYPE(rgw_cls_obj_complete_op)
+TYPE(rgw_cls_obj_put_inline_op)
+TYPE(rgw_cls_guard_inline_entry_op)
+TYPE(rgw_cls_obj_complete_ops_op)
 TYPE(rgw_cls_list_op)
 TYPE(rgw_cls_list_ret)
 TYPE(cls_rgw_gc_defer_entry_op)